@@ -25,24 +25,53 @@
 
 #include "BdryQuadDivider.h"
 
-void BdryQuadDivider::divideInterior() {
+namespace {
+	struct BdryQuadStencil {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			auto L = [nDivs](const int ii, const int jj) {
+				return packedLatticeIndex(BdryQuadTraits::latticeShape, nDivs, ii, jj, 0);
+			};
+			for (int jj = 0; jj <= nDivs - 1; jj++) {
+				for (int ii = 0; ii <= nDivs - 1; ii++) {
+					const int verts[] = { L(ii, jj), L(ii + 1, jj), L(ii + 1, jj + 1), L(
+							ii, jj + 1) };
+					pushCell(out, verts);
+				} // Done with all quads for this row.
+			} // Done with this row (constant j)
+		}
+	};
+
+	template<int NDIVS>
+	struct FixedBdryQuadTables {
+		static constexpr auto quadStencil = makeFixedTable<int, BdryQuadStencil,
+				NDIVS>();
+	};
+}
+
+template<int NDIVS, typename MapT>
+void BdryQuadDivider<NDIVS, MapT>::divideInterior() {
+}
+
+template<int NDIVS, typename MapT>
+void BdryQuadDivider<NDIVS, MapT>::setupTables() {
+	m_quadStencil = makeTable<int, BdryQuadStencil>(nDivs);
 }
 
-void BdryQuadDivider::createNewCells() {
+template<int NDIVS, typename MapT>
+void BdryQuadDivider<NDIVS, MapT>::createNewCells() {
 	// Okay, sure, these aren't actually cells in the usual sense, but so what?
-	for (int jj = 0; jj <= nDivs - 1; jj++) {
-		int ii = -1;
-		for (ii = 0; ii <= nDivs - 1; ii++) {
-			emInt vertsNew1[] = { localVerts[ii][jj][0], localVerts[ii + 1][jj][0],
-														localVerts[ii + 1][jj + 1][0],
-														localVerts[ii][jj + 1][0] };
-#ifndef NDEBUG
-			emInt bdryQuad =
-#endif
-			m_pMesh->addBdryQuad(vertsNew1);
-			assert(
-					m_pMesh->numBdryQuads() <= m_pMesh->maxNBdryQuads());
-		} // Done with all quads for this row.
-	} // Done with this row (constant j)
+	if constexpr (NDIVS > 0) {
+		this->appendFromStencil(FixedBdryQuadTables<NDIVS>::quadStencil,
+													&RefineSink::addBdryQuads);
+	}
+	else {
+		this->appendFromStencil(m_quadStencil, &RefineSink::addBdryQuads);
+	}
 }
 
+template class BdryQuadDivider<0>;
+template class BdryQuadDivider<2>;
+template class BdryQuadDivider<3>;
+template class BdryQuadDivider<4>;
+template class BdryQuadDivider<8>;
@@ -28,61 +28,35 @@
 
 #include "CellDivider.h"
 
-class BdryQuadDivider: public CellDivider {
+// NDIVS is either the number of divisions per edge, known at compile time,
+// or 0 for a divider whose tables are built at run time.
+template<int NDIVS, typename MapT = NoMapping>
+class BdryQuadDivider: public CellDivider<BdryQuadDivider<NDIVS, MapT>,
+		BdryQuadTraits, MapT, NDIVS> {
+	typedef CellDivider<BdryQuadDivider<NDIVS, MapT>, BdryQuadTraits, MapT,
+			NDIVS> Base;
+	using Base::nDivs;
+	using Base::m_pMesh;
+	using Base::localVerts;
+	using Base::addInteriorVerts;
+	using Base::appendFromStencil;
 public:
-	BdryQuadDivider(UMesh *pVolMesh, const int segmentsPerEdge) :
-			CellDivider(pVolMesh, segmentsPerEdge) {
-		vertIJK[0][0] = 0;
-		vertIJK[0][1] = 0;
-		vertIJK[0][2] = 0;
-
-		vertIJK[1][0] = nDivs;
-		vertIJK[1][1] = 0;
-		vertIJK[1][2] = 0;
-
-		vertIJK[2][0] = nDivs;
-		vertIJK[2][1] = nDivs;
-		vertIJK[2][2] = 0;
-
-		vertIJK[3][0] = 0;
-		vertIJK[3][1] = nDivs;
-		vertIJK[3][2] = 0;
-
-		numVerts = 4;
-		numEdges = 4;
-		numTriFaces = 0;
-		numQuadFaces = 1;
-		edgeVertIndices[0][0] = 0;
-		edgeVertIndices[0][1] = 1;
-
-		edgeVertIndices[1][0] = 1;
-		edgeVertIndices[1][1] = 2;
-
-		edgeVertIndices[2][0] = 2;
-		edgeVertIndices[2][1] = 3;
-
-		edgeVertIndices[3][0] = 3;
-		edgeVertIndices[3][1] = 0;
-
-		faceVertIndices[0][0] = 0;
-		faceVertIndices[0][1] = 1;
-		faceVertIndices[0][2] = 2;
-		faceVertIndices[0][3] = 3;
+	BdryQuadDivider(RefineSink *pSink, const ExaMesh* const pInitMesh,
+			const int segmentsPerEdge) :
+			Base(pSink, pInitMesh, segmentsPerEdge) {
+		if (NDIVS == 0) {
+			setupTables();
+		}
 	}
 	~BdryQuadDivider() {
 	}
 	void divideInterior();
 	void createNewCells();
-
-	// TODO: Currently, there's no coord mapping set up for bdry faces
-	void setupCoordMapping(const emInt verts[]) {
-		for (int ii = 0; ii < 4; ii++) {
-			cellVerts[ii] = verts[ii];
-		}
-
-	}
-	void getPhysCoordsFromParamCoords(const double /*uvw*/[], double /*xyz*/[]) {
-	}
+private:
+	// Lattice indices for the new quads, 4 per quad; only filled in when
+	// NDIVS is 0.
+	std::vector<int> m_quadStencil;
+	void setupTables();
 };
 
 
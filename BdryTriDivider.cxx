@@ -25,33 +25,62 @@
 
 #include "BdryTriDivider.h"
 
-void BdryTriDivider::divideInterior() {
+namespace {
+	struct BdryTriStencil {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			auto L = [nDivs](const int ii, const int jj) {
+				return packedLatticeIndex(BdryTriTraits::latticeShape, nDivs, ii, jj, 0);
+			};
+			// Create topologically up-pointing triangles.
+			for (int jj = 0; jj <= nDivs - 1; jj++) {
+				int ii = -1;
+				for (ii = 0; ii <= nDivs - jj - 2; ii++) {
+					const int verts1[] = { L(ii, jj), L(ii + 1, jj), L(ii, jj + 1) };
+					pushCell(out, verts1);
+
+					// And now the other in that pair:
+					const int verts2[] = { verts1[1], L(ii + 1, jj + 1), verts1[2] };
+					pushCell(out, verts2);
+				} // Done with all prism pairs for this row.
+				// Now one more at the end.
+				ii = nDivs - jj - 1;
+				const int vertsLast[] = { L(ii, jj), L(ii + 1, jj), L(ii, jj + 1) };
+				pushCell(out, vertsLast);
+			} // Done with this row (constant j)
+		}
+	};
+
+	template<int NDIVS>
+	struct FixedBdryTriTables {
+		static constexpr auto triStencil = makeFixedTable<int, BdryTriStencil,
+				NDIVS>();
+	};
+}
+
+template<int NDIVS, typename MapT>
+void BdryTriDivider<NDIVS, MapT>::divideInterior() {
+}
+
+template<int NDIVS, typename MapT>
+void BdryTriDivider<NDIVS, MapT>::setupTables() {
+	m_triStencil = makeTable<int, BdryTriStencil>(nDivs);
 }
 
-void BdryTriDivider::createNewCells() {
+template<int NDIVS, typename MapT>
+void BdryTriDivider<NDIVS, MapT>::createNewCells() {
 	// Okay, sure, these aren't actually cells in the usual sense, but so what?
-	// Create topologically up-pointing triangles.
-	for (int jj = 0; jj <= nDivs - 1; jj++) {
-		int ii = -1;
-		for (ii = 0; ii <= nDivs - jj - 2; ii++) {
-			emInt vertsNew1[] = { localVerts[ii][jj][0], localVerts[ii + 1][jj][0],
-														localVerts[ii][jj + 1][0] };
-			m_pMesh->addBdryTri(vertsNew1);
-			assert(m_pMesh->numBdryTris() <= m_pMesh->maxNBdryTris());
-
-			// And now the other in that pair:
-			emInt vertsNew2[] = { vertsNew1[1], localVerts[ii + 1][jj + 1][0],
-														vertsNew1[2] };
-			m_pMesh->addBdryTri(vertsNew2);
-			assert(m_pMesh->numBdryTris() < m_pMesh->maxNBdryTris());
-		} // Done with all prism pairs for this row.
-		// Now one more at the end.
-		ii = nDivs - jj - 1;
-		emInt vertsNewLast[] = { localVerts[ii][jj][0], localVerts[ii + 1][jj][0],
-															localVerts[ii][jj + 1][0] };
-
-		m_pMesh->addBdryTri(vertsNewLast);
-		assert(m_pMesh->numBdryTris() <= m_pMesh->maxNBdryTris());
-	} // Done with this row (constant j)
+	if constexpr (NDIVS > 0) {
+		this->appendFromStencil(FixedBdryTriTables<NDIVS>::triStencil,
+													&RefineSink::addBdryTris);
+	}
+	else {
+		this->appendFromStencil(m_triStencil, &RefineSink::addBdryTris);
+	}
 }
 
+template class BdryTriDivider<0>;
+template class BdryTriDivider<2>;
+template class BdryTriDivider<3>;
+template class BdryTriDivider<4>;
+template class BdryTriDivider<8>;
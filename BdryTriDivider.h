@@ -28,53 +28,34 @@
 
 #include "CellDivider.h"
 
-class BdryTriDivider: public CellDivider {
+// NDIVS is either the number of divisions per edge, known at compile time,
+// or 0 for a divider whose tables are built at run time.
+template<int NDIVS, typename MapT = NoMapping>
+class BdryTriDivider: public CellDivider<BdryTriDivider<NDIVS, MapT>, BdryTriTraits, MapT,
+		NDIVS> {
+	typedef CellDivider<BdryTriDivider<NDIVS, MapT>, BdryTriTraits, MapT, NDIVS> Base;
+	using Base::nDivs;
+	using Base::m_pMesh;
+	using Base::localVerts;
+	using Base::addInteriorVerts;
+	using Base::appendFromStencil;
 public:
-	BdryTriDivider(UMesh *pVolMesh, const int segmentsPerEdge) :
-			CellDivider(pVolMesh, segmentsPerEdge) {
-		vertIJK[0][0] = 0;
-		vertIJK[0][1] = 0;
-		vertIJK[0][2] = 0;
-
-		vertIJK[1][0] = nDivs;
-		vertIJK[1][1] = 0;
-		vertIJK[1][2] = 0;
-
-		vertIJK[2][0] = 0;
-		vertIJK[2][1] = nDivs;
-		vertIJK[2][2] = 0;
-
-		numVerts = 3;
-		numEdges = 3;
-		numTriFaces = 1;
-		numQuadFaces = 0;
-		edgeVertIndices[0][0] = 0;
-		edgeVertIndices[0][1] = 1;
-
-		edgeVertIndices[1][0] = 1;
-		edgeVertIndices[1][1] = 2;
-
-		edgeVertIndices[2][0] = 2;
-		edgeVertIndices[2][1] = 0;
-
-		faceVertIndices[0][0] = 0;
-		faceVertIndices[0][1] = 1;
-		faceVertIndices[0][2] = 2;
+	BdryTriDivider(RefineSink *pSink, const ExaMesh* const pInitMesh,
+			const int segmentsPerEdge) :
+			Base(pSink, pInitMesh, segmentsPerEdge) {
+		if (NDIVS == 0) {
+			setupTables();
+		}
 	}
 	~BdryTriDivider() {
 	}
 	void divideInterior();
 	void createNewCells();
-
-	// TODO: Currently, there's no coord mapping set up for bdry faces
-	void setupCoordMapping(const emInt verts[]) {
-		for (int ii = 0; ii < 3; ii++) {
-			cellVerts[ii] = verts[ii];
-		}
-
-	}
-	void getPhysCoordsFromParamCoords(const double /*uvw*/[], double /*xyz*/[]) {
-	}
+private:
+	// Lattice indices for the new triangles, 3 per triangle; only filled in
+	// when NDIVS is 0.
+	std::vector<int> m_triStencil;
+	void setupTables();
 };
 
 
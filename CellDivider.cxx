@@ -26,6 +26,111 @@
 #include "ExaMesh.h"
 #include "GeomUtils.h"
 #include "CellDivider.h"
+#include "TetDivider.h"
+#include "PyrDivider.h"
+#include "PrismDivider.h"
+#include "HexDivider.h"
+#include "BdryTriDivider.h"
+#include "BdryQuadDivider.h"
+
+namespace {
+	// Corner of a cell face (as a cell vert index) that matches corner
+	// "which" of a face stored with the given orientation.  Orientations
+	// 0..nCorners-1 are rotations of the cell's own corner order;
+	// nCorners..2*nCorners-1 are rotations of the reversed order.
+	template<typename Traits>
+	constexpr int orientedFaceCorner(const int face, const int nCorners,
+			const int orient, const int which) {
+		const int rot = orient % nCorners;
+		const int local =
+				orient < nCorners ?
+						(rot + which) % nCorners : (rot - which + nCorners) % nCorners;
+		return Traits::faceVerts[face][local];
+	}
+
+	// Lattice indices for the verts along each edge, in both directions.  Entry
+	// ((edge * 2 + dir) * (nDivs + 1) + ii) is vert ii along the edge, counting
+	// from edgeVerts[edge][dir].
+	template<typename Traits>
+	struct EdgeTranscription {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			for (int iE = 0; iE < Traits::numEdges; iE++) {
+				for (int dir = 0; dir < 2; dir++) {
+					const int start = Traits::edgeVerts[iE][dir];
+					const int end = Traits::edgeVerts[iE][1 - dir];
+					int ijk[3] = { 0, 0, 0 };
+					for (int ii = 0; ii <= nDivs; ii++) {
+						for (int cc = 0; cc < 3; cc++) {
+							ijk[cc] = Traits::vertIJK[start][cc] * nDivs
+									+ (Traits::vertIJK[end][cc] - Traits::vertIJK[start][cc]) * ii;
+						}
+						out.push_back(packedLatticeIndex(Traits::latticeShape, nDivs,
+																							ijk[0], ijk[1], ijk[2]));
+					}
+				}
+			}
+		}
+	};
+
+	// Lattice indices for the interior verts of each face, for every
+	// orientation in which a neighbor may have stored the face.  Entries are
+	// in the same order as the face's intVerts array: all quad faces (8
+	// orientations each), then all tri faces (6 orientations each).
+	template<typename Traits>
+	struct FaceTranscription {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			for (int iF = 0; iF < Traits::numQuadFaces; iF++) {
+				for (int orient = 0; orient < 8; orient++) {
+					const int c0 = orientedFaceCorner<Traits>(iF, 4, orient, 0);
+					const int c1 = orientedFaceCorner<Traits>(iF, 4, orient, 1);
+					const int c3 = orientedFaceCorner<Traits>(iF, 4, orient, 3);
+					for (int jj = 1; jj <= nDivs - 1; jj++) {
+						for (int ii = 1; ii <= nDivs - 1; ii++) {
+							int ijk[3] = { 0, 0, 0 };
+							for (int cc = 0; cc < 3; cc++) {
+								ijk[cc] = Traits::vertIJK[c0][cc] * nDivs
+										+ (Traits::vertIJK[c1][cc] - Traits::vertIJK[c0][cc]) * ii
+										+ (Traits::vertIJK[c3][cc] - Traits::vertIJK[c0][cc]) * jj;
+							}
+							out.push_back(packedLatticeIndex(Traits::latticeShape, nDivs,
+																								ijk[0], ijk[1], ijk[2]));
+						}
+					}
+				}
+			}
+			for (int iF = Traits::numQuadFaces;
+					iF < Traits::numQuadFaces + Traits::numTriFaces; iF++) {
+				for (int orient = 0; orient < 6; orient++) {
+					const int c0 = orientedFaceCorner<Traits>(iF, 3, orient, 0);
+					const int c1 = orientedFaceCorner<Traits>(iF, 3, orient, 1);
+					const int c2 = orientedFaceCorner<Traits>(iF, 3, orient, 2);
+					for (int jj = 1; jj <= nDivs - 2; jj++) {
+						for (int ii = 1; ii <= nDivs - 1 - jj; ii++) {
+							int ijk[3] = { 0, 0, 0 };
+							for (int cc = 0; cc < 3; cc++) {
+								ijk[cc] = Traits::vertIJK[c0][cc] * nDivs
+										+ (Traits::vertIJK[c1][cc] - Traits::vertIJK[c0][cc]) * ii
+										+ (Traits::vertIJK[c2][cc] - Traits::vertIJK[c0][cc]) * jj;
+							}
+							out.push_back(packedLatticeIndex(Traits::latticeShape, nDivs,
+																								ijk[0], ijk[1], ijk[2]));
+						}
+					}
+				}
+			}
+		}
+	};
+
+	template<typename Traits, int NDIVS>
+	struct FixedTranscriptionTables {
+		static constexpr auto edges = makeFixedTable<int,
+				EdgeTranscription<Traits>, NDIVS>();
+		static constexpr auto faces = makeFixedTable<int,
+				FaceTranscription<Traits>, NDIVS>();
+	};
+}
 
 void sortVerts3(const emInt input[3], emInt output[3]) {
 	// This is insertion sort, specialized for three inputs.
@@ -60,6 +165,7 @@ TriFaceVerts::TriFaceVerts(const emInt v0, const emInt v1, const emInt v2,
 	volElement = elemInd;
 	volElementType = type;
 	intVerts = nullptr;
+	nDivs = 0;
 	setupSorted();
 }
 
@@ -87,6 +193,8 @@ QuadFaceVerts::QuadFaceVerts(const emInt v0, const emInt v1, const emInt v2,
 	corners[3] = v3;
 	volElement = elemInd;
 	volElementType = type;
+	intVerts = nullptr;
+	nDivs = 0;
 	setupSorted();
 }
 
@@ -154,7 +262,9 @@ bool operator<(const QuadFaceVerts& a, const QuadFaceVerts& b) {
 					&& a.sorted[2] == b.sorted[2] && a.sorted[3] < b.sorted[3]));
 }
 
-int CellDivider::checkOrient3D(const emInt verts[4]) const {
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+int CellDivider<Derived, Traits, MapT, NDIVS>::checkOrient3D(
+		const emInt verts[4]) const {
 	double coords0[3], coords1[3], coords2[3], coords3[3];
 	m_pMesh->getCoords(verts[0], coords0);
 	m_pMesh->getCoords(verts[1], coords1);
@@ -163,10 +273,84 @@ int CellDivider::checkOrient3D(const emInt verts[4]) const {
 	return ::checkOrient3D(coords0, coords1, coords2, coords3);
 }
 
-void CellDivider::getEdgeVerts(exa_map<Edge, EdgeVerts> &vertsOnEdges,
-		const int edge, const double dihedral, EdgeVerts &EV) {
-	int ind0 = edgeVertIndices[edge][0];
-	int ind1 = edgeVertIndices[edge][1];
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+void CellDivider<Derived, Traits, MapT, NDIVS>::getEdgePointCoords(
+		const int edge, const int step, double xyz[3]) const {
+	int ind0 = Traits::edgeVerts[edge][0];
+	int ind1 = Traits::edgeVerts[edge][1];
+	if (cellVerts[ind1] < cellVerts[ind0]) {
+		std::swap(ind0, ind1);
+	}
+	const double* const uvwStart = Traits::vertUVW[ind0];
+	const double* const uvwEnd = Traits::vertUVW[ind1];
+	double delta[] = { (uvwEnd[0] - uvwStart[0]) / nDivs, (uvwEnd[1]
+			- uvwStart[1])
+																												/ nDivs,
+											(uvwEnd[2] - uvwStart[2]) / nDivs };
+	double uvw[] = { uvwStart[0] + step * delta[0], uvwStart[1] + step * delta[1],
+										uvwStart[2] + step * delta[2] };
+	getPhysCoordsFromParamCoords(uvw, xyz);
+}
+
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+void CellDivider<Derived, Traits, MapT, NDIVS>::getTriFacePointCoords(
+		const int face, const int ii, const int jj, double xyz[3]) const {
+	const double inv_nDivs = 1. / (nDivs);
+	const double* const uvw0 = Traits::vertUVW[Traits::faceVerts[face][0]];
+	const double* const uvw1 = Traits::vertUVW[Traits::faceVerts[face][1]];
+	const double* const uvw2 = Traits::vertUVW[Traits::faceVerts[face][2]];
+
+	double deltaUVWInI[] = { (uvw1[0] - uvw0[0]) * inv_nDivs,
+														(uvw1[1] - uvw0[1]) * inv_nDivs, (uvw1[2]
+																- uvw0[2])
+																															* inv_nDivs };
+	double deltaUVWInJ[] = { (uvw2[0] - uvw0[0]) * inv_nDivs,
+														(uvw2[1] - uvw0[1]) * inv_nDivs, (uvw2[2]
+																- uvw0[2])
+																															* inv_nDivs };
+	double uvw[] = { uvw0[0] + deltaUVWInI[0] * ii + deltaUVWInJ[0] * jj,
+										uvw0[1] + deltaUVWInI[1] * ii + deltaUVWInJ[1] * jj,
+										uvw0[2] + deltaUVWInI[2] * ii + deltaUVWInJ[2] * jj };
+	getPhysCoordsFromParamCoords(uvw, xyz);
+}
+
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+void CellDivider<Derived, Traits, MapT, NDIVS>::getQuadFacePointCoords(
+		const int face, const int ii, const int jj, double xyz[3]) const {
+	const double inv_nDivs = 1. / (nDivs);
+	const double* const uvw0 = Traits::vertUVW[Traits::faceVerts[face][0]];
+	const double* const uvw1 = Traits::vertUVW[Traits::faceVerts[face][1]];
+	const double* const uvw2 = Traits::vertUVW[Traits::faceVerts[face][2]];
+	const double* const uvw3 = Traits::vertUVW[Traits::faceVerts[face][3]];
+
+	double deltaInI[] = { (uvw1[0] - uvw0[0]) * inv_nDivs, (uvw1[1] - uvw0[1])
+			* inv_nDivs,
+												(uvw1[2] - uvw0[2]) * inv_nDivs };
+	double deltaInJ[] = { (uvw3[0] - uvw0[0]) * inv_nDivs, (uvw3[1] - uvw0[1])
+			* inv_nDivs,
+												(uvw3[2] - uvw0[2]) * inv_nDivs };
+
+	double crossDelta[] = { (uvw2[0] + uvw0[0] - uvw1[0] - uvw3[0])
+			* (inv_nDivs * inv_nDivs),
+													(uvw2[1] + uvw0[1] - uvw1[1] - uvw3[1]) * (inv_nDivs
+															* inv_nDivs),
+													(uvw2[2] + uvw0[2] - uvw1[2] - uvw3[2]) * (inv_nDivs
+															* inv_nDivs) };
+	double uvw[] = { uvw0[0] + deltaInI[0] * ii + deltaInJ[0] * jj
+											+ crossDelta[0] * ii * jj,
+										uvw0[1] + deltaInI[1] * ii + deltaInJ[1] * jj
+											+ crossDelta[1] * ii * jj,
+										uvw0[2] + deltaInI[2] * ii + deltaInJ[2] * jj
+											+ crossDelta[2] * ii * jj };
+	getPhysCoordsFromParamCoords(uvw, xyz);
+}
+
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+const emInt* CellDivider<Derived, Traits, MapT, NDIVS>::getEdgeVerts(
+		exa_map<Edge, EdgeVerts> &vertsOnEdges, const int edge,
+		const double dihedral) {
+	int ind0 = Traits::edgeVerts[edge][0];
+	int ind1 = Traits::edgeVerts[edge][1];
 
 	emInt vert0 = cellVerts[ind0];
 	emInt vert1 = cellVerts[ind1];
@@ -175,101 +359,110 @@ void CellDivider::getEdgeVerts(exa_map<Edge, EdgeVerts> &vertsOnEdges,
 	auto iterEdges = vertsOnEdges.find(E);
 
 	if (iterEdges == vertsOnEdges.end()) {
-		// Doesn't exist yet, so create it.
+		// Doesn't exist yet, so create it, in place.
+		EdgeVerts& EV = vertsOnEdges[E];
+		EV.verts.resize(nDivs + 1);
 		EV.verts[0] = E.getV0();
 		EV.verts[nDivs] = E.getV1();
 		EV.m_totalDihed = dihedral;
 
-		bool forward = true;
-		if (EV.verts[0] != vert0) {
-			forward = false;
-		}
-
-		double uvwStart[3], uvwEnd[3];
-		if (forward) {
-			uvwStart[0] = uvwIJK[ind0][0];
-			uvwStart[1] = uvwIJK[ind0][1];
-			uvwStart[2] = uvwIJK[ind0][2];
-
-			uvwEnd[0] = uvwIJK[ind1][0];
-			uvwEnd[1] = uvwIJK[ind1][1];
-			uvwEnd[2] = uvwIJK[ind1][2];
-		}
-		else {
-			uvwStart[0] = uvwIJK[ind1][0];
-			uvwStart[1] = uvwIJK[ind1][1];
-			uvwStart[2] = uvwIJK[ind1][2];
-
-			uvwEnd[0] = uvwIJK[ind0][0];
-			uvwEnd[1] = uvwIJK[ind0][1];
-			uvwEnd[2] = uvwIJK[ind0][2];
-		}
-		double delta[] = { (uvwEnd[0] - uvwStart[0]) / nDivs, (uvwEnd[1]
-				- uvwStart[1])
-																													/ nDivs,
-												(uvwEnd[2] - uvwStart[2]) / nDivs };
 		for (int ii = 1; ii < nDivs; ii++) {
-			double uvw[] = { uvwStart[0] + ii * delta[0], uvwStart[1] + ii * delta[1],
-												uvwStart[2] + ii * delta[2] };
 			double newCoords[3];
-			getPhysCoordsFromParamCoords(uvw, newCoords);
+			getEdgePointCoords(edge, ii, newCoords);
 			EV.verts[ii] = m_pMesh->addVert(newCoords);
 		}
-		vertsOnEdges.insert(std::make_pair(E, EV));
+		return EV.verts.data();
 	}
 	else {
-		iterEdges->second.m_totalDihed += dihedral;
-		EV = iterEdges->second;
+		EdgeVerts& EV = iterEdges->second;
+		EV.m_totalDihed += dihedral;
+		// Once the cells seen so far go all the way around the edge, no other
+		// cell can have it.
 		if (EV.m_totalDihed > (2 - 1.e-8) * M_PI) {
+			std::copy(EV.verts.begin(), EV.verts.end(), m_edgeBuffer.begin());
+			m_doneVerts.insert(m_doneVerts.end(), EV.verts.begin() + 1,
+													EV.verts.end() - 1);
 			vertsOnEdges.erase(iterEdges);
+			return m_edgeBuffer.data();
 		}
+		return EV.verts.data();
 	}
 }
 
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+void CellDivider<Derived, Traits, MapT, NDIVS>::setupEdgeWings() {
+	if constexpr (!Traits::isSurface) {
+		for (int iE = 0; iE < Traits::numEdges; iE++) {
+			const int end0 = Traits::edgeVerts[iE][0];
+			const int end1 = Traits::edgeVerts[iE][1];
+			int nFaces = 0;
+			for (int iF = 0; iF < Traits::numQuadFaces + Traits::numTriFaces;
+					iF++) {
+				const int nCorners = iF < Traits::numQuadFaces ? 4 : 3;
+				const int* const FV = Traits::faceVerts[iF];
+				for (int ii = 0; ii < nCorners; ii++) {
+					const int next = FV[(ii + 1) % nCorners];
+					if ((FV[ii] == end0 && next == end1)
+							|| (FV[ii] == end1 && next == end0)) {
+						// The edge runs from FV[ii] to next on this face.
+						const int before = FV[(ii + nCorners - 1) % nCorners];
+						const int after = FV[(ii + 2) % nCorners];
+						assert(nFaces < 2);
+						m_edgeWings[iE][nFaces][0] = (FV[ii] == end0) ? before : after;
+						m_edgeWings[iE][nFaces][1] = (FV[ii] == end0) ? after : before;
+						nFaces++;
+					}
+				}
+			}
+			assert(nFaces == 2);
+		}
+	}
+}
+
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+void CellDivider<Derived, Traits, MapT, NDIVS>::findDihedrals(
+		double dihedrals[Traits::numEdges]) const {
+	double coords[Traits::numVerts][3];
+	for (int ii = 0; ii < Traits::numVerts; ii++) {
+		m_pInitMesh->getCoords(cellVerts[ii], coords[ii]);
+	}
+	for (int iE = 0; iE < Traits::numEdges; iE++) {
+		// Every cell around an edge measures from the same end, and so sees a
+		// shared quad face as the same half-plane, even if it isn't flat.
+		// Then the angles add up to exactly a full turn.
+		const int end =
+				cellVerts[Traits::edgeVerts[iE][0]]
+						< cellVerts[Traits::edgeVerts[iE][1]] ? 0 : 1;
+		dihedrals[iE] = dihedralAngle(coords[Traits::edgeVerts[iE][end]],
+																	coords[Traits::edgeVerts[iE][1 - end]],
+																	coords[m_edgeWings[iE][0][end]],
+																	coords[m_edgeWings[iE][1][end]]);
+	}
+}
 
-typename exa_set<TriFaceVerts>::iterator CellDivider::getTriVerts(
-		exa_set<TriFaceVerts> &vertsOnTris,
-		const int face,
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+typename exa_set<TriFaceVerts>::iterator CellDivider<Derived, Traits, MapT,
+		NDIVS>::getTriVerts(exa_set<TriFaceVerts> &vertsOnTris, const int face,
 		bool& shouldErase) {
-	int ind0 = faceVertIndices[face][0];
-	int ind1 = faceVertIndices[face][1];
-	int ind2 = faceVertIndices[face][2];
+	int ind0 = Traits::faceVerts[face][0];
+	int ind1 = Traits::faceVerts[face][1];
+	int ind2 = Traits::faceVerts[face][2];
 
 	emInt vert0 = cellVerts[ind0];
 	emInt vert1 = cellVerts[ind1];
 	emInt vert2 = cellVerts[ind2];
 	TriFaceVerts TFVTemp(vert0, vert1, vert2);
 	auto iterTris = vertsOnTris.find(TFVTemp);
-	TFVTemp.freeVertMemory();
 	if (iterTris == vertsOnTris.end()) {
-		const double inv_nDivs = 1. / (nDivs);
-		const double uvw0[] = { uvwIJK[ind0][0], uvwIJK[ind0][1], uvwIJK[ind0][2] };
-		const double uvw1[] = { uvwIJK[ind1][0], uvwIJK[ind1][1], uvwIJK[ind1][2] };
-		const double uvw2[] = { uvwIJK[ind2][0], uvwIJK[ind2][1], uvwIJK[ind2][2] };
-
-		double deltaUVWInI[] = { (uvw1[0] - uvw0[0]) * inv_nDivs,
-															(uvw1[1] - uvw0[1]) * inv_nDivs, (uvw1[2]
-																	- uvw0[2])
-																																* inv_nDivs };
-		double deltaUVWInJ[] = { (uvw2[0] - uvw0[0]) * inv_nDivs,
-															(uvw2[1] - uvw0[1]) * inv_nDivs, (uvw2[2]
-																	- uvw0[2])
-																																* inv_nDivs };
 		TriFaceVerts TFV(vert0, vert1, vert2);
-		TFV.allocVertMemory();
+		TFV.allocVertMemory(nDivs, *m_triArena);
 
 		for (int jj = 0; jj < nDivs - 2; jj++) {
 			for (int ii = 0; ii < nDivs - 2 - jj; ii++) {
-				double uvw[] = { uvw0[0] + deltaUVWInI[0] * (ii + 1)
-													+ deltaUVWInJ[0] * (jj + 1),
-													uvw0[1] + deltaUVWInI[1] * (ii + 1)
-													+ deltaUVWInJ[1] * (jj + 1),
-													uvw0[2] + deltaUVWInI[2] * (ii + 1)
-													+ deltaUVWInJ[2] * (jj + 1) };
 				double newCoords[3];
-				getPhysCoordsFromParamCoords(uvw, newCoords);
+				getTriFacePointCoords(face, ii + 1, jj + 1, newCoords);
 				emInt vNew = m_pMesh->addVert(newCoords);
-				TFV.intVerts[ii][jj] = vNew;
+				TFV.intVert(ii, jj) = vNew;
 			}
 		} // Done looping over all interior verts for the triangle.
 		iterTris = vertsOnTris.insert(TFV).first;
@@ -283,12 +476,14 @@ typename exa_set<TriFaceVerts>::iterator CellDivider::getTriVerts(
 	return iterTris;
 }
 
-void CellDivider::getQuadVerts(exa_set<QuadFaceVerts> &vertsOnQuads,
-		const int face, QuadFaceVerts &QFV) {
-	int ind0 = faceVertIndices[face][0];
-	int ind1 = faceVertIndices[face][1];
-	int ind2 = faceVertIndices[face][2];
-	int ind3 = faceVertIndices[face][3];
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+typename exa_set<QuadFaceVerts>::iterator CellDivider<Derived, Traits, MapT,
+		NDIVS>::getQuadVerts(exa_set<QuadFaceVerts> &vertsOnQuads, const int face,
+		bool& shouldErase) {
+	int ind0 = Traits::faceVerts[face][0];
+	int ind1 = Traits::faceVerts[face][1];
+	int ind2 = Traits::faceVerts[face][2];
+	int ind3 = Traits::faceVerts[face][3];
 
 	emInt vert0 = cellVerts[ind0];
 	emInt vert1 = cellVerts[ind1];
@@ -299,192 +494,164 @@ void CellDivider::getQuadVerts(exa_set<QuadFaceVerts> &vertsOnQuads,
 
 	auto iterQuads = vertsOnQuads.find(QFVTemp);
 	if (iterQuads == vertsOnQuads.end()) {
-		const double inv_nDivs = 1. / (nDivs);
-		const double uvw0[] = { uvwIJK[ind0][0], uvwIJK[ind0][1], uvwIJK[ind0][2] };
-		const double uvw1[] = { uvwIJK[ind1][0], uvwIJK[ind1][1], uvwIJK[ind1][2] };
-		const double uvw2[] = { uvwIJK[ind2][0], uvwIJK[ind2][1], uvwIJK[ind2][2] };
-		const double uvw3[] = { uvwIJK[ind3][0], uvwIJK[ind3][1], uvwIJK[ind3][2] };
-
-		double deltaInI[] = { (uvw1[0] - uvw0[0]) * inv_nDivs, (uvw1[1] - uvw0[1])
-				* inv_nDivs,
-													(uvw1[2] - uvw0[2]) * inv_nDivs };
-		double deltaInJ[] = { (uvw3[0] - uvw0[0]) * inv_nDivs, (uvw3[1] - uvw0[1])
-				* inv_nDivs,
-													(uvw3[2] - uvw0[2]) * inv_nDivs };
-
-		double crossDelta[] = { (uvw2[0] + uvw0[0] - uvw1[0] - uvw3[0])
-				* (inv_nDivs * inv_nDivs),
-														(uvw2[1] + uvw0[1] - uvw1[1] - uvw3[1]) * (inv_nDivs
-																* inv_nDivs),
-														(uvw2[2] + uvw0[2] - uvw1[2] - uvw3[2]) * (inv_nDivs
-																* inv_nDivs) };
-		QFV.corners[0] = vert0;
-		QFV.corners[1] = vert1;
-		QFV.corners[2] = vert2;
-		QFV.corners[3] = vert3;
-		QFV.setupSorted();
-
+		QuadFaceVerts QFV(vert0, vert1, vert2, vert3);
+		QFV.allocVertMemory(nDivs, *m_quadArena);
 
 		for (int jj = 1; jj <= nDivs - 1; jj++) {
 			for (int ii = 1; ii <= nDivs - 1; ii++) {
 				double newCoords[3];
-				double uvw[] = { uvw0[0] + deltaInI[0] * ii + deltaInJ[0] * jj
-																+ crossDelta[0] * ii * jj,
-																uvw0[1] + deltaInI[1] * ii + deltaInJ[1] * jj
-																+ crossDelta[1] * ii * jj,
-																uvw0[2] + deltaInI[2] * ii + deltaInJ[2] * jj
-																+ crossDelta[2] * ii * jj };
-				getPhysCoordsFromParamCoords(uvw, newCoords);
+				getQuadFacePointCoords(face, ii, jj, newCoords);
 				emInt vNew = m_pMesh->addVert(newCoords);
-				QFV.intVerts[ii - 1][jj - 1] = vNew;
+				QFV.intVert(ii - 1, jj - 1) = vNew;
 			}
 		} // Done looping over all interior verts for the triangle.
-		vertsOnQuads.insert(QFV);
+		iterQuads = vertsOnQuads.insert(QFV).first;
+		shouldErase = false;
+	}
+	else {
+		shouldErase = true;
+	}
+	return iterQuads;
+}
+
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+void CellDivider<Derived, Traits, MapT, NDIVS>::setupTranscription() {
+	if (NDIVS == 0) {
+		m_edgeTrans = makeTable<int, EdgeTranscription<Traits>>(nDivs);
+		m_faceTrans = makeTable<int, FaceTranscription<Traits>>(nDivs);
+	}
+}
+
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+const int* CellDivider<Derived, Traits, MapT, NDIVS>::edgeTranscription() const {
+	if constexpr (NDIVS > 0) {
+		return FixedTranscriptionTables<Traits, NDIVS>::edges.data();
+	}
+	else {
+		return m_edgeTrans.data();
+	}
+}
+
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+const int* CellDivider<Derived, Traits, MapT, NDIVS>::faceTranscription() const {
+	if constexpr (NDIVS > 0) {
+		return FixedTranscriptionTables<Traits, NDIVS>::faces.data();
 	}
 	else {
-		QFV = *iterQuads;
-		vertsOnQuads.erase(iterQuads); // Will never need this again.
+		return m_faceTrans.data();
+	}
+}
+
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+template<int nCorners>
+int CellDivider<Derived, Traits, MapT, NDIVS>::faceOrientation(const int face,
+		const emInt corners[nCorners]) const {
+	for (int rot = 0; rot < nCorners; rot++) {
+		if (corners[0] == cellVerts[Traits::faceVerts[face][rot]]) {
+			const int next = Traits::faceVerts[face][(rot + 1) % nCorners];
+			return (corners[1] == cellVerts[next]) ? rot : nCorners + rot;
+		}
 	}
+	assert(0);
+	return -1;
 }
 
-void CellDivider::divideEdges(exa_map<Edge, EdgeVerts> &vertsOnEdges) {
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+void CellDivider<Derived, Traits, MapT, NDIVS>::divideEdges(
+		exa_map<Edge, EdgeVerts> &vertsOnEdges) {
 	// Divide all the edges, including storing info about which new verts
 	// are on which edges
-	for (int iE = 0; iE < numEdges; iE++) {
-
-		EdgeVerts EV;
-		double dihedral = 0;
-		getEdgeVerts(vertsOnEdges, iE, dihedral, EV);
+	const int* const edgeTrans = edgeTranscription();
+	// Bdry faces never finish off an edge, since they're refined after all
+	// the cells.
+	double dihedrals[Traits::numEdges] = { };
+	if constexpr (!Traits::isSurface) findDihedrals(dihedrals);
+	for (int iE = 0; iE < Traits::numEdges; iE++) {
+		const emInt* const EV = getEdgeVerts(vertsOnEdges, iE, dihedrals[iE]);
 
 		// Now transcribe these into the master table for this cell.
-		emInt startIndex = 1000, endIndex = 1000;
-		if (EV.verts[0] == cellVerts[edgeVertIndices[iE][0]]) {
-			// Transcribe this edge forward.
-			startIndex = edgeVertIndices[iE][0];
-			endIndex = edgeVertIndices[iE][1];
-		}
-		else {
-			startIndex = edgeVertIndices[iE][1];
-			endIndex = edgeVertIndices[iE][0];
-		}
-		int startI = vertIJK[startIndex][0];
-		int startJ = vertIJK[startIndex][1];
-		int startK = vertIJK[startIndex][2];
-		int incrI = (vertIJK[endIndex][0] - startI) / nDivs;
-		int incrJ = (vertIJK[endIndex][1] - startJ) / nDivs;
-		int incrK = (vertIJK[endIndex][2] - startK) / nDivs;
-
+		const int dir = (EV[0] == cellVerts[Traits::edgeVerts[iE][0]]) ? 0 : 1;
+		const int* const trans = edgeTrans + (iE * 2 + dir) * (nDivs + 1);
 		for (int ii = 0; ii <= nDivs; ii++) {
-			int II = startI + ii * incrI;
-			int JJ = startJ + ii * incrJ;
-			int KK = startK + ii * incrK;
-			assert(II >= 0 && II <= nDivs);
-			assert(JJ >= 0 && JJ <= nDivs);
-			assert(KK >= 0 && KK <= nDivs);
-			localVerts[II][JJ][KK] = EV.verts[ii];
+			localVerts[trans[ii]] = EV[ii];
 		}
 	}
 }
 
-void CellDivider::divideFaces(exa_set<TriFaceVerts> &vertsOnTris,
-exa_set<QuadFaceVerts> &vertsOnQuads) {
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
+void CellDivider<Derived, Traits, MapT, NDIVS>::divideFaces(
+		exa_set<TriFaceVerts> &vertsOnTris, exa_set<QuadFaceVerts> &vertsOnQuads) {
 	// Divide all the faces, including storing info about which new verts
 	// are on which faces
+	assert(m_triArena && m_quadArena);
+	const int* const faceTrans = faceTranscription();
+	const int quadSize = (nDivs - 1) * (nDivs - 1);
+	const int triSize = (nDivs - 1) * (nDivs - 2) / 2;
 
 	// The quad faces are first.
-	for (int iF = 0; iF < numQuadFaces; iF++) {
-		QuadFaceVerts QFV;
-		getQuadVerts(vertsOnQuads, iF, QFV);
+	for (int iF = 0; iF < Traits::numQuadFaces; iF++) {
+		bool shouldErase = false;
+		auto iterQuads = getQuadVerts(vertsOnQuads, iF, shouldErase);
+		const QuadFaceVerts& QFV = *iterQuads;
 		// Now extract info from the QFV and stuff it into the cell's point
-		// array.
-
-		// Critical first step: identify which vert is which.
-		emInt corner[] = { 1000, 1000, 1000, 1000 };
-
-		for (int iC = 0; iC < 4; iC++) {
-			const emInt corn = QFV.corners[iC];
-			for (int iV = 0; iV < numVerts; iV++) {
-				const emInt cand = cellVerts[iV];
-				if (corn == cand) {
-					corner[iC] = iV;
-					break;
-				}
-			}
+		// array, using the table for the orientation the face was stored in.
+		const int orient = faceOrientation<4>(iF, QFV.corners);
+		const int* const trans = faceTrans + (iF * 8 + orient) * quadSize;
+		for (int ii = 0; ii < quadSize; ii++) {
+			localVerts[trans[ii]] = QFV.intVerts[ii];
 		}
-
-		int startI = vertIJK[corner[0]][0];
-		int startJ = vertIJK[corner[0]][1];
-		int startK = vertIJK[corner[0]][2];
-		int incrIi = (vertIJK[corner[1]][0] - startI) / nDivs;
-		int incrJi = (vertIJK[corner[1]][1] - startJ) / nDivs;
-		int incrKi = (vertIJK[corner[1]][2] - startK) / nDivs;
-		int incrIj = (vertIJK[corner[3]][0] - startI) / nDivs;
-		int incrJj = (vertIJK[corner[3]][1] - startJ) / nDivs;
-		int incrKj = (vertIJK[corner[3]][2] - startK) / nDivs;
-
-		for (int jj = 1; jj <= nDivs - 1; jj++) {
-			for (int ii = 1; ii <= nDivs - 1; ii++) {
-				int II = startI + incrIi * ii + incrIj * jj;
-				int JJ = startJ + incrJi * ii + incrJj * jj;
-				int KK = startK + incrKi * ii + incrKj * jj;
-				assert(II >= 0 && II <= nDivs);
-				assert(JJ >= 0 && JJ <= nDivs);
-				assert(KK >= 0 && KK <= nDivs);
-
-				localVerts[II][JJ][KK] = QFV.intVerts[ii - 1][jj - 1];
-			}
+		if (shouldErase) {
+			m_doneVerts.insert(m_doneVerts.end(), QFV.intVerts,
+													QFV.intVerts + quadSize);
+			QFV.freeVertMemory(*m_quadArena);
+			vertsOnQuads.erase(iterQuads); // Will never need this again.
 		}
 	}
 
-	for (int iF = numQuadFaces; iF < numQuadFaces + numTriFaces; iF++) {
+	const int* const triTrans = faceTrans + Traits::numQuadFaces * 8 * quadSize;
+	for (int iF = Traits::numQuadFaces;
+			iF < Traits::numQuadFaces + Traits::numTriFaces; iF++) {
 		bool shouldErase = false;
 		auto iterTris = getTriVerts(vertsOnTris, iF, shouldErase);
-		// Now extract info from the TFV and stuff it into the Prismamid's point
-		// array.
-
-		// 1000 is way more points than cells have.
-		emInt corner[] = { 1000, 1000, 1000 };
-		// Critical first step: identify which vert is which.
-		for (int iC = 0; iC < 3; iC++) {
-			const emInt corn = iterTris->corners[iC];
-//			const emInt corn = TFV.corners[iC];
-
-			for (int iV = 0; iV < numVerts; iV++) {
-				const emInt cand = cellVerts[iV];
-				if (corn == cand) {
-					corner[iC] = iV;
-					break;
-				}
-			}
-		}
-
-		int startI = vertIJK[corner[0]][0];
-		int startJ = vertIJK[corner[0]][1];
-		int startK = vertIJK[corner[0]][2];
-		int incrIi = (vertIJK[corner[1]][0] - startI) / nDivs;
-		int incrJi = (vertIJK[corner[1]][1] - startJ) / nDivs;
-		int incrKi = (vertIJK[corner[1]][2] - startK) / nDivs;
-		int incrIj = (vertIJK[corner[2]][0] - startI) / nDivs;
-		int incrJj = (vertIJK[corner[2]][1] - startJ) / nDivs;
-		int incrKj = (vertIJK[corner[2]][2] - startK) / nDivs;
-
-		for (int jj = 0; jj < nDivs - 2; jj++) {
-			for (int ii = 0; ii < nDivs - 2 - jj; ii++) {
-				int II = startI + incrIi * (ii + 1) + incrIj * (jj + 1);
-				int JJ = startJ + incrJi * (ii + 1) + incrJj * (jj + 1);
-				int KK = startK + incrKi * (ii + 1) + incrKj * (jj + 1);
-				assert(II >= 0 && II <= nDivs);
-				assert(JJ >= 0 && JJ <= nDivs);
-				assert(KK >= 0 && KK <= nDivs);
-
-				localVerts[II][JJ][KK] = iterTris->intVerts[ii][jj];
-//				localVerts[II][JJ][KK] = TFV.intVerts[ii][jj];
-			}
+		const int orient = faceOrientation<3>(iF, iterTris->corners);
+		const int* const trans = triTrans
+				+ ((iF - Traits::numQuadFaces) * 6 + orient) * triSize;
+		for (int ii = 0; ii < triSize; ii++) {
+			localVerts[trans[ii]] = iterTris->intVerts[ii];
 		}
 		if (shouldErase) {
-			iterTris->freeVertMemory();
+			m_doneVerts.insert(m_doneVerts.end(), iterTris->intVerts,
+													iterTris->intVerts + triSize);
+			iterTris->freeVertMemory(*m_triArena);
 			vertsOnTris.erase(iterTris);
 		}
 	}
 }
 
+// The dividers used by subdividePartMesh, for each specialized nDivs.
+#define INSTANTIATE_CELL_DIVIDERS(N) \
+	template class CellDivider<TetDivider<N>, TetTraits, TetLengthScaleMapping, \
+			N>; \
+	template class CellDivider<PyrDivider<N>, PyrTraits, UniformPyramidMapping, \
+			N>; \
+	template class CellDivider<PrismDivider<N>, PrismTraits, \
+			UniformPrismMapping, N>; \
+	template class CellDivider<HexDivider<N>, HexTraits, UniformHexMapping, N>; \
+	template class CellDivider<BdryTriDivider<N>, BdryTriTraits, NoMapping, N>; \
+	template class CellDivider<BdryQuadDivider<N>, BdryQuadTraits, NoMapping, N>;
+
+INSTANTIATE_CELL_DIVIDERS(0)
+INSTANTIATE_CELL_DIVIDERS(2)
+INSTANTIATE_CELL_DIVIDERS(3)
+INSTANTIATE_CELL_DIVIDERS(4)
+INSTANTIATE_CELL_DIVIDERS(8)
+
+// Cubic mappings are only available with run-time nDivs.
+template class CellDivider<TetDivider<0, LagrangeCubicTetMapping>, TetTraits,
+		LagrangeCubicTetMapping, 0>;
+template class CellDivider<PyrDivider<0, LagrangeCubicPyramidMapping>,
+		PyrTraits, LagrangeCubicPyramidMapping, 0>;
+template class CellDivider<PrismDivider<0, LagrangeCubicPrismMapping>,
+		PrismTraits, LagrangeCubicPrismMapping, 0>;
+template class CellDivider<HexDivider<0, LagrangeCubicHexMapping>, HexTraits,
+		LagrangeCubicHexMapping, 0>;
@@ -28,64 +28,269 @@
 
 #include <algorithm>
 #include <cmath>
+#include <vector>
 
 
+#include "CellTraits.h"
 #include "ExaMesh.h"
 #include "Mapping.h"
-#include "UMesh.h"
+#include "RefineSink.h"
 
+// A vert inside a cell: where it is in parametric space, and where it goes in
+// the lattice.
+struct InteriorPoint {
+	double uvw[3];
+	int index;
+};
+
+// Connectivity stencils and interior point lists are produced by generator
+// functors with a templated
+//   constexpr void operator()(const int nDivs, Table& out) const
+// which only ever calls out.push_back().  For commonly used nDivs, the same
+// generator is run at compile time, first to size a FixedTable and then to
+// fill it.
+template<typename T, int N>
+struct FixedTable {
+	T m_data[N > 0 ? N : 1] = { };
+	int m_size = 0;
+	constexpr void push_back(const T& t) {
+		m_data[m_size++] = t;
+	}
+	constexpr int size() const {
+		return m_size;
+	}
+	constexpr const T* data() const {
+		return m_data;
+	}
+	constexpr const T* begin() const {
+		return m_data;
+	}
+	constexpr const T* end() const {
+		return m_data + m_size;
+	}
+};
+
+struct TableCounter {
+	int m_size = 0;
+	template<typename T>
+	constexpr void push_back(const T&) {
+		m_size++;
+	}
+};
+
+template<typename Gen>
+constexpr int generatedTableSize(const int nDivs) {
+	TableCounter counter;
+	Gen()(nDivs, counter);
+	return counter.m_size;
+}
+
+template<typename T, typename Gen, int NDIVS>
+constexpr FixedTable<T, generatedTableSize<Gen>(NDIVS)> makeFixedTable() {
+	FixedTable<T, generatedTableSize<Gen>(NDIVS)> table;
+	Gen()(NDIVS, table);
+	return table;
+}
+
+template<typename T, typename Gen>
+std::vector<T> makeTable(const int nDivs) {
+	std::vector<T> table;
+	Gen()(nDivs, table);
+	return table;
+}
+
+template<typename Table, int nPts>
+constexpr void pushCell(Table& out, const int (&verts)[nPts]) {
+	for (int ii = 0; ii < nPts; ii++) {
+		out.push_back(verts[ii]);
+	}
+}
+
+// Common code for dividing cells of all types.  Traits gives the topology
+// of the cell type, MapT is the (concrete) mapping type used to place new
+// verts, and NDIVS is either a compile-time nDivs or 0.  Derived is the
+// actual divider (CRTP), which provides divideInterior and createNewCells.
+template<typename Derived, typename Traits, typename MapT, int NDIVS>
 class CellDivider {
 protected:
-	UMesh *m_pMesh;
-	Mapping *m_Map;
-	emInt (*localVerts)[MAX_DIVS + 1][MAX_DIVS + 1];
-	int edgeVertIndices[12][2];
-	int faceVertIndices[6][4];
-	int numTriFaces, numQuadFaces, numEdges, numVerts;
-	int vertIJK[8][3];
-	double uvwIJK[8][3];
-	emInt cellVerts[8];
+	// Where the new verts and cells go.
+	RefineSink *m_pMesh;
+	MapT m_Map;
+	// The lattice of verts for this cell, packed according to
+	// Traits::latticeShape.
+	std::vector<emInt> localVerts;
+	emInt cellVerts[Traits::numVerts];
 	int nDivs;
+	// Where the interior verts of new shared faces are kept.
+	FaceVertArena *m_triArena, *m_quadArena;
+	// The coarse mesh, for the corners of the cell.
+	const ExaMesh* m_pInitMesh;
+	// The verts of an edge that the last cell around it has just taken out
+	// of the table.
+	std::vector<emInt> m_edgeBuffer;
+	// Verts that no later cell will use, for the sink to release once this
+	// cell is done.
+	std::vector<emInt> m_doneVerts;
+	// For each edge and each of the two faces that share it, the corners
+	// next to each end of the edge on that face: [edge][face][end].  Only
+	// set up for volume cells.
+	int m_edgeWings[Traits::numEdges][2][2];
+
+	// Lattice indices for transcribing edge and face verts into localVerts,
+	// for each edge direction and face orientation; only filled in when
+	// NDIVS is 0.
+	std::vector<int> m_edgeTrans, m_faceTrans;
 
 	// Used by both tets and pyramids.
 	int checkOrient3D(const emInt verts[4]) const;
+
+	// Cells are written to the output mesh in batches of at most this many.
+	enum {
+		chunkCells = 256
+	};
+
+	// Index into the packed localVerts array for lattice point (i,j,k).
+	int latticeIndex(const int ii, const int jj, const int kk) const {
+		assert(ii >= 0 && ii <= nDivs);
+		assert(jj >= 0 && jj <= nDivs);
+		assert(kk >= 0 && kk <= nDivs);
+		const int index = packedLatticeIndex(Traits::latticeShape, nDivs, ii, jj,
+																					kk);
+		assert(index < int(localVerts.size()));
+		return index;
+	}
+
+	// Create verts inside the cell, at the points given by the table.
+	template<typename Table>
+	void addInteriorVerts(const Table& points) {
+		for (const InteriorPoint& IP : points) {
+			double coords[3];
+			getPhysCoordsFromParamCoords(IP.uvw, coords);
+			localVerts[IP.index] = m_pMesh->addVert(coords);
+			m_doneVerts.push_back(localVerts[IP.index]);
+		}
+	}
+
+	// A stencil is a list of lattice indices, nPts per new cell.  Emitting
+	// the cells is then just a gather from the lattice and a bulk append.
+	template<int nPts, typename Stencil>
+	void appendFromStencil(const Stencil& stencil,
+			emInt (RefineSink::*append)(const emInt[][nPts], const emInt)) {
+		const emInt* const lattice = localVerts.data();
+		const int nCells = stencil.size() / nPts;
+		emInt newConn[chunkCells][nPts];
+		for (int first = 0; first < nCells; first += chunkCells) {
+			const int count = std::min(int(chunkCells), nCells - first);
+			const int* const st = stencil.data() + first * nPts;
+			emInt* const out = newConn[0];
+			for (int ii = 0; ii < count * nPts; ii++) {
+				out[ii] = lattice[st[ii]];
+			}
+			(m_pMesh->*append)(newConn, count);
+		}
+	}
+
+#ifndef NDEBUG
+	// Check that the tets a stencil makes are all right-handed.
+	template<typename Stencil>
+	void checkStencilTets(const Stencil& stencil) const {
+		const int nTets = stencil.size() / 4;
+		for (int tet = 0; tet < nTets; tet++) {
+			const emInt verts[] = { localVerts[stencil.data()[4 * tet]],
+															localVerts[stencil.data()[4 * tet + 1]],
+															localVerts[stencil.data()[4 * tet + 2]],
+															localVerts[stencil.data()[4 * tet + 3]] };
+			assert(checkOrient3D(verts) == 1);
+		}
+	}
+#endif
 private:
-	void getEdgeVerts(exa_map<Edge, EdgeVerts> &vertsOnEdges, const int edge,
-			const double dihedral, EdgeVerts &EV);
+	// The verts along an edge, from its lower-numbered end.  The pointer is
+	// good until the next call.
+	const emInt* getEdgeVerts(exa_map<Edge, EdgeVerts> &vertsOnEdges,
+			const int edge, const double dihedral);
+	void setupEdgeWings();
+	// The dihedral angle of the cell at each edge.
+	void findDihedrals(double dihedrals[Traits::numEdges]) const;
 
-	void getQuadVerts(exa_set<QuadFaceVerts> &vertsOnQuads, const int face,
-			QuadFaceVerts &QFV);
+	typename exa_set<QuadFaceVerts>::iterator getQuadVerts(
+			exa_set<QuadFaceVerts> &vertsOnQuads, const int face, bool& shouldErase);
 
 	typename exa_set<TriFaceVerts>::iterator getTriVerts(
 			exa_set<TriFaceVerts> &vertsOnTris,
 			const int face,
 			bool& shouldErase);
+
+	void setupTranscription();
+	const int* edgeTranscription() const;
+	const int* faceTranscription() const;
+	// Which of the 2 * nCorners orientations a shared face was stored with.
+	template<int nCorners>
+	int faceOrientation(const int face, const emInt corners[nCorners]) const;
+	CellDivider(const CellDivider&);
+	CellDivider& operator=(const CellDivider&);
 public:
-	CellDivider(UMesh *pVolMesh, const emInt segmentsPerEdge) :
-			m_pMesh(pVolMesh), m_Map(nullptr),
-					numTriFaces(0), numQuadFaces(0), numEdges(0),
-					numVerts(0), nDivs(segmentsPerEdge) {
-		localVerts = new emInt[MAX_DIVS + 1][MAX_DIVS + 1][MAX_DIVS + 1];
-//		for (int ii = 0; ii <= MAX_DIVS; ii++) {
-//			for (int jj = 0; jj <= MAX_DIVS; jj++) {
-//				for (int kk = 0; kk <= MAX_DIVS; kk++) {
-//					localVerts[ii][jj][kk] = 100;
-//				}
-//			}
-//		}
-	}
-	virtual ~CellDivider() {
-		delete[] localVerts;
-		if (m_Map) delete m_Map;
+	// New verts are placed by mapping from the coarse cells of pInitMesh.
+	CellDivider(RefineSink *pSink, const ExaMesh* const pInitMesh,
+			const int segmentsPerEdge) :
+			m_pMesh(pSink), m_Map(pInitMesh), nDivs(segmentsPerEdge),
+					m_triArena(nullptr), m_quadArena(nullptr), m_pInitMesh(pInitMesh),
+					m_edgeBuffer(segmentsPerEdge + 1) {
+		assert(NDIVS == 0 || NDIVS == nDivs);
+		localVerts.assign(
+				packedLatticeSize(Traits::latticeShape, nDivs,
+													Traits::isSurface ? 1 : nDivs + 1),
+				EMINT_MAX);
+		setupTranscription();
+		setupEdgeWings();
+	}
+	// Must be called before refining cells; the arenas belong to whoever
+	// owns the face tables, and their block sizes must match nDivs.
+	void setFaceArenas(FaceVertArena& triArena, FaceVertArena& quadArena) {
+		m_triArena = &triArena;
+		m_quadArena = &quadArena;
+	}
+	void setupCoordMapping(const emInt verts[]) {
+		for (int ii = 0; ii < Traits::numVerts; ii++) {
+			cellVerts[ii] = verts[ii];
+		}
+		m_Map.setupCoordMapping(verts);
 	}
+	void getPhysCoordsFromParamCoords(const double uvw[3], double xyz[3]) const {
+		m_Map.computeTransformedCoords(uvw, xyz);
+	}
+	// Where new verts on the edges and faces of the cell last set up go.
+	// Steps along an edge count from its lower-numbered vert; (ii,jj) on a
+	// face are steps along its first and last edges, in the cell's
+	// orientation.
+	void getEdgePointCoords(const int edge, const int step, double xyz[3]) const;
+	void getTriFacePointCoords(const int face, const int ii, const int jj,
+			double xyz[3]) const;
+	void getQuadFacePointCoords(const int face, const int ii, const int jj,
+			double xyz[3]) const;
 	void divideEdges(exa_map<Edge, EdgeVerts> &vertsOnEdges);
 	void divideFaces(exa_set<TriFaceVerts> &vertsOnTris,
 	exa_set<QuadFaceVerts> &vertsOnQuads);
-	virtual void divideInterior() = 0;
-	virtual void createNewCells() = 0;
-	virtual void setupCoordMapping(const emInt verts[]) = 0;
-	virtual void getPhysCoordsFromParamCoords(const double uvw[],
-			double xyz[]) = 0;
+
+	// The lattice of verts for the last cell refined.
+	const std::vector<emInt>& getLocalVerts() const {
+		return localVerts;
+	}
+
+	// Do everything needed for one coarse cell.
+	void refineCell(const emInt verts[], exa_map<Edge, EdgeVerts> &vertsOnEdges,
+			exa_set<TriFaceVerts> &vertsOnTris,
+			exa_set<QuadFaceVerts> &vertsOnQuads) {
+		setupCoordMapping(verts);
+		divideEdges(vertsOnEdges);
+		divideFaces(vertsOnTris, vertsOnQuads);
+		static_cast<Derived*>(this)->divideInterior();
+		static_cast<Derived*>(this)->createNewCells();
+		if (!m_doneVerts.empty()) {
+			m_pMesh->releaseVerts(m_doneVerts.data(), m_doneVerts.size());
+			m_doneVerts.clear();
+		}
+	}
 };
 
 #endif /* SRC_CELLDIVIDER_H_ */
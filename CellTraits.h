@@ -0,0 +1,166 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * CellTraits.h
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#ifndef SRC_CELLTRAITS_H_
+#define SRC_CELLTRAITS_H_
+
+// Packed lattice layouts.  Each layer (constant k) is either a triangle
+// (i + j <= side) or a square (i, j <= side); its side is either nDivs
+// or, for cells that taper to a point at k = 0, k itself.  Within a layer,
+// verts are stored row by row (constant j).
+enum LatticeShape {
+	eTriLayers, eTaperedTriLayers, eQuadLayers, eTaperedQuadLayers
+};
+
+constexpr int packedLatticeIndex(const LatticeShape shape, const int nDivs,
+		const int ii, const int jj, const int kk) {
+	switch (shape) {
+		case eTaperedTriLayers:
+			return kk * (kk + 1) * (kk + 2) / 6 + jj * (kk + 1) - jj * (jj - 1) / 2
+					+ ii;
+		case eTaperedQuadLayers:
+			return kk * (kk + 1) * (2 * kk + 1) / 6 + jj * (kk + 1) + ii;
+		case eTriLayers:
+			return kk * (nDivs + 1) * (nDivs + 2) / 2 + jj * (nDivs + 1)
+					- jj * (jj - 1) / 2 + ii;
+		default:
+			return (kk * (nDivs + 1) + jj) * (nDivs + 1) + ii;
+	}
+}
+
+constexpr int packedLatticeSize(const LatticeShape shape, const int nDivs,
+		const int nLayers) {
+	return packedLatticeIndex(shape, nDivs, 0, 0, nLayers);
+}
+
+// Topology of each cell type, as seen by the cell dividers.
+//   faceVerts:  quad faces first, then tri faces (which leave entry 3 unused).
+//   vertIJK:    lattice position of each vertex, in units of nDivs.
+//   vertUVW:    parametric coordinates of each vertex.
+// Surface cells (bdry faces) have a single layer in their lattice.
+
+struct TetTraits {
+	static constexpr int numVerts = 4, numEdges = 6, numTriFaces = 4,
+			numQuadFaces = 0;
+	static constexpr bool isSurface = false;
+	static constexpr LatticeShape latticeShape = eTaperedTriLayers;
+	static constexpr int edgeVerts[numEdges][2] = {
+			{ 0, 1 }, { 0, 2 }, { 0, 3 }, { 1, 2 }, { 1, 3 }, { 2, 3 } };
+	static constexpr int faceVerts[numTriFaces + numQuadFaces][4] = {
+			{ 0, 1, 2 }, { 0, 3, 1 }, { 1, 3, 2 },
+			{ 2, 3, 0 } };
+	static constexpr int vertIJK[numVerts][3] = {
+			{ 0, 0, 1 }, { 1, 0, 1 }, { 0, 1, 1 }, { 0, 0, 0 } };
+	static constexpr double vertUVW[numVerts][3] = {
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+};
+
+struct PyrTraits {
+	static constexpr int numVerts = 5, numEdges = 8, numTriFaces = 4,
+			numQuadFaces = 1;
+	static constexpr bool isSurface = false;
+	static constexpr LatticeShape latticeShape = eTaperedQuadLayers;
+	static constexpr int edgeVerts[numEdges][2] = {
+			{ 0, 1 }, { 0, 3 }, { 0, 4 }, { 1, 2 }, { 1, 4 }, { 2, 3 },
+			{ 2, 4 }, { 3, 4 } };
+	static constexpr int faceVerts[numTriFaces + numQuadFaces][4] = {
+			{ 0, 1, 2, 3 }, { 0, 4, 1 }, { 1, 4, 2 },
+			{ 2, 4, 3 }, { 3, 4, 0 } };
+	static constexpr int vertIJK[numVerts][3] = {
+			{ 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 },
+			{ 0, 0, 0 } };
+	static constexpr double vertUVW[numVerts][3] = {
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 },
+			{ 0, 0, 1 } };
+};
+
+struct PrismTraits {
+	static constexpr int numVerts = 6, numEdges = 9, numTriFaces = 2,
+			numQuadFaces = 3;
+	static constexpr bool isSurface = false;
+	static constexpr LatticeShape latticeShape = eTriLayers;
+	static constexpr int edgeVerts[numEdges][2] = {
+			{ 0, 1 }, { 1, 2 }, { 0, 2 }, { 3, 4 }, { 4, 5 }, { 3, 5 },
+			{ 0, 3 }, { 1, 4 }, { 2, 5 } };
+	static constexpr int faceVerts[numTriFaces + numQuadFaces][4] = {
+			{ 2, 1, 4, 5 }, { 1, 0, 3, 4 }, { 0, 2, 5, 3 },
+			{ 0, 1, 2 }, { 5, 4, 3 } };
+	static constexpr int vertIJK[numVerts][3] = {
+			{ 0, 0, 1 }, { 1, 0, 1 }, { 0, 1, 1 }, { 0, 0, 0 },
+			{ 1, 0, 0 }, { 0, 1, 0 } };
+	static constexpr double vertUVW[numVerts][3] = {
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 },
+			{ 1, 0, 1 }, { 0, 1, 1 } };
+};
+
+struct HexTraits {
+	static constexpr int numVerts = 8, numEdges = 12, numTriFaces = 0,
+			numQuadFaces = 6;
+	static constexpr bool isSurface = false;
+	static constexpr LatticeShape latticeShape = eQuadLayers;
+	static constexpr int edgeVerts[numEdges][2] = {
+			{ 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 }, { 4, 5 }, { 5, 6 },
+			{ 6, 7 }, { 7, 4 }, { 0, 4 }, { 1, 5 }, { 2, 6 }, { 3, 7 } };
+	static constexpr int faceVerts[numTriFaces + numQuadFaces][4] = {
+			{ 0, 1, 2, 3 }, { 7, 6, 5, 4 }, { 0, 4, 5, 1 },
+			{ 1, 5, 6, 2 }, { 2, 6, 7, 3 }, { 3, 7, 4, 0 } };
+	static constexpr int vertIJK[numVerts][3] = {
+			{ 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 },
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+	static constexpr double vertUVW[numVerts][3] = {
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 },
+			{ 0, 0, 1 }, { 1, 0, 1 }, { 1, 1, 1 }, { 0, 1, 1 } };
+};
+
+struct BdryTriTraits {
+	static constexpr int numVerts = 3, numEdges = 3, numTriFaces = 1,
+			numQuadFaces = 0;
+	static constexpr bool isSurface = true;
+	static constexpr LatticeShape latticeShape = eTriLayers;
+	static constexpr int edgeVerts[numEdges][2] = {
+			{ 0, 1 }, { 1, 2 }, { 2, 0 } };
+	static constexpr int faceVerts[numTriFaces + numQuadFaces][4] = {
+			{ 0, 1, 2 } };
+	static constexpr int vertIJK[numVerts][3] = {
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+	static constexpr double vertUVW[numVerts][3] = {
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 } };
+};
+
+struct BdryQuadTraits {
+	static constexpr int numVerts = 4, numEdges = 4, numTriFaces = 0,
+			numQuadFaces = 1;
+	static constexpr bool isSurface = true;
+	static constexpr LatticeShape latticeShape = eQuadLayers;
+	static constexpr int edgeVerts[numEdges][2] = {
+			{ 0, 1 }, { 1, 2 }, { 2, 3 }, { 3, 0 } };
+	static constexpr int faceVerts[numTriFaces + numQuadFaces][4] = {
+			{ 0, 1, 2, 3 } };
+	static constexpr int vertIJK[numVerts][3] = {
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+	static constexpr double vertUVW[numVerts][3] = {
+			{ 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 } };
+};
+
+#endif /* SRC_CELLTRAITS_H_ */
@@ -37,6 +37,8 @@
 #endif
 
 #include "CubicMesh.h"
+#include "PartInterface.h"
+#include "Snapshot.h"
 #include "UMesh.h"
 
 CubicMesh::CubicMesh(const emInt nVerts, const emInt nBdryVerts,
@@ -285,6 +287,70 @@ CubicMesh::CubicMesh(const char CGNSfilename[]) {
 }
 #endif
 
+// The arrays here are owned by the mesh, so they're read from the snapshot
+// rather than mapped.
+CubicMesh::CubicMesh(const Snapshot& snap) :
+		CubicMesh(snap.count(0), snap.count(1), snap.count(2), snap.count(3),
+							snap.count(4), snap.count(5), snap.count(6), snap.count(7)) {
+	double timeBefore = exaTime();
+	if (snap.meshType() != eSnapshotCubicMesh) {
+		fprintf(stderr, "Snapshot %s doesn't hold a cubic mesh.\n",
+						snap.fileName());
+		exit(1);
+	}
+	m_nVertNodes = snap.count(8);
+	SnapshotHeader header;
+	SnapshotBlock blocks[eSnapMaxBlocks - eSnapMeshBlocks];
+	const int nBlocks = getSnapshotBlocks(header, blocks);
+	bool ok = true;
+	for (int iB = 0; ok && iB < nBlocks; iB++) {
+		ok = snap.blockBytes(eSnapMeshBlocks + iB) == blocks[iB].bytes
+				&& snap.readBlock(eSnapMeshBlocks + iB,
+													const_cast<void*>(blocks[iB].data));
+	}
+	if (!ok) {
+		fprintf(stderr, "Couldn't read the mesh from snapshot %s.\n",
+						snap.fileName());
+		exit(1);
+	}
+	m_vert = m_nVerts;
+	m_tri = m_nTri10;
+	m_quad = m_nQuad16;
+	m_tet = m_nTet20;
+	m_pyr = m_nPyr30;
+	m_prism = m_nPrism40;
+	m_hex = m_nHex64;
+
+	if (snap.blockBytes(eSnapLenScale) == m_nVerts * sizeof(double)) {
+		m_lenScale = new double[m_nVerts];
+		snap.readBlock(eSnapLenScale, m_lenScale);
+	}
+	double elapsed = exaTime() - timeBefore;
+	fprintf(stderr, "CPU time for snapshot read = %5.2F seconds\n", elapsed);
+}
+
+int CubicMesh::getSnapshotBlocks(SnapshotHeader& header,
+		SnapshotBlock blocks[]) const {
+	header.meshType = eSnapshotCubicMesh;
+	const emInt counts[] = { m_nVerts, m_nBdryVerts, m_nTri10, m_nQuad16,
+														m_nTet20, m_nPyr30, m_nPrism40, m_nHex64,
+														m_nVertNodes };
+	std::copy(counts, counts + 9, header.counts);
+	const SnapshotBlock meshBlocks[] = {
+			{ m_xcoords, m_nVerts * sizeof(double), 0 },
+			{ m_ycoords, m_nVerts * sizeof(double), 0 },
+			{ m_zcoords, m_nVerts * sizeof(double), 0 },
+			{ m_Tri10Conn, m_nTri10 * sizeof(m_Tri10Conn[0]), 0 },
+			{ m_Quad16Conn, m_nQuad16 * sizeof(m_Quad16Conn[0]), 0 },
+			{ m_Tet20Conn, m_nTet20 * sizeof(m_Tet20Conn[0]), 0 },
+			{ m_Pyr30Conn, m_nPyr30 * sizeof(m_Pyr30Conn[0]), 0 },
+			{ m_Prism40Conn, m_nPrism40 * sizeof(m_Prism40Conn[0]), 0 },
+			{ m_Hex64Conn, m_nHex64 * sizeof(m_Hex64Conn[0]), 0 } };
+	const int nBlocks = sizeof(meshBlocks) / sizeof(meshBlocks[0]);
+	std::copy(meshBlocks, meshBlocks + nBlocks, blocks);
+	return nBlocks;
+}
+
 void CubicMesh::renumberNodes(emInt thisSize, emInt* aliasConn,
 		emInt* newNodeInd) {
 	emInt* cloneConn = new emInt[thisSize];
@@ -340,7 +406,7 @@ void CubicMesh::reorderCubicMesh() {
 		}
 	}
 	m_nVertNodes = node;
-	fprintf(stderr, "%'u vertex nodes.\nRenumbering other nodes.\n", node);
+	fprintf(stderr, "%'" EMINT_FMT " vertex nodes.\nRenumbering other nodes.\n", node);
 	for (emInt ii = 0; ii < m_nVerts; ii++) {
 		if (!isVertexNode[ii]) {
 			assert(newNodeInd[ii] == EMINT_MAX);
@@ -413,9 +479,12 @@ static void remapIndices(const emInt nPts, const emInt newIndices[],
 }
 
 std::unique_ptr<CubicMesh> CubicMesh::extractCoarseMesh(Part& P,
-		std::vector<CellPartData>& vecCPD) const {
+		std::vector<CellPartData>& vecCPD, PartInterface* pPI) const {
 	CALLGRIND_TOGGLE_COLLECT
 	;
+	// Only the cells are reordered; the nodes keep their global order, which
+	// puts the vertex nodes first.
+	if (m_orderPartsForLocality) P.orderForLocality(vecCPD);
 
 	// Count the number of tris, quads, tets, pyrs, prisms and hexes.
 	const emInt first = P.getFirst();
@@ -606,11 +675,17 @@ std::unique_ptr<CubicMesh> CubicMesh::extractCoarseMesh(Part& P,
 	// Store the vertices, while keeping a mapping from the full list of verts
 	// to the restricted list so the connectivity can be copied properly.
 	emInt *newIndices = new emInt[nVerts];
+	if (pPI) {
+		pPI->coarseToGlobal.clear();
+		pPI->lattices.firstTri = nTris;
+		pPI->lattices.firstQuad = nQuads;
+	}
 	for (emInt ii = 0; ii < nVerts; ii++) {
 		if (isVertUsed[ii]) {
 			double coords[3];
 			getCoords(ii, coords);
 			newIndices[ii] = UCM->addVert(coords);
+			if (pPI) pPI->coarseToGlobal.push_back(ii);
 			// Copy length scale for vertices from the parent; otherwise, there will be
 			// mismatches in the refined meshes.
 			UCM->setLengthScale(newIndices[ii], getLengthScale(ii));
@@ -1273,15 +1348,17 @@ emInt CubicMesh::addHex(const emInt verts[]) {
 }
 
 std::unique_ptr<UMesh> CubicMesh::createFineUMesh(const emInt numDivs, Part& P,
-		std::vector<CellPartData>& vecCPD, struct RefineStats& RS) const {
+		std::vector<CellPartData>& vecCPD, struct RefineStats& RS,
+		const char mapFileName[], PartInterface* pPI) const {
 	// Create a coarse
 	double start = exaTime();
-	auto coarse = extractCoarseMesh(P, vecCPD);
+	auto coarse = extractCoarseMesh(P, vecCPD, pPI);
 	double middle = exaTime();
 	RS.extractTime = middle - start;
 
 	// For some reason, I needed the helper variable to keep the compiler happy here.
-	auto UUM = std::make_unique<UMesh>(*coarse, numDivs);
+	auto UUM = std::make_unique<UMesh>(*coarse, numDivs, mapFileName,
+																			pPI ? &pPI->lattices : nullptr);
 	RS.cells = UUM->numCells();
 	RS.refineTime = exaTime() - middle;
 	return UUM;
@@ -31,6 +31,8 @@
 #include "exa_config.h"
 #include "ExaMesh.h"
 
+class Snapshot;
+
 // This data structure is organized to read and write easily to/from CGNS files.
 class CubicMesh: public ExaMesh {
 	emInt m_vert, m_tri, m_quad, m_tet, m_pyr, m_prism, m_hex;
@@ -50,6 +52,7 @@ class CubicMesh: public ExaMesh {
 	void reorderCubicMesh();
 	void renumberNodes(emInt thisSize, emInt* aliasConn, emInt* newNodeInd);
 	void decrementVertIndices(emInt connSize, emInt* const connect);
+	int getSnapshotBlocks(SnapshotHeader& header, SnapshotBlock blocks[]) const;
 
 	// Length scales
 public:
@@ -59,6 +62,7 @@ public:
 #if (HAVE_CGNS == 1)
 	CubicMesh(const char CGNSFileName[]);
 #endif
+	explicit CubicMesh(const Snapshot& snap);
 	virtual ~CubicMesh();
 
 	// Will eventually want to create a fine CubicMesh from a coarse CubicMesh
@@ -156,11 +160,18 @@ public:
 		return Mapping::Lagrange;
 	}
 
+	// As for UMesh::extractCoarseMesh.
 	std::unique_ptr<CubicMesh> extractCoarseMesh(Part& P,
-			std::vector<CellPartData>& vecCPD) const;
+			std::vector<CellPartData>& vecCPD, PartInterface* pPI = nullptr) const;
+	std::unique_ptr<ExaMesh> extractCoarsePart(Part& P,
+			std::vector<CellPartData>& vecCPD, PartInterface* pPI = nullptr) const {
+		return extractCoarseMesh(P, vecCPD, pPI);
+	}
 
 	virtual std::unique_ptr<UMesh> createFineUMesh(const emInt numDivs, Part& P,
-			std::vector<CellPartData>& vecCPD, struct RefineStats& RS) const;
+			std::vector<CellPartData>& vecCPD, struct RefineStats& RS,
+			const char mapFileName[] = nullptr,
+			PartInterface* pPI = nullptr) const;
 
 	void setupCellDataForPartitioning(std::vector<CellPartData>& vecCPD,
 			double &xmin, double& ymin, double& zmin, double& xmax, double& ymax,
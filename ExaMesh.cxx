@@ -24,6 +24,7 @@
  */
 
 #include <assert.h>
+#include <array>
 #include <memory>
 #include <vector>
 #include <iostream>
@@ -33,7 +34,11 @@ using std::endl;
 
 #include "ExaMesh.h"
 #include "GeomUtils.h"
+#include "NumaMemory.h"
 #include "Part.h"
+#include "PartInterface.h"
+#include "Snapshot.h"
+#include "UGridIO.h"
 #include "UMesh.h"
 
 
@@ -377,7 +382,7 @@ void ExaMesh::prettyPrintCellCount(size_t cells, const char* prefix) const {
 	}
 }
 
-void ExaMesh::refineForParallel(const emInt numDivs,
+emInt ExaMesh::numPartsForParallel(const emInt numDivs,
 		const emInt maxCellsPerPart) const {
 	// Find size of output mesh
 	size_t numCells = numTets() + numPyramids() + numHexes() + numPrisms();
@@ -387,6 +392,12 @@ void ExaMesh::refineForParallel(const emInt numDivs,
 	// N*maxCells, you'll get N parts.  With N*maxCells + 1, you'll get N+1.
 	emInt nParts = (outputCells - 1) / maxCellsPerPart + 1;
 	if (nParts > numCells) nParts = numCells;
+	return nParts;
+}
+
+void ExaMesh::refineForParallel(const emInt numDivs,
+		const emInt maxCellsPerPart, const char outFileBase[]) const {
+	emInt nParts = numPartsForParallel(numDivs, maxCellsPerPart);
 
 	// Partition the mesh.
 	std::vector<Part> parts;
@@ -395,44 +406,83 @@ void ExaMesh::refineForParallel(const emInt numDivs,
 	partitionCells(this, nParts, parts, vecCPD);
 	double partitionTime = exaTime() - start;
 
+	refineForParallel(numDivs, parts, vecCPD, outFileBase, partitionTime);
+}
+
+void ExaMesh::refineForParallel(const emInt numDivs, std::vector<Part>& parts,
+		std::vector<CellPartData>& vecCPD, const char outFileBase[],
+		const double partitionTime) const {
+	const emInt nParts = parts.size();
+	double start = exaTime();
+
 	// Create new sub-meshes and refine them.
 	double totalRefineTime = 0;
 	double totalExtractTime = 0;
 	size_t totalCells = 0;
 	size_t totalTets = 0, totalPyrs = 0, totalPrisms = 0, totalHexes = 0;
 	size_t totalFileSize = 0;
-	struct RefineStats RS;
-	double totalTime = partitionTime;
-	emInt ii;
-//#pragma omp parallel for schedule(dynamic) reduction(+: totalRefineTime, totalExtractTime, totalTets, totalPyrs, totalPrisms, totalHexes, totalCells) num_threads(8)
-	for (ii = 0; ii < nParts; ii++) {
+	// With the parts written to files, the verts each shares with its
+	// neighbours go in a table next to it.
+	std::vector<std::vector<InterfaceVert> > partVerts(
+			outFileBase ? nParts : 0);
+	// Each worker extracts, refines and writes whole parts, so every part's
+	// memory is first touched by the (pinned, with pinWorkerThreads) thread
+	// that uses it.  Each worker's coarse and fine meshes (unless the fine
+	// one is in a mapped file) and refinement tables reuse the memory of its
+	// part before.
+	pinInitialThread();
+#pragma omp parallel reduction(+: totalRefineTime, totalExtractTime, totalCells, \
+		totalTets, totalPyrs, totalPrisms, totalHexes, totalFileSize)
+	{
+		LocalPool pool;
+#pragma omp for schedule(dynamic)
+		for (emInt ii = 0; ii < nParts; ii++) {
+			char outFileName[1024];
+			if (outFileBase) {
+				snprintf(outFileName, 1024,
+									"%s%03" EMINT_FMT "." NATIVE_UGRID_INFIX ".ugrid",
+									outFileBase, ii);
+			}
+			RefineStats RS;
+			PartInterface PI;
+			std::unique_ptr<UMesh> pUM = createFineUMesh(
+					numDivs, parts[ii], vecCPD, RS, outFileBase ? outFileName : nullptr,
+					outFileBase ? &PI : nullptr);
+			if (outFileBase) partVerts[ii] = findInterfaceVerts(PI, numDivs);
+			totalRefineTime += RS.refineTime;
+			totalExtractTime += RS.extractTime;
+			totalCells += RS.cells;
+			totalTets += pUM->numTets();
+			totalPyrs += pUM->numPyramids();
+			totalPrisms += pUM->numPrisms();
+			totalHexes += pUM->numHexes();
+			totalFileSize += pUM->getFileImageSize();
+			if (outFileBase) {
+				pUM->writeUGridFileAndRelease(outFileName);
+			}
+			printf("Part %3" EMINT_FMT ": cells %5" EMINT_FMT "-%5" EMINT_FMT
+							", refined in %5.2F seconds (%5.2F million cells / minute).\n",
+							ii, parts[ii].getFirst(), parts[ii].getLast(), RS.refineTime,
+							(RS.cells / 1000000.) / (RS.refineTime / 60));
+		}
+	}
+	unpinInitialThread();
+	double totalTime = partitionTime + exaTime() - start;
+	if (outFileBase) {
 		start = exaTime();
-//		char filename[100];
-//		sprintf(filename, "/tmp/submesh%03d.vtk", ii);
-//		writeVTKFile(filename);
-		printf("Part %3d: cells %5d-%5d.\n", ii, parts[ii].getFirst(),
-						parts[ii].getLast());
-		std::unique_ptr<UMesh> pUM = createFineUMesh(numDivs, parts[ii], vecCPD,
-																									RS);
-		totalRefineTime += RS.refineTime;
-		totalExtractTime += RS.extractTime;
-		totalCells += RS.cells;
-		totalTets += pUM->numTets();
-		totalPyrs += pUM->numPyramids();
-		totalPrisms += pUM->numPrisms();
-		totalHexes += pUM->numHexes();
-		totalFileSize += pUM->getFileImageSize();
+		std::vector<std::vector<PartNeighbour> > tables;
+		buildInterfaceTables(partVerts, tables);
+		for (emInt ii = 0; ii < nParts; ii++) {
+			char tableFileName[1024];
+			snprintf(tableFileName, 1024, "%s%03" EMINT_FMT ".interface", outFileBase,
+								ii);
+			writeInterfaceTable(tableFileName, ii, tables[ii]);
+		}
 		totalTime += exaTime() - start;
-		printf("\nCPU time for refinement = %5.2F seconds\n",
-						RS.refineTime);
-		printf("                          %5.2F million cells / minute\n",
-						(RS.cells / 1000000.) / (RS.refineTime / 60));
-
-//		char filename[100];
-//		sprintf(filename, "/tmp/fine-submesh%03d.vtk", ii);
-//		pUM->writeVTKFile(filename);
+		printf("\nTime for interface tables: %10.3F seconds\n",
+						exaTime() - start);
 	}
-	printf("\nDone parallel refinement with %d parts.\n", nParts);
+	printf("\nDone parallel refinement with %" EMINT_FMT " parts.\n", nParts);
 	printf("Time for partitioning:           %10.3F seconds\n",
 					partitionTime);
 	printf("Time for coarse mesh extraction: %10.3F seconds\n",
@@ -462,6 +512,288 @@ void ExaMesh::refineForParallel(const emInt numDivs,
 	prettyPrintCellCount(totalHexes, "Total hexes");
 }
 
+// The size of the whole fine mesh, in the order of the UGRID header, using
+// an exact count of coarse edges.  Only real bdry faces are counted.
+static bool fineMeshCounts(const ExaMesh& EM, const emInt numDivs,
+		size_t counts[7]) {
+	MeshSize MSIn, MSOut;
+	MSIn.nBdryVerts = EM.numBdryVerts();
+	MSIn.nVerts = EM.numVertsToCopy();
+	MSIn.nBdryTris = EM.numBdryTris();
+	MSIn.nBdryQuads = EM.numBdryQuads();
+	MSIn.nTets = EM.numTets();
+	MSIn.nPyrs = EM.numPyramids();
+	MSIn.nPrisms = EM.numPrisms();
+	MSIn.nHexes = EM.numHexes();
+	if (!computeMeshSize(MSIn, numDivs, MSOut, countEdges(EM))) return false;
+	counts[0] = MSOut.nVerts;
+	counts[1] = MSOut.nBdryTris;
+	counts[2] = MSOut.nBdryQuads;
+	counts[3] = MSOut.nTets;
+	counts[4] = MSOut.nPyrs;
+	counts[5] = MSOut.nPrisms;
+	counts[6] = MSOut.nHexes;
+	return true;
+}
+
+bool ExaMesh::refineIntoUGridFile(const emInt numDivs,
+		const char fileName[]) const {
+	double start = exaTime();
+	if (isBlockCompressedFileName(fileName)) {
+		fprintf(stderr, "Can't write %s as an uncompressed UGRID file.\n",
+						fileName);
+		return false;
+	}
+	const UGridFormat format = formatForUGridFile(fileName);
+	size_t counts[7];
+	if (!fineMeshCounts(*this, numDivs, counts)) return false;
+	UGridSliceWriter writer;
+	if (!writer.open(fileName, format, counts)) return false;
+
+	UGridStreamingSink sink(writer);
+	subdividePartMesh(this, &sink, numDivs);
+	bool ok = sink.finish() && sink.numVerts() == counts[0];
+	for (int type = 1; type < 7; type++) {
+		ok = ok && sink.numOfType(type) == counts[type];
+	}
+	ok = writer.close() && ok;
+	if (!ok) {
+		fprintf(stderr, "Couldn't write all of file %s.  Bummer!\n", fileName);
+		return false;
+	}
+
+	const double time = exaTime() - start;
+	const size_t totalCells = counts[3] + counts[4] + counts[5] + counts[6];
+	fprintf(stderr, "\nDone streaming refinement into %s.\n", fileName);
+	fprintf(stderr, "CPU time for refinement and writing = %5.2F seconds\n",
+					time);
+	fprintf(stderr, "                          %5.2F million cells / minute\n",
+					(totalCells / 1000000.) / (time / 60));
+	fprintf(stderr, "Most vert coords kept at once: %zu of %zu\n",
+					sink.maxLiveVerts(), counts[0]);
+	return true;
+}
+
+bool ExaMesh::refineIntoSingleFile(const emInt numDivs,
+		std::vector<Part>& parts, std::vector<CellPartData>& vecCPD,
+		const char fileName[], const double partitionTime) const {
+	double start = exaTime();
+	UGridFormat format;
+	if (!ugridFormatFromFileName(fileName, format)
+			|| isBlockCompressedFileName(fileName)) {
+		fprintf(stderr, "Can't write %s as a single uncompressed UGRID file.\n",
+						fileName);
+		return false;
+	}
+
+	// Lay out the file from the size of the whole fine mesh.  Only real bdry
+	// faces are written.
+	size_t counts[7];
+	if (!fineMeshCounts(*this, numDivs, counts)) return false;
+	UGridSliceWriter writer;
+	if (!writer.open(fileName, format, counts)) return false;
+
+	// First, from each coarse part alone, find how much of each slice of the
+	// file it needs and the keys of its verts on part bdry faces.  Only real
+	// bdry faces are written, and they come in blocks of nDivs^2 fine faces
+	// per coarse face, with the part bdry faces last.
+	const emInt nParts = parts.size();
+	const size_t facesPerFace = size_t(numDivs) * numDivs;
+	std::vector<std::array<size_t, 7> > partCounts(nParts);
+	std::vector<std::vector<InterfaceVert> > partKeys(nParts);
+	bool ok = true;
+	double layoutStart = exaTime();
+#pragma omp parallel for schedule(dynamic) reduction(&&: ok)
+	for (emInt ii = 0; ii < nParts; ii++) {
+		PartInterface PI;
+		std::unique_ptr<ExaMesh> coarse = extractCoarsePart(parts[ii], vecCPD,
+																												&PI);
+		ok = fineMeshCounts(*coarse, numDivs, partCounts[ii].data()) && ok;
+		partCounts[ii][1] = PI.lattices.firstTri * facesPerFace;
+		partCounts[ii][2] = PI.lattices.firstQuad * facesPerFace;
+		partKeys[ii] = findInterfaceKeys(*coarse, PI, numDivs);
+	}
+
+	// Each vert on a part bdry belongs to the lowest-numbered part that has
+	// it, which numbers it among its own verts; the interface tables list
+	// every part that has it, so the others look it up there.  Each part's
+	// verts on part bdry faces come first among its own, in key order, and
+	// everything else it has follows in the order it makes it.  Taking the
+	// parts in order, every part's slices start where the last one's end.
+	std::vector<std::vector<PartNeighbour> > tables;
+	buildInterfaceTables(partKeys, tables);
+	std::vector<std::vector<emInt> > keyIndices(nParts);
+	std::vector<std::array<size_t, 7> > partFirsts(nParts);
+	size_t nextVert = 0;
+	size_t nextCell[7] = { 0, 0, 0, 0, 0, 0, 0 };
+	for (emInt ii = 0; ii < nParts; ii++) {
+		std::vector<emInt>& indices = keyIndices[ii];
+		indices.assign(partKeys[ii].size(), EMINT_MAX);
+		for (const PartNeighbour& PN : tables[ii]) {
+			if (PN.part >= ii) break;
+			for (size_t jj = 0; jj < PN.localVerts.size(); jj++) {
+				emInt& index = indices[PN.localVerts[jj]];
+				if (index == EMINT_MAX) {
+					index = keyIndices[PN.part][PN.neighbourVerts[jj]];
+				}
+			}
+		}
+		size_t nShared = 0;
+		partFirsts[ii][0] = nextVert;
+		for (emInt& index : indices) {
+			if (index == EMINT_MAX) {
+				index = nextVert++;
+			}
+			else {
+				nShared++;
+			}
+		}
+		nextVert = partFirsts[ii][0] + partCounts[ii][0] - nShared;
+		for (int type = 1; type < 7; type++) {
+			partFirsts[ii][type] = nextCell[type];
+			nextCell[type] += partCounts[ii][type];
+		}
+	}
+	// Every slice has to be filled exactly.
+	ok = ok && nextVert == counts[0];
+	for (int type = 1; type < 7; type++) {
+		ok = ok && nextCell[type] == counts[type];
+	}
+	const double layoutTime = exaTime() - layoutStart;
+	if (!ok) {
+		writer.close();
+		fprintf(stderr, "Couldn't lay out file %s from its parts.  Bummer!\n",
+						fileName);
+		return false;
+	}
+
+	// Then refine and write the parts in parallel, each worker writing
+	// whole parts, as refineForParallel does.  Coords go out a block at a
+	// time, in the order the part numbered its verts.
+	double totalRefineTime = 0, totalExtractTime = 0;
+	pinInitialThread();
+#pragma omp parallel reduction(+: totalRefineTime, totalExtractTime) \
+		reduction(&&: ok)
+	{
+		LocalPool pool;
+		const size_t blockVerts = 1 << 16;
+		std::vector<double> block(3 * blockVerts);
+#pragma omp for schedule(dynamic)
+		for (emInt ii = 0; ii < nParts; ii++) {
+			if (!ok) continue;
+			RefineStats RS;
+			PartInterface PI;
+			std::unique_ptr<UMesh> pUM = createFineUMesh(numDivs, parts[ii], vecCPD,
+																										RS, nullptr, &PI);
+			totalRefineTime += RS.refineTime;
+			totalExtractTime += RS.extractTime;
+			const std::vector<InterfaceVert> IVs = findInterfaceVerts(PI, numDivs);
+			const std::vector<emInt>& indices = keyIndices[ii];
+			if (pUM->numVerts() != partCounts[ii][0]
+					|| IVs.size() != indices.size()) {
+				ok = false;
+				continue;
+			}
+
+			std::vector<emInt> newIndices(pUM->numVerts(), EMINT_MAX);
+			size_t nextOwn = partFirsts[ii][0], blockStart = nextOwn;
+			size_t nInBlock = 0;
+			auto addOwnVert = [&](const emInt vv) {
+				newIndices[vv] = nextOwn++;
+				pUM->getCoords(vv, block.data() + 3 * nInBlock);
+				if (++nInBlock == blockVerts) {
+					ok = writer.writeVerts(blockStart, block.data(), nInBlock) && ok;
+					blockStart += nInBlock;
+					nInBlock = 0;
+				}
+			};
+			for (size_t jj = 0; jj < IVs.size(); jj++) {
+				assert(IVs[jj].key == partKeys[ii][jj].key);
+				if (indices[jj] < partFirsts[ii][0]) {
+					newIndices[IVs[jj].fineVert] = indices[jj];
+				}
+				else {
+					assert(indices[jj] == nextOwn);
+					addOwnVert(IVs[jj].fineVert);
+				}
+			}
+			for (emInt vv = 0; vv < pUM->numVerts(); vv++) {
+				if (newIndices[vv] == EMINT_MAX) addOwnVert(vv);
+			}
+			ok = writer.writeVerts(blockStart, block.data(), nInBlock) && ok;
+
+			const emInt* const conn[] = {
+					nullptr, partCounts[ii][1] ? pUM->getBdryTriConn(0) : nullptr,
+					partCounts[ii][2] ? pUM->getBdryQuadConn(0) : nullptr,
+					pUM->numTets() ? pUM->getTetConn(0) : nullptr,
+					pUM->numPyramids() ? pUM->getPyrConn(0) : nullptr,
+					pUM->numPrisms() ? pUM->getPrismConn(0) : nullptr,
+					pUM->numHexes() ? pUM->getHexConn(0) : nullptr };
+			const size_t cellCounts[] = { 0, partCounts[ii][1], partCounts[ii][2],
+																		pUM->numTets(), pUM->numPyramids(),
+																		pUM->numPrisms(), pUM->numHexes() };
+			for (int type = 1; type < 7; type++) {
+				ok = ok && cellCounts[type] == partCounts[ii][type]
+						&& writer.writeCells(type, partFirsts[ii][type], conn[type],
+																	cellCounts[type], newIndices.data());
+			}
+			printf("Part %3" EMINT_FMT ": cells %5" EMINT_FMT "-%5" EMINT_FMT
+							", %zu verts of its own.\n", ii, parts[ii].getFirst(),
+							parts[ii].getLast(), nextOwn - partFirsts[ii][0]);
+		}
+	}
+	unpinInitialThread();
+
+	ok = writer.close() && ok;
+	if (!ok) {
+		fprintf(stderr, "Couldn't write all of file %s.  Bummer!\n", fileName);
+		return false;
+	}
+
+	const size_t totalCells = counts[3] + counts[4] + counts[5] + counts[6];
+	const double totalTime = exaTime() - start + partitionTime;
+	printf("\nDone parallel refinement into one file with %" EMINT_FMT
+					" parts.\n", nParts);
+	printf("Time for partitioning:           %10.3F seconds\n",
+					partitionTime);
+	printf("Time for laying out the file:    %10.3F seconds\n",
+					layoutTime);
+	printf("Time for coarse mesh extraction: %10.3F seconds\n",
+					totalExtractTime);
+	printf("Time for refinement:             %10.3F seconds\n",
+					totalRefineTime);
+	printf("Rate (overall):          %5.2F million cells / minute\n",
+					(totalCells / 1000000.) / (totalTime / 60));
+	prettyPrintCellCount(counts[0], "Total verts");
+	prettyPrintCellCount(totalCells, "Total cells");
+	return true;
+}
+
+bool ExaMesh::writeSnapshot(const char fileName[],
+		const std::vector<Part>* parts,
+		const std::vector<CellPartData>* vecCPD) const {
+	double timeBefore = exaTime();
+	SnapshotHeader header = SnapshotHeader();
+	SnapshotBlock blocks[eSnapMaxBlocks] = { };
+	if (m_lenScale) {
+		blocks[eSnapLenScale].data = m_lenScale;
+		blocks[eSnapLenScale].bytes = numVerts() * sizeof(double);
+	}
+	if (parts && vecCPD) {
+		header.nParts = parts->size();
+		blocks[eSnapParts].data = parts->data();
+		blocks[eSnapParts].bytes = parts->size() * sizeof(Part);
+		blocks[eSnapCellPartData].data = vecCPD->data();
+		blocks[eSnapCellPartData].bytes = vecCPD->size() * sizeof(CellPartData);
+	}
+	const int nBlocks = eSnapMeshBlocks
+			+ getSnapshotBlocks(header, blocks + eSnapMeshBlocks);
+	if (!writeSnapshotFile(fileName, header, blocks, nBlocks)) return false;
+	fprintf(stderr, "CPU time for snapshot write = %5.2F seconds\n",
+					exaTime() - timeBefore);
+	return true;
+}
+
 //void ExaMesh::buildFaceCellConnectivity() {
 //	fprintf(stderr, "Starting to build face cell connectivity\n");
 //	// Create a multimap that will hold all of the face data, in duplicate.
@@ -28,28 +28,56 @@
 
 #include <limits.h>
 #include <assert.h>
+#include <sys/types.h>
 #include <memory>
+#include <vector>
 
 #include "Mapping.h"
 #include "Part.h"
 #include "exa-defs.h"
 
+class RefineSink;
 class UMesh;
+struct PartInterface;
+struct SnapshotHeader;
+struct SnapshotBlock;
 
 struct MeshSize {
 	emInt nBdryVerts, nVerts, nBdryTris, nBdryQuads, nTets, nPyrs, nPrisms,
 			nHexes;
 };
 
+// The fine verts on coarse bdry faces, as the bdry face dividers lay them
+// out: for each face, its whole lattice, row by row (see CellTraits.h).
+// Only faces from firstTri and firstQuad on are recorded.
+struct BdryFaceLattices {
+	emInt firstTri, firstQuad;
+	std::vector<emInt> triVerts, quadVerts;
+	BdryFaceLattices() :
+			firstTri(0), firstQuad(0) {
+	}
+};
+
+// The most entries the refinement's tables of shared edges and faces held
+// at once, each on its own, and roughly how many bytes that is.
+struct RefineTableSizes {
+	size_t edges, tris, quads, bytes;
+	RefineTableSizes() :
+			edges(0), tris(0), quads(0), bytes(0) {
+	}
+};
+
 class ExaMesh {
 protected:
 	double *m_lenScale;
+	// Whether each coarse part is reordered for locality as it's extracted.
+	bool m_orderPartsForLocality;
 
 	void setupLengthScales();
 
 public:
 	ExaMesh() :
-			m_lenScale(nullptr) {
+			m_lenScale(nullptr), m_orderPartsForLocality(false) {
 	}
 	virtual ~ExaMesh() {
 		if (m_lenScale) delete[] m_lenScale;
@@ -112,11 +140,68 @@ public:
 
 	void buildFaceCellConnectivity();
 
-	virtual void refineForParallel(const emInt numDivs,
+	// With this set, parallel refinement sorts the cells of each coarse part
+	// along a space-filling curve (see Part::orderForLocality), which
+	// reorders that part's stretch of vecCPD, and numbers the part's verts
+	// in the order the cells first use them.  Shared faces then leave the
+	// refinement tables sooner, and each cell's verts are near each other
+	// in memory.  The fine mesh is the same, apart from
+	// numbering.
+	void setOrderPartsForLocality(const bool order) {
+		m_orderPartsForLocality = order;
+	}
+	bool ordersPartsForLocality() const {
+		return m_orderPartsForLocality;
+	}
+
+	// How many parts refineForParallel splits the mesh into.
+	emInt numPartsForParallel(const emInt numDivs,
 			const emInt maxCellsPerPart) const;
+	// Parts are refined in parallel, each by a single OpenMP thread that
+	// extracts, refines and writes it.  If outFileBase is given, each refined
+	// part is built directly in a mapped UGRID file named
+	// <outFileBase>NNN.<infix>.ugrid, where infix is NATIVE_UGRID_INFIX (lb8
+	// on little-endian hosts, with a trailing l for 64-bit indices), and the
+	// verts it shares with other parts are listed in
+	// <outFileBase>NNN.interface (see writeInterfaceTable in PartInterface.h).
+	virtual void refineForParallel(const emInt numDivs,
+			const emInt maxCellsPerPart, const char outFileBase[] = nullptr) const;
+	// The same, for a partition that's already been made (for instance, one
+	// read from a snapshot).  partitionTime is only used for reporting.
+	void refineForParallel(const emInt numDivs, std::vector<Part>& parts,
+			std::vector<CellPartData>& vecCPD, const char outFileBase[] = nullptr,
+			const double partitionTime = 0) const;
+	// Refine part by part, as above, but into a single globally numbered
+	// UGRID file, with each vert on a part bdry appearing only once, as one
+	// of the verts of the lowest-numbered part that has it.  Each part's
+	// slices of the file are found from its coarse mesh first, and the
+	// numbers of its verts on part bdry faces from the interface tables, so
+	// the parts are then refined and written in parallel.  Part bdry faces
+	// aren't written.
+	bool refineIntoSingleFile(const emInt numDivs, std::vector<Part>& parts,
+			std::vector<CellPartData>& vecCPD, const char fileName[],
+			const double partitionTime = 0) const;
+	// Refine the whole mesh in one pass, writing the fine mesh to an
+	// uncompressed UGRID file as it's made (see UGridStreamingSink).  Only
+	// the coords of fine verts that later cells still need are kept.
+	bool refineIntoUGridFile(const emInt numDivs, const char fileName[]) const;
+
+	// Save the mesh, its length scales and optionally a partition of it; see
+	// Snapshot.h.
+	bool writeSnapshot(const char fileName[],
+			const std::vector<Part>* parts = nullptr,
+			const std::vector<CellPartData>* vecCPD = nullptr) const;
 
+	// If pPI is given, it's filled in with what's needed to match the fine
+	// verts on the part bdry with those of other parts; see PartInterface.h.
 	virtual std::unique_ptr<UMesh> createFineUMesh(const emInt numDivs, Part& P,
-			std::vector<CellPartData>& vecCPD, struct RefineStats& RS) const = 0;
+			std::vector<CellPartData>& vecCPD, struct RefineStats& RS,
+			const char mapFileName[] = nullptr,
+			PartInterface* pPI = nullptr) const = 0;
+	// The coarse mesh of part P that createFineUMesh refines.
+	virtual std::unique_ptr<ExaMesh> extractCoarsePart(Part& P,
+			std::vector<CellPartData>& vecCPD,
+			PartInterface* pPI = nullptr) const = 0;
 
 	virtual void setupCellDataForPartitioning(std::vector<CellPartData>& vecCPD,
 			double &xmin, double& ymin, double& zmin, double& xmax, double& ymax,
@@ -124,6 +209,10 @@ public:
 	void prettyPrintCellCount(size_t cells, const char* prefix) const;
 
 protected:
+	// Set the mesh type and counts in the header and describe the mesh's
+	// own blocks, returning how many there are.
+	virtual int getSnapshotBlocks(SnapshotHeader& header,
+			SnapshotBlock blocks[]) const = 0;
 	void addCellToPartitionData(const emInt* verts, emInt nPts, emInt ii,
 			int type, std::vector<CellPartData>& vecCPD, double& xmin, double& ymin,
 			double& zmin, double& xmax, double& ymax, double& zmax) const;
@@ -143,13 +232,20 @@ void addUniquely(exa_set<T>& mySet, T& val) {
 	}
 }
 
+// The number of input edges is estimated from the Euler characteristic,
+// which assumes a connected mesh, unless it's given.
 bool computeMeshSize(const struct MeshSize& MSIn, const emInt nDivs,
-		struct MeshSize& MSOut);
+		struct MeshSize& MSOut, const ssize_t nEdgesIn = -1);
 
-// Defined elsewhere.
+// Defined elsewhere.  The fine mesh goes to pVM_output as it's made (see
+// RefineSink.h); the return value is the number of cells there.  If
+// lattices is given, the lattice of each bdry face it asks for is recorded
+// there.  If tableSizes is given, how big the edge and face tables got is
+// recorded there.
 emInt subdividePartMesh(const ExaMesh * const pVM_input,
-		UMesh * const pVM_output,
-		const int nDivs);
+		RefineSink * const pVM_output,
+		const int nDivs, BdryFaceLattices* lattices = nullptr,
+		RefineTableSizes* tableSizes = nullptr);
 
 bool partitionCells(const ExaMesh* const pEM, const emInt nPartsToMake,
 		std::vector<Part>& parts, std::vector<CellPartData>& vecCPD);
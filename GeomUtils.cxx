@@ -23,6 +23,8 @@
  *      Author: cfog
  */
 
+#include <cmath>
+
 #define MAX(a, b) \
 	((a) > (b) ? (a) : (b))
 
@@ -134,6 +136,30 @@ int checkOrient3D(const double adA[3], const double adB[3], const double adC[3],
 	return (0);
 }
 
-
-
-
+double dihedralAngle(const double coordsA[3], const double coordsB[3],
+		const double coordsC[3], const double coordsD[3]) {
+	double edge[3], toC[3], toD[3];
+	for (int ii = 0; ii < 3; ii++) {
+		edge[ii] = coordsB[ii] - coordsA[ii];
+		toC[ii] = coordsC[ii] - coordsA[ii];
+		toD[ii] = coordsD[ii] - coordsA[ii];
+	}
+	// Take out the parts along the edge.
+	const double edgeSq = edge[0] * edge[0] + edge[1] * edge[1]
+			+ edge[2] * edge[2];
+	const double alongC = (toC[0] * edge[0] + toC[1] * edge[1]
+			+ toC[2] * edge[2]) / edgeSq;
+	const double alongD = (toD[0] * edge[0] + toD[1] * edge[1]
+			+ toD[2] * edge[2]) / edgeSq;
+	for (int ii = 0; ii < 3; ii++) {
+		toC[ii] -= alongC * edge[ii];
+		toD[ii] -= alongD * edge[ii];
+	}
+	const double cross[] = { toC[1] * toD[2] - toC[2] * toD[1], toC[2] * toD[0]
+			- toC[0] * toD[2],
+														toC[0] * toD[1] - toC[1] * toD[0] };
+	const double sine = sqrt(cross[0] * cross[0] + cross[1] * cross[1]
+			+ cross[2] * cross[2]);
+	const double cosine = toC[0] * toD[0] + toC[1] * toD[1] + toC[2] * toD[2];
+	return atan2(sine, cosine);
+}
@@ -32,3 +32,8 @@ bool checkOrient3D(const double coordsA[3], const double coordsB[3],
   ((a[0] - b[0]) * (a[0] - b[0]) + (a[1] - b[1]) * (a[1] - b[1]) +         \
       (a[2] - b[2]) * (a[2] - b[2]))
 
+// The angle at edge AB between the half-planes through it that hold C and
+// D; C and D are usually the verts next to A on the two faces that share
+// AB.
+double dihedralAngle(const double coordsA[3], const double coordsB[3],
+		const double coordsC[3], const double coordsD[3]);
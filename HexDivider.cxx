@@ -25,16 +25,61 @@
 
 #include "HexDivider.h"
 
-void HexDivider::setupCoordMapping(const emInt verts[]) {
-	for (int ii = 0; ii < 8; ii++) {
-		cellVerts[ii] = verts[ii];
-	}
-	m_Map->setupCoordMapping(verts);
+namespace {
+	// Verts inside the hex, ordered layer by layer.
+	struct HexInteriorPoints {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			for (int kk = 1; kk <= nDivs - 1; kk++) {
+				const double w = (1 - double(kk) / nDivs);
+				for (int jj = 1; jj <= nDivs - 1; jj++) {
+					const double v = double(jj) / nDivs;
+					for (int ii = 1; ii <= nDivs - 1; ii++) {
+						const double u = double(ii) / nDivs;
+						out.push_back(InteriorPoint { { u, v, w }, packedLatticeIndex(
+								HexTraits::latticeShape, nDivs, ii, jj, kk) });
+					}
+				}
+			}
+		}
+	};
+
+	struct HexHexStencil {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			auto L = [nDivs](const int ii, const int jj, const int kk) {
+				return packedLatticeIndex(HexTraits::latticeShape, nDivs, ii, jj, kk);
+			};
+			for (int level = 1; level <= nDivs; level++) {
+				// Create new hexes.  Always (nDivs-1)^2 for each level.
+				for (int jj = 0; jj <= nDivs - 1; jj++) {
+					for (int ii = 0; ii <= nDivs - 1; ii++) {
+						const int verts[] = { L(ii, jj, level), L(ii + 1, jj, level), L(
+								ii + 1, jj + 1, level),
+																	L(ii, jj + 1, level), L(ii, jj, level - 1), L(
+																			ii + 1, jj, level - 1),
+																	L(ii + 1, jj + 1, level - 1), L(ii, jj + 1,
+																																	level - 1) };
+						pushCell(out, verts);
+					}
+				} // Done with this row (constant j)
+			}   // Done with this level
+		}
+	};
+
+	template<int NDIVS>
+	struct FixedHexTables {
+		static constexpr auto intPoints = makeFixedTable<InteriorPoint,
+				HexInteriorPoints, NDIVS>();
+		static constexpr auto hexStencil =
+				makeFixedTable<int, HexHexStencil, NDIVS>();
+	};
 }
 
-void HexDivider::getPhysCoordsFromParamCoords(const double uvw[3],
-		double xyz[3]) {
-	m_Map->computeTransformedCoords(uvw, xyz);
+template<int NDIVS, typename MapT>
+void HexDivider<NDIVS, MapT>::setupTables() {
+	m_intPoints = makeTable<InteriorPoint, HexInteriorPoints>(nDivs);
+	m_hexStencil = makeTable<int, HexHexStencil>(nDivs);
 }
 
 //void HexDivider::setupCoordMapping(const emInt verts[]) {
@@ -80,61 +125,30 @@ void HexDivider::getPhysCoordsFromParamCoords(const double uvw[3],
 //	}
 //}
 
-void HexDivider::divideInterior() {
-  // Number of verts added:
-  //    Tets:      (nD-1)(nD-2)(nD-3)/6
-	double uvw[3];
-	double &u = uvw[0];
-	double& v = uvw[1];
-	double& w = uvw[2];
-	for (int kk = 1; kk <= nDivs - 1; kk++) {
-		w = (1 - double(kk) / nDivs);
-		for (int jj = 1; jj <= nDivs - 1; jj++) {
-			v = double(jj) / nDivs;
-			for (int ii = 1; ii <= nDivs - 1; ii++) {
-				u = double(ii) / nDivs;
-				double coordsNew[3];
-				getPhysCoordsFromParamCoords(uvw, coordsNew);
-				emInt vNew = m_pMesh->addVert(coordsNew);
-				localVerts[ii][jj][kk] = vNew;
-      }
-    } // Done looping over all interior verts for the triangle.
-  }   // Done looping over all levels for the prism.
+template<int NDIVS, typename MapT>
+void HexDivider<NDIVS, MapT>::divideInterior() {
+	if constexpr (NDIVS > 0) {
+		this->addInteriorVerts(FixedHexTables<NDIVS>::intPoints);
+	}
+	else {
+		this->addInteriorVerts(m_intPoints);
+	}
 }
 
-void HexDivider::createNewCells() {
-	// Output info about the points for this hex, layer by layer
-
-//	for (int level = 0; level <= nDivs; level++) {
-//		fprintf(stderr, "Level = %d\n", level);
-//		for (int jj = 0; jj <= level; jj++) {
-//			for (int ii = 0; ii <= level; ii++) {
-//				const double* coords = m_pMesh->getCoords(localVerts[ii][jj][level]);
-//				fprintf(stderr, "  i = %2d, j = %2d:  (%10.6f, %10.6f, %10.6f)\n", ii,
-//								jj, coords[0], coords[1], coords[2]);
-//      }
-//    }
-//  }
-
-	for (int level = 1; level <= nDivs; level++) {
-//		fprintf(stderr, "Level: %d\n", level);
-		// Create new hexes.  Always (nDivs-1)^2 for each level.
-		for (int jj = 0; jj <= nDivs - 1; jj++) {
-			for (int ii = 0; ii <= nDivs - 1; ii++) {
-				emInt vertsNew[] = { localVerts[ii][jj][level],
-															localVerts[ii + 1][jj][level],
-															localVerts[ii + 1][jj + 1][level],
-															localVerts[ii][jj + 1][level],
-															localVerts[ii][jj][level - 1],
-															localVerts[ii + 1][jj][level - 1], localVerts[ii
-																	+ 1][jj + 1][level - 1],
-															localVerts[ii][jj + 1][level - 1] };
-#ifndef NDEBUG
-				emInt hex =
-#endif
-				m_pMesh->addHex(vertsNew);
-				assert(m_pMesh->numHexes() <= m_pMesh->maxNHexes());
-      }
-    } // Done with this row (constant j)
-  }   // Done with this level
+template<int NDIVS, typename MapT>
+void HexDivider<NDIVS, MapT>::createNewCells() {
+	if constexpr (NDIVS > 0) {
+		this->appendFromStencil(FixedHexTables<NDIVS>::hexStencil,
+													&RefineSink::addHexes);
+	}
+	else {
+		this->appendFromStencil(m_hexStencil, &RefineSink::addHexes);
+	}
 }
+
+template class HexDivider<0>;
+template class HexDivider<2>;
+template class HexDivider<3>;
+template class HexDivider<4>;
+template class HexDivider<8>;
+template class HexDivider<0, LagrangeCubicHexMapping>;
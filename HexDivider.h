@@ -29,166 +29,39 @@
 #include "CellDivider.h"
 #include "ExaMesh.h"
 
-class HexDivider: public CellDivider {
+// NDIVS is either the number of divisions per edge, known at compile time,
+// or 0 for a divider whose tables are built at run time.  MapT places new
+// verts in physical space.
+template<int NDIVS, typename MapT = UniformHexMapping>
+class HexDivider: public CellDivider<HexDivider<NDIVS, MapT>, HexTraits, MapT,
+		NDIVS> {
+	typedef CellDivider<HexDivider<NDIVS, MapT>, HexTraits, MapT, NDIVS> Base;
+	using Base::nDivs;
+	using Base::m_pMesh;
+	using Base::localVerts;
+	using Base::addInteriorVerts;
+	using Base::appendFromStencil;
 	double xyzOffsetBot[3], uVecBot[3], vVecBot[3], uvVecBot[3];
 	double xyzOffsetTop[3], uVecTop[3], vVecTop[3], uvVecTop[3];
 
 public:
-	HexDivider(UMesh *pInitMesh, const int segmentsPerEdge,
-			const Mapping::MappingType type = Mapping::Uniform)
-      :
-			CellDivider(pInitMesh, segmentsPerEdge) {
-    vertIJK[0][0] = 0;
-    vertIJK[0][1] = 0;
-    vertIJK[0][2] = nDivs;
-
-    vertIJK[1][0] = nDivs;
-    vertIJK[1][1] = 0;
-    vertIJK[1][2] = nDivs;
-
-    vertIJK[2][0] = nDivs;
-    vertIJK[2][1] = nDivs;
-    vertIJK[2][2] = nDivs;
-
-    vertIJK[3][0] = 0;
-    vertIJK[3][1] = nDivs;
-    vertIJK[3][2] = nDivs;
-
-    vertIJK[4][0] = 0;
-    vertIJK[4][1] = 0;
-    vertIJK[4][2] = 0;
-
-    vertIJK[5][0] = nDivs;
-    vertIJK[5][1] = 0;
-    vertIJK[5][2] = 0;
-
-    vertIJK[6][0] = nDivs;
-    vertIJK[6][1] = nDivs;
-    vertIJK[6][2] = 0;
-
-    vertIJK[7][0] = 0;
-    vertIJK[7][1] = nDivs;
-    vertIJK[7][2] = 0;
-
-		uvwIJK[0][0] = 0;
-		uvwIJK[0][1] = 0;
-		uvwIJK[0][2] = 0;
-
-		uvwIJK[1][0] = 1;
-		uvwIJK[1][1] = 0;
-		uvwIJK[1][2] = 0;
-
-		uvwIJK[2][0] = 1;
-		uvwIJK[2][1] = 1;
-		uvwIJK[2][2] = 0;
-
-		uvwIJK[3][0] = 0;
-		uvwIJK[3][1] = 1;
-		uvwIJK[3][2] = 0;
-
-		uvwIJK[4][0] = 0;
-		uvwIJK[4][1] = 0;
-		uvwIJK[4][2] = 1;
-
-		uvwIJK[5][0] = 1;
-		uvwIJK[5][1] = 0;
-		uvwIJK[5][2] = 1;
-
-		uvwIJK[6][0] = 1;
-		uvwIJK[6][1] = 1;
-		uvwIJK[6][2] = 1;
-
-		uvwIJK[7][0] = 0;
-		uvwIJK[7][1] = 1;
-		uvwIJK[7][2] = 1;
-
-		numVerts = 8;
-		numEdges = 12;
-		numTriFaces = 0;
-		numQuadFaces = 6;
-		edgeVertIndices[0][0] = 0;
-		edgeVertIndices[0][1] = 1;
-
-		edgeVertIndices[1][0] = 1;
-		edgeVertIndices[1][1] = 2;
-
-		edgeVertIndices[2][0] = 2;
-		edgeVertIndices[2][1] = 3;
-
-		edgeVertIndices[3][0] = 3;
-		edgeVertIndices[3][1] = 0;
-
-		edgeVertIndices[4][0] = 4;
-		edgeVertIndices[4][1] = 5;
-
-		edgeVertIndices[5][0] = 5;
-		edgeVertIndices[5][1] = 6;
-
-		edgeVertIndices[6][0] = 6;
-		edgeVertIndices[6][1] = 7;
-
-		edgeVertIndices[7][0] = 7;
-		edgeVertIndices[7][1] = 4;
-
-		edgeVertIndices[8][0] = 0;
-		edgeVertIndices[8][1] = 4;
-
-		edgeVertIndices[9][0] = 1;
-		edgeVertIndices[9][1] = 5;
-
-		edgeVertIndices[10][0] = 2;
-		edgeVertIndices[10][1] = 6;
-
-		edgeVertIndices[11][0] = 3;
-		edgeVertIndices[11][1] = 7;
-
-		faceVertIndices[0][0] = 0;
-		faceVertIndices[0][1] = 1;
-		faceVertIndices[0][2] = 2;
-		faceVertIndices[0][3] = 3;
-
-		faceVertIndices[1][0] = 7;
-		faceVertIndices[1][1] = 6;
-		faceVertIndices[1][2] = 5;
-		faceVertIndices[1][3] = 4;
-
-		faceVertIndices[2][0] = 0;
-		faceVertIndices[2][1] = 4;
-		faceVertIndices[2][2] = 5;
-		faceVertIndices[2][3] = 1;
-
-		faceVertIndices[3][0] = 1;
-		faceVertIndices[3][1] = 5;
-		faceVertIndices[3][2] = 6;
-		faceVertIndices[3][3] = 2;
-
-		faceVertIndices[4][0] = 2;
-		faceVertIndices[4][1] = 6;
-		faceVertIndices[4][2] = 7;
-		faceVertIndices[4][3] = 3;
-
-		faceVertIndices[5][0] = 3;
-		faceVertIndices[5][1] = 7;
-		faceVertIndices[5][2] = 4;
-		faceVertIndices[5][3] = 0;
-
-		if (type == Mapping::LengthScale) {
-			// TODO: Must fix this
-			m_Map = new UniformHexMapping(pInitMesh);
-		}
-		else if (type == Mapping::Lagrange) {
-			m_Map = new LagrangeCubicHexMapping(pInitMesh);
+	HexDivider(RefineSink *pSink, const ExaMesh* const pInitMesh,
+			const int segmentsPerEdge) :
+			Base(pSink, pInitMesh, segmentsPerEdge) {
+		if (NDIVS == 0) {
+			setupTables();
 		}
-		else {
-			m_Map = new UniformHexMapping(pInitMesh);
-		}
-  }
+	}
 	~HexDivider() {
 	}
 	void divideInterior();
-  void createNewCells();
-	void setupCoordMapping(const emInt verts[]);
-	void getPhysCoordsFromParamCoords(const double uvw[], double xyz[]);
+	void createNewCells();
+private:
+	// Lattice indices for the new hexes, 8 per hex.  This, and the interior
+	// points, are only filled in when NDIVS is 0.
+	std::vector<int> m_hexStencil;
+	std::vector<InteriorPoint> m_intPoints;
+	void setupTables();
 };
 
 #endif /* APPS_EXAMESH_HEXDIVIDER_H_ */
@@ -104,6 +104,19 @@ public:
 	void computeTransformedCoords(const double uvw[3], double xyz[3]) const;
 };
 
+// Bdry faces are divided using verts that already exist on the edges and
+// faces of the cells, so they never need to place new ones.
+class NoMapping {
+public:
+	NoMapping(const ExaMesh* const) {
+	}
+	void setupCoordMapping(const emInt /*verts*/[]) {
+	}
+	void computeTransformedCoords(const double /*uvw*/[3],
+			double /*xyz*/[3]) const {
+	}
+};
+
 class LengthScaleMapping: public Mapping {
 protected:
 	double getIsoLengthScale(const emInt vert);
@@ -0,0 +1,206 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*
+ * NumaMemory.cxx
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "exa-defs.h"
+#include "NumaMemory.h"
+
+static bool useHugePages = false;
+static const size_t hugePageBytes = size_t(2) << 20;
+
+void* allocateLocal(const size_t bytes) {
+	if (bytes == 0) return nullptr;
+	// Anonymous mappings are zero pages until written.
+	void* ptr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+										MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (ptr == MAP_FAILED) return nullptr;
+#ifdef MADV_HUGEPAGE
+	if (useHugePages && bytes >= hugePageBytes) {
+		// Only advice; if the kernel won't, small pages work just as well.
+		madvise(ptr, bytes, MADV_HUGEPAGE);
+	}
+#endif
+	return ptr;
+}
+
+void freeLocal(void* ptr, const size_t bytes) {
+	if (ptr) munmap(ptr, bytes);
+}
+
+// A fine part mesh and the coarse one it came from, with room to spare.
+static const size_t maxPoolBlocks = 4;
+static thread_local LocalPool* activePool = nullptr;
+
+LocalPool::LocalPool() :
+		m_outer(activePool) {
+	activePool = this;
+}
+
+LocalPool::~LocalPool() {
+	for (const Block& block : m_blocks) {
+		freeLocal(block.ptr, block.capacity);
+	}
+	assert(activePool == this);
+	activePool = m_outer;
+}
+
+void* LocalPool::take(const size_t bytes, size_t& capacity) {
+	auto best = m_blocks.end();
+	for (auto iter = m_blocks.begin(); iter != m_blocks.end(); ++iter) {
+		if (iter->capacity >= bytes
+				&& (best == m_blocks.end() || iter->capacity < best->capacity)) {
+			best = iter;
+		}
+	}
+	if (best == m_blocks.end()) return nullptr;
+	void* const ptr = best->ptr;
+	capacity = best->capacity;
+	m_blocks.erase(best);
+	return ptr;
+}
+
+void LocalPool::give(void* ptr, const size_t capacity) {
+	m_blocks.push_back(Block { ptr, capacity });
+	if (m_blocks.size() > maxPoolBlocks) {
+		// The smallest block is the least likely to fit the next part.
+		auto smallest = std::min_element(m_blocks.begin(), m_blocks.end(),
+				[](const Block& a, const Block& b) {
+					return a.capacity < b.capacity;
+				});
+		freeLocal(smallest->ptr, smallest->capacity);
+		m_blocks.erase(smallest);
+	}
+}
+
+LocalPool* LocalPool::active() {
+	return activePool;
+}
+
+void* allocateReusable(const size_t bytes, const bool mustZero,
+		size_t& capacity, bool& isZero) {
+	LocalPool* const pool = LocalPool::active();
+	if (pool) {
+		void* const ptr = pool->take(bytes, capacity);
+		if (ptr) {
+			if (mustZero) memset(ptr, 0, bytes);
+			isZero = mustZero;
+			return ptr;
+		}
+		// Leave some room, so that a slightly bigger part next time still
+		// fits; the pages aren't touched unless they're used.
+		capacity = bytes + bytes / 8;
+	}
+	else {
+		capacity = bytes;
+	}
+	isZero = true;
+	return allocateLocal(capacity);
+}
+
+void freeReusable(void* ptr, const size_t capacity) {
+	if (!ptr) return;
+	LocalPool* const pool = LocalPool::active();
+	if (pool) pool->give(ptr, capacity);
+	else freeLocal(ptr, capacity);
+}
+
+void setUseHugePages(const bool use) {
+	useHugePages = use;
+}
+
+#if defined(_OPENMP) && defined(__linux__)
+// The CPU pinWorkerThreads kept for the initial thread, or -1 if it didn't
+// pin any threads, and the initial thread's own binding while it's pinned.
+static int initialThreadCPU = -1;
+static bool isInitialThreadPinned = false;
+static cpu_set_t initialThreadBinding;
+#endif
+
+void pinWorkerThreads() {
+#if defined(_OPENMP) && defined(__linux__)
+	if (getenv("OMP_PROC_BIND")) return;
+	cpu_set_t allowed;
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) return;
+	std::vector<int> cpus;
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+		if (CPU_ISSET(cpu, &allowed)) cpus.push_back(cpu);
+	}
+	if (cpus.size() < 2) return;
+	// Thread 0 is the initial thread; the rest go on the other CPUs in order,
+	// which the kernel numbers socket by socket on most machines.  With more
+	// threads than CPUs, they wrap around, but never onto the initial
+	// thread's CPU.
+	int nPinned = 0;
+#pragma omp parallel reduction(+: nPinned)
+	{
+		const int thread = omp_get_thread_num();
+		if (thread != 0) {
+			cpu_set_t mine;
+			CPU_ZERO(&mine);
+			CPU_SET(cpus[1 + (thread - 1) % (cpus.size() - 1)], &mine);
+			if (pthread_setaffinity_np(pthread_self(), sizeof(mine), &mine) == 0) {
+				nPinned++;
+			}
+		}
+	}
+	if (nPinned > 0) initialThreadCPU = cpus[0];
+	fprintf(stderr, "Pinned %d worker threads.\n", nPinned);
+#endif
+}
+
+void pinInitialThread() {
+#if defined(_OPENMP) && defined(__linux__)
+	if (initialThreadCPU < 0 || isInitialThreadPinned || omp_in_parallel()) {
+		return;
+	}
+	if (pthread_getaffinity_np(pthread_self(), sizeof(initialThreadBinding),
+															&initialThreadBinding) != 0) {
+		return;
+	}
+	cpu_set_t mine;
+	CPU_ZERO(&mine);
+	CPU_SET(initialThreadCPU, &mine);
+	isInitialThreadPinned = (pthread_setaffinity_np(pthread_self(),
+																									sizeof(mine), &mine) == 0);
+#endif
+}
+
+void unpinInitialThread() {
+#if defined(_OPENMP) && defined(__linux__)
+	if (!isInitialThreadPinned || omp_in_parallel()) return;
+	pthread_setaffinity_np(pthread_self(), sizeof(initialThreadBinding),
+													&initialThreadBinding);
+	isInitialThreadPinned = false;
+#endif
+}
@@ -0,0 +1,98 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*
+ * NumaMemory.h
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#ifndef SRC_NUMAMEMORY_H_
+#define SRC_NUMAMEMORY_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+// Memory for big arrays (mesh file images, mostly), taken straight from
+// the OS so that no page is touched until something is written there.  On
+// a NUMA machine, each page then lands on the node of the thread that
+// fills it ("first touch"), which is what parallel readers and per-part
+// workers want.  calloc can't promise this:  once glibc has freed a block
+// that size, it hands out the next one from its heap and zeroes it on the
+// calling thread.  Memory from allocateLocal reads as zero; returns null
+// if the allocation fails.
+void* allocateLocal(const size_t bytes);
+void freeLocal(void* ptr, const size_t bytes);
+
+// Blocks freed with freeReusable while a LocalPool is active on the same
+// thread are kept in it, and allocateReusable hands them out again, so
+// that refining part after part doesn't fault in (and have the kernel
+// zero) gigabytes of fresh pages for every part.  Pools nest; each thread
+// has its own, which keeps reused pages on the worker's NUMA node.
+class LocalPool {
+	struct Block {
+		void* ptr;
+		size_t capacity;
+	};
+	std::vector<Block> m_blocks;
+	LocalPool* m_outer;
+	LocalPool(const LocalPool&);
+	LocalPool& operator=(const LocalPool&);
+public:
+	LocalPool();
+	// Blocks still held go back to the OS.
+	~LocalPool();
+	// The smallest block that holds bytes, or null if none does.
+	void* take(const size_t bytes, size_t& capacity);
+	void give(void* ptr, const size_t capacity);
+	static LocalPool* active();
+};
+
+// Like allocateLocal, but reuses a block from the active pool if one is
+// big enough.  capacity is set to the block's real size, which is what
+// freeReusable needs back.  A reused block is zeroed only if mustZero;
+// isZero says whether the memory returned reads as zero.
+void* allocateReusable(const size_t bytes, const bool mustZero,
+		size_t& capacity, bool& isZero);
+void freeReusable(void* ptr, const size_t capacity);
+
+// Ask for transparent huge pages for allocations of at least 2 MB from now
+// on.  That cuts TLB misses when refining into big coordinate and
+// connectivity arrays, but first touch then places memory 2 MB at a time.
+void setUseHugePages(const bool use);
+
+// Bind every OpenMP worker thread but the initial one to its own CPU, out
+// of those the process may run on, so workers stay near the memory they
+// first touched.  The first of those CPUs is kept for the initial thread
+// (see pinInitialThread), even when there are more threads than CPUs.  The
+// initial thread itself stays free, so that threads the runtime creates
+// later don't inherit a single-CPU binding.  Does nothing
+// if OMP_PROC_BIND is set, since the runtime is binding threads already.
+void pinWorkerThreads();
+
+// The initial thread is a worker too, inside parallel regions.  Around a
+// region whose workers each allocate and fill their own memory, these bind
+// it to the CPU pinWorkerThreads kept free for it, and then give it back
+// the binding it had.  Both do nothing unless pinWorkerThreads pinned
+// threads, or if called inside a parallel region.
+void pinInitialThread();
+void unpinInitialThread();
+
+#endif /* SRC_NUMAMEMORY_H_ */
@@ -0,0 +1,333 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * PackedConn.cxx
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+
+#include "PackedConn.h"
+
+// The SIMD decoder is built for SSSE3 whatever the compiler flags, and is
+// only used if the CPU running it has SSSE3.
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <tmmintrin.h>
+#define EXA_SSSE3_DECODER
+#endif
+
+// Packed data is a header, then an index of nBlocks + 1 offsets (from the
+// start of the packed data) to where each block starts, then the blocks,
+// then enough padding that a 16-byte load starting anywhere in the last
+// block stays inside the data.  Each block is its control bytes followed
+// by its difference bytes.
+namespace {
+	struct PackedHeader {
+		uint64_t nCells;
+		uint32_t nPts;
+		uint32_t cellsPerBlock;
+		uint64_t nBlocks;
+	};
+
+	const size_t cellsPerBlock = 4096;
+	const size_t paddingBytes = 16;
+
+	// For each control byte, the total length of its group of four, and the
+	// shuffle that moves each value's bytes to the bottom of its own 32-bit
+	// lane (0x80 zeroes a byte).
+	struct DecodeTables {
+		uint8_t length[256];
+		uint8_t shuffle[256][16];
+		DecodeTables() {
+			for (int ctrl = 0; ctrl < 256; ctrl++) {
+				int offset = 0;
+				for (int ii = 0; ii < 4; ii++) {
+					const int len = ((ctrl >> (2 * ii)) & 3) + 1;
+					for (int bb = 0; bb < 4; bb++) {
+						shuffle[ctrl][4 * ii + bb] = (bb < len) ? offset + bb : 0x80;
+					}
+					offset += len;
+				}
+				length[ctrl] = offset;
+			}
+		}
+	};
+	const DecodeTables decodeTables;
+}
+
+static inline uint32_t zigzag(const int32_t value) {
+	return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+}
+
+static inline uint32_t unzigzag(const uint32_t value) {
+	return (value >> 1) ^ (0 - (value & 1));
+}
+
+static inline int byteLength(const uint32_t value) {
+	return (value < (1u << 8)) ? 1 :
+					(value < (1u << 16)) ? 2 : (value < (1u << 24)) ? 3 : 4;
+}
+
+// Pack a block of cells into out, or with out null, just find how many
+// bytes that takes.  fits is cleared if a difference is too big.
+static size_t packBlock(const emInt* conn, const size_t nCells,
+		const int nPts, char* out, bool& fits) {
+	const size_t nInts = nCells * nPts;
+	const size_t ctrlBytes = (nInts + 3) / 4;
+	uint8_t* const ctrl = reinterpret_cast<uint8_t*>(out);
+	if (out) memset(ctrl, 0, ctrlBytes);
+	size_t dataBytes = 0;
+	emInt prevFirst = 0;
+	for (size_t ii = 0; ii < nInts; ii++) {
+		const emInt first = conn[ii - ii % nPts];
+		const emInt base = (ii % nPts == 0) ? prevFirst : first;
+		const int64_t diff = int64_t(conn[ii]) - int64_t(base);
+		fits = fits && diff >= INT32_MIN && diff <= INT32_MAX;
+		const uint32_t value = zigzag(int32_t(diff));
+		const int len = byteLength(value);
+		if (out) {
+			ctrl[ii / 4] |= (len - 1) << (2 * (ii % 4));
+			char* const data = out + ctrlBytes + dataBytes;
+			for (int bb = 0; bb < len; bb++) {
+				data[bb] = char(value >> (8 * bb));
+			}
+		}
+		dataBytes += len;
+		if (ii % nPts == 0) prevFirst = first;
+	}
+	return ctrlBytes + dataBytes;
+}
+
+#ifdef EXA_SSSE3_DECODER
+// Four values per control byte: one shuffle puts each value's bytes in its
+// own lane, and the zigzag is undone in place.  Returns where the data for
+// the values after the groups starts.
+__attribute__((target("ssse3")))
+static const uint8_t* decodeGroupsSSSE3(const uint8_t* ctrl,
+		const size_t nGroups, const uint8_t* data, int32_t* deltas) {
+	const __m128i one = _mm_set1_epi32(1);
+	for (size_t ii = 0; ii < nGroups; ii++) {
+		const __m128i packed = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(data));
+		const __m128i shuffle = _mm_loadu_si128(
+				reinterpret_cast<const __m128i*>(decodeTables.shuffle[ctrl[ii]]));
+		const __m128i values = _mm_shuffle_epi8(packed, shuffle);
+		const __m128i decoded = _mm_xor_si128(
+				_mm_srli_epi32(values, 1),
+				_mm_sub_epi32(_mm_setzero_si128(), _mm_and_si128(values, one)));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(deltas + 4 * ii), decoded);
+		data += decodeTables.length[ctrl[ii]];
+	}
+	return data;
+}
+
+// Called while statics are set up, so the CPU has to be checked first.
+static bool detectSSSE3() {
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("ssse3");
+}
+
+static const bool cpuHasSSSE3 = detectSSSE3();
+static bool useSIMD = cpuHasSSSE3;
+#else
+static bool useSIMD = false;
+#endif
+
+bool setUseSIMDUnpacking(const bool use) {
+#ifdef EXA_SSSE3_DECODER
+	useSIMD = use && cpuHasSSSE3;
+#else
+	(void) use;
+#endif
+	return useSIMD;
+}
+
+// Decode the nInts differences of a block (still relative to their bases)
+// into deltas.  Returns false if the control bytes don't match the block
+// size.
+static bool decodeDeltas(const char* block, const size_t blockBytes,
+		const size_t nInts, int32_t* deltas) {
+	const size_t ctrlBytes = (nInts + 3) / 4;
+	const uint8_t* const ctrl = reinterpret_cast<const uint8_t*>(block);
+	const size_t nGroups = nInts / 4;
+	size_t dataBytes = 0;
+	for (size_t ii = 0; ii < nGroups; ii++) {
+		dataBytes += decodeTables.length[ctrl[ii]];
+	}
+	for (size_t ii = 4 * nGroups; ii < nInts; ii++) {
+		dataBytes += ((ctrl[ii / 4] >> (2 * (ii % 4))) & 3) + 1;
+	}
+	if (ctrlBytes + dataBytes != blockBytes) return false;
+
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(block + ctrlBytes);
+	size_t scalarStart = 0;
+#ifdef EXA_SSSE3_DECODER
+	if (useSIMD) {
+		data = decodeGroupsSSSE3(ctrl, nGroups, data, deltas);
+		scalarStart = 4 * nGroups;
+	}
+#endif
+	for (size_t ii = scalarStart; ii < nInts; ii++) {
+		const int len = ((ctrl[ii / 4] >> (2 * (ii % 4))) & 3) + 1;
+		uint32_t value = 0;
+		for (int bb = 0; bb < len; bb++) {
+			value |= uint32_t(data[bb]) << (8 * bb);
+		}
+		data += len;
+		deltas[ii] = int32_t(unzigzag(value));
+	}
+	return true;
+}
+
+// Turn differences back into verts.
+static void applyDeltas(const int32_t* deltas, const size_t nCells,
+		const int nPts, emInt* conn) {
+	emInt prevFirst = 0;
+	for (size_t cc = 0; cc < nCells; cc++) {
+		const int32_t* const cellDeltas = deltas + cc * nPts;
+		emInt* const cellConn = conn + cc * nPts;
+		const emInt first = emInt(int64_t(prevFirst) + cellDeltas[0]);
+		cellConn[0] = first;
+#pragma omp simd
+		for (int jj = 1; jj < nPts; jj++) {
+			cellConn[jj] = emInt(int64_t(first) + cellDeltas[jj]);
+		}
+		prevFirst = first;
+	}
+}
+
+std::vector<char> packConnectivity(const emInt* conn, const size_t nCells,
+		const int nPts) {
+	const size_t nBlocks = (nCells + cellsPerBlock - 1) / cellsPerBlock;
+	const size_t indexStart = sizeof(PackedHeader);
+	std::vector<uint64_t> index(nBlocks + 1);
+
+	// Sizing the blocks first lets each be packed straight into place.
+	bool fits = true;
+#pragma omp parallel for schedule(dynamic) reduction(&&: fits)
+	for (size_t iB = 0; iB < nBlocks; iB++) {
+		const size_t first = iB * cellsPerBlock;
+		const size_t count = std::min(cellsPerBlock, nCells - first);
+		index[iB + 1] = packBlock(conn + first * nPts, count, nPts, nullptr, fits);
+	}
+	if (!fits) return std::vector<char>();
+	index[0] = indexStart + sizeof(uint64_t) * (nBlocks + 1);
+	for (size_t iB = 0; iB < nBlocks; iB++) {
+		index[iB + 1] += index[iB];
+	}
+
+	std::vector<char> packed(index[nBlocks] + paddingBytes, 0);
+	PackedHeader header;
+	header.nCells = nCells;
+	header.nPts = nPts;
+	header.cellsPerBlock = cellsPerBlock;
+	header.nBlocks = nBlocks;
+	memcpy(packed.data(), &header, sizeof(header));
+	memcpy(packed.data() + indexStart, index.data(),
+					sizeof(uint64_t) * index.size());
+#pragma omp parallel for schedule(dynamic) reduction(&&: fits)
+	for (size_t iB = 0; iB < nBlocks; iB++) {
+		const size_t first = iB * cellsPerBlock;
+		const size_t count = std::min(cellsPerBlock, nCells - first);
+		packBlock(conn + first * nPts, count, nPts, packed.data() + index[iB],
+							fits);
+	}
+	return packed;
+}
+
+bool packedConnectivitySize(const char* packed, const size_t bytes,
+		size_t& nCells, int& nPts) {
+	PackedHeader header;
+	if (bytes < sizeof(header)) return false;
+	memcpy(&header, packed, sizeof(header));
+	const size_t indexStart = sizeof(header);
+	if (header.nPts < 1 || header.nPts > 64
+			|| header.cellsPerBlock != cellsPerBlock
+			|| header.nBlocks != (header.nCells + cellsPerBlock - 1) / cellsPerBlock
+			|| (bytes - indexStart) / sizeof(uint64_t) < header.nBlocks + 1) {
+		return false;
+	}
+	const char* const index = packed + indexStart;
+	uint64_t start, end;
+	memcpy(&start, index, sizeof(start));
+	memcpy(&end, index + sizeof(uint64_t) * header.nBlocks, sizeof(end));
+	bool ok = start == indexStart + sizeof(uint64_t) * (header.nBlocks + 1)
+			&& end + paddingBytes <= bytes;
+#pragma omp parallel for reduction(&&: ok)
+	for (uint64_t iB = 0; iB < header.nBlocks; iB++) {
+		uint64_t offsets[2];
+		memcpy(offsets, index + sizeof(uint64_t) * iB, sizeof(offsets));
+		ok = offsets[0] <= offsets[1] && ok;
+	}
+	nCells = header.nCells;
+	nPts = header.nPts;
+	return ok;
+}
+
+bool unpackConnectivity(const char* packed, const size_t firstCell,
+		const size_t count, emInt* conn) {
+	if (count == 0) return true;
+	PackedHeader header;
+	memcpy(&header, packed, sizeof(header));
+	const int nPts = header.nPts;
+	if (firstCell + count > header.nCells) return false;
+	const char* const index = packed + sizeof(header);
+	const size_t firstBlock = firstCell / cellsPerBlock;
+	const size_t lastBlock = (firstCell + count - 1) / cellsPerBlock;
+	bool ok = true;
+#pragma omp parallel reduction(&&: ok)
+	{
+		std::vector<int32_t> deltas(cellsPerBlock * nPts);
+		std::vector<emInt> partial;
+#pragma omp for schedule(dynamic)
+		for (size_t iB = firstBlock; iB <= lastBlock; iB++) {
+			uint64_t offsets[2];
+			memcpy(offsets, index + sizeof(uint64_t) * iB, sizeof(offsets));
+			const size_t blockStart = iB * cellsPerBlock;
+			const size_t blockCells = std::min(size_t(header.nCells) - blockStart,
+																					cellsPerBlock);
+			if (!decodeDeltas(packed + offsets[0], offsets[1] - offsets[0],
+												blockCells * nPts, deltas.data())) {
+				ok = false;
+				continue;
+			}
+			// Blocks that are wanted whole go straight into place.
+			if (blockStart >= firstCell
+					&& blockStart + blockCells <= firstCell + count) {
+				applyDeltas(deltas.data(), blockCells, nPts,
+										conn + (blockStart - firstCell) * nPts);
+			}
+			else {
+				partial.resize(blockCells * nPts);
+				applyDeltas(deltas.data(), blockCells, nPts, partial.data());
+				const size_t copyStart = std::max(firstCell, blockStart);
+				const size_t copyEnd = std::min(firstCell + count,
+																				blockStart + blockCells);
+				std::copy(partial.begin() + (copyStart - blockStart) * nPts,
+									partial.begin() + (copyEnd - blockStart) * nPts,
+									conn + (copyStart - firstCell) * nPts);
+			}
+		}
+	}
+	return ok;
+}
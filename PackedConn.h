@@ -0,0 +1,67 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * PackedConn.h
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#ifndef SRC_PACKEDCONN_H_
+#define SRC_PACKEDCONN_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "exa-defs.h"
+
+// Compact encoding of cell connectivity.  The verts of a refined cell are
+// almost always close to each other in index space, and to those of the
+// cell before it, so each cell is stored as the difference between its
+// first vert and the previous cell's first vert, plus the differences
+// between its other verts and its first.  Differences are zigzag-encoded
+// and stored in 1 to 4 bytes each, with the lengths of each group of four
+// in a separate control byte (the "stream VByte" layout), which is what
+// lets them be decoded with a few SIMD instructions per group.
+//
+// Cells are packed in independent blocks, with an index of where each
+// block starts, so packing and unpacking run in parallel and any range of
+// cells can be unpacked without the rest.  Packed data is in native byte
+// order, and is only meant to be read by the same kind of machine.
+
+// Pack nCells cells of nPts verts each.  Returns an empty vector if two
+// verts of a cell (or the first verts of two cells in a row) are more than
+// 2^31 apart.
+std::vector<char> packConnectivity(const emInt* conn, const size_t nCells,
+		const int nPts);
+
+// Check the header and index of packed data and find what it holds.
+bool packedConnectivitySize(const char* packed, const size_t bytes,
+		size_t& nCells, int& nPts);
+
+// Unpack cells [firstCell, firstCell + count) into conn, in parallel over
+// blocks.  The data must have passed packedConnectivitySize.
+bool unpackConnectivity(const char* packed, const size_t firstCell,
+		const size_t count, emInt* conn);
+
+// On x86, unpacking uses SSSE3 if the CPU has it; this turns that off or
+// back on (for testing, say).  Returns whether SIMD is now used.
+bool setUseSIMDUnpacking(const bool use);
+
+#endif /* SRC_PACKEDCONN_H_ */
@@ -23,6 +23,8 @@
  *      Author: cfog
  */
 
+#include <stdint.h>
+
 #include <algorithm>
 
 #include <assert.h>
@@ -105,3 +107,83 @@ void Part::split(std::vector<CellPartData>& vCPD, Part& P1, Part& P2) const {
 }
 
 
+
+// Position along a Hilbert curve through a 2^bits lattice on each axis,
+// from integer coordinates, using Skilling's transpose method.
+static uint64_t hilbertKey(uint32_t X[3], const int bits) {
+	const uint32_t M = 1U << (bits - 1);
+	// Undo the excess work of the inverse transform.
+	for (uint32_t Q = M; Q > 1; Q >>= 1) {
+		const uint32_t P = Q - 1;
+		for (int ii = 0; ii < 3; ii++) {
+			if (X[ii] & Q) {
+				X[0] ^= P;
+			}
+			else {
+				const uint32_t t = (X[0] ^ X[ii]) & P;
+				X[0] ^= t;
+				X[ii] ^= t;
+			}
+		}
+	}
+	// Gray encode.
+	X[1] ^= X[0];
+	X[2] ^= X[1];
+	uint32_t t = 0;
+	for (uint32_t Q = M; Q > 1; Q >>= 1) {
+		if (X[2] & Q) t ^= Q - 1;
+	}
+	for (int ii = 0; ii < 3; ii++) {
+		X[ii] ^= t;
+	}
+	// Interleave the bits of the transposed form.
+	uint64_t key = 0;
+	for (int bit = bits - 1; bit >= 0; bit--) {
+		for (int ii = 0; ii < 3; ii++) {
+			key = (key << 1) | ((X[ii] >> bit) & 1);
+		}
+	}
+	return key;
+}
+
+void Part::orderForLocality(std::vector<CellPartData>& vCPD) const {
+	if (m_last - m_first < 2) return;
+	// The curve fills the box around the centroids themselves, which may be
+	// a bit smaller than the part's box.
+	double mins[] = { DBL_MAX, DBL_MAX, DBL_MAX };
+	double maxes[] = { -DBL_MAX, -DBL_MAX, -DBL_MAX };
+	for (emInt ii = m_first; ii < m_last; ii++) {
+		for (int jj = 0; jj < 3; jj++) {
+			mins[jj] = std::min(mins[jj], vCPD[ii].getCoord(jj));
+			maxes[jj] = std::max(maxes[jj], vCPD[ii].getCoord(jj));
+		}
+	}
+	// 21 bits per axis fills a 63-bit key.
+	const int bits = 21;
+	const double latticeMax = (1U << bits) - 1;
+	double scale[3];
+	for (int jj = 0; jj < 3; jj++) {
+		const double extent = maxes[jj] - mins[jj];
+		scale[jj] = extent > 0 ? latticeMax / extent : 0;
+	}
+
+	std::vector<std::pair<uint64_t, emInt> > keys;
+	keys.reserve(m_last - m_first);
+	for (emInt ii = m_first; ii < m_last; ii++) {
+		uint32_t X[3];
+		for (int jj = 0; jj < 3; jj++) {
+			const double coord = (vCPD[ii].getCoord(jj) - mins[jj]) * scale[jj];
+			X[jj] = uint32_t(std::min(latticeMax, std::max(0., coord)));
+		}
+		keys.push_back(std::make_pair(hilbertKey(X, bits), ii));
+	}
+	// Cells with the same key keep their order.
+	std::sort(keys.begin(), keys.end());
+
+	std::vector<CellPartData> sorted;
+	sorted.reserve(keys.size());
+	for (const auto& key : keys) {
+		sorted.push_back(vCPD[key.second]);
+	}
+	std::copy(sorted.begin(), sorted.end(), vCPD.begin() + m_first);
+}
@@ -85,6 +85,10 @@ public:
 		return m_nParts;
 	}
 	void split(std::vector<CellPartData>& vCPD, Part& P1, Part& P2) const;
+	// Sort this part's cells along a Hilbert curve through their centroids,
+	// so that cells next to each other in the list are near each other in
+	// space.
+	void orderForLocality(std::vector<CellPartData>& vCPD) const;
 
 	emInt getFirst() const {
 		return m_first;
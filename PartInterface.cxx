@@ -0,0 +1,459 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*
+ * PartInterface.cxx
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <map>
+#include <utility>
+
+#include "CellTraits.h"
+#include "PartInterface.h"
+
+bool operator==(const InterfaceVertKey& a, const InterfaceVertKey& b) {
+	return std::equal(a.verts, a.verts + 4, b.verts) && a.ii == b.ii
+			&& a.jj == b.jj;
+}
+
+bool operator<(const InterfaceVertKey& a, const InterfaceVertKey& b) {
+	for (int ii = 0; ii < 4; ii++) {
+		if (a.verts[ii] != b.verts[ii]) return a.verts[ii] < b.verts[ii];
+	}
+	return a.ii < b.ii || (a.ii == b.ii && a.jj < b.jj);
+}
+
+// The key for a point that's a weighted average of up to four coarse
+// verts; the weights add up to nDivs, and zero weights are dropped.
+static InterfaceVertKey weightedKey(const emInt verts[], const int weights[],
+		const int nPts) {
+	std::pair<emInt, int> points[4];
+	int nPoints = 0;
+	for (int ii = 0; ii < nPts; ii++) {
+		if (weights[ii] > 0) {
+			points[nPoints++] = std::make_pair(verts[ii], weights[ii]);
+		}
+	}
+	for (int ii = 1; ii < nPoints; ii++) {
+		for (int jj = ii; jj > 0 && points[jj] < points[jj - 1]; jj--) {
+			std::swap(points[jj], points[jj - 1]);
+		}
+	}
+	InterfaceVertKey key = { { EMINT_MAX, EMINT_MAX, EMINT_MAX, EMINT_MAX }, 0,
+														0 };
+	for (int ii = 0; ii < nPoints; ii++) {
+		key.verts[ii] = points[ii].first;
+	}
+	if (nPoints > 1) key.ii = points[1].second;
+	if (nPoints > 2) key.jj = points[2].second;
+	return key;
+}
+
+// The key for lattice point (ii,jj) of a quad with the given corners, at
+// lattice points (0,0), (nDivs,0), (nDivs,nDivs) and (0,nDivs).
+static InterfaceVertKey quadKey(const emInt corners[4], const int nDivs,
+		const int ii, const int jj) {
+	// On the quad's edges, points are weighted averages of two corners,
+	// just as they are for tris.
+	if (ii == 0 || jj == 0 || ii == nDivs || jj == nDivs) {
+		int weights[4] = { 0, 0, 0, 0 };
+		if (jj == 0) {
+			weights[0] = nDivs - ii;
+			weights[1] = ii;
+		}
+		else if (ii == nDivs) {
+			weights[1] = nDivs - jj;
+			weights[2] = jj;
+		}
+		else if (jj == nDivs) {
+			weights[2] = ii;
+			weights[3] = nDivs - ii;
+		}
+		else {
+			weights[0] = nDivs - jj;
+			weights[3] = jj;
+		}
+		return weightedKey(corners, weights, 4);
+	}
+
+	// Inside, the point is located relative to the canonical first corner.
+	static const int cornerIJ[4][2] = { { 0, 0 }, { 1, 0 }, { 1, 1 }, { 0, 1 } };
+	const int first = std::min_element(corners, corners + 4) - corners;
+	const int dir = (corners[(first + 1) % 4] < corners[(first + 3) % 4]) ? 1 : 3;
+	const int next = (first + dir) % 4, prev = (first + 4 - dir) % 4;
+	InterfaceVertKey key = { { corners[first], corners[next],
+															corners[(first + 2) % 4], corners[prev] },
+														0, 0 };
+	const int di = ii - cornerIJ[first][0] * nDivs;
+	const int dj = jj - cornerIJ[first][1] * nDivs;
+	key.ii = di * (cornerIJ[next][0] - cornerIJ[first][0])
+			+ dj * (cornerIJ[next][1] - cornerIJ[first][1]);
+	key.jj = di * (cornerIJ[prev][0] - cornerIJ[first][0])
+			+ dj * (cornerIJ[prev][1] - cornerIJ[first][1]);
+	return key;
+}
+
+std::vector<InterfaceVert> findInterfaceVerts(const PartInterface& PI,
+		const int nDivs) {
+	const BdryFaceLattices& lattices = PI.lattices;
+	const size_t triPts = packedLatticeSize(eTriLayers, nDivs, 1);
+	const size_t quadPts = packedLatticeSize(eQuadLayers, nDivs, 1);
+	const size_t nTris = lattices.triVerts.size() / triPts;
+	const size_t nQuads = lattices.quadVerts.size() / quadPts;
+	// The corners of each lattice are coarse verts, which keep their
+	// indices in the fine mesh.
+	auto globalVert = [&](const emInt fineVert) {
+		assert(fineVert < PI.coarseToGlobal.size());
+		return PI.coarseToGlobal[fineVert];
+	};
+
+	std::vector<InterfaceVert> result(
+			lattices.triVerts.size() + lattices.quadVerts.size());
+#pragma omp parallel for schedule(dynamic, 64)
+	for (size_t iF = 0; iF < nTris; iF++) {
+		const emInt* const lattice = lattices.triVerts.data() + iF * triPts;
+		const emInt corners[] = {
+				globalVert(lattice[packedLatticeIndex(eTriLayers, nDivs, 0, 0, 0)]),
+				globalVert(lattice[packedLatticeIndex(eTriLayers, nDivs, nDivs, 0, 0)]),
+				globalVert(lattice[packedLatticeIndex(eTriLayers, nDivs, 0, nDivs, 0)]) };
+		for (int jj = 0; jj <= nDivs; jj++) {
+			for (int ii = 0; ii <= nDivs - jj; ii++) {
+				const int index = packedLatticeIndex(eTriLayers, nDivs, ii, jj, 0);
+				const int weights[] = { nDivs - ii - jj, ii, jj };
+				InterfaceVert& IV = result[iF * triPts + index];
+				IV.key = weightedKey(corners, weights, 3);
+				IV.fineVert = lattice[index];
+			}
+		}
+	}
+#pragma omp parallel for schedule(dynamic, 64)
+	for (size_t iF = 0; iF < nQuads; iF++) {
+		const emInt* const lattice = lattices.quadVerts.data() + iF * quadPts;
+		const emInt corners[] = {
+				globalVert(lattice[packedLatticeIndex(eQuadLayers, nDivs, 0, 0, 0)]),
+				globalVert(
+						lattice[packedLatticeIndex(eQuadLayers, nDivs, nDivs, 0, 0)]),
+				globalVert(
+						lattice[packedLatticeIndex(eQuadLayers, nDivs, nDivs, nDivs, 0)]),
+				globalVert(
+						lattice[packedLatticeIndex(eQuadLayers, nDivs, 0, nDivs, 0)]) };
+		for (int jj = 0; jj <= nDivs; jj++) {
+			for (int ii = 0; ii <= nDivs; ii++) {
+				const int index = packedLatticeIndex(eQuadLayers, nDivs, ii, jj, 0);
+				InterfaceVert& IV = result[lattices.triVerts.size() + iF * quadPts
+						+ index];
+				IV.key = quadKey(corners, nDivs, ii, jj);
+				IV.fineVert = lattice[index];
+			}
+		}
+	}
+
+	// Verts on edges are shared by faces, and coarse verts even more so.
+	std::sort(result.begin(), result.end(),
+						[](const InterfaceVert& a, const InterfaceVert& b) {
+							return a.key < b.key;
+						});
+	result.erase(std::unique(result.begin(), result.end(),
+														[](const InterfaceVert& a, const InterfaceVert& b) {
+															assert(!(a.key == b.key) || a.fineVert == b.fineVert);
+															return a.key == b.key;
+														}),
+								result.end());
+	return result;
+}
+
+std::vector<InterfaceVert> findInterfaceKeys(const ExaMesh& coarsePart,
+		const PartInterface& PI, const int nDivs) {
+	const emInt firstTri = PI.lattices.firstTri;
+	const emInt firstQuad = PI.lattices.firstQuad;
+	const size_t nTris = coarsePart.numBdryTris() - firstTri;
+	const size_t nQuads = coarsePart.numBdryQuads() - firstQuad;
+	auto globalVert = [&](const emInt coarseVert) {
+		assert(coarseVert < PI.coarseToGlobal.size());
+		return PI.coarseToGlobal[coarseVert];
+	};
+
+	// The keys don't depend on how a face is oriented, so its corners can be
+	// taken in the order the coarse mesh has them.
+	std::vector<InterfaceVert> result;
+	result.reserve(nTris * (nDivs + 1) * (nDivs + 2) / 2
+			+ nQuads * (nDivs + 1) * (nDivs + 1));
+	for (size_t iF = 0; iF < nTris; iF++) {
+		const emInt* const conn = coarsePart.getBdryTriConn(firstTri + iF);
+		const emInt corners[] = { globalVert(conn[0]), globalVert(conn[1]),
+															globalVert(conn[2]) };
+		for (int jj = 0; jj <= nDivs; jj++) {
+			for (int ii = 0; ii <= nDivs - jj; ii++) {
+				const int weights[] = { nDivs - ii - jj, ii, jj };
+				result.push_back( { weightedKey(corners, weights, 3), 0 });
+			}
+		}
+	}
+	for (size_t iF = 0; iF < nQuads; iF++) {
+		const emInt* const conn = coarsePart.getBdryQuadConn(firstQuad + iF);
+		const emInt corners[] = { globalVert(conn[0]), globalVert(conn[1]),
+															globalVert(conn[2]), globalVert(conn[3]) };
+		for (int jj = 0; jj <= nDivs; jj++) {
+			for (int ii = 0; ii <= nDivs; ii++) {
+				result.push_back( { quadKey(corners, nDivs, ii, jj), 0 });
+			}
+		}
+	}
+
+	std::sort(result.begin(), result.end(),
+						[](const InterfaceVert& a, const InterfaceVert& b) {
+							return a.key < b.key;
+						});
+	result.erase(std::unique(result.begin(), result.end(),
+														[](const InterfaceVert& a, const InterfaceVert& b) {
+															return a.key == b.key;
+														}),
+								result.end());
+	for (size_t ii = 0; ii < result.size(); ii++) {
+		result[ii].fineVert = ii;
+	}
+	return result;
+}
+
+namespace {
+	struct SharedVert {
+		const InterfaceVertKey* key;
+		emInt part, fineVert;
+	};
+}
+
+void buildInterfaceTables(
+		const std::vector<std::vector<InterfaceVert> >& partVerts,
+		std::vector<std::vector<PartNeighbour> >& tables) {
+	const emInt nParts = partVerts.size();
+	std::vector<SharedVert> all;
+	for (emInt part = 0; part < nParts; part++) {
+		for (const InterfaceVert& IV : partVerts[part]) {
+			all.push_back( { &IV.key, part, IV.fineVert });
+		}
+	}
+	// Each part's verts are already sorted by key, so keeping the parts in
+	// order within each key keeps every table in key order.  That's what
+	// makes both sides of each table list their verts in the same order.
+	std::stable_sort(all.begin(), all.end(),
+										[](const SharedVert& a, const SharedVert& b) {
+											return *a.key < *b.key;
+										});
+
+	std::vector<std::map<emInt, PartNeighbour> > neighbours(nParts);
+	for (size_t begin = 0, end = 0; begin < all.size(); begin = end) {
+		for (end = begin + 1; end < all.size() && *all[end].key == *all[begin].key;
+				end++) {
+		}
+		for (size_t aa = begin; aa < end; aa++) {
+			for (size_t bb = begin; bb < end; bb++) {
+				if (aa == bb) continue;
+				PartNeighbour& PN = neighbours[all[aa].part][all[bb].part];
+				PN.part = all[bb].part;
+				PN.localVerts.push_back(all[aa].fineVert);
+				PN.neighbourVerts.push_back(all[bb].fineVert);
+			}
+		}
+	}
+
+	tables.assign(nParts, std::vector<PartNeighbour>());
+	for (emInt part = 0; part < nParts; part++) {
+		for (auto& entry : neighbours[part]) {
+			tables[part].push_back(std::move(entry.second));
+		}
+	}
+}
+
+// The file holds this header, and then for each neighbour its part and
+// number of shared verts (as two uint64s), its localVerts and its
+// neighbourVerts.
+namespace {
+	struct InterfaceTableHeader {
+		char magic[8];
+		uint32_t version;
+		// Written as 0x01020304 in native byte order.
+		uint32_t byteOrder;
+		uint32_t intBytes;
+		uint32_t part;
+		uint64_t nNeighbours;
+	};
+}
+
+static const char interfaceMagic[8] = "ExaPIfc";
+static const uint32_t interfaceVersion = 1;
+static const uint32_t interfaceByteOrder = 0x01020304;
+
+bool writeInterfaceTable(const char fileName[], const emInt part,
+		const std::vector<PartNeighbour>& table) {
+	FILE* file = fopen(fileName, "wb");
+	if (!file) {
+		fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n",
+						fileName);
+		return false;
+	}
+	InterfaceTableHeader header;
+	memcpy(header.magic, interfaceMagic, sizeof(header.magic));
+	header.version = interfaceVersion;
+	header.byteOrder = interfaceByteOrder;
+	header.intBytes = sizeof(emInt);
+	header.part = part;
+	header.nNeighbours = table.size();
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+	for (const PartNeighbour& PN : table) {
+		assert(PN.localVerts.size() == PN.neighbourVerts.size());
+		const uint64_t sizes[] = { PN.part, PN.localVerts.size() };
+		const size_t nVerts = PN.localVerts.size();
+		ok = ok && fwrite(sizes, sizeof(sizes), 1, file) == 1
+				&& fwrite(PN.localVerts.data(), sizeof(emInt), nVerts, file) == nVerts
+				&& fwrite(PN.neighbourVerts.data(), sizeof(emInt), nVerts, file)
+						== nVerts;
+	}
+	if (fclose(file) != 0) ok = false;
+	if (!ok) {
+		fprintf(stderr, "Couldn't write interface table %s.\n", fileName);
+	}
+	return ok;
+}
+
+bool readInterfaceTable(const char fileName[], emInt& part,
+		std::vector<PartNeighbour>& table) {
+	FILE* file = fopen(fileName, "rb");
+	if (!file) {
+		fprintf(stderr, "Couldn't open file %s for reading.  Bummer!\n",
+						fileName);
+		return false;
+	}
+	InterfaceTableHeader header;
+	bool ok = fread(&header, sizeof(header), 1, file) == 1
+			&& memcmp(header.magic, interfaceMagic, sizeof(interfaceMagic)) == 0
+			&& header.version == interfaceVersion
+			&& header.byteOrder == interfaceByteOrder
+			&& header.intBytes == sizeof(emInt);
+	table.clear();
+	for (uint64_t iN = 0; ok && iN < header.nNeighbours; iN++) {
+		uint64_t sizes[2];
+		ok = fread(sizes, sizeof(sizes), 1, file) == 1 && sizes[0] < EMINT_MAX
+				&& sizes[1] < EMINT_MAX;
+		if (!ok) break;
+		PartNeighbour PN;
+		PN.part = sizes[0];
+		PN.localVerts.resize(sizes[1]);
+		PN.neighbourVerts.resize(sizes[1]);
+		ok = fread(PN.localVerts.data(), sizeof(emInt), sizes[1], file) == sizes[1]
+				&& fread(PN.neighbourVerts.data(), sizeof(emInt), sizes[1], file)
+						== sizes[1];
+		table.push_back(std::move(PN));
+	}
+	fclose(file);
+	if (!ok) {
+		fprintf(stderr, "%s isn't a valid interface table for this build.\n",
+						fileName);
+		return false;
+	}
+	part = header.part;
+	return true;
+}
+
+namespace {
+	// The corner conn of one type of cell, and its edges.
+	struct CellEdges {
+		emInt nCells;
+		const emInt* (ExaMesh::*getConn)(const emInt) const;
+		const int (*edges)[2];
+		int nEdges;
+	};
+}
+
+// Call visit(lower, higher) for each edge of each cell, in parallel; must
+// be called from inside a parallel region.
+template<typename Visitor>
+static void visitCellEdges(const ExaMesh& EM, const CellEdges groups[],
+		const int nGroups, Visitor& visit) {
+	for (int iG = 0; iG < nGroups; iG++) {
+		const CellEdges& group = groups[iG];
+#pragma omp for schedule(static)
+		for (emInt cell = 0; cell < group.nCells; cell++) {
+			const emInt* const conn = (EM.*group.getConn)(cell);
+			for (int iE = 0; iE < group.nEdges; iE++) {
+				const emInt v0 = conn[group.edges[iE][0]];
+				const emInt v1 = conn[group.edges[iE][1]];
+				visit(std::min(v0, v1), std::max(v0, v1));
+			}
+		}
+	}
+}
+
+size_t countEdges(const ExaMesh& EM) {
+	const CellEdges groups[] = {
+			{ EM.numTets(), &ExaMesh::getTetConn, TetTraits::edgeVerts,
+				TetTraits::numEdges },
+			{ EM.numPyramids(), &ExaMesh::getPyrConn, PyrTraits::edgeVerts,
+				PyrTraits::numEdges },
+			{ EM.numPrisms(), &ExaMesh::getPrismConn, PrismTraits::edgeVerts,
+				PrismTraits::numEdges },
+			{ EM.numHexes(), &ExaMesh::getHexConn, HexTraits::edgeVerts,
+				HexTraits::numEdges } };
+	const int nGroups = sizeof(groups) / sizeof(groups[0]);
+
+	// Bucket each edge by its lower vert; then each bucket is small enough
+	// to sort on its own.
+	const emInt nVerts = EM.numVertsToCopy();
+	std::vector<size_t> starts(size_t(nVerts) + 1, 0);
+	std::vector<emInt> higher;
+	size_t nEdges = 0;
+#pragma omp parallel
+	{
+		auto count = [&](const emInt lower, const emInt) {
+#pragma omp atomic
+			starts[lower + 1]++;
+		};
+		visitCellEdges(EM, groups, nGroups, count);
+#pragma omp single
+		{
+			for (emInt vv = 0; vv < nVerts; vv++) {
+				starts[vv + 1] += starts[vv];
+			}
+			higher.resize(starts[nVerts]);
+		}
+		// Filling each bucket moves its start up to its end, which is where
+		// the next one starts.
+		auto scatter = [&](const emInt lower, const emInt upper) {
+			size_t slot;
+#pragma omp atomic capture
+			slot = starts[lower]++;
+			higher[slot] = upper;
+		};
+		visitCellEdges(EM, groups, nGroups, scatter);
+#pragma omp for schedule(dynamic, 1024) reduction(+: nEdges)
+		for (emInt vv = 0; vv < nVerts; vv++) {
+			const auto begin = higher.begin() + (vv ? starts[vv - 1] : 0);
+			const auto end = higher.begin() + starts[vv];
+			std::sort(begin, end);
+			nEdges += std::unique(begin, end) - begin;
+		}
+	}
+	return nEdges;
+}
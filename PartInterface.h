@@ -0,0 +1,105 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*
+ * PartInterface.h
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#ifndef SRC_PARTINTERFACE_H_
+#define SRC_PARTINTERFACE_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "ExaMesh.h"
+
+// What's needed to match the fine verts on the bdry of a refined part with
+// those of its neighbours, without any geometric search.
+struct PartInterface {
+	// Global index of each of the part's coarse verts.
+	std::vector<emInt> coarseToGlobal;
+	// The fine verts on the part bdry faces, which are the last bdry faces
+	// of the coarse part mesh.
+	BdryFaceLattices lattices;
+};
+
+// A fine vert on a part bdry is identified by where it lies in the coarse
+// mesh, in global coarse vert indices, so that every part that has it
+// finds the same key, however its faces are oriented:
+//   - at a coarse vert:  verts = { v }.
+//   - on a coarse edge:  verts = { v0 < v1 }, ii steps from v0.
+//   - inside a coarse tri:  verts = { v0 < v1 < v2 }, with ii and jj the
+//     weights (out of nDivs) of v1 and v2.
+//   - inside a coarse quad:  verts are its corners, starting from the
+//     smallest and heading towards its smaller neighbour; ii and jj are
+//     steps along the first and last edges.
+// Unused verts are EMINT_MAX.
+struct InterfaceVertKey {
+	emInt verts[4];
+	int ii, jj;
+};
+bool operator==(const InterfaceVertKey& a, const InterfaceVertKey& b);
+bool operator<(const InterfaceVertKey& a, const InterfaceVertKey& b);
+
+struct InterfaceVert {
+	InterfaceVertKey key;
+	emInt fineVert;
+};
+
+// All the fine verts on the part bdry, sorted by key, each once.
+std::vector<InterfaceVert> findInterfaceVerts(const PartInterface& PI,
+		const int nDivs);
+
+// The same keys, in the same order, found from the coarse part mesh that
+// PI was filled in for, so before the part is refined.  Each one's
+// fineVert is its place in the list.
+std::vector<InterfaceVert> findInterfaceKeys(const ExaMesh& coarsePart,
+		const PartInterface& PI, const int nDivs);
+
+// The fine verts a part shares with one neighbouring part, as indices into
+// each part's own fine mesh (zero-based).  Both parts list their shared
+// verts in the same order, so values sent in one part's order arrive in
+// the other's.
+struct PartNeighbour {
+	emInt part;
+	std::vector<emInt> localVerts, neighbourVerts;
+};
+
+// From each part's interface verts, as findInterfaceVerts gives them, find
+// which verts each part shares with each of its neighbours.  Verts on
+// coarse edges and at coarse verts can be shared by several parts, and
+// appear in the table for each of them.  Neighbours are in part order.
+void buildInterfaceTables(
+		const std::vector<std::vector<InterfaceVert> >& partVerts,
+		std::vector<std::vector<PartNeighbour> >& tables);
+
+// A part's table, in its own file next to the part's mesh file.  Native
+// byte order only.
+bool writeInterfaceTable(const char fileName[], const emInt part,
+		const std::vector<PartNeighbour>& table);
+bool readInterfaceTable(const char fileName[], emInt& part,
+		std::vector<PartNeighbour>& table);
+
+// The number of distinct edges of the mesh's cells.
+size_t countEdges(const ExaMesh& EM);
+
+#endif /* SRC_PARTINTERFACE_H_ */
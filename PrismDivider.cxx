@@ -25,16 +25,75 @@
 
 #include "PrismDivider.h"
 
-void PrismDivider::setupCoordMapping(const emInt verts[]) {
-	for (int ii = 0; ii < 6; ii++) {
-		cellVerts[ii] = verts[ii];
-	}
-	m_Map->setupCoordMapping(verts);
+namespace {
+	// Verts inside the prism, ordered layer by layer.
+	struct PrismInteriorPoints {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			for (int kk = 1; kk < nDivs; kk++) {
+				const double w = (1 - double(kk) / nDivs);
+				for (int jj = 1; jj <= nDivs - 2; jj++) {
+					const double v = double(jj) / nDivs;
+					for (int ii = 1; ii <= nDivs - 1 - jj; ii++) {
+						const double u = double(ii) / nDivs;
+						out.push_back(InteriorPoint { { u, v, w }, packedLatticeIndex(
+								PrismTraits::latticeShape, nDivs, ii, jj, kk) });
+					}
+				} // Done looping over all interior verts for the triangle.
+			}   // Done looping over all levels for the prism.
+		}
+	};
+
+	struct PrismPrismStencil {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			auto L = [nDivs](const int ii, const int jj, const int kk) {
+				return packedLatticeIndex(PrismTraits::latticeShape, nDivs, ii, jj, kk);
+			};
+			for (int level = 1; level <= nDivs; level++) {
+				// Create up-pointing Prisms.
+				for (int jj = 0; jj <= nDivs - 1; jj++) {
+					int ii = -1;
+					for (ii = 0; ii <= nDivs - jj - 2; ii++) {
+						const int verts1[] = { L(ii, jj, level), L(ii + 1, jj, level), L(
+								ii, jj + 1, level),
+																	 L(ii, jj, level - 1), L(ii + 1, jj, level - 1),
+																	 L(ii, jj + 1, level - 1) };
+						pushCell(out, verts1);
+
+						// And now the other in that pair:
+						const int verts2[] = { verts1[1], L(ii + 1, jj + 1, level),
+																	 verts1[2], verts1[4], L(ii + 1, jj + 1,
+																													 level - 1),
+																	 verts1[5] };
+						pushCell(out, verts2);
+					} // Done with all prism pairs for this row.
+					// Now one more at the end.
+					ii = nDivs - jj - 1;
+					const int vertsLast[] = { L(ii, jj, level), L(ii + 1, jj, level), L(
+							ii, jj + 1, level),
+																		L(ii, jj, level - 1), L(ii + 1, jj,
+																														level - 1),
+																		L(ii, jj + 1, level - 1) };
+					pushCell(out, vertsLast);
+				} // Done with this row (constant j)
+			}   // Done with this level
+		}
+	};
+
+	template<int NDIVS>
+	struct FixedPrismTables {
+		static constexpr auto intPoints = makeFixedTable<InteriorPoint,
+				PrismInteriorPoints, NDIVS>();
+		static constexpr auto prismStencil = makeFixedTable<int,
+				PrismPrismStencil, NDIVS>();
+	};
 }
 
-void PrismDivider::getPhysCoordsFromParamCoords(const double uvw[3],
-		double xyz[3]) {
-	m_Map->computeTransformedCoords(uvw, xyz);
+template<int NDIVS, typename MapT>
+void PrismDivider<NDIVS, MapT>::setupTables() {
+	m_intPoints = makeTable<InteriorPoint, PrismInteriorPoints>(nDivs);
+	m_prismStencil = makeTable<int, PrismPrismStencil>(nDivs);
 }
 
 //
@@ -74,76 +133,30 @@ void PrismDivider::getPhysCoordsFromParamCoords(const double uvw[3],
 //	}
 //}
 
-void PrismDivider::divideInterior() {
-  // Number of verts added:
-  //    Tets:      (nD-1)(nD-2)(nD-3)/6
-	double uvw[3];
-	double &u = uvw[0];
-	double& v = uvw[1];
-	double& w = uvw[2];
-	for (int kk = 1; kk < nDivs; kk++) {
-		w = (1 - double(kk) / nDivs);
-		for (int jj = 1; jj <= nDivs - 2; jj++) {
-			v = double(jj) / nDivs;
-			for (int ii = 1; ii <= nDivs - 1 - jj; ii++) {
-				u = double(ii) / nDivs;
-				double coordsNew[3];
-				getPhysCoordsFromParamCoords(uvw, coordsNew);
-				emInt vNew = m_pMesh->addVert(coordsNew);
-				localVerts[ii][jj][kk] = vNew;
-      }
-    } // Done looping over all interior verts for the triangle.
-  }   // Done looping over all levels for the prism.
+template<int NDIVS, typename MapT>
+void PrismDivider<NDIVS, MapT>::divideInterior() {
+	if constexpr (NDIVS > 0) {
+		this->addInteriorVerts(FixedPrismTables<NDIVS>::intPoints);
+	}
+	else {
+		this->addInteriorVerts(m_intPoints);
+	}
 }
 
-void PrismDivider::createNewCells() {
-	// Output info about the points for this Prism, layer by layer
-//	double newVol = 0;
-//	for (int level = 0; level <= nDivs; level++) {
-//		fprintf(stderr, "Level = %d\n", level);
-//		for (int jj = 0; jj <= nDivs; jj++) {
-//			for (int ii = 0; ii <= nDivs - jj; ii++) {
-//				const double* coords = m_pMesh->getCoords(localVerts[ii][jj][level]);
-//				fprintf(stderr, "  i = %2d, j = %2d:  (%10.6f, %10.6f, %10.6f)\n", ii,
-//								jj, coords[0], coords[1], coords[2]);
-//			}
-//		}
-//	}
-
-	for (int level = 1; level <= nDivs; level++) {
-//		fprintf(stderr, "Level: %d\n", level);
-		// Create up-pointing Prisms.
-		for (int jj = 0; jj <= nDivs - 1; jj++) {
-      int ii = -1;
-			for (ii = 0; ii <= nDivs - jj - 2; ii++) {
-				emInt vertsNew1[] = { localVerts[ii][jj][level],
-															localVerts[ii + 1][jj][level], localVerts[ii][jj
-																	+ 1][level],
-															localVerts[ii][jj][level - 1],
-															localVerts[ii + 1][jj][level - 1],
-															localVerts[ii][jj + 1][level - 1] };
-				m_pMesh->addPrism(vertsNew1);
-				assert(m_pMesh->numPrisms() < m_pMesh->maxNPrisms());
-
-				// And now the other in that pair:
-				emInt vertsNew2[] = { vertsNew1[1], localVerts[ii + 1][jj + 1][level],
-															vertsNew1[2], vertsNew1[4], localVerts[ii + 1][jj
-																	+ 1][level - 1],
-															vertsNew1[5] };
-				m_pMesh->addPrism(vertsNew2);
-				assert(m_pMesh->numPrisms() < m_pMesh->maxNPrisms());
-      } // Done with all prism pairs for this row.
-      // Now one more at the end.
-      ii = nDivs - jj - 1;
-			emInt vertsNewLast[] = { localVerts[ii][jj][level],
-																localVerts[ii + 1][jj][level], localVerts[ii][jj
-																		+ 1][level],
-																localVerts[ii][jj][level - 1],
-																localVerts[ii + 1][jj][level - 1],
-																localVerts[ii][jj + 1][level - 1] };
-			m_pMesh->addPrism(vertsNewLast);
-			assert(m_pMesh->numPrisms() <= m_pMesh->maxNPrisms());
-    } // Done with this row (constant j)
-  }   // Done with this level
-//	logMessage(MSG_MANAGER, "  final volume: %G\n", newVol);
+template<int NDIVS, typename MapT>
+void PrismDivider<NDIVS, MapT>::createNewCells() {
+	if constexpr (NDIVS > 0) {
+		this->appendFromStencil(FixedPrismTables<NDIVS>::prismStencil,
+													&RefineSink::addPrisms);
+	}
+	else {
+		this->appendFromStencil(m_prismStencil, &RefineSink::addPrisms);
+	}
 }
+
+template class PrismDivider<0>;
+template class PrismDivider<2>;
+template class PrismDivider<3>;
+template class PrismDivider<4>;
+template class PrismDivider<8>;
+template class PrismDivider<0, LagrangeCubicPrismMapping>;
@@ -29,133 +29,38 @@
 #include "CellDivider.h"
 #include "ExaMesh.h"
 
-class PrismDivider: public CellDivider {
+// NDIVS is either the number of divisions per edge, known at compile time,
+// or 0 for a divider whose tables are built at run time.  MapT places new
+// verts in physical space.
+template<int NDIVS, typename MapT = UniformPrismMapping>
+class PrismDivider: public CellDivider<PrismDivider<NDIVS, MapT>, PrismTraits, MapT,
+		NDIVS> {
+	typedef CellDivider<PrismDivider<NDIVS, MapT>, PrismTraits, MapT, NDIVS> Base;
+	using Base::nDivs;
+	using Base::m_pMesh;
+	using Base::localVerts;
+	using Base::addInteriorVerts;
+	using Base::appendFromStencil;
 	double xyzOffsetBot[3], uVecBot[3], vVecBot[3];
 	double xyzOffsetTop[3], uVecTop[3], vVecTop[3];
 public:
-	PrismDivider(UMesh *pInitMesh, const int segmentsPerEdge,
-			const Mapping::MappingType type = Mapping::Uniform)
-:
-			CellDivider(pInitMesh, segmentsPerEdge) {
-    vertIJK[0][0] = 0;
-    vertIJK[0][1] = 0;
-    vertIJK[0][2] = nDivs;
-
-    vertIJK[1][0] = nDivs;
-    vertIJK[1][1] = 0;
-    vertIJK[1][2] = nDivs;
-
-    vertIJK[2][0] = 0;
-    vertIJK[2][1] = nDivs;
-    vertIJK[2][2] = nDivs;
-
-    vertIJK[3][0] = 0;
-    vertIJK[3][1] = 0;
-    vertIJK[3][2] = 0;
-
-    vertIJK[4][0] = nDivs;
-    vertIJK[4][1] = 0;
-    vertIJK[4][2] = 0;
-
-    vertIJK[5][0] = 0;
-    vertIJK[5][1] = nDivs;
-    vertIJK[5][2] = 0;
-
-		uvwIJK[0][0] = 0;
-		uvwIJK[0][1] = 0;
-		uvwIJK[0][2] = 0;
-
-		uvwIJK[1][0] = 1;
-		uvwIJK[1][1] = 0;
-		uvwIJK[1][2] = 0;
-
-		uvwIJK[2][0] = 0;
-		uvwIJK[2][1] = 1;
-		uvwIJK[2][2] = 0;
-
-		uvwIJK[3][0] = 0;
-		uvwIJK[3][1] = 0;
-		uvwIJK[3][2] = 1;
-
-		uvwIJK[4][0] = 1;
-		uvwIJK[4][1] = 0;
-		uvwIJK[4][2] = 1;
-
-		uvwIJK[5][0] = 0;
-		uvwIJK[5][1] = 1;
-		uvwIJK[5][2] = 1;
-
-		numVerts = 6;
-		numEdges = 9;
-		numTriFaces = 2;
-		numQuadFaces = 3;
-		edgeVertIndices[0][0] = 0;
-		edgeVertIndices[0][1] = 1;
-
-		edgeVertIndices[1][0] = 1;
-		edgeVertIndices[1][1] = 2;
-
-		edgeVertIndices[2][0] = 0;
-		edgeVertIndices[2][1] = 2;
-
-		edgeVertIndices[3][0] = 3;
-		edgeVertIndices[3][1] = 4;
-
-		edgeVertIndices[4][0] = 4;
-		edgeVertIndices[4][1] = 5;
-
-		edgeVertIndices[5][0] = 3;
-		edgeVertIndices[5][1] = 5;
-
-		edgeVertIndices[6][0] = 0;
-		edgeVertIndices[6][1] = 3;
-
-		edgeVertIndices[7][0] = 1;
-		edgeVertIndices[7][1] = 4;
-
-		edgeVertIndices[8][0] = 2;
-		edgeVertIndices[8][1] = 5;
-
-		faceVertIndices[0][0] = 2;
-		faceVertIndices[0][1] = 1;
-		faceVertIndices[0][2] = 4;
-		faceVertIndices[0][3] = 5;
-
-		faceVertIndices[1][0] = 1;
-		faceVertIndices[1][1] = 0;
-		faceVertIndices[1][2] = 3;
-		faceVertIndices[1][3] = 4;
-
-		faceVertIndices[2][0] = 0;
-		faceVertIndices[2][1] = 2;
-		faceVertIndices[2][2] = 5;
-		faceVertIndices[2][3] = 3;
-
-		faceVertIndices[3][0] = 0;
-		faceVertIndices[3][1] = 1;
-		faceVertIndices[3][2] = 2;
-
-		faceVertIndices[4][0] = 5;
-		faceVertIndices[4][1] = 4;
-		faceVertIndices[4][2] = 3;
-
-		if (type == Mapping::LengthScale) {
-			// TODO: Must fix this
-			m_Map = new UniformPrismMapping(pInitMesh);
+	PrismDivider(RefineSink *pSink, const ExaMesh* const pInitMesh,
+			const int segmentsPerEdge) :
+			Base(pSink, pInitMesh, segmentsPerEdge) {
+		if (NDIVS == 0) {
+			setupTables();
 		}
-		else if (type == Mapping::Lagrange) {
-			m_Map = new LagrangeCubicPrismMapping(pInitMesh);
-		}
-		else {
-			m_Map = new UniformPrismMapping(pInitMesh);
-		}
-  }
+	}
 	~PrismDivider() {
 	}
-	virtual void divideInterior();
-	virtual void createNewCells();
-	void setupCoordMapping(const emInt verts[]);
-	void getPhysCoordsFromParamCoords(const double uvw[], double xyz[]);
+	void divideInterior();
+	void createNewCells();
+private:
+	// Lattice indices for the new prisms, 6 per prism.  This, and the
+	// interior points, are only filled in when NDIVS is 0.
+	std::vector<int> m_prismStencil;
+	std::vector<InteriorPoint> m_intPoints;
+	void setupTables();
 };
 
 #endif /* APPS_EXAMESH_PRISMDIVIDER_H_ */
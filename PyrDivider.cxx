@@ -26,16 +26,111 @@
 #include "GeomUtils.h"
 #include "PyrDivider.h"
 
-void PyrDivider::setupCoordMapping(const emInt verts[]) {
-	for (int ii = 0; ii < 5; ii++) {
-		cellVerts[ii] = verts[ii];
-	}
-	m_Map->setupCoordMapping(verts);
+namespace {
+	// Verts inside the pyramid, ordered layer by layer.
+	struct PyrInteriorPoints {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			// Number of verts added:
+			//    Pyrs:      (nD-1)(nD-2)(2 nD-3)/6
+			for (int kk = 2; kk <= nDivs - 1; kk++) {
+				const double w = 1 - double(kk) / nDivs;
+				for (int jj = 1; jj <= kk - 1; jj++) {
+					const double v = double(jj) / nDivs;
+					for (int ii = 1; ii <= kk - 1; ii++) {
+						const double u = double(ii) / nDivs;
+						out.push_back(InteriorPoint { { u, v, w }, packedLatticeIndex(
+								PyrTraits::latticeShape, nDivs, ii, jj, kk) });
+					}
+				}
+			} // Done looping to create all verts inside the pyramid.
+		}
+	};
+
+	struct PyrPyrStencil {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			auto L = [nDivs](const int ii, const int jj, const int kk) {
+				return packedLatticeIndex(PyrTraits::latticeShape, nDivs, ii, jj, kk);
+			};
+			for (int level = 1; level <= nDivs; level++) {
+				// Create up-pointing pyrs.  For a given level, there are
+				// level^2 of these.
+				for (int jj = 0; jj < level; jj++) {
+					for (int ii = 0; ii < level; ii++) {
+						const int verts[] = { L(ii, jj, level), L(ii + 1, jj, level), L(
+								ii + 1, jj + 1, level),
+																	L(ii, jj + 1, level), L(ii, jj, level - 1) };
+						pushCell(out, verts);
+					}
+				}
+
+				// Down-pointing pyramids, hanging from quads on the previous level.
+				// There are (level-1)^2 of these.
+				for (int jj = 0; jj <= level - 2; jj++) {
+					for (int ii = 0; ii <= level - 2; ii++) {
+						const int verts[] = { L(ii, jj, level - 1), L(ii, jj + 1,
+																													level - 1),
+																	L(ii + 1, jj + 1, level - 1), L(ii + 1, jj,
+																																					level - 1),
+																	L(ii + 1, jj + 1, level) };
+						pushCell(out, verts);
+					}
+				}
+			}
+		}
+	};
+
+	// Now there are tets in the gaps between these pyramids.  There are
+	// 2 (level-1) (level-2) of these on each level.
+	struct PyrTetStencil {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			auto L = [nDivs](const int ii, const int jj, const int kk) {
+				return packedLatticeIndex(PyrTraits::latticeShape, nDivs, ii, jj, kk);
+			};
+			for (int level = 1; level <= nDivs; level++) {
+				// The set on lines of constant j on level l.
+				for (int jj = 1; jj <= level - 1; jj++) {
+					for (int ii = 0; ii <= level - 1; ii++) {
+						const int verts[] = { L(ii, jj, level), L(ii + 1, jj, level), L(ii,
+																																						 jj,
+																																						 level
+																																						 - 1),
+																	L(ii, jj - 1, level - 1) };
+						pushCell(out, verts);
+					}
+				}
+
+				// The set on lines of constant i on level l.
+				for (int jj = 0; jj <= level - 1; jj++) {
+					for (int ii = 1; ii <= level - 1; ii++) {
+						const int verts[] = { L(ii, jj, level), L(ii, jj + 1, level), L(
+								ii - 1, jj, level - 1),
+																	L(ii, jj, level - 1) };
+						pushCell(out, verts);
+					}
+				}
+			} // Done with this level
+		}
+	};
+
+	template<int NDIVS>
+	struct FixedPyrTables {
+		static constexpr auto intPoints = makeFixedTable<InteriorPoint,
+				PyrInteriorPoints, NDIVS>();
+		static constexpr auto pyrStencil =
+				makeFixedTable<int, PyrPyrStencil, NDIVS>();
+		static constexpr auto tetStencil =
+				makeFixedTable<int, PyrTetStencil, NDIVS>();
+	};
 }
 
-void PyrDivider::getPhysCoordsFromParamCoords(const double uvw[3],
-		double xyz[3]) {
-	m_Map->computeTransformedCoords(uvw, xyz);
+template<int NDIVS, typename MapT>
+void PyrDivider<NDIVS, MapT>::setupTables() {
+	m_intPoints = makeTable<InteriorPoint, PyrInteriorPoints>(nDivs);
+	m_pyrStencil = makeTable<int, PyrPyrStencil>(nDivs);
+	m_tetStencil = makeTable<int, PyrTetStencil>(nDivs);
 }
 
 //void PyrDivider::setupCoordMapping(const emInt verts[]) {
@@ -76,104 +171,41 @@ void PyrDivider::getPhysCoordsFromParamCoords(const double uvw[3],
 //}
 
 
-void PyrDivider::divideInterior() {
-  // Number of verts added:
-	//    Pyrs:      (nD-1)(nD-2)(2 nD-3)/6
-	double uvw[3];
-	double &u = uvw[0];
-	double &v = uvw[1];
-	double &w = uvw[2];
-	for (int kk = 2; kk <= nDivs - 1; kk++) {
-		w = 1 - double(kk) / nDivs;
-    for (int jj = 1; jj <= kk - 1; jj++) {
-			v = double(jj) / nDivs;
-      for (int ii = 1; ii <= kk - 1; ii++) {
-				u = double(ii) / nDivs;
-				double coords[3];
-				m_Map->computeTransformedCoords(uvw, coords);
-				emInt vNew = m_pMesh->addVert(coords);
-				localVerts[ii][jj][kk] = vNew;
-      }
-    }
-  } // Done looping to create all verts inside the tet.
+template<int NDIVS, typename MapT>
+void PyrDivider<NDIVS, MapT>::divideInterior() {
+	if constexpr (NDIVS > 0) {
+		this->addInteriorVerts(FixedPyrTables<NDIVS>::intPoints);
+	}
+	else {
+		this->addInteriorVerts(m_intPoints);
+	}
 }
 
-void PyrDivider::createNewCells() {
-  // Output info about the points for this pyramid, layer by layer
-
-//	for (int level = 0; level <= nDivs; level++) {
-//		fprintf(stderr, "Level = %d\n", level);
-//    for (int jj = 0; jj <= level; jj++) {
-//      for (int ii = 0; ii <= level; ii++) {
-//				emInt vert = localVerts[ii][jj][level];
-//				fprintf(stderr, "  i = %2d, j = %2d:  (%10.6f, %10.6f, %10.6f)\n", ii,
-//								jj, m_pMesh->getCoords(vert)[0], m_pMesh->getCoords(vert)[1],
-//								m_pMesh->getCoords(vert)[2]);
-//      }
-//    }
-//  }
-
-	for (int level = 1; level <= nDivs; level++) {
-//		fprintf(stderr, "Level: %d\n", level);
-    // Create up-pointing pyrs.  For a given level, there are
-    // level^2 of these.
-    for (int jj = 0; jj < level; jj++) {
-      for (int ii = 0; ii < level; ii++) {
-				emInt vertsNew[] = { localVerts[ii][jj][level],
-															localVerts[ii + 1][jj][level],
-															localVerts[ii + 1][jj + 1][level],
-															localVerts[ii][jj + 1][level],
-															localVerts[ii][jj][level - 1] };
-				m_pMesh->addPyramid(vertsNew);
-				assert(m_pMesh->numPyramids() < m_pMesh->maxNPyrs());
-      }
-    }
-
-    // Down-pointing pyramids, hanging from quads on the previous level.  There
-    // are (level-1)^2 of these.
-    for (int jj = 0; jj <= level - 2; jj++) {
-      for (int ii = 0; ii <= level - 2; ii++) {
-				emInt vertsNew[] = { localVerts[ii][jj][level - 1], localVerts[ii][jj
-						+ 1][level - 1],
-															localVerts[ii + 1][jj + 1][level - 1],
-															localVerts[ii + 1][jj][level - 1], localVerts[ii
-																	+ 1][jj + 1][level] };
-				m_pMesh->addPyramid(vertsNew);
-				assert(m_pMesh->numPyramids() <= m_pMesh->maxNPyrs());
-      }
-    }
-
-    // Now there are tets in the gaps between these pyramids.  There are
-    // 2 (level-1) (level-2) of these.
-
-    // The set on lines of constant j on level l.
-    for (int jj = 1; jj <= level - 1; jj++) {
-      for (int ii = 0; ii <= level - 1; ii++) {
-				emInt vertsNew[] = { localVerts[ii][jj][level],
-															localVerts[ii + 1][jj][level],
-															localVerts[ii][jj][level - 1], localVerts[ii][jj
-																	- 1][level - 1] };
-				m_pMesh->addTet(vertsNew);
-				assert(m_pMesh->numTets() < m_pMesh->maxNTets());
-				assert(checkOrient3D(vertsNew) == 1);
-      }
-    }
-
-    // The set on lines of constant i on level l.
-    for (int jj = 0; jj <= level - 1; jj++) {
-      for (int ii = 1; ii <= level - 1; ii++) {
-				emInt vertsNew[] = { localVerts[ii][jj][level],
-															localVerts[ii][jj + 1][level],
-															localVerts[ii - 1][jj][level - 1],
-															localVerts[ii][jj][level - 1] };
+template<int NDIVS, typename MapT>
+void PyrDivider<NDIVS, MapT>::createNewCells() {
+	if constexpr (NDIVS > 0) {
+		createNewCells(FixedPyrTables<NDIVS>::pyrStencil,
+										FixedPyrTables<NDIVS>::tetStencil);
+	}
+	else {
+		createNewCells(m_pyrStencil, m_tetStencil);
+	}
+}
+
+template<int NDIVS, typename MapT>
+template<typename PyrStencil, typename TetStencil>
+void PyrDivider<NDIVS, MapT>::createNewCells(const PyrStencil& pyrStencil,
+		const TetStencil& tetStencil) {
+	this->appendFromStencil(pyrStencil, &RefineSink::addPyramids);
 #ifndef NDEBUG
-				emInt tet =
+	this->checkStencilTets(tetStencil);
 #endif
-				m_pMesh->addTet(vertsNew);
-				assert(m_pMesh->numTets() <= m_pMesh->maxNTets());
-				assert(checkOrient3D(vertsNew) == 1);
-      }
-    }
-
-  } // Done with this level
+	this->appendFromStencil(tetStencil, &RefineSink::addTets);
 }
+
+template class PyrDivider<0>;
+template class PyrDivider<2>;
+template class PyrDivider<3>;
+template class PyrDivider<4>;
+template class PyrDivider<8>;
+template class PyrDivider<0, LagrangeCubicPyramidMapping>;
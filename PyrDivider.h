@@ -29,119 +29,43 @@
 #include "CellDivider.h"
 #include "ExaMesh.h"
 
-class PyrDivider: public CellDivider {
+// NDIVS is either the number of divisions per edge, known at compile time,
+// or 0 for a divider whose tables are built at run time.  MapT places new
+// verts in physical space.
+template<int NDIVS, typename MapT = UniformPyramidMapping>
+class PyrDivider: public CellDivider<PyrDivider<NDIVS, MapT>, PyrTraits, MapT,
+		NDIVS> {
+	typedef CellDivider<PyrDivider<NDIVS, MapT>, PyrTraits, MapT, NDIVS> Base;
+	using Base::nDivs;
+	using Base::m_pMesh;
+	using Base::localVerts;
+	using Base::addInteriorVerts;
+	using Base::appendFromStencil;
+	using Base::checkOrient3D;
+	using Base::chunkCells;
 	double xyzOffset[3], uVec[3], vVec[3], uvVec[3], xyzApex[3];
 public:
-	PyrDivider(UMesh *pInitMesh, const int segmentsPerEdge,
-			const Mapping::MappingType type = Mapping::Uniform)
-      :
-			CellDivider(pInitMesh, segmentsPerEdge) {
-    vertIJK[0][0] = 0;
-    vertIJK[0][1] = 0;
-    vertIJK[0][2] = nDivs;
-
-    vertIJK[1][0] = nDivs;
-    vertIJK[1][1] = 0;
-    vertIJK[1][2] = nDivs;
-
-    vertIJK[2][0] = nDivs;
-    vertIJK[2][1] = nDivs;
-    vertIJK[2][2] = nDivs;
-
-    vertIJK[3][0] = 0;
-    vertIJK[3][1] = nDivs;
-    vertIJK[3][2] = nDivs;
-
-    vertIJK[4][0] = 0;
-    vertIJK[4][1] = 0;
-    vertIJK[4][2] = 0;
-
-		uvwIJK[0][0] = 0;
-		uvwIJK[0][1] = 0;
-		uvwIJK[0][2] = 0;
-
-		uvwIJK[1][0] = 1;
-		uvwIJK[1][1] = 0;
-		uvwIJK[1][2] = 0;
-
-		uvwIJK[2][0] = 1;
-		uvwIJK[2][1] = 1;
-		uvwIJK[2][2] = 0;
-
-		uvwIJK[3][0] = 0;
-		uvwIJK[3][1] = 1;
-		uvwIJK[3][2] = 0;
-
-		uvwIJK[4][0] = 0;
-		uvwIJK[4][1] = 0;
-		uvwIJK[4][2] = 1;
-
-		numVerts = 5;
-		numEdges = 8;
-		numTriFaces = 4;
-		numQuadFaces = 1;
-		edgeVertIndices[0][0] = 0;
-		edgeVertIndices[0][1] = 1;
-
-		edgeVertIndices[1][0] = 0;
-		edgeVertIndices[1][1] = 3;
-
-		edgeVertIndices[2][0] = 0;
-		edgeVertIndices[2][1] = 4;
-
-		edgeVertIndices[3][0] = 1;
-		edgeVertIndices[3][1] = 2;
-
-		edgeVertIndices[4][0] = 1;
-		edgeVertIndices[4][1] = 4;
-
-		edgeVertIndices[5][0] = 2;
-		edgeVertIndices[5][1] = 3;
-
-		edgeVertIndices[6][0] = 2;
-		edgeVertIndices[6][1] = 4;
-
-		edgeVertIndices[7][0] = 3;
-		edgeVertIndices[7][1] = 4;
-
-		faceVertIndices[0][0] = 0;
-		faceVertIndices[0][1] = 1;
-		faceVertIndices[0][2] = 2;
-		faceVertIndices[0][3] = 3;
-
-		faceVertIndices[1][0] = 0;
-		faceVertIndices[1][1] = 4;
-		faceVertIndices[1][2] = 1;
-
-		faceVertIndices[2][0] = 1;
-		faceVertIndices[2][1] = 4;
-		faceVertIndices[2][2] = 2;
-
-		faceVertIndices[3][0] = 2;
-		faceVertIndices[3][1] = 4;
-		faceVertIndices[3][2] = 3;
-
-		faceVertIndices[4][0] = 3;
-		faceVertIndices[4][1] = 4;
-		faceVertIndices[4][2] = 0;
-
-		if (type == Mapping::LengthScale) {
-			// TODO: Must fix this
-			m_Map = new UniformPyramidMapping(pInitMesh);
+	PyrDivider(RefineSink *pSink, const ExaMesh* const pInitMesh,
+			const int segmentsPerEdge) :
+			Base(pSink, pInitMesh, segmentsPerEdge) {
+		if (NDIVS == 0) {
+			setupTables();
 		}
-		else if (type == Mapping::Lagrange) {
-			m_Map = new LagrangeCubicPyramidMapping(pInitMesh);
-		}
-		else {
-			m_Map = new UniformPyramidMapping(pInitMesh);
-		}
-  }
+	}
 	~PyrDivider() {
 	}
 	void divideInterior();
-  void createNewCells();
-	void setupCoordMapping(const emInt verts[]);
-	void getPhysCoordsFromParamCoords(const double uvw[], double xyz[]);
+	void createNewCells();
+private:
+	// Lattice indices for the new pyramids (5 per pyramid) and for the tets
+	// filling the gaps between them (4 per tet).  These, and the interior
+	// points, are only filled in when NDIVS is 0.
+	std::vector<int> m_pyrStencil, m_tetStencil;
+	std::vector<InteriorPoint> m_intPoints;
+	void setupTables();
+	template<typename PyrStencil, typename TetStencil>
+	void createNewCells(const PyrStencil& pyrStencil,
+			const TetStencil& tetStencil);
 };
 
 #endif /* APPS_EXAMESH_PYRDIVIDER_H_ */
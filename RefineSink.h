@@ -0,0 +1,163 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*
+ * RefineSink.h
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#ifndef SRC_REFINESINK_H_
+#define SRC_REFINESINK_H_
+
+#include <assert.h>
+
+#include <array>
+#include <unordered_map>
+
+#include "exa-defs.h"
+
+// Where the cell dividers put the fine mesh, as they make it.  Verts are
+// added one at a time and numbered from 0 in order; cells come in batches,
+// each in the order the dividers make them.  The dividers look up the
+// coords of verts they've already added (to decide how to split octahedra,
+// for instance), so every sink has to keep those, at least until the
+// dividers release them.  UMesh is a sink that keeps everything;
+// StreamingSink keeps only the verts that might still be looked up.
+class RefineSink {
+public:
+	virtual ~RefineSink() {
+	}
+	virtual emInt addVert(const double newCoords[3]) = 0;
+	virtual void getCoords(const emInt vert, double coords[3]) const = 0;
+
+	// Each returns the index of the first new entity.
+	virtual emInt addBdryTris(const emInt verts[][3], const emInt nNew) = 0;
+	virtual emInt addBdryQuads(const emInt verts[][4], const emInt nNew) = 0;
+	virtual emInt addTets(const emInt verts[][4], const emInt nNew) = 0;
+	virtual emInt addPyramids(const emInt verts[][5], const emInt nNew) = 0;
+	virtual emInt addPrisms(const emInt verts[][6], const emInt nNew) = 0;
+	virtual emInt addHexes(const emInt verts[][8], const emInt nNew) = 0;
+
+	// The dividers call this, once the cell that used them last is done,
+	// with verts no later cell or face will look up.  Coarse verts and fine
+	// verts on bdry edges are never released.
+	virtual void releaseVerts(const emInt /*verts*/[], const emInt /*count*/) {
+	}
+
+	virtual emInt numCells() const = 0;
+};
+
+// A sink that hands each vert and each batch of faces or cells on as soon
+// as it's made, so that the fine mesh never has to be held all at once.
+// Only the coords of verts that haven't been released are kept.  Derived
+// classes consume the verts and batches, to write them or to build solver
+// data from them, for instance.
+class StreamingSink: public RefineSink {
+	std::unordered_map<emInt, std::array<double, 3> > m_liveCoords;
+	size_t m_maxLiveVerts;
+	emInt m_counts[7];
+	StreamingSink(const StreamingSink&);
+	StreamingSink& operator=(const StreamingSink&);
+
+	template<int nPts>
+	emInt addCells(const int type, const emInt verts[][nPts], const emInt nNew) {
+		const emInt first = m_counts[type];
+		if (nNew > 0) cells(type, first, verts[0], nNew);
+		m_counts[type] += nNew;
+		return first;
+	}
+protected:
+	virtual void newVert(const emInt index, const double coords[3]) = 0;
+	// type is the entry in the UGRID header (1 for bdry tris, 2 for bdry
+	// quads, 3 for tets and so on up to 6 for hexes); first is the index,
+	// among all those of its type, of the first of the count faces or cells
+	// whose verts are in conn.
+	virtual void cells(const int type, const emInt first, const emInt conn[],
+			const emInt count) = 0;
+public:
+	StreamingSink() :
+			m_maxLiveVerts(0) {
+		for (int ii = 0; ii < 7; ii++) {
+			m_counts[ii] = 0;
+		}
+	}
+
+	emInt addVert(const double newCoords[3]) {
+		const emInt index = m_counts[0]++;
+		m_liveCoords.emplace(index, std::array<double, 3> { { newCoords[0],
+																													newCoords[1],
+																													newCoords[2] } });
+		m_maxLiveVerts = std::max(m_maxLiveVerts, m_liveCoords.size());
+		newVert(index, newCoords);
+		return index;
+	}
+	void getCoords(const emInt vert, double coords[3]) const {
+		auto iter = m_liveCoords.find(vert);
+		assert(iter != m_liveCoords.end());
+		coords[0] = iter->second[0];
+		coords[1] = iter->second[1];
+		coords[2] = iter->second[2];
+	}
+	void releaseVerts(const emInt verts[], const emInt count) {
+		for (emInt ii = 0; ii < count; ii++) {
+			m_liveCoords.erase(verts[ii]);
+		}
+	}
+
+	emInt addBdryTris(const emInt verts[][3], const emInt nNew) {
+		return addCells(1, verts, nNew);
+	}
+	emInt addBdryQuads(const emInt verts[][4], const emInt nNew) {
+		return addCells(2, verts, nNew);
+	}
+	emInt addTets(const emInt verts[][4], const emInt nNew) {
+		return addCells(3, verts, nNew);
+	}
+	emInt addPyramids(const emInt verts[][5], const emInt nNew) {
+		return addCells(4, verts, nNew);
+	}
+	emInt addPrisms(const emInt verts[][6], const emInt nNew) {
+		return addCells(5, verts, nNew);
+	}
+	emInt addHexes(const emInt verts[][8], const emInt nNew) {
+		return addCells(6, verts, nNew);
+	}
+
+	emInt numVerts() const {
+		return m_counts[0];
+	}
+	// The number of faces or cells of a type (as for cells) so far.
+	emInt numOfType(const int type) const {
+		assert(type >= 1 && type < 7);
+		return m_counts[type];
+	}
+	emInt numCells() const {
+		return m_counts[3] + m_counts[4] + m_counts[5] + m_counts[6];
+	}
+	// The number of verts whose coords are still kept, now and at most.
+	size_t numLiveVerts() const {
+		return m_liveCoords.size();
+	}
+	size_t maxLiveVerts() const {
+		return m_maxLiveVerts;
+	}
+};
+
+#endif /* SRC_REFINESINK_H_ */
@@ -0,0 +1,170 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * Snapshot.cxx
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <type_traits>
+
+#include "Snapshot.h"
+#include "UGridIO.h"
+
+static const char snapshotMagic[8] = "ExaSnap";
+static const uint32_t snapshotVersion = 1;
+static const uint32_t byteOrderTag = 0x01020304;
+static const size_t blockAlign = 4096;
+
+// Parts and cell data are saved as raw bytes.
+static_assert(std::is_trivially_copyable<Part>::value,
+		"Part must be trivially copyable to be saved in a snapshot");
+static_assert(std::is_trivially_copyable<CellPartData>::value,
+		"CellPartData must be trivially copyable to be saved in a snapshot");
+
+bool writeSnapshotFile(const char fileName[], SnapshotHeader& header,
+		const SnapshotBlock blocks[], const int nBlocks) {
+	assert(nBlocks <= eSnapMaxBlocks);
+	memcpy(header.magic, snapshotMagic, sizeof(header.magic));
+	header.version = snapshotVersion;
+	header.byteOrder = byteOrderTag;
+	header.intBytes = sizeof(emInt);
+	header.nBlocks = nBlocks;
+	size_t offset = sizeof(SnapshotHeader);
+	for (int iB = 0; iB < nBlocks; iB++) {
+		assert(blocks[iB].skew < blockAlign);
+		offset = (offset + blockAlign - 1) / blockAlign * blockAlign;
+		header.blockOffsets[iB] = offset + blocks[iB].skew;
+		header.blockBytes[iB] = blocks[iB].bytes;
+		offset = header.blockOffsets[iB] + blocks[iB].bytes;
+	}
+	for (int iB = nBlocks; iB < eSnapMaxBlocks; iB++) {
+		header.blockOffsets[iB] = header.blockBytes[iB] = 0;
+	}
+
+	int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n",
+						fileName);
+		return false;
+	}
+	bool ok = pwriteAll(fd, reinterpret_cast<const char*>(&header),
+											sizeof(header), 0);
+	for (int iB = 0; ok && iB < nBlocks; iB++) {
+		ok = pwriteAll(fd, reinterpret_cast<const char*>(blocks[iB].data),
+										blocks[iB].bytes, header.blockOffsets[iB]);
+	}
+	// Make sure the file covers the last block, even if it's empty.
+	ok = ok && ftruncate(fd, offset) == 0;
+	if (close(fd) != 0) ok = false;
+	if (!ok) {
+		fprintf(stderr, "Couldn't write snapshot file %s.\n", fileName);
+	}
+	return ok;
+}
+
+Snapshot::Snapshot(const char fileName[]) :
+		m_fileName(fileName), m_header(), m_fd(-1) {
+	m_fd = open(fileName, O_RDONLY);
+	struct stat fileStat;
+	if (m_fd < 0 || fstat(m_fd, &fileStat) != 0) {
+		fprintf(stderr, "Couldn't open file %s for reading.  Bummer!\n",
+						fileName);
+		exit(1);
+	}
+	if (pread(m_fd, &m_header, sizeof(m_header), 0) != sizeof(m_header)
+			|| memcmp(m_header.magic, snapshotMagic, sizeof(snapshotMagic)) != 0) {
+		fprintf(stderr, "%s isn't a snapshot file.\n", fileName);
+		exit(1);
+	}
+	if (m_header.version != snapshotVersion || m_header.byteOrder != byteOrderTag
+			|| m_header.intBytes != sizeof(emInt)) {
+		fprintf(stderr,
+						"Snapshot %s is version %u with %u-byte ints; this build "
+						"reads version %u with %zu-byte ints, in its own byte "
+						"order.\n",
+						fileName, m_header.version, m_header.intBytes,
+						snapshotVersion, sizeof(emInt));
+		exit(1);
+	}
+	bool ok = m_header.nBlocks >= eSnapMeshBlocks
+			&& m_header.nBlocks <= eSnapMaxBlocks;
+	for (uint64_t iB = 0; ok && iB < m_header.nBlocks; iB++) {
+		ok = m_header.blockOffsets[iB] + m_header.blockBytes[iB]
+				<= uint64_t(fileStat.st_size);
+	}
+	if (!ok) {
+		fprintf(stderr, "Snapshot %s is truncated or corrupt.\n", fileName);
+		exit(1);
+	}
+}
+
+Snapshot::~Snapshot() {
+	close(m_fd);
+}
+
+bool Snapshot::readBlock(const int iBlock, void* dst) const {
+	char* data = reinterpret_cast<char*>(dst);
+	size_t bytes = blockBytes(iBlock);
+	off_t offset = m_header.blockOffsets[iBlock];
+	while (bytes > 0) {
+		ssize_t bytesRead = pread(m_fd, data, bytes, offset);
+		if (bytesRead <= 0) return false;
+		data += bytesRead;
+		bytes -= bytesRead;
+		offset += bytesRead;
+	}
+	return true;
+}
+
+char* Snapshot::mapBlock(const int iBlock, size_t& mappedBytes,
+		size_t& skew) const {
+	const size_t pageSize = sysconf(_SC_PAGESIZE);
+	const size_t offset = m_header.blockOffsets[iBlock];
+	skew = offset % pageSize;
+	mappedBytes = skew + blockBytes(iBlock);
+	void* mapped = mmap(nullptr, mappedBytes, PROT_READ | PROT_WRITE,
+											MAP_PRIVATE, m_fd, offset - skew);
+	if (mapped == MAP_FAILED) return nullptr;
+	return reinterpret_cast<char*>(mapped);
+}
+
+bool Snapshot::getPartition(std::vector<Part>& parts,
+		std::vector<CellPartData>& vecCPD) const {
+	const size_t nCPD = blockBytes(eSnapCellPartData) / sizeof(CellPartData);
+	if (numParts() == 0
+			|| blockBytes(eSnapParts) != numParts() * sizeof(Part)
+			|| blockBytes(eSnapCellPartData) != nCPD * sizeof(CellPartData)) {
+		return false;
+	}
+	// CellPartData has no default constructor, so placeholders are made and
+	// then overwritten.
+	parts.assign(numParts(), Part());
+	vecCPD.assign(nCPD, CellPartData(0, 0, 0, 0, 0));
+	return readBlock(eSnapParts, parts.data())
+			&& readBlock(eSnapCellPartData, vecCPD.data());
+}
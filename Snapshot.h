@@ -0,0 +1,120 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * Snapshot.h
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#ifndef SRC_SNAPSHOT_H_
+#define SRC_SNAPSHOT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "exa-defs.h"
+#include "Part.h"
+
+// A snapshot is a coarse mesh saved exactly as it sits in memory, so that it
+// can be brought back without parsing, detecting bdry faces or computing
+// length scales.  It's only meant to be read back on the same kind of
+// machine, by the same build.
+//
+// After a fixed header, the file is a series of blocks, each starting on a
+// page boundary (plus a small per-block skew, so that data that's aligned
+// in memory is aligned in the mapped file, too).  The first three blocks
+// are the same for all meshes: length scales and, optionally, the
+// partition from partitionCells.  Each mesh type decides what the rest
+// are, and what the counts in the header mean.
+enum {
+	eSnapshotUMesh = 1, eSnapshotCubicMesh = 2
+};
+enum {
+	eSnapLenScale = 0, eSnapParts, eSnapCellPartData, eSnapMeshBlocks,
+	eSnapMaxBlocks = 16
+};
+
+struct SnapshotHeader {
+	char magic[8];
+	uint32_t version;
+	// Written as 0x01020304 in native byte order.
+	uint32_t byteOrder;
+	uint32_t intBytes;
+	uint32_t meshType;
+	uint64_t counts[16];
+	uint64_t nParts;
+	uint64_t nBlocks;
+	uint64_t blockOffsets[eSnapMaxBlocks];
+	uint64_t blockBytes[eSnapMaxBlocks];
+};
+
+struct SnapshotBlock {
+	const void* data;
+	size_t bytes;
+	// Where in its page the block starts.
+	size_t skew;
+};
+
+// Write blocks [0, nBlocks) after the header, filling in everything but
+// meshType, counts and nParts.
+bool writeSnapshotFile(const char fileName[], SnapshotHeader& header,
+		const SnapshotBlock blocks[], const int nBlocks);
+
+// An open snapshot file.  The constructor exits if the file isn't a
+// snapshot this build can read.
+class Snapshot {
+	std::string m_fileName;
+	SnapshotHeader m_header;
+	int m_fd;
+	Snapshot(const Snapshot&);
+	Snapshot& operator=(const Snapshot&);
+public:
+	explicit Snapshot(const char fileName[]);
+	~Snapshot();
+	const char* fileName() const {
+		return m_fileName.c_str();
+	}
+	uint32_t meshType() const {
+		return m_header.meshType;
+	}
+	uint64_t count(const int which) const {
+		return m_header.counts[which];
+	}
+	size_t blockBytes(const int iBlock) const {
+		return iBlock < int(m_header.nBlocks) ? m_header.blockBytes[iBlock] : 0;
+	}
+	// Copy a block into dst, which must hold blockBytes(iBlock) bytes.
+	bool readBlock(const int iBlock, void* dst) const;
+	// Map a block privately (so it can be changed without changing the
+	// file), starting at the page boundary just before it; the block itself
+	// starts skew bytes in.  Returns nullptr on failure.
+	char* mapBlock(const int iBlock, size_t& mappedBytes, size_t& skew) const;
+
+	// Zero if the snapshot holds no partition.
+	emInt numParts() const {
+		return emInt(m_header.nParts);
+	}
+	bool getPartition(std::vector<Part>& parts,
+			std::vector<CellPartData>& vecCPD) const;
+};
+
+#endif /* SRC_SNAPSHOT_H_ */
@@ -26,184 +26,203 @@
 #include "GeomUtils.h"
 #include "TetDivider.h"
 
-void TetDivider::setupCoordMapping(const emInt verts[]) {
-	for (int ii = 0; ii < 4; ii++) {
-		cellVerts[ii] = verts[ii];
-	}
-	m_Map->setupCoordMapping(verts);
-}
+namespace {
+	// Verts inside the tet, ordered layer by layer.
+	struct TetInteriorPoints {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			// Number of verts added:
+			//    Tets:      (nD-1)(nD-2)(nD-3)/6
+			for (int kk = 0; kk <= nDivs - 4; kk++) {
+				const double w = double(kk + 1) / nDivs;
+				for (int jj = 0; jj <= nDivs - 4 - kk; jj++) {
+					const double v = double(jj + 1) / nDivs;
+					for (int ii = 0; ii <= nDivs - 4 - kk - jj; ii++) {
+						const double u = double(ii + 1) / nDivs;
+						out.push_back(InteriorPoint { { u, v, w }, packedLatticeIndex(
+								TetTraits::latticeShape, nDivs, ii + 1, jj + 1, nDivs - (kk + 1)) });
+					}
+				}
+			} // Done looping to create all verts inside the tet.
+		}
+	};
 
-void TetDivider::getPhysCoordsFromParamCoords(const double uvw[3],
-		double xyz[3]) {
-	m_Map->computeTransformedCoords(uvw, xyz);
-}
+	struct TetTetStencil {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			auto L = [nDivs](const int ii, const int jj, const int kk) {
+				return packedLatticeIndex(TetTraits::latticeShape, nDivs, ii, jj, kk);
+			};
+			for (int level = 1; level <= nDivs; level++) {
+				// Create up-pointing tets.  For a given level, there are
+				// (level+1)(level)/2 of these.
+				for (int jj = 0; jj < level; jj++) {
+					for (int ii = 0; ii < level - jj; ii++) {
+						const int verts[] = { L(ii, jj, level), L(ii + 1, jj, level), L(ii,
+																																						 jj + 1,
+																																						 level),
+																	L(ii, jj, level - 1) };
+						pushCell(out, verts);
+					}
+				}
 
-void TetDivider::divideInterior() {
-	// Number of verts added:
-	//    Tets:      (nD-1)(nD-2)(nD-3)/6
-	double uvw[3];
-	double& u = uvw[0];
-	double& v = uvw[1];
-	double& w = uvw[2];
-	for (int kk = 0; kk <= nDivs - 4; kk++) {
-		w = double(kk + 1) / nDivs;
-		for (int jj = 0; jj <= nDivs - 4 - kk; jj++) {
-			v = double(jj + 1) / nDivs;
-			for (int ii = 0; ii <= nDivs - 4 - kk - jj; ii++) {
-				u = double(ii + 1) / nDivs;
-				assert(ii + jj + kk <= nDivs - 4);
-				double coords[3];
-				m_Map->computeTransformedCoords(uvw, coords);
-				emInt vNew = m_pMesh->addVert(coords);
-				localVerts[ii + 1][jj + 1][nDivs - (kk + 1)] = vNew;
+				// Each down-point triangle on the previous level has a tet
+				// that extends down to a point on this level. There are
+				// (levels-1)*(levels-2)/2 of thes.
+				for (int jj = 0; jj <= level - 3; jj++) {
+					for (int ii = 1; ii <= level - jj - 2; ii++) {
+						const int verts[] = { L(ii, jj, level - 1), L(ii - 1, jj + 1,
+																													level - 1),
+																	L(ii, jj + 1, level - 1), L(ii, jj + 1, level) };
+						pushCell(out, verts);
+					}
+				}
+			}
+		}
+	};
+
+	// The rest of the tris (down-pointing) in each level have an octahedron
+	// on them, connecting them to an (up-pointing) tri the level above.
+	// There are (level)(level-1)/2 octahedra, each of which will be split
+	// into four tetrahedra; that split depends on geometry, so the stencil
+	// gives only the corners A-F.
+	struct TetOctStencil {
+		template<typename Table>
+		constexpr void operator()(const int nDivs, Table& out) const {
+			auto L = [nDivs](const int ii, const int jj, const int kk) {
+				return packedLatticeIndex(TetTraits::latticeShape, nDivs, ii, jj, kk);
+			};
+			for (int level = 1; level <= nDivs; level++) {
+				for (int jj = 0; jj <= level - 2; jj++) {
+					for (int ii = 1; ii <= level - jj - 1; ii++) {
+						const int verts[] = { L(ii, jj, level), // A
+								L(ii, jj + 1, level), // B
+								L(ii - 1, jj + 1, level), // C
+								L(ii - 1, jj, level - 1), // D
+								L(ii, jj, level - 1), // E
+								L(ii - 1, jj + 1, level - 1) }; // F
+						pushCell(out, verts);
+					}
+				}
 			}
 		}
-	} // Done looping to create all verts inside the tet.
+	};
+
+	template<int NDIVS>
+	struct FixedTetTables {
+		static constexpr auto intPoints = makeFixedTable<InteriorPoint,
+				TetInteriorPoints, NDIVS>();
+		static constexpr auto tetStencil =
+				makeFixedTable<int, TetTetStencil, NDIVS>();
+		static constexpr auto octStencil =
+				makeFixedTable<int, TetOctStencil, NDIVS>();
+	};
 }
 
-void TetDivider::stuffTetsIntoOctahedron(emInt vertsNew[][4]) {
-	m_pMesh->addTet(vertsNew[0]);
-	m_pMesh->addTet(vertsNew[1]);
-	m_pMesh->addTet(vertsNew[2]);
-	m_pMesh->addTet(vertsNew[3]);
-	assert(m_pMesh->numTets() <= m_pMesh->maxNTets());
-#ifndef NDEBUG
-	assert(checkOrient3D(vertsNew[0]) != -1);
-	assert(checkOrient3D(vertsNew[1]) != -1);
-	assert(checkOrient3D(vertsNew[2]) != -1);
-	assert(checkOrient3D(vertsNew[3]) != -1);
-#endif
+template<int NDIVS, typename MapT>
+void TetDivider<NDIVS, MapT>::setupTables() {
+	m_intPoints = makeTable<InteriorPoint, TetInteriorPoints>(nDivs);
+	m_tetStencil = makeTable<int, TetTetStencil>(nDivs);
+	m_octStencil = makeTable<int, TetOctStencil>(nDivs);
 }
 
-void TetDivider::createNewCells() {
-//		// Output info about the points for this tet, layer by layer
-//
-//	for (int level = 0; level <= nDivs; level++) {
-//		fprintf(stderr, "Level = %d\n", level);
-//		for (int jj = 0; jj <= level; jj++) {
-//			for (int ii = 0; ii <= level - jj; ii++) {
-//				fprintf(stderr, "  i = %2d, j = %2d, v = %4u:  ", ii, jj,
-//								localVerts[ii][jj][level]);
-//				const double* coords = m_pMesh->getCoords(localVerts[ii][jj][level]);
-//				fprintf(stderr, "(%10.6f, %10.6f, %10.6f)\n", coords[0], coords[1],
-//								coords[2]);
-//			}
-//		}
-//	}
-
-	for (int level = 1; level <= nDivs; level++) {
-//		fprintf(stderr, "Level: %d\n", level);
-		// Create up-pointing tets.  For a given level, there are
-		// (level+1)(level)/2 of these.
-		for (int jj = 0; jj < level; jj++) {
-			for (int ii = 0; ii < level - jj; ii++) {
-				//					logMessage(
-				//							MSG_DEBUG,
-				//							"Tet: (%d, %d, %d), (%d, %d,
-				//%d), (%d, %d, %d), (%d, %d, %d)\n", 							ii, jj, level, ii + 1, jj, level,
-				//ii, jj + 1, level, ii, jj, 							level - 1);
-				emInt vert0 = localVerts[ii][jj][level];
-				emInt vert1 = localVerts[ii + 1][jj][level];
-				emInt vert2 = localVerts[ii][jj + 1][level];
-				emInt vert3 = localVerts[ii][jj][level - 1];
-				emInt verts[] = { vert0, vert1, vert2, vert3 };
+template<int NDIVS, typename MapT>
+void TetDivider<NDIVS, MapT>::divideInterior() {
+	if constexpr (NDIVS > 0) {
+		this->addInteriorVerts(FixedTetTables<NDIVS>::intPoints);
+	}
+	else {
+		this->addInteriorVerts(m_intPoints);
+	}
+}
 
-#ifndef NDEBUG
-				emInt tet =
-#endif
-				m_pMesh->addTet(verts);
-				assert(m_pMesh->numTets() <= m_pMesh->maxNTets());
-				assert(checkOrient3D(verts) == 1);
-			}
-		}
+template<int NDIVS, typename MapT>
+void TetDivider<NDIVS, MapT>::createNewCells() {
+	if constexpr (NDIVS > 0) {
+		createNewCells(FixedTetTables<NDIVS>::tetStencil,
+										FixedTetTables<NDIVS>::octStencil);
+	}
+	else {
+		createNewCells(m_tetStencil, m_octStencil);
+	}
+}
 
-		// Each down-point triangle on the previous level has a tet
-		// that extends down to a point on this level. There are
-		// (levels-1)*(levels-2)/2 of thes.
-		for (int jj = 0; jj <= level - 3; jj++) {
-			for (int ii = 1; ii <= level - jj - 2; ii++) {
-				emInt vert0 = localVerts[ii][jj][level - 1];
-				emInt vert1 = localVerts[ii - 1][jj + 1][level - 1];
-				emInt vert2 = localVerts[ii][jj + 1][level - 1];
-				emInt vert3 = localVerts[ii][jj + 1][level];
-				emInt verts[] = { vert0, vert1, vert2, vert3 };
-				//					logMessage(
-				//							MSG_DEBUG,
-				//							"Tet: (%d, %d, %d), (%d, %d,
-				//%d), (%d, %d, %d), (%d, %d, %d)\n", 							ii, jj, level - 1, ii - 1, jj + 1,
-				//level - 1, ii, jj + 1, 							level - 1, ii, jj + 1, level);
+template<int NDIVS, typename MapT>
+template<typename TetStencil, typename OctStencil>
+void TetDivider<NDIVS, MapT>::createNewCells(const TetStencil& tetStencil,
+		const OctStencil& octStencil) {
 #ifndef NDEBUG
-				emInt tet =
+	this->checkStencilTets(tetStencil);
 #endif
-				m_pMesh->addTet(verts);
-				assert(m_pMesh->numTets() <= m_pMesh->maxNTets());
-				assert(checkOrient3D(verts) == 1);
-			}
+	this->appendFromStencil(tetStencil, &RefineSink::addTets);
+
+	// Each octahedron is split into four tets around its shortest diagonal.
+	// Corners are indexed A = 0 through F = 5, in stencil order.
+	static const int octTets[3][4][4] = {
+	// Diagonal AF
+			{ { 1, 2, 0, 5 }, { 2, 3, 0, 5 }, { 3, 4, 0, 5 }, { 4, 1, 0, 5 } },
+			// Diagonal BD
+			{ { 2, 0, 1, 3 }, { 0, 4, 1, 3 }, { 4, 5, 1, 3 }, { 5, 2, 1, 3 } },
+			// Diagonal CE
+			{ { 0, 1, 2, 4 }, { 1, 5, 2, 4 }, { 5, 3, 2, 4 }, { 3, 0, 2, 4 } } };
+
+	const emInt* const lattice = localVerts.data();
+	const int nOcts = octStencil.size() / 6;
+	emInt newTets[chunkCells][4];
+	int nNew = 0;
+	for (int oct = 0; oct < nOcts; oct++) {
+		const int* const st = octStencil.data() + 6 * oct;
+		emInt octVerts[6];
+		double coords[6][3];
+		for (int ii = 0; ii < 6; ii++) {
+			octVerts[ii] = lattice[st[ii]];
+			m_pMesh->getCoords(octVerts[ii], coords[ii]);
 		}
 
-		// The rest of the tris (down-pointing) in this level have an octahedron
-		// on them, connecting them to an (up-pointing) tri the level above.
-		// There are (level)(level-1)/2 octahedra, each of which will be split
-		// into four tetrahedra.
-
-		bool useDiagAF = true, useDiagBD = false, useDiagCE = false;
-		for (int jj = 0; jj <= level - 2; jj++) {
-			for (int ii = 1; ii <= level - jj - 1; ii++) {
-				emInt vertA = localVerts[ii][jj][level];
-				emInt vertB = localVerts[ii][jj + 1][level];
-				emInt vertC = localVerts[ii - 1][jj + 1][level];
-				emInt vertD = localVerts[ii - 1][jj][level - 1];
-				emInt vertE = localVerts[ii][jj][level - 1];
-				emInt vertF = localVerts[ii - 1][jj + 1][level - 1];
-
-				double coordsA[3], coordsB[3], coordsC[3], coordsD[3], coordsE[3],
-						coordsF[3];
-				m_pMesh->getCoords(vertA, coordsA);
-				m_pMesh->getCoords(vertB, coordsB);
-				m_pMesh->getCoords(vertC, coordsC);
-				m_pMesh->getCoords(vertD, coordsD);
-				m_pMesh->getCoords(vertE, coordsE);
-				m_pMesh->getCoords(vertF, coordsF);
-
-				useDiagAF = useDiagBD = useDiagCE = false;
-				double distsqAF = dDISTSQ3D(coordsA, coordsF);
-				double distsqBD = dDISTSQ3D(coordsB, coordsD);
-				double distsqCE = dDISTSQ3D(coordsC, coordsE);
-				if (distsqAF <= distsqBD && distsqAF <= distsqCE) {
-					useDiagAF = true;
-				}
-				else if (distsqBD <= distsqCE) {
-					useDiagBD = true;
-				}
-				else {
-					useDiagCE = true;
-				}
+		double distsqAF = dDISTSQ3D(coords[0], coords[5]);
+		double distsqBD = dDISTSQ3D(coords[1], coords[3]);
+		double distsqCE = dDISTSQ3D(coords[2], coords[4]);
+		int diag;
+		if (distsqAF <= distsqBD && distsqAF <= distsqCE) {
+			diag = 0;
+		}
+		else if (distsqBD <= distsqCE) {
+			diag = 1;
+		}
+		else {
+			diag = 2;
+		}
 
-				if (useDiagAF) {
-					assert(!useDiagBD && !useDiagCE);
-					emInt vertsNew[][4] = { { vertB, vertC, vertA, vertF },
-																	{ vertC, vertD, vertA, vertF },
-																	{ vertD, vertE, vertA, vertF },
-																	{ vertE, vertB, vertA, vertF } };
-					stuffTetsIntoOctahedron(vertsNew);
-				}
-				else if (useDiagBD) {
-					assert(!useDiagAF && !useDiagCE);
-					emInt vertsNew[][4] = { { vertC, vertA, vertB, vertD },
-																	{ vertA, vertE, vertB, vertD },
-																	{ vertE, vertF, vertB, vertD },
-																	{ vertF, vertC, vertB, vertD } };
-					stuffTetsIntoOctahedron(vertsNew);
-				}
-				else {
-					assert(!useDiagAF && !useDiagBD);
-					emInt vertsNew[][4] = { { vertA, vertB, vertC, vertE },
-																	{ vertB, vertF, vertC, vertE },
-																	{ vertF, vertD, vertC, vertE },
-																	{ vertD, vertA, vertC, vertE } };
-					stuffTetsIntoOctahedron(vertsNew);
-				}
+		for (int tet = 0; tet < 4; tet++) {
+			for (int ii = 0; ii < 4; ii++) {
+				newTets[nNew][ii] = octVerts[octTets[diag][tet][ii]];
 			}
-		} // Done with octahedra
-	}   // Done with this level
+			nNew++;
+		}
+		if (nNew + 4 > chunkCells) {
+			addOctTets(newTets, nNew);
+			nNew = 0;
+		}
+	} // Done with octahedra
+	if (nNew > 0) {
+		addOctTets(newTets, nNew);
+	}
 }
+
+template<int NDIVS, typename MapT>
+void TetDivider<NDIVS, MapT>::addOctTets(const emInt newTets[][4],
+		const int nNew) {
+#ifndef NDEBUG
+	for (int tet = 0; tet < nNew; tet++) {
+		assert(checkOrient3D(newTets[tet]) != -1);
+	}
+#endif
+	m_pMesh->addTets(newTets, nNew);
+}
+
+template class TetDivider<0>;
+template class TetDivider<2>;
+template class TetDivider<3>;
+template class TetDivider<4>;
+template class TetDivider<8>;
+template class TetDivider<0, LagrangeCubicTetMapping>;
@@ -30,107 +30,43 @@
 #include "ExaMesh.h"
 #include "Mapping.h"
 
-class TetDivider: public CellDivider {
+// NDIVS is either the number of divisions per edge, known at compile time,
+// or 0 for a divider whose tables are built at run time.  MapT places new
+// verts in physical space.
+template<int NDIVS, typename MapT = TetLengthScaleMapping>
+class TetDivider: public CellDivider<TetDivider<NDIVS, MapT>, TetTraits, MapT,
+		NDIVS> {
+	typedef CellDivider<TetDivider<NDIVS, MapT>, TetTraits, MapT, NDIVS> Base;
+	using Base::nDivs;
+	using Base::m_pMesh;
+	using Base::localVerts;
+	using Base::addInteriorVerts;
+	using Base::appendFromStencil;
+	using Base::checkOrient3D;
+	using Base::chunkCells;
 public:
-	TetDivider(UMesh *pVolMesh, const ExaMesh* const pInitMesh,
-			const int segmentsPerEdge,
-			const Mapping::MappingType type =
-					Mapping::Uniform)
-      :
-			CellDivider(pVolMesh, segmentsPerEdge) {
-    vertIJK[0][0] = 0;
-    vertIJK[0][1] = 0;
-    vertIJK[0][2] = nDivs;
-
-    vertIJK[1][0] = nDivs;
-    vertIJK[1][1] = 0;
-    vertIJK[1][2] = nDivs;
-
-    vertIJK[2][0] = 0;
-    vertIJK[2][1] = nDivs;
-    vertIJK[2][2] = nDivs;
-
-    vertIJK[3][0] = 0;
-    vertIJK[3][1] = 0;
-    vertIJK[3][2] = 0;
-
-		uvwIJK[0][0] = 0;
-		uvwIJK[0][1] = 0;
-		uvwIJK[0][2] = 0;
-
-		uvwIJK[1][0] = 1;
-		uvwIJK[1][1] = 0;
-		uvwIJK[1][2] = 0;
-
-		uvwIJK[2][0] = 0;
-		uvwIJK[2][1] = 1;
-		uvwIJK[2][2] = 0;
-
-		uvwIJK[3][0] = 0;
-		uvwIJK[3][1] = 0;
-		uvwIJK[3][2] = 1;
-
-		numVerts = 4;
-		numEdges = 6;
-		numTriFaces = 4;
-		numQuadFaces = 0;
-		edgeVertIndices[0][0] = 0;
-		edgeVertIndices[0][1] = 1;
-
-		edgeVertIndices[1][0] = 0;
-		edgeVertIndices[1][1] = 2;
-
-		edgeVertIndices[2][0] = 0;
-		edgeVertIndices[2][1] = 3;
-
-		edgeVertIndices[3][0] = 1;
-		edgeVertIndices[3][1] = 2;
-
-		edgeVertIndices[4][0] = 1;
-		edgeVertIndices[4][1] = 3;
-
-		edgeVertIndices[5][0] = 2;
-		edgeVertIndices[5][1] = 3;
-
-		faceVertIndices[0][0] = 0;
-		faceVertIndices[0][1] = 1;
-		faceVertIndices[0][2] = 2;
-
-		faceVertIndices[1][0] = 0;
-		faceVertIndices[1][1] = 3;
-		faceVertIndices[1][2] = 1;
-
-		faceVertIndices[2][0] = 1;
-		faceVertIndices[2][1] = 3;
-		faceVertIndices[2][2] = 2;
-
-		faceVertIndices[3][0] = 2;
-		faceVertIndices[3][1] = 3;
-		faceVertIndices[3][2] = 0;
-
-		if (type == Mapping::LengthScale) {
-			m_Map = new TetLengthScaleMapping(pInitMesh);
-		}
-		else if (type == Mapping::Lagrange) {
-			m_Map = new LagrangeCubicTetMapping(pInitMesh);
+	TetDivider(RefineSink *pSink, const ExaMesh* const pInitMesh,
+			const int segmentsPerEdge) :
+			Base(pSink, pInitMesh, segmentsPerEdge) {
+		if (NDIVS == 0) {
+			setupTables();
 		}
-		else {
-			m_Map = new TetLengthScaleMapping(pInitMesh);
-		}
-  }
+	}
 	~TetDivider() {
 	}
 	void divideInterior();
-  void createNewCells();
-	void setupCoordMapping(const emInt verts[]);
-	void getPhysCoordsFromParamCoords(const double uvw[], double xyz[]);
-	void setPolyCoeffs(const double* xyz0, const double* xyz1, const double* xyz2,
-			const double* xyz3, double uderiv0[3], double vderiv0[3],
-			double wderiv0[3], double uderiv1[3], double vderiv1[3],
-			double wderiv1[3], double uderiv2[3], double vderiv2[3],
-			double wderiv2[3], double uderiv3[3], double vderiv3[3],
-			double wderiv3[3]);
-	void stuffTetsIntoOctahedron(emInt vertsNew[][4]);
+	void createNewCells();
+private:
+	// Lattice indices for the up- and down-pointing tets (4 per tet) and for
+	// the corners A-F of each octahedron (6 per octahedron).  These, and the
+	// interior points, are only filled in when NDIVS is 0.
+	std::vector<int> m_tetStencil, m_octStencil;
+	std::vector<InteriorPoint> m_intPoints;
+	void setupTables();
+	template<typename TetStencil, typename OctStencil>
+	void createNewCells(const TetStencil& tetStencil,
+			const OctStencil& octStencil);
+	void addOctTets(const emInt newTets[][4], const int nNew);
 };
 
 #endif /* APPS_EXAMESH_TETDIVIDER_H_ */
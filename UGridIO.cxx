@@ -0,0 +1,640 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * UGridIO.cxx
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "UGridIO.h"
+
+#if (HAVE_LIBZ == 1)
+#include <zlib.h>
+#endif
+
+static const bool hostIsBigEndian =
+		(__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__);
+
+bool UGridFormat::needsByteSwap() const {
+	return isBigEndian != hostIsBigEndian;
+}
+
+bool parseUGridInfix(const char infix[], UGridFormat& format) {
+	UGridFormat result;
+	const char* cp = infix;
+	result.isBigEndian = true;
+	if (*cp == 'l') {
+		result.isBigEndian = false;
+		cp++;
+	}
+	if (*cp == 'b') {
+		result.isFortran = false;
+	}
+	else if (*cp == 'r') {
+		result.isFortran = true;
+	}
+	else {
+		return false;
+	}
+	cp++;
+	if (*cp == '8') {
+		result.isSinglePrec = false;
+	}
+	else if (*cp == '4') {
+		result.isSinglePrec = true;
+	}
+	else {
+		return false;
+	}
+	cp++;
+	if (*cp == 'l') {
+		result.isLongInt = true;
+		cp++;
+	}
+	if (*cp != '\0') return false;
+	format = result;
+	return true;
+}
+
+bool ugridFormatFromFileName(const char fileName[], UGridFormat& format) {
+	const char suffix[] = ".ugrid";
+	size_t len = strlen(fileName);
+	if (isBlockCompressedFileName(fileName)) len -= 2;
+	const size_t suffixLen = strlen(suffix);
+	if (len <= suffixLen
+			|| strncmp(fileName + len - suffixLen, suffix, suffixLen) != 0) {
+		return false;
+	}
+	// The infix runs from the previous dot to the suffix.
+	const char* infixEnd = fileName + len - suffixLen;
+	const char* infixStart = infixEnd;
+	while (infixStart > fileName && *(infixStart - 1) != '.'
+			&& *(infixStart - 1) != '/') {
+		infixStart--;
+	}
+	char infix[8];
+	const size_t infixLen = infixEnd - infixStart;
+	if (infixLen == 0 || infixLen >= sizeof(infix)) return false;
+	memcpy(infix, infixStart, infixLen);
+	infix[infixLen] = '\0';
+	return parseUGridInfix(infix, format);
+}
+
+UGridFormat formatForUGridFile(const char fileName[]) {
+	UGridFormat format;
+	if (!ugridFormatFromFileName(fileName, format)) {
+		format.isBigEndian = hostIsBigEndian;
+		format.isLongInt = (sizeof(emInt) == 8);
+	}
+	return format;
+}
+
+// These loops are written so that the compiler turns them into vector
+// shuffles; the memcpy's let the data be only 4-byte aligned.
+void swapBytes4(void* data, const size_t count) {
+	uint32_t* const words = reinterpret_cast<uint32_t*>(data);
+#pragma omp simd
+	for (size_t ii = 0; ii < count; ii++) {
+		words[ii] = __builtin_bswap32(words[ii]);
+	}
+}
+
+void swapBytes8(void* data, const size_t count) {
+	char* const bytes = reinterpret_cast<char*>(data);
+#pragma omp simd
+	for (size_t ii = 0; ii < count; ii++) {
+		uint64_t word;
+		memcpy(&word, bytes + 8 * ii, 8);
+		word = __builtin_bswap64(word);
+		memcpy(bytes + 8 * ii, &word, 8);
+	}
+}
+
+template<typename FileInt>
+static void encodeInts(const emInt* src, const size_t count, const int inc,
+		const bool pyrSwap, FileInt* out) {
+#pragma omp simd
+	for (size_t ii = 0; ii < count; ii++) {
+		out[ii] = FileInt(src[ii]) + inc;
+	}
+	if (pyrSwap) {
+		for (size_t ii = 0; ii < count; ii += 5) {
+			std::swap(out[ii + 2], out[ii + 4]);
+		}
+	}
+}
+
+size_t encodeUGridInts(const emInt* src, const size_t count, const int inc,
+		const bool pyrSwap, const UGridFormat& format, char* out) {
+	if (format.isLongInt) {
+		encodeInts(src, count, inc, pyrSwap, reinterpret_cast<uint64_t*>(out));
+		if (format.needsByteSwap()) swapBytes8(out, count);
+	}
+	else {
+		encodeInts(src, count, inc, pyrSwap, reinterpret_cast<uint32_t*>(out));
+		if (format.needsByteSwap()) swapBytes4(out, count);
+	}
+	return count * format.intBytes();
+}
+
+size_t encodeUGridReals(const void* src, const size_t count,
+		const UGridFormat& format, char* out) {
+	if (format.isSinglePrec) {
+		const char* const bytes = reinterpret_cast<const char*>(src);
+		float* const fOut = reinterpret_cast<float*>(out);
+#pragma omp simd
+		for (size_t ii = 0; ii < count; ii++) {
+			double value;
+			memcpy(&value, bytes + 8 * ii, 8);
+			fOut[ii] = float(value);
+		}
+		if (format.needsByteSwap()) swapBytes4(out, count);
+	}
+	else {
+		memcpy(out, src, 8 * count);
+		if (format.needsByteSwap()) swapBytes8(out, count);
+	}
+	return count * format.realBytes();
+}
+
+template<typename FileInt>
+static bool decodeInts(const FileInt* in, const size_t count, const int inc,
+		const bool pyrSwap, emInt* dst) {
+	bool fits = true;
+#pragma omp simd reduction(&&: fits)
+	for (size_t ii = 0; ii < count; ii++) {
+		const FileInt value = in[ii] + inc;
+		fits = fits && (value <= FileInt(EMINT_MAX));
+		dst[ii] = emInt(value);
+	}
+	if (pyrSwap) {
+		for (size_t ii = 0; ii < count; ii += 5) {
+			std::swap(dst[ii + 2], dst[ii + 4]);
+		}
+	}
+	return fits;
+}
+
+bool decodeUGridInts(char* in, const size_t count, const int inc,
+		const bool pyrSwap, const UGridFormat& format, emInt* dst) {
+	if (format.isLongInt) {
+		if (format.needsByteSwap()) swapBytes8(in, count);
+		return decodeInts(reinterpret_cast<const uint64_t*>(in), count, inc,
+											pyrSwap, dst);
+	}
+	else {
+		if (format.needsByteSwap()) swapBytes4(in, count);
+		return decodeInts(reinterpret_cast<const uint32_t*>(in), count, inc,
+											pyrSwap, dst);
+	}
+}
+
+void decodeUGridReals(char* in, const size_t count, const UGridFormat& format,
+		void* dst) {
+	if (format.isSinglePrec) {
+		if (format.needsByteSwap()) swapBytes4(in, count);
+		const float* const fIn = reinterpret_cast<const float*>(in);
+		char* const bytes = reinterpret_cast<char*>(dst);
+#pragma omp simd
+		for (size_t ii = 0; ii < count; ii++) {
+			const double value = fIn[ii];
+			memcpy(bytes + 8 * ii, &value, 8);
+		}
+	}
+	else {
+		if (format.needsByteSwap()) swapBytes8(in, count);
+		memcpy(dst, in, 8 * count);
+	}
+}
+
+bool pwriteAll(const int fd, const char* data, size_t bytes, off_t offset) {
+	while (bytes > 0) {
+		ssize_t written = pwrite(fd, data, bytes, offset);
+		if (written <= 0) return false;
+		data += written;
+		bytes -= written;
+		offset += written;
+	}
+	return true;
+}
+
+bool UGridSliceWriter::open(const char fileName[], const UGridFormat& format,
+		const size_t counts[7]) {
+	close();
+	m_format = format;
+	std::copy(counts, counts + 7, m_counts);
+	static const int nPts[] = { 3, 3, 4, 4, 5, 6, 8 };
+	// Fortran unformatted files have the header in one record and everything
+	// else in a second, each wrapped in 4-byte length markers.
+	const size_t markerBytes = format.isFortran ? 4 : 0;
+	const size_t headerBytes = 7 * format.intBytes();
+	off_t offset = headerBytes + 3 * markerBytes;
+	const off_t dataStart = offset;
+	for (int ii = 0; ii < 7; ii++) {
+		m_offsets[ii] = offset;
+		offset += nPts[ii] * counts[ii]
+				* (ii == 0 ? format.realBytes() : format.intBytes());
+		// Bdry conditions follow the quads.
+		if (ii == 2) offset += (counts[1] + counts[2]) * format.intBytes();
+	}
+	const size_t dataBytes = offset - dataStart;
+	if (!format.canHold(*std::max_element(counts, counts + 7))) {
+		fprintf(stderr, "Mesh too big for 32-bit ints in %s; "
+						"use a variant ending in l, as in b8l.\n", fileName);
+		return false;
+	}
+	if (format.isFortran && dataBytes > INT32_MAX) {
+		fprintf(stderr, "Mesh too big for a single Fortran record in %s.\n",
+						fileName);
+		return false;
+	}
+
+	m_fd = ::open(fileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (m_fd < 0) {
+		fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n",
+						fileName);
+		return false;
+	}
+	bool ok = ftruncate(m_fd, offset + markerBytes) == 0;
+
+	emInt header[7];
+	for (int ii = 0; ii < 7; ii++) {
+		header[ii] = counts[ii];
+		ok = ok && counts[ii] <= EMINT_MAX;
+	}
+	uint64_t encoded[7];
+	encodeUGridInts(header, 7, 0, false, format,
+									reinterpret_cast<char*>(encoded));
+	ok = ok
+			&& pwriteAll(m_fd, reinterpret_cast<const char*>(encoded), headerBytes,
+										markerBytes);
+	if (format.isFortran) {
+		uint32_t markers[] = { uint32_t(headerBytes), uint32_t(headerBytes),
+														uint32_t(dataBytes), uint32_t(dataBytes) };
+		const off_t markerOffsets[] = { 0, off_t(markerBytes + headerBytes),
+																		dataStart - 4, offset };
+		if (format.needsByteSwap()) swapBytes4(markers, 4);
+		for (int ii = 0; ii < 4; ii++) {
+			ok = ok
+					&& pwriteAll(m_fd, reinterpret_cast<const char*>(&markers[ii]), 4,
+												markerOffsets[ii]);
+		}
+	}
+	if (!ok) {
+		fprintf(stderr, "Couldn't set up file %s.  Bummer!\n", fileName);
+		close();
+	}
+	return ok;
+}
+
+bool UGridSliceWriter::writeVerts(const size_t first, const double coords[],
+		const size_t count) {
+	if (m_fd < 0 || first + count > m_counts[0]) return false;
+	const size_t chunkVerts = 8192 * 16;
+	const size_t nChunks = (count + chunkVerts - 1) / chunkVerts;
+	bool ok = true;
+#pragma omp parallel reduction(&&: ok)
+	{
+		std::vector<double> staging(3 * chunkVerts);
+		char* const out = reinterpret_cast<char*>(staging.data());
+#pragma omp for schedule(dynamic)
+		for (size_t iC = 0; iC < nChunks; iC++) {
+			const size_t start = iC * chunkVerts;
+			const size_t num = std::min(chunkVerts, count - start);
+			const size_t bytes = encodeUGridReals(coords + 3 * start, 3 * num,
+																						m_format, out);
+			ok = pwriteAll(m_fd, out, bytes,
+											m_offsets[0]
+													+ 3 * (first + start) * m_format.realBytes())
+					&& ok;
+		}
+	}
+	return ok;
+}
+
+bool UGridSliceWriter::writeCells(const int type, const size_t first,
+		const emInt conn[], const size_t count, const emInt newIndices[]) {
+	static const int nPts[] = { 3, 3, 4, 4, 5, 6, 8 };
+	if (m_fd < 0 || type < 1 || type > 6 || first + count > m_counts[type]) {
+		return false;
+	}
+	const int pts = nPts[type];
+	const size_t chunkCells = 8192 * 16;
+	const size_t nChunks = (count + chunkCells - 1) / chunkCells;
+	bool ok = true;
+#pragma omp parallel reduction(&&: ok)
+	{
+		std::vector<emInt> remapped(newIndices ? pts * chunkCells : 0);
+		std::vector<uint64_t> staging(pts * chunkCells);
+		char* const out = reinterpret_cast<char*>(staging.data());
+#pragma omp for schedule(dynamic)
+		for (size_t iC = 0; iC < nChunks; iC++) {
+			const size_t start = iC * chunkCells;
+			const size_t num = std::min(chunkCells, count - start);
+			const emInt* src = conn + pts * start;
+			if (newIndices) {
+				for (size_t ii = 0; ii < pts * num; ii++) {
+					remapped[ii] = newIndices[src[ii]];
+				}
+				src = remapped.data();
+			}
+			// UGRID is 1-based, and switches pyramid verts 2 and 4.
+			const size_t bytes = encodeUGridInts(src, pts * num, 1, type == 4,
+																						m_format, out);
+			ok = pwriteAll(m_fd, out, bytes,
+											m_offsets[type]
+													+ pts * (first + start) * m_format.intBytes())
+					&& ok;
+		}
+	}
+	return ok;
+}
+
+bool UGridSliceWriter::close() {
+	if (m_fd < 0) return true;
+	const bool ok = ::close(m_fd) == 0;
+	m_fd = -1;
+	return ok;
+}
+
+// Big enough that each write is worth a pass over the writer's threads.
+static const size_t streamBlockEntities = 1 << 16;
+static const int streamPts[] = { 3, 3, 4, 4, 5, 6, 8 };
+
+UGridStreamingSink::UGridStreamingSink(UGridSliceWriter& writer) :
+		m_writer(writer), m_firstBlockVert(0), m_ok(true) {
+	m_vertBlock.reserve(3 * streamBlockEntities);
+	for (int type = 0; type < 7; type++) {
+		m_firstBlockCell[type] = 0;
+	}
+}
+
+void UGridStreamingSink::flushVerts() {
+	const size_t count = m_vertBlock.size() / 3;
+	m_ok = m_writer.writeVerts(m_firstBlockVert, m_vertBlock.data(), count)
+			&& m_ok;
+	m_firstBlockVert += count;
+	m_vertBlock.clear();
+}
+
+void UGridStreamingSink::flushCells(const int type) {
+	std::vector<emInt>& block = m_cellBlocks[type];
+	const size_t count = block.size() / streamPts[type];
+	m_ok = m_writer.writeCells(type, m_firstBlockCell[type], block.data(),
+															count) && m_ok;
+	m_firstBlockCell[type] += count;
+	block.clear();
+}
+
+void UGridStreamingSink::newVert(const emInt index, const double coords[3]) {
+	// Verts come in order, but a sink could be handed any range.
+	if (index != m_firstBlockVert + m_vertBlock.size() / 3) {
+		flushVerts();
+		m_firstBlockVert = index;
+	}
+	m_vertBlock.insert(m_vertBlock.end(), coords, coords + 3);
+	if (m_vertBlock.size() == 3 * streamBlockEntities) flushVerts();
+}
+
+void UGridStreamingSink::cells(const int type, const emInt first,
+		const emInt conn[], const emInt count) {
+	std::vector<emInt>& block = m_cellBlocks[type];
+	const size_t blockSize = streamPts[type] * streamBlockEntities;
+	if (block.capacity() < blockSize) block.reserve(blockSize);
+	if (first != m_firstBlockCell[type] + block.size() / streamPts[type]) {
+		flushCells(type);
+		m_firstBlockCell[type] = first;
+	}
+	const emInt* next = conn;
+	const emInt* const end = conn + streamPts[type] * size_t(count);
+	while (next != end) {
+		const size_t num = std::min(size_t(end - next), blockSize - block.size());
+		block.insert(block.end(), next, next + num);
+		next += num;
+		if (block.size() == blockSize) flushCells(type);
+	}
+}
+
+bool UGridStreamingSink::finish() {
+	flushVerts();
+	for (int type = 1; type < 7; type++) {
+		flushCells(type);
+	}
+	return m_ok;
+}
+
+bool isBlockCompressedFileName(const char fileName[]) {
+	const size_t len = strlen(fileName);
+	return len > 2 && strcmp(fileName + len - 2, ".z") == 0;
+}
+
+static const char blockMagic[8] = "ExaZBlk";
+static const uint32_t blockVersion = 1;
+static const size_t blockHeaderBytes = 40;
+// Deflate only looks back 32 KB, so bigger blocks hardly compress better.
+static const size_t compressedBlockBytes = 1 << 18;
+
+static uint64_t littleEndian64(uint64_t value) {
+	return hostIsBigEndian ? __builtin_bswap64(value) : value;
+}
+
+static uint32_t littleEndian32(uint32_t value) {
+	return hostIsBigEndian ? __builtin_bswap32(value) : value;
+}
+
+static uint64_t readLittle64(const char* data) {
+	uint64_t value;
+	memcpy(&value, data, 8);
+	return littleEndian64(value);
+}
+
+#if (HAVE_LIBZ == 1)
+bool writeBlockCompressedFile(const char fileName[], const size_t dataBytes,
+		const std::function<void(size_t offset, size_t bytes, char* out)>& fill) {
+	const size_t nBlocks = (dataBytes + compressedBlockBytes - 1)
+			/ compressedBlockBytes;
+	int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n",
+						fileName);
+		return false;
+	}
+
+	// Blocks are compressed a batch at a time, so that only a batch of
+	// compressed blocks is ever held in memory.  Once a batch is done, its
+	// blocks' places in the file are known, and they're written in parallel.
+#ifdef _OPENMP
+	const size_t batchBlocks = 16 * omp_get_max_threads();
+#else
+	const size_t batchBlocks = 16;
+#endif
+	const size_t boundBytes = compressBound(compressedBlockBytes);
+	std::vector<std::vector<char> > compressed(batchBlocks,
+																							std::vector<char>(boundBytes));
+	std::vector<uLongf> compressedBytes(batchBlocks);
+	std::vector<uint64_t> index(nBlocks + 1);
+	index[0] = blockHeaderBytes;
+	bool ok = true;
+	for (size_t batchStart = 0; ok && batchStart < nBlocks; batchStart +=
+			batchBlocks) {
+		const size_t batchEnd = std::min(nBlocks, batchStart + batchBlocks);
+#pragma omp parallel reduction(&&: ok)
+		{
+			std::vector<char> raw(compressedBlockBytes);
+#pragma omp for schedule(dynamic)
+			for (size_t iB = batchStart; iB < batchEnd; iB++) {
+				const size_t offset = iB * compressedBlockBytes;
+				const size_t bytes = std::min(compressedBlockBytes,
+																			dataBytes - offset);
+				fill(offset, bytes, raw.data());
+				uLongf& outBytes = compressedBytes[iB - batchStart];
+				outBytes = boundBytes;
+				ok = compress2(
+						reinterpret_cast<Bytef*>(compressed[iB - batchStart].data()),
+						&outBytes, reinterpret_cast<const Bytef*>(raw.data()), bytes,
+						Z_DEFAULT_COMPRESSION) == Z_OK && ok;
+			}
+		}
+		for (size_t iB = batchStart; iB < batchEnd; iB++) {
+			index[iB + 1] = index[iB] + compressedBytes[iB - batchStart];
+		}
+#pragma omp parallel for schedule(dynamic) reduction(&&: ok)
+		for (size_t iB = batchStart; iB < batchEnd; iB++) {
+			ok = pwriteAll(fd, compressed[iB - batchStart].data(),
+											compressedBytes[iB - batchStart], index[iB]) && ok;
+		}
+	}
+
+	const uint64_t indexOffset = index[nBlocks];
+	for (uint64_t& entry : index) {
+		entry = littleEndian64(entry);
+	}
+	char header[blockHeaderBytes];
+	const uint32_t version = littleEndian32(blockVersion);
+	const uint32_t blockBytes = littleEndian32(compressedBlockBytes);
+	const uint64_t sizes[] = { littleEndian64(dataBytes), littleEndian64(
+			nBlocks), littleEndian64(indexOffset) };
+	memcpy(header, blockMagic, 8);
+	memcpy(header + 8, &version, 4);
+	memcpy(header + 12, &blockBytes, 4);
+	memcpy(header + 16, sizes, 24);
+	ok = ok
+			&& pwriteAll(fd, reinterpret_cast<const char*>(index.data()),
+										8 * index.size(), indexOffset)
+			&& pwriteAll(fd, header, blockHeaderBytes, 0);
+	if (close(fd) != 0) ok = false;
+	if (!ok) {
+		fprintf(stderr, "Couldn't write all of file %s.  Bummer!\n", fileName);
+	}
+	return ok;
+}
+
+bool blockCompressedDataSize(const char* file, const size_t fileSize,
+		size_t& dataBytes) {
+	if (fileSize < blockHeaderBytes || memcmp(file, blockMagic, 8) != 0) {
+		return false;
+	}
+	uint32_t version, blockBytes;
+	memcpy(&version, file + 8, 4);
+	memcpy(&blockBytes, file + 12, 4);
+	dataBytes = readLittle64(file + 16);
+	const uint64_t nBlocks = readLittle64(file + 24);
+	const uint64_t indexOffset = readLittle64(file + 32);
+	if (littleEndian32(version) != blockVersion
+			|| littleEndian32(blockBytes) != compressedBlockBytes
+			|| nBlocks != (dataBytes + compressedBlockBytes - 1)
+					/ compressedBlockBytes
+			|| indexOffset > fileSize
+			|| (fileSize - indexOffset) / 8 < nBlocks + 1) {
+		return false;
+	}
+	// Blocks have to be in order, and between the header and the index.
+	const char* const index = file + indexOffset;
+	bool ok = readLittle64(index) == blockHeaderBytes
+			&& readLittle64(index + 8 * nBlocks) == indexOffset;
+#pragma omp parallel for reduction(&&: ok)
+	for (uint64_t iB = 0; iB < nBlocks; iB++) {
+		ok = readLittle64(index + 8 * iB) <= readLittle64(index + 8 * (iB + 1))
+				&& ok;
+	}
+	return ok;
+}
+
+bool readBlockCompressedRange(const char* file, const size_t fileSize,
+		const size_t offset, const size_t bytes, char* out) {
+	if (bytes == 0) return true;
+	const size_t dataBytes = readLittle64(file + 16);
+	const char* const index = file + readLittle64(file + 32);
+	if (offset + bytes > dataBytes) return false;
+	std::vector<char> partial;
+	bool ok = true;
+	for (size_t iB = offset / compressedBlockBytes;
+			ok && iB <= (offset + bytes - 1) / compressedBlockBytes; iB++) {
+		const size_t blockStart = iB * compressedBlockBytes;
+		const size_t blockBytes = std::min(compressedBlockBytes,
+																				dataBytes - blockStart);
+		const uint64_t inStart = readLittle64(index + 8 * iB);
+		const uint64_t inBytes = readLittle64(index + 8 * (iB + 1)) - inStart;
+		if (inStart + inBytes > fileSize) return false;
+		// Blocks that are wanted whole go straight into place.
+		const bool isWhole = blockStart >= offset
+				&& blockStart + blockBytes <= offset + bytes;
+		if (!isWhole) partial.resize(blockBytes);
+		char* const dst = isWhole ? out + (blockStart - offset) : partial.data();
+		uLongf outBytes = blockBytes;
+		ok = uncompress(reinterpret_cast<Bytef*>(dst), &outBytes,
+										reinterpret_cast<const Bytef*>(file + inStart), inBytes)
+				== Z_OK && outBytes == blockBytes;
+		if (ok && !isWhole) {
+			const size_t copyStart = std::max(offset, blockStart);
+			const size_t copyEnd = std::min(offset + bytes, blockStart + blockBytes);
+			memcpy(out + (copyStart - offset), partial.data()
+							+ (copyStart - blockStart),
+							copyEnd - copyStart);
+		}
+	}
+	return ok;
+}
+#else
+bool writeBlockCompressedFile(const char fileName[], const size_t,
+		const std::function<void(size_t offset, size_t bytes, char* out)>&) {
+	fprintf(stderr, "Can't write %s; not compiled with zlib.\n", fileName);
+	return false;
+}
+
+bool blockCompressedDataSize(const char*, const size_t, size_t&) {
+	fprintf(stderr, "Can't read block-compressed files; not compiled with "
+					"zlib.\n");
+	return false;
+}
+
+bool readBlockCompressedRange(const char*, const size_t, const size_t,
+		const size_t, char*) {
+	return false;
+}
+#endif
@@ -0,0 +1,200 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * UGridIO.h
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#ifndef SRC_UGRIDIO_H_
+#define SRC_UGRIDIO_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <functional>
+#include <vector>
+
+#include "exa-defs.h"
+#include "RefineSink.h"
+
+// The binary UGRID variants, as named by the infix in <name>.<infix>.ugrid:
+//   [l]{b|r}{8|4}[l]
+// A leading l means little-endian (otherwise big-endian); b is plain binary
+// and r is Fortran unformatted (one record for the header, one for
+// everything else); 8 and 4 give the size of a coordinate; a trailing l
+// means 64-bit integers.  So lb8 is little-endian binary with doubles and
+// 32-bit ints, and r4l is big-endian Fortran with floats and 64-bit ints.
+struct UGridFormat {
+	bool isBigEndian;
+	bool isFortran;
+	bool isSinglePrec;
+	bool isLongInt;
+	UGridFormat() :
+			isBigEndian(false), isFortran(false), isSinglePrec(false),
+					isLongInt(false) {
+	}
+	size_t intBytes() const {
+		return isLongInt ? 8 : 4;
+	}
+	size_t realBytes() const {
+		return isSinglePrec ? 4 : 8;
+	}
+	bool needsByteSwap() const;
+	// True if every count and (1-based) index up to maxValue fits in this
+	// format's ints.  Only 64-bit builds can have meshes that don't.
+	bool canHold(const size_t maxValue) const {
+		return isLongInt || maxValue <= UINT32_MAX;
+	}
+	// True if a file in this format is byte-for-byte the same as a UMesh
+	// file image (apart from 1-based indexing), except perhaps for byte
+	// order.
+	bool matchesImageLayout() const {
+		return !isFortran && !isSinglePrec && intBytes() == sizeof(emInt);
+	}
+};
+
+// Parse an infix like "lb8"; returns false if it isn't a UGRID variant.
+bool parseUGridInfix(const char infix[], UGridFormat& format);
+
+// Find the format from a file name like mesh.lb8.ugrid (or the
+// block-compressed mesh.lb8.ugrid.z); returns false if the name doesn't end
+// with a recognized <infix>.ugrid.
+bool ugridFormatFromFileName(const char fileName[], UGridFormat& format);
+
+// The format to use for a UGRID file; if the name doesn't say, use the
+// layout of the file image.
+UGridFormat formatForUGridFile(const char fileName[]);
+
+// Reverse the bytes of each of count 4- or 8-byte words, in place.  Data
+// need only be 4-byte aligned.
+void swapBytes4(void* data, const size_t count);
+void swapBytes8(void* data, const size_t count);
+
+// Convert count indices to file form: add inc, switch verts 2 and 4 of
+// each pyramid if pyrSwap, then widen and byte swap as needed.  Returns the
+// number of bytes written to out.
+size_t encodeUGridInts(const emInt* src, const size_t count, const int inc,
+		const bool pyrSwap, const UGridFormat& format, char* out);
+
+// Convert count coordinates (doubles, which need only be 4-byte aligned) to
+// file form.  Returns the number of bytes written to out.
+size_t encodeUGridReals(const void* src, const size_t count,
+		const UGridFormat& format, char* out);
+
+// The reverse of encodeUGridInts.  in is only modified if its byte order
+// has to change, and must be aligned for the file's integer size.  Returns
+// false if an index doesn't fit in an emInt.
+bool decodeUGridInts(char* in, const size_t count, const int inc,
+		const bool pyrSwap, const UGridFormat& format, emInt* dst);
+
+// The reverse of encodeUGridReals.  in is only modified if its byte order
+// has to change.
+void decodeUGridReals(char* in, const size_t count, const UGridFormat& format,
+		void* dst);
+
+// Write all of a buffer at the given file offset, retrying short writes.
+// Used by all the parallel writers, which each write their chunks at
+// precomputed offsets.
+bool pwriteAll(const int fd, const char* data, size_t bytes, off_t offset);
+
+// A UGRID file written a slice at a time, in any order, by code that never
+// has the whole mesh.  The file is laid out from the final counts (in the
+// order of the UGRID header) when it's opened; each slice is then encoded
+// and written in parallel, straight to its place.  Anything never written,
+// such as bdry conditions, is left zero.  Not for block-compressed files.
+class UGridSliceWriter {
+	int m_fd;
+	UGridFormat m_format;
+	size_t m_counts[7];
+	// Where the coordinates and each type of face or cell start.
+	off_t m_offsets[7];
+	UGridSliceWriter(const UGridSliceWriter&);
+	UGridSliceWriter& operator=(const UGridSliceWriter&);
+public:
+	UGridSliceWriter() :
+			m_fd(-1) {
+	}
+	~UGridSliceWriter() {
+		close();
+	}
+	bool open(const char fileName[], const UGridFormat& format,
+			const size_t counts[7]);
+	// coords holds 3 * count doubles.
+	bool writeVerts(const size_t first, const double coords[],
+			const size_t count);
+	// type is the entry in the UGRID header (1 for tris, and so on up to 6
+	// for hexes), and conn holds zero-based indices.  If newIndices is
+	// given, each index is looked up there first.
+	bool writeCells(const int type, const size_t first, const emInt conn[],
+			const size_t count, const emInt newIndices[] = nullptr);
+	bool close();
+};
+
+// Refinement straight into a UGRID file, through a writer laid out for the
+// whole fine mesh.  Verts and each type of face or cell are gathered a
+// block at a time and written as each block fills, so neither the fine
+// mesh nor the file image is ever held.
+class UGridStreamingSink: public StreamingSink {
+	UGridSliceWriter& m_writer;
+	std::vector<double> m_vertBlock;
+	size_t m_firstBlockVert;
+	std::vector<emInt> m_cellBlocks[7];
+	size_t m_firstBlockCell[7];
+	bool m_ok;
+	void flushVerts();
+	void flushCells(const int type);
+protected:
+	void newVert(const emInt index, const double coords[3]);
+	void cells(const int type, const emInt first, const emInt conn[],
+			const emInt count);
+public:
+	explicit UGridStreamingSink(UGridSliceWriter& writer);
+	// Write whatever is still gathered; false if any write failed.
+	bool finish();
+};
+
+// Block-compressed files (named <name>.z) hold data cut into fixed-size
+// blocks, each deflated independently, followed by an index of where each
+// block starts.  So blocks can be compressed and decompressed on all
+// cores, and any range of the data can be read without the rest.  The
+// header and index are little-endian:
+//   char magic[8]; uint32 version, blockBytes; uint64 dataBytes, nBlocks,
+//   indexOffset; then the blocks; then nBlocks + 1 uint64 block offsets.
+bool isBlockCompressedFileName(const char fileName[]);
+
+// Write dataBytes bytes of data, which fill produces on demand: each call
+// fills out with bytes [offset, offset + bytes) of the data, and calls are
+// made from many threads at once.  Requires zlib.
+bool writeBlockCompressedFile(const char fileName[], const size_t dataBytes,
+		const std::function<void(size_t offset, size_t bytes, char* out)>& fill);
+
+// Check the header and index of a block-compressed file, which the caller
+// has mapped, and find how much data it holds.
+bool blockCompressedDataSize(const char* file, const size_t fileSize,
+		size_t& dataBytes);
+
+// Decompress bytes [offset, offset + bytes) of the data into out; only the
+// blocks that hold them are touched.  The file must have passed
+// blockCompressedDataSize.  Thread safe.
+bool readBlockCompressedRange(const char* file, const size_t fileSize,
+		const size_t offset, const size_t bytes, char* out);
+
+#endif /* SRC_UGRIDIO_H_ */
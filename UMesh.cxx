@@ -31,7 +31,11 @@
 #include <set>
 #include <vector>
 
+#include <fcntl.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "ExaMesh.h"
 #include "exa-defs.h"
@@ -51,6 +55,12 @@
 #endif
 
 #include "GMGW_FileWrapper.hxx"
+#include "NumaMemory.h"
+#include "PackedConn.h"
+#include "PartInterface.h"
+#include "Snapshot.h"
+#include "UGridIO.h"
+#include "VTKIO.h"
 
 using std::cout;
 using std::endl;
@@ -66,9 +76,61 @@ static bool memoryCheck(void* address, int nBytes) {
 }
 #endif
 
+bool UMesh::mapFileImage(const char mapFileName[]) {
+	// Only formats laid out like the file image can be built in place; byte
+	// order is fixed when the file is written.
+	if (!formatForUGridFile(mapFileName).matchesImageLayout()
+			|| isBlockCompressedFileName(mapFileName)) {
+		fprintf(stderr, "Can't build %s in place; refining in memory instead.\n",
+						mapFileName);
+		return false;
+	}
+	// A freshly truncated file reads back as zeros, just like calloc'd memory.
+	int fd = open(mapFileName, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Couldn't open file %s for mapping.  Bummer!\n",
+						mapFileName);
+		return false;
+	}
+	if (ftruncate(fd, m_fileImageSize) != 0) {
+		fprintf(stderr, "Couldn't size file %s to %lu bytes.\n", mapFileName,
+						m_fileImageSize);
+		close(fd);
+		return false;
+	}
+	void* image = mmap(nullptr, m_fileImageSize, PROT_READ | PROT_WRITE,
+											MAP_SHARED, fd, 0);
+	if (image == MAP_FAILED) {
+		fprintf(stderr, "Couldn't map file %s.\n", mapFileName);
+		close(fd);
+		return false;
+	}
+	m_buffer = reinterpret_cast<char*>(image);
+	m_fileImage = m_buffer;
+	m_mapFD = fd;
+	m_mapFileName = mapFileName;
+	return true;
+}
+
+void UMesh::setImagePointers() {
+	// The pointer arithmetic here is made more complicated because the pointers aren't
+	// compatible with each other.
+	m_header = reinterpret_cast<emInt*>(m_fileImage);
+	m_coords = reinterpret_cast<imageDouble (*)[3]>(m_header + 7);
+	m_TriConn = reinterpret_cast<emInt (*)[3]>(m_coords + m_nVerts);
+	m_QuadConn = reinterpret_cast<emInt (*)[4]>(m_TriConn + m_nTris);
+	m_TriBC = reinterpret_cast<emInt*>(m_QuadConn + m_nQuads);
+	m_QuadBC = m_TriBC + m_nTris;
+	m_TetConn = reinterpret_cast<emInt (*)[4]>(m_QuadBC + m_nQuads);
+	m_PyrConn = reinterpret_cast<emInt (*)[5]>(m_TetConn + m_nTets);
+	m_PrismConn = reinterpret_cast<emInt (*)[6]>(m_PyrConn + m_nPyrs);
+	m_HexConn = reinterpret_cast<emInt (*)[8]>(m_PrismConn + m_nPrisms);
+}
+
 void UMesh::init(const emInt nVerts, const emInt nBdryVerts,
 		const emInt nBdryTris, const emInt nBdryQuads, const emInt nTets,
-		const emInt nPyramids, const emInt nPrisms, const emInt nHexes) {
+		const emInt nPyramids, const emInt nPrisms, const emInt nHexes,
+		const char mapFileName[], const bool isSlim) {
 	m_nVerts = nVerts;
 	m_nBdryVerts = nBdryVerts;
 	m_nTris = nBdryTris;
@@ -101,26 +163,36 @@ void UMesh::init(const emInt nVerts, const emInt nBdryVerts,
 	assert((connSize + BCSize + slack2Size) % 8 == 0);
 	assert(bufferBytes % 8 == 0);
 	size_t bufferWords = bufferBytes / 8;
-	// Use words instead of bytes to ensure 8-byte alignment.
-	m_buffer = reinterpret_cast<char*>(calloc(bufferWords, 8));
+	m_fileImageSize = bufferBytes - slack1Size - slack2Size;
+	if (!mapFileName || !mapFileImage(mapFileName)) {
+		// Page-aligned and zero, but untouched, so each page ends up on the
+		// NUMA node of whichever thread writes it first; see NumaMemory.h.  A
+		// slim mesh is about to be written from end to end, so a block reused
+		// from a pool needn't be zeroed first (see clearUnwrittenImage),
+		// except that debug builds check that nothing is written twice.
+#ifdef NDEBUG
+		const bool mustZero = !isSlim;
+#else
+		const bool mustZero = true;
+#endif
+		bool isZero = true;
+		m_buffer = reinterpret_cast<char*>(allocateReusable(bufferWords * 8,
+				mustZero, m_bufferBytes, isZero));
+		m_isRecycled = !isZero;
+		if (!m_buffer) {
+			fprintf(stderr, "Couldn't allocate %lu bytes for the mesh.\n",
+							bufferBytes);
+			exit(1);
+		}
+		m_fileImage = m_buffer + slack1Size;
+		if (m_isRecycled) {
+			std::fill(m_buffer, m_fileImage, 0);
+			std::fill(m_fileImage + m_fileImageSize, m_buffer + bufferBytes, 0);
+		}
+	}
 
-	// The pointer arithmetic here is made more complicated because the pointers aren't
-	// compatible with each other.
-	m_header = reinterpret_cast<emInt*>(m_buffer + slack1Size);
+	setImagePointers();
 	std::fill(m_header, m_header + 7, 0);
-	m_coords =
-			reinterpret_cast<double (*)[3]>(m_buffer + headerSize + slack1Size);
-	m_TriConn = reinterpret_cast<emInt (*)[3]>(m_buffer + headerSize + slack1Size
-																							+ coordSize);
-	m_QuadConn = reinterpret_cast<emInt (*)[4]>(m_TriConn + nBdryTris);
-	m_TriBC = reinterpret_cast<emInt*>(m_QuadConn + nBdryQuads);
-	m_QuadBC = m_TriBC + nBdryTris;
-	m_TetConn = reinterpret_cast<emInt (*)[4]>(m_QuadBC + nBdryQuads);
-	m_PyrConn = reinterpret_cast<emInt (*)[5]>(m_TetConn + nTets);
-	m_PrismConn = reinterpret_cast<emInt (*)[6]>(m_PyrConn + nPyramids);
-	m_HexConn = reinterpret_cast<emInt (*)[8]>(m_PrismConn + nPrisms);
-	m_fileImage = m_buffer + slack1Size;
-	m_fileImageSize = bufferBytes - slack1Size - slack2Size;
 
 //	printf("Diagnostics for UMesh data struct:\n");
 //	printf("Buffer size, in bytes:     %lu\n", bufferBytes);
@@ -144,12 +216,55 @@ void UMesh::init(const emInt nVerts, const emInt nBdryVerts,
 //			"Tet conn offset: %10lu\n",
 //			reinterpret_cast<char*>(m_TetConn) - reinterpret_cast<char*>(m_header));
 
-	m_lenScale = new double[m_nVerts];
-	for (emInt ii = 0; ii < m_nVerts; ii++) {
-		m_lenScale[ii] = 0;
+	// The mappings only ever use the length scales of the coarse mesh.
+	if (!isSlim) {
+		m_lenScale = new double[m_nVerts];
+		for (emInt ii = 0; ii < m_nVerts; ii++) {
+			m_lenScale[ii] = 0;
+		}
 	}
 }
 
+void UMesh::clearUnwrittenImage() {
+	if (!m_isRecycled) return;
+	// Refinement writes no BCs, and any shortfall from the estimated sizes
+	// leaves a gap at the end of each section.
+	auto clearTail = [](void* section, const size_t entrySize,
+			const emInt used, const emInt size) {
+		char* const start = reinterpret_cast<char*>(section);
+		std::fill(start + entrySize * used, start + entrySize * size, 0);
+	};
+	clearTail(m_TriBC, sizeof(emInt), 0, m_nTris + m_nQuads);
+	clearTail(m_coords, sizeof(m_coords[0]), m_header[eVert], m_nVerts);
+	clearTail(m_TriConn, sizeof(m_TriConn[0]), m_header[eTri], m_nTris);
+	clearTail(m_QuadConn, sizeof(m_QuadConn[0]), m_header[eQuad], m_nQuads);
+	clearTail(m_TetConn, sizeof(m_TetConn[0]), m_header[eTet], m_nTets);
+	clearTail(m_PyrConn, sizeof(m_PyrConn[0]), m_header[ePyr], m_nPyrs);
+	clearTail(m_PrismConn, sizeof(m_PrismConn[0]), m_header[ePrism],
+						m_nPrisms);
+	clearTail(m_HexConn, sizeof(m_HexConn[0]), m_header[eHex], m_nHexes);
+	m_isRecycled = false;
+}
+
+UMeshMemory UMesh::memoryUsage() const {
+	UMeshMemory UMM;
+	UMM.coords = 3 * sizeof(double) * size_t(m_nVerts);
+	UMM.triConn = 3 * sizeof(emInt) * size_t(m_nTris);
+	UMM.quadConn = 4 * sizeof(emInt) * size_t(m_nQuads);
+	UMM.triBCs = sizeof(emInt) * size_t(m_nTris);
+	UMM.quadBCs = sizeof(emInt) * size_t(m_nQuads);
+	UMM.tetConn = 4 * sizeof(emInt) * size_t(m_nTets);
+	UMM.pyrConn = 5 * sizeof(emInt) * size_t(m_nPyrs);
+	UMM.prismConn = 6 * sizeof(emInt) * size_t(m_nPrisms);
+	UMM.hexConn = 8 * sizeof(emInt) * size_t(m_nHexes);
+	UMM.other = m_fileImageSize
+			- (UMM.coords + UMM.triConn + UMM.quadConn + UMM.triBCs + UMM.quadBCs
+				+ UMM.tetConn + UMM.pyrConn + UMM.prismConn + UMM.hexConn);
+	UMM.lengthScales = m_lenScale ? sizeof(double) * size_t(m_nVerts) : 0;
+	UMM.refineTables = m_tableSizes.bytes;
+	return UMM;
+}
+
 UMesh::UMesh(const emInt nVerts, const emInt nBdryVerts, const emInt nBdryTris,
 		const emInt nBdryQuads, const emInt nTets, const emInt nPyramids,
 		const emInt nPrisms, const emInt nHexes) :
@@ -159,7 +274,8 @@ UMesh::UMesh(const emInt nVerts, const emInt nBdryVerts, const emInt nBdryTris,
 				m_header(nullptr), m_coords(nullptr), m_TriConn(nullptr),
 				m_QuadConn(nullptr), m_TetConn(nullptr), m_PyrConn(nullptr),
 				m_PrismConn(nullptr), m_HexConn(nullptr), m_buffer(nullptr),
-				m_fileImage(nullptr) {
+				m_fileImage(nullptr), m_mapFD(-1), m_snapshotBytes(0),
+				m_bufferBytes(0), m_isRecycled(false) {
 
 	// All sizes are computed in bytes.
 
@@ -263,8 +379,96 @@ emInt UMesh::addHex(const emInt verts[8]) {
 #endif
 }
 
+emInt UMesh::addBdryTris(const emInt verts[][3], const emInt nNew) {
+	emInt firstTriInd = m_header[eTri];
+	assert(firstTriInd + nNew <= m_nTris);
+	assert(memoryCheck(m_TriConn[firstTriInd], 3 * nNew * sizeof(emInt)));
+	std::copy(verts[0], verts[0] + 3 * nNew, m_TriConn[firstTriInd]);
+	m_header[eTri] += nNew;
+	return firstTriInd;
+}
+
+emInt UMesh::addBdryQuads(const emInt verts[][4], const emInt nNew) {
+	emInt firstQuadInd = m_header[eQuad];
+	assert(firstQuadInd + nNew <= m_nQuads);
+	assert(memoryCheck(m_QuadConn[firstQuadInd], 4 * nNew * sizeof(emInt)));
+	std::copy(verts[0], verts[0] + 4 * nNew, m_QuadConn[firstQuadInd]);
+	m_header[eQuad] += nNew;
+	return firstQuadInd;
+}
+
+emInt UMesh::addTets(const emInt verts[][4], const emInt nNew) {
+	emInt firstTetInd = m_header[eTet];
+	assert(firstTetInd + nNew <= m_nTets);
+	assert(memoryCheck(m_TetConn[firstTetInd], 4 * nNew * sizeof(emInt)));
+	std::copy(verts[0], verts[0] + 4 * nNew, m_TetConn[firstTetInd]);
+	m_header[eTet] += nNew;
+	return firstTetInd;
+}
+
+emInt UMesh::addPyramids(const emInt verts[][5], const emInt nNew) {
+	emInt firstPyrInd = m_header[ePyr];
+	assert(firstPyrInd + nNew <= m_nPyrs);
+	assert(memoryCheck(m_PyrConn[firstPyrInd], 5 * nNew * sizeof(emInt)));
+	std::copy(verts[0], verts[0] + 5 * nNew, m_PyrConn[firstPyrInd]);
+	m_header[ePyr] += nNew;
+	return firstPyrInd;
+}
+
+emInt UMesh::addPrisms(const emInt verts[][6], const emInt nNew) {
+	emInt firstPrismInd = m_header[ePrism];
+	assert(firstPrismInd + nNew <= m_nPrisms);
+	assert(memoryCheck(m_PrismConn[firstPrismInd], 6 * nNew * sizeof(emInt)));
+	std::copy(verts[0], verts[0] + 6 * nNew, m_PrismConn[firstPrismInd]);
+	m_header[ePrism] += nNew;
+	return firstPrismInd;
+}
+
+emInt UMesh::addHexes(const emInt verts[][8], const emInt nNew) {
+	emInt firstHexInd = m_header[eHex];
+	assert(firstHexInd + nNew <= m_nHexes);
+	assert(memoryCheck(m_HexConn[firstHexInd], 8 * nNew * sizeof(emInt)));
+	std::copy(verts[0], verts[0] + 8 * nNew, m_HexConn[firstHexInd]);
+	m_header[eHex] += nNew;
+	return firstHexInd;
+}
+
 UMesh::~UMesh() {
-	free(m_buffer);
+	releaseImage();
+}
+
+// What a released mesh's counts are read from.
+static emInt releasedHeader[7] = { 0, 0, 0, 0, 0, 0, 0 };
+
+void UMesh::releaseImage() {
+	if (isMapped()) {
+		munmap(m_buffer, m_fileImageSize);
+		close(m_mapFD);
+	}
+	else if (m_snapshotBytes != 0) {
+		munmap(m_buffer, m_snapshotBytes);
+	}
+	else {
+		freeReusable(m_buffer, m_bufferBytes);
+	}
+	m_nVerts = m_nBdryVerts = m_nTris = m_nQuads = 0;
+	m_nTets = m_nPyrs = m_nPrisms = m_nHexes = 0;
+	m_fileImageSize = 0;
+	m_header = releasedHeader;
+	m_coords = nullptr;
+	m_TriConn = nullptr;
+	m_QuadConn = nullptr;
+	m_TriBC = m_QuadBC = nullptr;
+	m_TetConn = nullptr;
+	m_PyrConn = nullptr;
+	m_PrismConn = nullptr;
+	m_HexConn = nullptr;
+	m_buffer = m_fileImage = nullptr;
+	m_mapFD = -1;
+	m_mapFileName.clear();
+	m_snapshotBytes = m_bufferBytes = 0;
+	delete[] m_lenScale;
+	m_lenScale = nullptr;
 }
 
 void checkConnectivitySize(const char cellType, const emInt nVerts) {
@@ -272,86 +476,190 @@ void checkConnectivitySize(const char cellType, const emInt nVerts) {
 	if (expected[int(cellType)] != nVerts) {
 		fprintf(
 				stderr,
-				"Error reading mesh file.  Cell type %d expects %u verts; found %u.\n",
+				"Error reading mesh file.  Cell type %d expects %" EMINT_FMT
+						" verts; found %" EMINT_FMT ".\n",
 				cellType, expected[int(cellType)], nVerts);
 		exit(1);
 	}
 }
 
-class vertTriple {
-	emInt corners[3];
-public:
-	vertTriple(const emInt vA, const emInt vB, const emInt vC) {
-		corners[0] = vA;
-		corners[1] = vB;
-		corners[2] = vC;
-	}
-	bool operator<(const vertTriple& that) const {
-		emInt thisTemp[3], thatTemp[3];
-		sortVerts3(corners, thisTemp);
-		sortVerts3(that.corners, thatTemp);
-		return (thisTemp[0] < thatTemp[0]
-				|| (thisTemp[0] == thatTemp[0] && thisTemp[1] < thatTemp[1])
-				|| (thisTemp[0] == thatTemp[0] && thisTemp[1] == thatTemp[1]
-						&& thisTemp[2] < thatTemp[2]));
-	}
-	const emInt* getCorners() const {
-		return corners;
-	}
-};
-
-class vertQuadruple {
-	emInt corners[4];
-public:
-	vertQuadruple(const emInt vA, const emInt vB, const emInt vC,
-			const emInt vD) {
-		corners[0] = vA;
-		corners[1] = vB;
-		corners[2] = vC;
-		corners[3] = vD;
-	}
-	bool operator<(const vertQuadruple& that) const {
-		emInt thisTemp[4], thatTemp[4];
-		sortVerts4(corners, thisTemp);
-		sortVerts4(that.corners, thatTemp);
-		return (thisTemp[0] < thatTemp[0]
-				|| (thisTemp[0] == thatTemp[0] && thisTemp[1] < thatTemp[1])
-				|| (thisTemp[0] == thatTemp[0] && thisTemp[1] == thatTemp[1]
-						&& thisTemp[2] < thatTemp[2])
-				|| (thisTemp[0] == thatTemp[0] && thisTemp[1] == thatTemp[1]
-						&& thisTemp[2] == thatTemp[2] && thisTemp[3] < thatTemp[3]));
-	}
-	const emInt* getCorners() const {
-		return corners;
-	}
-};
+namespace {
+	// Corners of each face of each cell type, in the orientation used when a
+	// missing bdry face is added.
+	const int bdryTriFaces[][3] = { { 0, 1, 2 } };
+	const int bdryQuadFaces[][4] = { { 0, 1, 2, 3 } };
+	const int tetTriFaces[][3] = { { 0, 1, 2 }, { 0, 1, 3 }, { 1, 2, 3 },
+																	{ 2, 0, 3 } };
+	const int pyrTriFaces[][3] = { { 0, 1, 4 }, { 1, 2, 4 }, { 2, 3, 4 },
+																	{ 3, 0, 4 } };
+	const int pyrQuadFaces[][4] = { { 0, 1, 2, 3 } };
+	const int prismTriFaces[][3] = { { 0, 1, 2 }, { 3, 4, 5 } };
+	const int prismQuadFaces[][4] = { { 0, 1, 4, 3 }, { 1, 2, 5, 4 },
+																		{ 2, 0, 3, 5 } };
+	const int hexQuadFaces[][4] = { { 0, 1, 2, 3 }, { 4, 5, 6, 7 },
+																	{ 0, 1, 5, 4 }, { 1, 2, 6, 5 },
+																	{ 2, 3, 7, 6 }, { 3, 0, 4, 7 } };
+
+	// The faces with N corners of a run of cells of one type.
+	struct CellFaces {
+		const emInt* conn;
+		size_t nCells;
+		int nPts;
+		const int* faces;
+		int nFaces;
+	};
+
+	template<int N>
+	struct FaceRecord {
+		emInt sorted[N];
+		emInt corners[N];
+		bool sameFace(const FaceRecord& that) const {
+			return std::equal(sorted, sorted + N, that.sorted);
+		}
+		bool operator<(const FaceRecord& that) const {
+			if (!sameFace(that)) {
+				return std::lexicographical_compare(sorted, sorted + N, that.sorted,
+																						that.sorted + N);
+			}
+			return std::lexicographical_compare(corners, corners + N,
+																					that.corners, that.corners + N);
+		}
+		uint64_t hash() const {
+			uint64_t hash = 0xcbf29ce484222325ULL;
+			for (int ii = 0; ii < N; ii++) {
+				hash = (hash ^ sorted[ii]) * 0x100000001b3ULL;
+			}
+			return hash ^ (hash >> 32);
+		}
+	};
 
-void updateTriSet(std::set<vertTriple>& triSet, const emInt v0, const emInt v1,
-		const emInt v2) {
-	vertTriple VT(v0, v1, v2);
-	typename std::set<vertTriple>::iterator vertIter, VIend = triSet.end();
+	// Face records are built in batches of at most this many bytes.
+	const size_t faceBatchBytes = size_t(1) << 31;
+}
 
-	vertIter = triSet.find(VT);
-	if (vertIter == VIend) {
-		triSet.insert(VT);
-	}
-	else {
-		triSet.erase(vertIter);
+// Call visit(record) for each face of this thread's share of the cells.
+template<int N, typename Visitor>
+static void visitFaces(const CellFaces groups[], const int nGroups,
+		const int thread, const int nThreads, Visitor& visit) {
+	FaceRecord<N> record;
+	for (int iG = 0; iG < nGroups; iG++) {
+		const CellFaces& group = groups[iG];
+		const size_t begin = group.nCells * thread / nThreads;
+		const size_t end = group.nCells * (thread + 1) / nThreads;
+		for (size_t cell = begin; cell < end; cell++) {
+			const emInt* const verts = group.conn + cell * group.nPts;
+			for (int iF = 0; iF < group.nFaces; iF++) {
+				const int* const face = group.faces + iF * N;
+				for (int ii = 0; ii < N; ii++) {
+					record.corners[ii] = record.sorted[ii] = verts[face[ii]];
+				}
+				std::sort(record.sorted, record.sorted + N);
+				visit(record);
+			}
+		}
 	}
 }
 
-void updateQuadSet(std::set<vertQuadruple>& quadSet, const emInt v0,
-		const emInt v1, const emInt v2, const emInt v3) {
-	vertQuadruple VQ(v0, v1, v2, v3);
-	typename std::set<vertQuadruple>::iterator vertIter, VQend = quadSet.end();
-
-	vertIter = quadSet.find(VQ);
-	if (vertIter == VQend) {
-		quadSet.insert(VQ);
+// Find the faces with N corners that appear an odd number of times among
+// all the cell and bdry faces (that is, once, for a valid mesh).  Each
+// thread hashes its faces into partitions; each partition is then sorted,
+// so matching faces are adjacent.  The result is sorted by face.
+template<int N>
+static std::vector<FaceRecord<N> > findUnmatchedFaces(const CellFaces groups[],
+		const int nGroups) {
+#ifdef _OPENMP
+	const int nParts = 64 * omp_get_max_threads();
+#else
+	const int nParts = 64;
+#endif
+	size_t totalFaces = 0;
+	for (int iG = 0; iG < nGroups; iG++) {
+		totalFaces += groups[iG].nCells * groups[iG].nFaces;
 	}
-	else {
-		quadSet.erase(vertIter);
+	// Huge meshes are done a range of partitions at a time, to cap memory.
+	const int nRounds = std::min(
+			size_t(nParts), 1 + totalFaces * sizeof(FaceRecord<N> ) / faceBatchBytes);
+
+	std::vector<FaceRecord<N> > unmatched, records;
+	std::vector<size_t> offsets;
+	int nThreads = 1;
+	for (int round = 0; round < nRounds; round++) {
+		const int firstPart = nParts * round / nRounds;
+		const int endPart = nParts * (round + 1) / nRounds;
+
+#pragma omp parallel
+		{
+			// The team can be smaller than asked for (nested, dynamic or
+			// limited), so the cells are split among the threads it has.
+#pragma omp single
+			{
+#ifdef _OPENMP
+				nThreads = omp_get_num_threads();
+#endif
+				offsets.assign(size_t(nThreads) * nParts, 0);
+			}
+#ifdef _OPENMP
+			const int thread = omp_get_thread_num();
+#else
+			const int thread = 0;
+#endif
+			// First count this thread's faces in each partition.
+			size_t* const myOffsets = offsets.data() + size_t(thread) * nParts;
+			auto count = [&](const FaceRecord<N>& record) {
+				const int part = record.hash() % nParts;
+				if (part >= firstPart && part < endPart) myOffsets[part]++;
+			};
+			visitFaces<N>(groups, nGroups, thread, nThreads, count);
+#pragma omp barrier
+#pragma omp single
+			{
+				// Partition by partition, then thread by thread, so that each
+				// partition is contiguous.
+				size_t total = 0;
+				for (int part = firstPart; part < endPart; part++) {
+					for (int tt = 0; tt < nThreads; tt++) {
+						size_t& offset = offsets[size_t(tt) * nParts + part];
+						const size_t num = offset;
+						offset = total;
+						total += num;
+					}
+				}
+				records.resize(total);
+			}
+			auto scatter = [&](const FaceRecord<N>& record) {
+				const int part = record.hash() % nParts;
+				if (part >= firstPart && part < endPart) {
+					records[myOffsets[part]++] = record;
+				}
+			};
+			visitFaces<N>(groups, nGroups, thread, nThreads, scatter);
+#pragma omp barrier
+
+			// Now the last thread's offsets mark the end of each partition.
+			std::vector<FaceRecord<N> > myUnmatched;
+#pragma omp for schedule(dynamic)
+			for (int part = firstPart; part < endPart; part++) {
+				const size_t* const partEnds = offsets.data()
+						+ size_t(nThreads - 1) * nParts;
+				const size_t begin = (part == firstPart) ? 0 : partEnds[part - 1];
+				const size_t end = partEnds[part];
+				std::sort(records.begin() + begin, records.begin() + end);
+				for (size_t first = begin; first < end;) {
+					size_t last = first + 1;
+					while (last < end && records[last].sameFace(records[first])) {
+						last++;
+					}
+					if ((last - first) % 2 == 1) myUnmatched.push_back(records[last - 1]);
+					first = last;
+				}
+			}
+#pragma omp critical
+			unmatched.insert(unmatched.end(), myUnmatched.begin(),
+												myUnmatched.end());
+		}
 	}
+	std::sort(unmatched.begin(), unmatched.end());
+	return unmatched;
 }
 
 UMesh::UMesh(const char baseFileName[], const char type[],
@@ -361,72 +669,59 @@ UMesh::UMesh(const char baseFileName[], const char type[],
 				m_header(nullptr), m_coords(nullptr), m_TriConn(nullptr),
 				m_QuadConn(nullptr), m_TetConn(nullptr), m_PyrConn(nullptr),
 				m_PrismConn(nullptr), m_HexConn(nullptr), m_buffer(nullptr),
-				m_fileImage(nullptr) {
-	// Use the same IO routines as the mesh analyzer code from GMGW.
-	FileWrapper* reader = FileWrapper::factory(baseFileName, type, ugridInfix);
-
-	reader->scanFile();
+				m_fileImage(nullptr), m_mapFD(-1), m_snapshotBytes(0),
+				m_bufferBytes(0), m_isRecycled(false) {
+	UGridFormat format;
+	if (strcmp(type, "ugrid") == 0 && parseUGridInfix(ugridInfix, format)) {
+		// Binary UGRID is already laid out like the file image, so it's read
+		// directly.
+		char fileName[FILE_NAME_LEN];
+		snprintf(fileName, FILE_NAME_LEN, "%s.%s.ugrid", baseFileName,
+							ugridInfix);
+		if (access(fileName, F_OK) != 0) {
+			// Try for a block-compressed version.
+			snprintf(fileName, FILE_NAME_LEN, "%s.%s.ugrid.z", baseFileName,
+								ugridInfix);
+		}
+		readUGridFile(fileName);
+	}
+	else {
+		// ASCII legacy VTK is parsed in parallel here; anything else goes
+		// through the FileWrapper readers.
+		char fileName[FILE_NAME_LEN];
+		snprintf(fileName, FILE_NAME_LEN, "%s.vtk", baseFileName);
+		if (strcmp(type, "vtk") != 0 || !readVTKFile(fileName)) {
+			readWithFileWrapper(baseFileName, type, ugridInfix);
+		}
+	}
+	addMissingBdryFaces();
 
-	// Identify any bdry tris and quads that aren't in the file
+	// Now tag all bdry verts
+	countBdryVerts();
 
-	emInt numBdryTris = reader->getNumBdryTris();
-	emInt numBdryQuads = reader->getNumBdryQuads();
+	// If any of these fail, your file was invalid.
+	assert(m_nVerts == m_header[eVert]);
+	assert(m_nTris == m_header[eTri]);
+	assert(m_nQuads == m_header[eQuad]);
+	assert(m_nTets == m_header[eTet]);
+	assert(m_nPyrs == m_header[ePyr]);
+	assert(m_nPrisms == m_header[ePrism]);
+	assert(m_nHexes == m_header[eHex]);
 
-	std::set<vertTriple> setTris;
-	std::set<vertQuadruple> setQuads;
+	setupLengthScales();
+}
 
-	reader->seekStartOfConnectivity();
-	for (emInt ii = 0; ii < reader->getNumCells(); ii++) {
-		char cellType = reader->getCellType(ii);
-		emInt nConn, connect[8];
-		reader->getNextCellConnectivity(nConn, connect);
-		checkConnectivitySize(cellType, nConn);
-		switch (cellType) {
-			case BDRY_TRI:
-				updateTriSet(setTris, connect[0], connect[1], connect[2]);
-				break;
-			case BDRY_QUAD:
-				updateQuadSet(setQuads, connect[0], connect[1], connect[2], connect[3]);
-				break;
-			case TET:
-				updateTriSet(setTris, connect[0], connect[1], connect[2]);
-				updateTriSet(setTris, connect[0], connect[1], connect[3]);
-				updateTriSet(setTris, connect[1], connect[2], connect[3]);
-				updateTriSet(setTris, connect[2], connect[0], connect[3]);
-				break;
-			case PYRAMID:
-				updateTriSet(setTris, connect[0], connect[1], connect[4]);
-				updateTriSet(setTris, connect[1], connect[2], connect[4]);
-				updateTriSet(setTris, connect[2], connect[3], connect[4]);
-				updateTriSet(setTris, connect[3], connect[0], connect[4]);
-				updateQuadSet(setQuads, connect[0], connect[1], connect[2], connect[3]);
-				break;
-			case PRISM:
-				updateTriSet(setTris, connect[0], connect[1], connect[2]);
-				updateTriSet(setTris, connect[3], connect[4], connect[5]);
-				updateQuadSet(setQuads, connect[0], connect[1], connect[4], connect[3]);
-				updateQuadSet(setQuads, connect[1], connect[2], connect[5], connect[4]);
-				updateQuadSet(setQuads, connect[2], connect[0], connect[3], connect[5]);
-				break;
-			case HEX:
-				updateQuadSet(setQuads, connect[0], connect[1], connect[2], connect[3]);
-				updateQuadSet(setQuads, connect[4], connect[5], connect[6], connect[7]);
-				updateQuadSet(setQuads, connect[0], connect[1], connect[5], connect[4]);
-				updateQuadSet(setQuads, connect[1], connect[2], connect[6], connect[5]);
-				updateQuadSet(setQuads, connect[2], connect[3], connect[7], connect[6]);
-				updateQuadSet(setQuads, connect[3], connect[0], connect[4], connect[7]);
-				break;
-			default:
-				assert(0);
-		}
-	}
+void UMesh::readWithFileWrapper(const char baseFileName[], const char type[],
+		const char ugridInfix[]) {
+	// Use the same IO routines as the mesh analyzer code from GMGW.
+	FileWrapper* reader = FileWrapper::factory(baseFileName, type, ugridInfix);
 
-	numBdryTris += setTris.size();
-	numBdryQuads += setQuads.size();
+	reader->scanFile();
 
-	init(reader->getNumVerts(), reader->getNumBdryVerts(), numBdryTris,
-				numBdryQuads, reader->getNumTets(), reader->getNumPyramids(),
-				reader->getNumPrisms(), reader->getNumHexes());
+	init(reader->getNumVerts(), reader->getNumBdryVerts(),
+				reader->getNumBdryTris(), reader->getNumBdryQuads(),
+				reader->getNumTets(), reader->getNumPyramids(), reader->getNumPrisms(),
+				reader->getNumHexes());
 
 	reader->seekStartOfCoords();
 	for (emInt ii = 0; ii < m_nVerts; ii++) {
@@ -438,9 +733,12 @@ UMesh::UMesh(const char baseFileName[], const char type[],
 	reader->seekStartOfConnectivity();
 	for (emInt ii = 0; ii < reader->getNumCells(); ii++) {
 		char cellType = reader->getCellType(ii);
-		emInt nConn, connect[8];
-		reader->getNextCellConnectivity(nConn, connect);
+		// The reader's indices are always 32-bit.
+		unsigned nConn, readConn[8];
+		reader->getNextCellConnectivity(nConn, readConn);
 		checkConnectivitySize(cellType, nConn);
+		emInt connect[8];
+		std::copy(readConn, readConn + std::min(nConn, 8u), connect);
 		switch (cellType) {
 			case BDRY_TRI:
 				addBdryTri(connect);
@@ -465,16 +763,76 @@ UMesh::UMesh(const char baseFileName[], const char type[],
 		}
 	}
 
-	for (auto VT : setTris) {
-		const emInt* const corners = VT.getCorners();
-		addBdryTri(corners);
+	delete reader;
+}
+
+void UMesh::addMissingBdryFaces() {
+	const CellFaces triGroups[] = {
+			{ reinterpret_cast<const emInt*>(m_TriConn),
+				m_header[eTri], 3, bdryTriFaces[0], 1 },
+			{ reinterpret_cast<const emInt*>(m_TetConn),
+				m_header[eTet], 4, tetTriFaces[0], 4 },
+			{ reinterpret_cast<const emInt*>(m_PyrConn),
+				m_header[ePyr], 5, pyrTriFaces[0], 4 },
+			{ reinterpret_cast<const emInt*>(m_PrismConn),
+				m_header[ePrism], 6, prismTriFaces[0], 2 } };
+	const CellFaces quadGroups[] = {
+			{ reinterpret_cast<const emInt*>(m_QuadConn),
+				m_header[eQuad], 4, bdryQuadFaces[0], 1 },
+			{ reinterpret_cast<const emInt*>(m_PyrConn),
+				m_header[ePyr], 5, pyrQuadFaces[0], 1 },
+			{ reinterpret_cast<const emInt*>(m_PrismConn),
+				m_header[ePrism], 6, prismQuadFaces[0], 3 },
+			{ reinterpret_cast<const emInt*>(m_HexConn),
+				m_header[eHex], 8, hexQuadFaces[0], 6 } };
+	const std::vector<FaceRecord<3> > newTris = findUnmatchedFaces<3>(triGroups,
+																																		4);
+	const std::vector<FaceRecord<4> > newQuads = findUnmatchedFaces<4>(
+			quadGroups, 4);
+	if (newTris.empty() && newQuads.empty()) return;
+
+	// Move everything into a file image with room for the new faces.
+	assert(!isMapped());
+	char* const oldBuffer = m_buffer;
+	const size_t oldBufferBytes = m_bufferBytes;
+	const imageDouble (*const oldCoords)[3] = m_coords;
+	const emInt (*const oldTriConn)[3] = m_TriConn;
+	const emInt (*const oldQuadConn)[4] = m_QuadConn;
+	const emInt* const oldTriBC = m_TriBC;
+	const emInt* const oldQuadBC = m_QuadBC;
+	const emInt (*const oldTetConn)[4] = m_TetConn;
+	const emInt nTris = m_nTris, nQuads = m_nQuads;
+	delete[] m_lenScale;
+	init(m_nVerts, 0, nTris + newTris.size(), nQuads + newQuads.size(), m_nTets,
+				m_nPyrs, m_nPrisms, m_nHexes);
+	memcpy(m_coords, oldCoords, 3 * sizeof(double) * m_nVerts);
+	memcpy(m_TriConn, oldTriConn, 3 * sizeof(emInt) * nTris);
+	memcpy(m_QuadConn, oldQuadConn, 4 * sizeof(emInt) * nQuads);
+	memcpy(m_TriBC, oldTriBC, sizeof(emInt) * nTris);
+	memcpy(m_QuadBC, oldQuadBC, sizeof(emInt) * nQuads);
+	// The cells are contiguous in both images.
+	memcpy(m_TetConn, oldTetConn,
+					sizeof(emInt)
+							* (4 * size_t(m_nTets) + 5 * size_t(m_nPyrs)
+									+ 6 * size_t(m_nPrisms) + 8 * size_t(m_nHexes)));
+	freeReusable(oldBuffer, oldBufferBytes);
+
+	m_header[eVert] = m_nVerts;
+	m_header[eTri] = nTris;
+	m_header[eQuad] = nQuads;
+	m_header[eTet] = m_nTets;
+	m_header[ePyr] = m_nPyrs;
+	m_header[ePrism] = m_nPrisms;
+	m_header[eHex] = m_nHexes;
+	for (const FaceRecord<3>& tri : newTris) {
+		addBdryTri(tri.corners);
 	}
-	for (auto VQ : setQuads) {
-		const emInt* const corners = VQ.getCorners();
-		addBdryQuad(corners);
+	for (const FaceRecord<4>& quad : newQuads) {
+		addBdryQuad(quad.corners);
 	}
+}
 
-	// Now tag all bdry verts
+void UMesh::countBdryVerts() {
 	bool *isBdryVert = new bool[m_nVerts];
 	for (emInt ii = 0; ii < m_nVerts; ii++) {
 		isBdryVert[ii] = false;
@@ -497,62 +855,659 @@ UMesh::UMesh(const char baseFileName[], const char type[],
 		}
 	}
 	delete[] isBdryVert;
+}
 
-	// If any of these fail, your file was invalid.
-	assert(m_nVerts == m_header[eVert]);
-	assert(m_nTris == m_header[eTri]);
-	assert(m_nQuads == m_header[eQuad]);
-	assert(m_nTets == m_header[eTet]);
-	assert(m_nPyrs == m_header[ePyr]);
-	assert(m_nPrisms == m_header[ePrism]);
-	assert(m_nHexes == m_header[eHex]);
+UMesh::UMesh(const char ugridFileName[]) :
+		m_nVerts(0), m_nBdryVerts(0), m_nTris(0), m_nQuads(0), m_nTets(0),
+				m_nPyrs(0), m_nPrisms(0), m_nHexes(0), m_fileImageSize(0),
+				m_header(nullptr), m_coords(nullptr), m_TriConn(nullptr),
+				m_QuadConn(nullptr), m_TetConn(nullptr), m_PyrConn(nullptr),
+				m_PrismConn(nullptr), m_HexConn(nullptr), m_buffer(nullptr),
+				m_fileImage(nullptr), m_mapFD(-1), m_snapshotBytes(0),
+				m_bufferBytes(0), m_isRecycled(false) {
+	const size_t len = strlen(ugridFileName);
+	if (len >= 6 && strcmp(ugridFileName + len - 6, ".pmesh") == 0) {
+		readPackedMeshFile(ugridFileName);
+	}
+	else {
+		readUGridFile(ugridFileName);
+	}
+	countBdryVerts();
+	setupLengthScales();
+}
 
-	delete reader;
+// Map a whole file read-only, for parsing front to back.  The mapping
+// outlives the descriptor, so that's closed right away.
+static const char* mapForReading(const char fileName[], size_t& fileSize) {
+	int fd = open(fileName, O_RDONLY);
+	struct stat fileStat;
+	if (fd < 0 || fstat(fd, &fileStat) != 0) {
+		fprintf(stderr, "Couldn't open file %s for reading.  Bummer!\n",
+						fileName);
+		exit(1);
+	}
+	fileSize = fileStat.st_size;
+	if (fileSize == 0) {
+		fprintf(stderr, "File %s is empty.\n", fileName);
+		exit(1);
+	}
+	void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapped == MAP_FAILED) {
+		fprintf(stderr, "Couldn't map file %s.\n", fileName);
+		exit(1);
+	}
+	madvise(mapped, fileSize, MADV_SEQUENTIAL);
+	return reinterpret_cast<const char*>(mapped);
+}
 
-	setupLengthScales();
+// A Fortran record marker, which is in the file's byte order.
+static uint32_t recordMarker(const char* data, const UGridFormat& format) {
+	uint32_t marker;
+	memcpy(&marker, data, 4);
+	if (format.needsByteSwap()) swapBytes4(&marker, 1);
+	return marker;
 }
 
-UMesh::UMesh(const UMesh& UMIn, const int nDivs) :
+void UMesh::readUGridFile(const char ugridFileName[]) {
+	double timeBefore = exaTime();
+	UGridFormat format;
+	if (!ugridFormatFromFileName(ugridFileName, format)) {
+		fprintf(stderr, "Can't tell the UGRID variant of %s from its name.\n",
+						ugridFileName);
+		exit(1);
+	}
+	size_t fileSize;
+	const char* const image = mapForReading(ugridFileName, fileSize);
+	// Block-compressed files are read as if they'd been decompressed, but
+	// each piece is only decompressed when it's needed.
+	const bool isCompressed = isBlockCompressedFileName(ugridFileName);
+	size_t dataSize = fileSize;
+	if (isCompressed && !blockCompressedDataSize(image, fileSize, dataSize)) {
+		fprintf(stderr, "%s isn't a block-compressed file.\n", ugridFileName);
+		exit(1);
+	}
+	auto readBytes = [&](size_t offset, size_t bytes, char* dst) {
+		if (isCompressed) {
+			return readBlockCompressedRange(image, fileSize, offset, bytes, dst);
+		}
+		memcpy(dst, image + offset, bytes);
+		return true;
+	};
+	auto markerAt = [&](size_t offset) {
+		char marker[4] = { };
+		readBytes(offset, 4, marker);
+		return recordMarker(marker, format);
+	};
+	const size_t markerBytes = format.isFortran ? 4 : 0;
+	const size_t headerBytes = 7 * format.intBytes();
+	if (dataSize < headerBytes + 4 * markerBytes) {
+		fprintf(stderr, "File %s is too short to be a UGRID file.\n",
+						ugridFileName);
+		exit(1);
+	}
+
+	uint64_t headerIn[7];
+	emInt counts[7];
+	bool ok = readBytes(markerBytes, headerBytes,
+											reinterpret_cast<char*>(headerIn))
+			&& decodeUGridInts(reinterpret_cast<char*>(headerIn), 7, 0, false,
+													format, counts);
+
+	// Check that the file is as big as the header says, and that Fortran
+	// record markers agree.
+	const size_t dataStart = headerBytes + 3 * markerBytes;
+	const size_t dataBytes = 3 * size_t(counts[eVert]) * format.realBytes()
+			+ format.intBytes()
+					* (4 * size_t(counts[eTri]) + 5 * size_t(counts[eQuad])
+							+ 4 * size_t(counts[eTet]) + 5 * size_t(counts[ePyr])
+							+ 6 * size_t(counts[ePrism]) + 8 * size_t(counts[eHex]));
+	ok = ok && dataSize >= dataStart + dataBytes + markerBytes;
+	if (ok && format.isFortran) {
+		ok = markerAt(0) == headerBytes
+				&& markerAt(markerBytes + headerBytes) == headerBytes;
+		// Records too big for one marker are split into subrecords, which
+		// aren't checked.
+		if (dataBytes <= INT32_MAX) {
+			ok = ok && markerAt(dataStart - markerBytes) == dataBytes
+					&& markerAt(dataStart + dataBytes) == dataBytes;
+		}
+	}
+	if (!ok) {
+		fprintf(stderr, "The header of %s doesn't match the file.\n",
+						ugridFileName);
+		exit(1);
+	}
+
+	// Bdry verts are counted once the bdry faces are in.
+	init(counts[eVert], 0, counts[eTri], counts[eQuad], counts[eTet],
+				counts[ePyr], counts[ePrism], counts[eHex]);
+
+	// Same order as in the file, and as in the file image.
+	struct Section {
+		char* dst;
+		size_t count;
+		bool isReal;
+		int inc;
+		bool pyrSwap;
+		size_t fileOffset;
+	} sections[] = {
+			{ reinterpret_cast<char*>(m_coords), 3 * size_t(m_nVerts), true, 0,
+				false, 0 },
+			{ reinterpret_cast<char*>(m_TriConn), 3 * size_t(m_nTris)
+					+ 4 * size_t(m_nQuads),
+				false, -1, false, 0 },
+			{ reinterpret_cast<char*>(m_TriBC), size_t(m_nTris) + m_nQuads, false, 0,
+				false, 0 },
+			{ reinterpret_cast<char*>(m_TetConn), 4 * size_t(m_nTets), false, -1,
+				false, 0 },
+			{ reinterpret_cast<char*>(m_PyrConn), 5 * size_t(m_nPyrs), false, -1,
+				true, 0 },
+			{ reinterpret_cast<char*>(m_PrismConn), 6 * size_t(m_nPrisms)
+					+ 8 * size_t(m_nHexes),
+				false, -1, false, 0 } };
+	const int nSecs = sizeof(sections) / sizeof(sections[0]);
+	size_t offset = dataStart;
+	for (Section& sec : sections) {
+		sec.fileOffset = offset;
+		offset += sec.count * (sec.isReal ? format.realBytes() : format.intBytes());
+	}
+
+	// A whole number of cells of every type, so pyramids never straddle
+	// chunks.
+	const size_t chunkCount = 120 * 8192;
+	std::vector<std::pair<int, size_t> > chunks;
+	for (int iSec = 0; iSec < nSecs; iSec++) {
+		for (size_t first = 0; first < sections[iSec].count; first +=
+				chunkCount) {
+			chunks.push_back(std::make_pair(iSec, first));
+		}
+	}
+
+#pragma omp parallel reduction(&&: ok)
+	{
+		std::vector<uint64_t> staging(chunkCount);
+#pragma omp for schedule(dynamic)
+		for (size_t ii = 0; ii < chunks.size(); ii++) {
+			const Section& sec = sections[chunks[ii].first];
+			const size_t first = chunks[ii].second;
+			const size_t count = std::min(chunkCount, sec.count - first);
+			const size_t elemBytes =
+					sec.isReal ? format.realBytes() : format.intBytes();
+			const size_t srcOffset = sec.fileOffset + first * elemBytes;
+			const char* const src = image + srcOffset;
+			// Decoding only writes to its input to change byte order, and
+			// integers have to be aligned; otherwise, decode straight from the
+			// mapped file.
+			char* in = const_cast<char*>(src);
+			if (isCompressed || format.needsByteSwap()
+					|| (!sec.isReal && reinterpret_cast<uintptr_t>(src) % elemBytes)) {
+				in = reinterpret_cast<char*>(staging.data());
+				ok = readBytes(srcOffset, count * elemBytes, in) && ok;
+			}
+			if (sec.isReal) {
+				decodeUGridReals(in, count, format, sec.dst + first * 8);
+			}
+			else {
+				ok = decodeUGridInts(in, count, sec.inc, sec.pyrSwap, format,
+															reinterpret_cast<emInt*>(sec.dst) + first)
+						&& ok;
+			}
+		}
+	}
+	munmap(const_cast<char*>(image), fileSize);
+	if (!ok) {
+		fprintf(stderr, "%s is corrupt, or has an index too big for this "
+						"build.\n",
+						ugridFileName);
+		exit(1);
+	}
+
+	m_header[eVert] = m_nVerts;
+	m_header[eTri] = m_nTris;
+	m_header[eQuad] = m_nQuads;
+	m_header[eTet] = m_nTets;
+	m_header[ePyr] = m_nPyrs;
+	m_header[ePrism] = m_nPrisms;
+	m_header[eHex] = m_nHexes;
+
+	double elapsed = exaTime() - timeBefore;
+	fprintf(stderr, "CPU time for UGRID file read = %5.2F seconds\n", elapsed);
+	fprintf(stderr, "                          %5.2F MB / second\n",
+					(fileSize / 1.e6) / elapsed);
+}
+
+bool UMesh::readVTKFile(const char vtkFileName[]) {
+	double timeBefore = exaTime();
+	size_t fileSize;
+	const char* const text = mapForReading(vtkFileName, fileSize);
+	const char* const textEnd = text + fileSize;
+
+	// The first three lines are the version, a title, and the file type.
+	const char* lineStarts[4] = { text };
+	for (int line = 0; line < 3 && lineStarts[line]; line++) {
+		const char* cp = reinterpret_cast<const char*>(memchr(lineStarts[line],
+				'\n', textEnd - lineStarts[line]));
+		lineStarts[line + 1] = cp ? cp + 1 : nullptr;
+	}
+	if (!lineStarts[3] || strncmp(text, "# vtk DataFile", 14) != 0
+			|| strncmp(lineStarts[2], "ASCII", 5) != 0) {
+		munmap(const_cast<char*>(text), fileSize);
+		return false;
+	}
+	const size_t headerEnd = lineStarts[3] - text;
+
+	// Each section runs from the end of its keyword line to the start of
+	// the next keyword line.
+	const std::vector<size_t> keywordLines = findVTKKeywordLines(text, fileSize);
+	enum {
+		ePoints, eCells, eOffsets, eConnectivity, eCellTypes, eNumSections
+	};
+	const char* keywords[] = { "POINTS ", "CELLS ", "OFFSETS ", "CONNECTIVITY ",
+															"CELL_TYPES " };
+	const char* sectionStart[eNumSections] = { };
+	const char* sectionEnd[eNumSections] = { };
+	size_t sizes[eNumSections][2] = { };
+	bool isUnstructured = false;
+	for (size_t ii = 0; ii < keywordLines.size(); ii++) {
+		if (keywordLines[ii] < headerEnd) continue;
+		const char* const line = text + keywordLines[ii];
+		const char* const lineEnd = reinterpret_cast<const char*>(memchr(
+				line, '\n', textEnd - line));
+		const char* const next =
+				(ii + 1 < keywordLines.size()) ? text + keywordLines[ii + 1] : textEnd;
+		if (strncmp(line, "DATASET UNSTRUCTURED_GRID", 25) == 0) {
+			isUnstructured = true;
+		}
+		for (int iS = 0; lineEnd && iS < eNumSections; iS++) {
+			if (strncmp(line, keywords[iS], strlen(keywords[iS])) == 0) {
+				char lineCopy[200];
+				snprintf(lineCopy, sizeof(lineCopy), "%.*s", int(lineEnd - line),
+									line);
+				sscanf(lineCopy + strlen(keywords[iS]), "%zu %zu", &sizes[iS][0],
+								&sizes[iS][1]);
+				sectionStart[iS] = lineEnd + 1;
+				sectionEnd[iS] = next;
+			}
+		}
+	}
+	// Legacy files through version 4 have sizes and connectivity interleaved
+	// under CELLS; version 5 files have separate offsets and connectivity,
+	// with their lengths on the CELLS line.
+	const bool isSplit = (sectionStart[eOffsets] != nullptr);
+	if (!isUnstructured || !sectionStart[ePoints] || !sectionStart[eCells]
+			|| !sectionStart[eCellTypes]
+			|| (isSplit && !sectionStart[eConnectivity])) {
+		fprintf(stderr, "%s isn't a legacy VTK unstructured grid.\n",
+						vtkFileName);
+		exit(1);
+	}
+
+	const size_t nVerts = sizes[ePoints][0];
+	const size_t nCells = sizes[eCellTypes][0];
+	std::vector<emInt> cellTypes(nCells);
+	bool ok = nVerts <= EMINT_MAX
+			&& parseVTKInts(sectionStart[eCellTypes], sectionEnd[eCellTypes],
+											nCells, cellTypes.data());
+
+	// Verts per cell for each VTK cell type we handle; 0 for the rest.
+	const int vtkTypeVerts[] = { 0, 0, 0, 0, 0, 3, 0, 0, 0, 4, 4, 0, 8, 6, 5 };
+	const int nVTKTypes = sizeof(vtkTypeVerts) / sizeof(vtkTypeVerts[0]);
+	size_t typeCounts[nVTKTypes] = { };
+#pragma omp parallel for reduction(+: typeCounts[:nVTKTypes]) reduction(&&: ok)
+	for (size_t ii = 0; ii < nCells; ii++) {
+		const emInt type = cellTypes[ii];
+		ok = ok && type < emInt(nVTKTypes) && vtkTypeVerts[type] != 0;
+		if (type < emInt(nVTKTypes)) typeCounts[type]++;
+	}
+	if (!ok) {
+		fprintf(stderr, "Bad cell types in %s; only tris, quads, tets, "
+						"pyramids, prisms and hexes are allowed.\n",
+						vtkFileName);
+		exit(1);
+	}
+
+	init(nVerts, 0, typeCounts[VTK_TRI], typeCounts[VTK_QUAD],
+				typeCounts[VTK_TET], typeCounts[VTK_PYR], typeCounts[VTK_PRISM],
+				typeCounts[VTK_HEX]);
+	ok = parseVTKReals(sectionStart[ePoints], sectionEnd[ePoints], 3 * nVerts,
+											m_coords);
+
+	// Where each cell's verts start in conn.
+	std::vector<emInt> conn;
+	std::vector<size_t> cellStarts(nCells + 1);
+	if (isSplit) {
+		conn.resize(sizes[eCells][1]);
+		std::vector<emInt> offsets(nCells + 1);
+		ok = ok && sizes[eCells][0] == nCells + 1
+				&& parseVTKInts(sectionStart[eOffsets], sectionEnd[eOffsets],
+												nCells + 1, offsets.data())
+				&& parseVTKInts(sectionStart[eConnectivity],
+												sectionEnd[eConnectivity], conn.size(), conn.data());
+		std::copy(offsets.begin(), offsets.end(), cellStarts.begin());
+	}
+	else {
+		conn.resize(sizes[eCells][1]);
+		ok = ok && sizes[eCells][0] == nCells
+				&& parseVTKInts(sectionStart[eCells], sectionEnd[eCells], conn.size(),
+												conn.data());
+	}
+	if (!ok) {
+		fprintf(stderr, "Couldn't parse the points or cells of %s.\n",
+						vtkFileName);
+		exit(1);
+	}
+
+	// Now each thread copies a contiguous range of cells into place.  First
+	// find where each range's cells of each type go and, if the sizes are
+	// interleaved with the connectivity, where its first cell starts.
+#ifdef _OPENMP
+	const int nRanges = omp_get_max_threads();
+#else
+	const int nRanges = 1;
+#endif
+	std::vector<size_t> rangeCounts((nRanges + 1) * nVTKTypes, 0);
+	std::vector<size_t> rangeStarts(nRanges + 1, 0);
+#pragma omp parallel for schedule(static)
+	for (int iR = 0; iR < nRanges; iR++) {
+		size_t* const counts = &rangeCounts[(iR + 1) * nVTKTypes];
+		for (size_t ii = nCells * iR / nRanges; ii < nCells * (iR + 1) / nRanges;
+				ii++) {
+			counts[cellTypes[ii]]++;
+			rangeStarts[iR + 1] += vtkTypeVerts[cellTypes[ii]] + 1;
+		}
+	}
+	for (int iR = 0; iR < nRanges; iR++) {
+		for (int type = 0; type < nVTKTypes; type++) {
+			rangeCounts[(iR + 1) * nVTKTypes + type] += rangeCounts[iR * nVTKTypes
+					+ type];
+		}
+		rangeStarts[iR + 1] += rangeStarts[iR];
+	}
+	if (!isSplit && rangeStarts[nRanges] != conn.size()) {
+		fprintf(stderr, "The cell sizes in %s don't match the CELLS line.\n",
+						vtkFileName);
+		exit(1);
+	}
+
+	emInt* typeConn[nVTKTypes] = { };
+	typeConn[VTK_TRI] = m_TriConn[0];
+	typeConn[VTK_QUAD] = m_QuadConn[0];
+	typeConn[VTK_TET] = m_TetConn[0];
+	typeConn[VTK_PYR] = m_PyrConn[0];
+	typeConn[VTK_PRISM] = m_PrismConn[0];
+	typeConn[VTK_HEX] = m_HexConn[0];
+#pragma omp parallel for schedule(static) reduction(&&: ok)
+	for (int iR = 0; iR < nRanges; iR++) {
+		size_t counts[nVTKTypes];
+		std::copy(&rangeCounts[iR * nVTKTypes], &rangeCounts[(iR + 1) * nVTKTypes],
+							counts);
+		size_t start = rangeStarts[iR];
+		const size_t end = nCells * (iR + 1) / nRanges;
+		for (size_t ii = nCells * iR / nRanges; ok && ii < end; ii++) {
+			const emInt type = cellTypes[ii];
+			const int nPts = vtkTypeVerts[type];
+			if (isSplit) {
+				start = cellStarts[ii];
+				ok = (cellStarts[ii + 1] - start == size_t(nPts))
+						&& cellStarts[ii + 1] <= conn.size();
+			}
+			else {
+				ok = (conn[start] == emInt(nPts));
+				start++;
+			}
+			emInt* const dst = typeConn[type] + counts[type]++ * nPts;
+			for (int jj = 0; ok && jj < nPts; jj++) {
+				dst[jj] = conn[start + jj];
+				ok = (dst[jj] < nVerts);
+			}
+			start += nPts;
+		}
+	}
+	munmap(const_cast<char*>(text), fileSize);
+	if (!ok) {
+		fprintf(stderr, "Bad cell connectivity in %s.\n", vtkFileName);
+		exit(1);
+	}
+
+	m_header[eVert] = m_nVerts;
+	m_header[eTri] = m_nTris;
+	m_header[eQuad] = m_nQuads;
+	m_header[eTet] = m_nTets;
+	m_header[ePyr] = m_nPyrs;
+	m_header[ePrism] = m_nPrisms;
+	m_header[eHex] = m_nHexes;
+
+	double elapsed = exaTime() - timeBefore;
+	fprintf(stderr, "CPU time for VTK file read = %5.2F seconds\n", elapsed);
+	fprintf(stderr, "                          %5.2F MB / second\n",
+					(fileSize / 1.e6) / elapsed);
+	return true;
+}
+
+// A packed mesh file is this header, then its sections, each starting on an
+// 8-byte boundary: coordinates, packed bdry tri and quad connectivity, the
+// bdry conditions for tris and quads, and packed tet, pyramid, prism and
+// hex connectivity.  Like the packed data, it's in native byte order.
+struct PackedMeshHeader {
+	enum {
+		eCoords = 0, eTris, eQuads, eBCs, eTets, ePyrs, ePrisms, eHexes, nSections
+	};
+	char magic[8];
+	uint32_t version, byteOrder, intBytes, padding;
+	// The seven UGRID counts, and then the number of bdry verts.
+	uint64_t counts[8];
+	uint64_t sectionBytes[nSections];
+};
+static const char packedMeshMagic[8] = "ExaPMsh";
+
+static size_t packedSectionStart(const PackedMeshHeader& header,
+		const int iSec) {
+	size_t offset = sizeof(header);
+	for (int ii = 0; ii < iSec; ii++) {
+		offset += (header.sectionBytes[ii] + 7) & ~size_t(7);
+	}
+	return offset;
+}
+
+void UMesh::readPackedMeshFile(const char fileName[]) {
+	double timeBefore = exaTime();
+	size_t fileSize;
+	const char* const image = mapForReading(fileName, fileSize);
+	PackedMeshHeader header;
+	bool ok = fileSize >= sizeof(header);
+	if (ok) {
+		memcpy(&header, image, sizeof(header));
+		ok = memcmp(header.magic, packedMeshMagic, 8) == 0 && header.version == 1
+				&& header.byteOrder == 0x01020304 && header.intBytes == sizeof(emInt)
+				&& packedSectionStart(header, PackedMeshHeader::nSections)
+						<= fileSize;
+		for (int ii = 0; ii < 8; ii++) {
+			ok = ok && header.counts[ii] <= EMINT_MAX;
+		}
+	}
+	if (!ok) {
+		fprintf(stderr, "%s isn't a packed mesh file for this build.\n",
+						fileName);
+		exit(1);
+	}
+
+	init(header.counts[eVert], header.counts[eHex + 1], header.counts[eTri],
+				header.counts[eQuad], header.counts[eTet], header.counts[ePyr],
+				header.counts[ePrism], header.counts[eHex]);
+	const char* sections[PackedMeshHeader::nSections];
+	for (int ii = 0; ii < PackedMeshHeader::nSections; ii++) {
+		sections[ii] = image + packedSectionStart(header, ii);
+	}
+
+	// Raw sections are copied as is.
+	const size_t coordBytes = 3 * sizeof(double) * size_t(m_nVerts);
+	const size_t bcBytes = sizeof(emInt) * (size_t(m_nTris) + m_nQuads);
+	ok = header.sectionBytes[PackedMeshHeader::eCoords] == coordBytes
+			&& header.sectionBytes[PackedMeshHeader::eBCs] == bcBytes;
+	if (ok) {
+		memcpy(m_coords, sections[PackedMeshHeader::eCoords], coordBytes);
+		memcpy(m_TriBC, sections[PackedMeshHeader::eBCs], bcBytes);
+	}
+
+	// The rest are unpacked, each in parallel.
+	struct {
+		int iSec;
+		emInt* conn;
+		emInt count;
+		int nPts;
+	} packedSecs[] = {
+			{ PackedMeshHeader::eTris, m_TriConn[0], m_nTris, 3 },
+			{ PackedMeshHeader::eQuads, m_QuadConn[0], m_nQuads, 4 },
+			{ PackedMeshHeader::eTets, m_TetConn[0], m_nTets, 4 },
+			{ PackedMeshHeader::ePyrs, m_PyrConn[0], m_nPyrs, 5 },
+			{ PackedMeshHeader::ePrisms, m_PrismConn[0], m_nPrisms, 6 },
+			{ PackedMeshHeader::eHexes, m_HexConn[0], m_nHexes, 8 } };
+	for (auto& sec : packedSecs) {
+		size_t nCells;
+		int nPts;
+		ok = ok && packedConnectivitySize(sections[sec.iSec],
+																			header.sectionBytes[sec.iSec], nCells,
+																			nPts)
+				&& nCells == sec.count && nPts == sec.nPts
+				&& unpackConnectivity(sections[sec.iSec], 0, nCells, sec.conn);
+	}
+	munmap(const_cast<char*>(image), fileSize);
+	if (!ok) {
+		fprintf(stderr, "%s is corrupt.\n", fileName);
+		exit(1);
+	}
+
+	m_header[eVert] = m_nVerts;
+	m_header[eTri] = m_nTris;
+	m_header[eQuad] = m_nQuads;
+	m_header[eTet] = m_nTets;
+	m_header[ePyr] = m_nPyrs;
+	m_header[ePrism] = m_nPrisms;
+	m_header[eHex] = m_nHexes;
+
+	double elapsed = exaTime() - timeBefore;
+	fprintf(stderr, "CPU time for packed mesh file read = %5.2F seconds\n",
+					elapsed);
+	fprintf(stderr, "                          %5.2F MB / second\n",
+					(fileSize / 1.e6) / elapsed);
+}
+
+UMesh::UMesh(const Snapshot& snap) :
 		m_nVerts(0), m_nBdryVerts(0), m_nTris(0), m_nQuads(0), m_nTets(0),
 				m_nPyrs(0), m_nPrisms(0), m_nHexes(0), m_fileImageSize(0),
 				m_header(nullptr), m_coords(nullptr), m_TriConn(nullptr),
 				m_QuadConn(nullptr), m_TetConn(nullptr), m_PyrConn(nullptr),
 				m_PrismConn(nullptr), m_HexConn(nullptr), m_buffer(nullptr),
-				m_fileImage(nullptr) {
+				m_fileImage(nullptr), m_mapFD(-1), m_snapshotBytes(0),
+				m_bufferBytes(0), m_isRecycled(false) {
+	double timeBefore = exaTime();
+	if (snap.meshType() != eSnapshotUMesh) {
+		fprintf(stderr, "Snapshot %s doesn't hold a linear mesh.\n",
+						snap.fileName());
+		exit(1);
+	}
+	m_nVerts = snap.count(eVert);
+	m_nTris = snap.count(eTri);
+	m_nQuads = snap.count(eQuad);
+	m_nTets = snap.count(eTet);
+	m_nPyrs = snap.count(ePyr);
+	m_nPrisms = snap.count(ePrism);
+	m_nHexes = snap.count(eHex);
+	m_nBdryVerts = snap.count(eHex + 1);
+
+	// The file image is used right where it's mapped.
+	size_t skew;
+	m_fileImageSize = snap.blockBytes(eSnapMeshBlocks);
+	m_buffer = snap.mapBlock(eSnapMeshBlocks, m_snapshotBytes, skew);
+	if (!m_buffer) {
+		fprintf(stderr, "Couldn't map snapshot %s.\n", snap.fileName());
+		exit(1);
+	}
+	m_fileImage = m_buffer + skew;
+	setImagePointers();
+	if (reinterpret_cast<char*>(m_HexConn + m_nHexes)
+			!= m_fileImage + m_fileImageSize) {
+		fprintf(stderr, "Snapshot %s has the wrong size of file image.\n",
+						snap.fileName());
+		exit(1);
+	}
+
+	m_lenScale = new double[m_nVerts];
+	const size_t lenScaleBytes = snap.blockBytes(eSnapLenScale);
+	if (lenScaleBytes == numVerts() * sizeof(double)) {
+		snap.readBlock(eSnapLenScale, m_lenScale);
+	}
+	else {
+		setupLengthScales();
+	}
+	double elapsed = exaTime() - timeBefore;
+	fprintf(stderr, "CPU time for snapshot read = %5.2F seconds\n", elapsed);
+}
+
+int UMesh::getSnapshotBlocks(SnapshotHeader& header,
+		SnapshotBlock blocks[]) const {
+	header.meshType = eSnapshotUMesh;
+	header.counts[eVert] = m_nVerts;
+	header.counts[eTri] = m_nTris;
+	header.counts[eQuad] = m_nQuads;
+	header.counts[eTet] = m_nTets;
+	header.counts[ePyr] = m_nPyrs;
+	header.counts[ePrism] = m_nPrisms;
+	header.counts[eHex] = m_nHexes;
+	header.counts[eHex + 1] = m_nBdryVerts;
+	// Skewed the same way as in memory, so that the coordinates are 8-byte
+	// aligned when mapped.
+	blocks[0].data = m_fileImage;
+	blocks[0].bytes = m_fileImageSize;
+	blocks[0].skew = (sizeof(emInt) == 4) ? 4 : 0;
+	return 1;
+}
+
+UMesh::UMesh(const UMesh& UMIn, const int nDivs, const char mapFileName[],
+		BdryFaceLattices* lattices) :
+		m_nVerts(0), m_nBdryVerts(0), m_nTris(0), m_nQuads(0), m_nTets(0),
+				m_nPyrs(0), m_nPrisms(0), m_nHexes(0), m_fileImageSize(0),
+				m_header(nullptr), m_coords(nullptr), m_TriConn(nullptr),
+				m_QuadConn(nullptr), m_TetConn(nullptr), m_PyrConn(nullptr),
+				m_PrismConn(nullptr), m_HexConn(nullptr), m_buffer(nullptr),
+				m_fileImage(nullptr), m_mapFD(-1), m_snapshotBytes(0),
+				m_bufferBytes(0), m_isRecycled(false) {
 
 	setlocale(LC_ALL, "");
 	size_t totalInputCells = size_t(UMIn.m_nTets) + UMIn.m_nPyrs + UMIn.m_nPrisms
 											+ UMIn.m_nHexes;
 	fprintf(
 			stderr,
-			"Initial mesh has:\n %'15u verts,\n %'15u bdry tris,\n %'15u bdry quads,\n %'15u tets,\n %'15u pyramids,\n %'15u prisms,\n %'15u hexes,\n%'15lu cells total\n",
-			UMIn.m_nVerts, UMIn.m_nTris, UMIn.m_nQuads, UMIn.m_nTets, UMIn.m_nPyrs,
-			UMIn.m_nPrisms, UMIn.m_nHexes, totalInputCells);
+			"Initial mesh has:\n %'15lu verts,\n %'15lu bdry tris,\n %'15lu bdry quads,\n %'15lu tets,\n %'15lu pyramids,\n %'15lu prisms,\n %'15lu hexes,\n%'15lu cells total\n",
+			size_t(UMIn.m_nVerts), size_t(UMIn.m_nTris), size_t(UMIn.m_nQuads),
+			size_t(UMIn.m_nTets), size_t(UMIn.m_nPyrs), size_t(UMIn.m_nPrisms),
+			size_t(UMIn.m_nHexes), totalInputCells);
 
 	MeshSize MSOut = UMIn.computeFineMeshSize(nDivs);
 	init(MSOut.nVerts, MSOut.nBdryVerts, MSOut.nBdryTris, MSOut.nBdryQuads,
-				MSOut.nTets, MSOut.nPyrs, MSOut.nPrisms, MSOut.nHexes);
-	// Copy length scale data from the other mesh.
-	for (emInt vv = 0; vv < UMIn.m_nVerts; vv++) {
-		m_lenScale[vv] = UMIn.m_lenScale[vv];
-	}
+				MSOut.nTets, MSOut.nPyrs, MSOut.nPrisms, MSOut.nHexes, mapFileName,
+				true);
 
-	subdividePartMesh(&UMIn, this, nDivs);
+	subdividePartMesh(&UMIn, this, nDivs, lattices, &m_tableSizes);
+	clearUnwrittenImage();
 	setlocale(LC_ALL, "");
 	fprintf(
 			stderr,
-			"Final mesh has:\n %'15u verts,\n %'15u bdry tris,\n %'15u bdry quads,\n %'15u tets,\n %'15u pyramids,\n %'15u prisms,\n %'15u hexes,\n%'15u cells total\n",
-			m_nVerts, m_nTris, m_nQuads, m_nTets, m_nPyrs, m_nPrisms, m_nHexes,
-			numCells());
+			"Final mesh has:\n %'15lu verts,\n %'15lu bdry tris,\n %'15lu bdry quads,\n %'15lu tets,\n %'15lu pyramids,\n %'15lu prisms,\n %'15lu hexes,\n%'15lu cells total\n",
+			size_t(m_nVerts), size_t(m_nTris), size_t(m_nQuads), size_t(m_nTets),
+			size_t(m_nPyrs), size_t(m_nPrisms), size_t(m_nHexes), size_t(numCells()));
 }
 
-UMesh::UMesh(const CubicMesh& CMIn, const int nDivs) :
+UMesh::UMesh(const CubicMesh& CMIn, const int nDivs,
+		const char mapFileName[], BdryFaceLattices* lattices) :
 		m_nVerts(0), m_nBdryVerts(0), m_nTris(0), m_nQuads(0), m_nTets(0),
 				m_nPyrs(0), m_nPrisms(0), m_nHexes(0), m_fileImageSize(0),
 				m_header(nullptr), m_coords(nullptr), m_TriConn(nullptr),
 				m_QuadConn(nullptr), m_TetConn(nullptr), m_PyrConn(nullptr),
 				m_PrismConn(nullptr), m_HexConn(nullptr), m_buffer(nullptr),
-				m_fileImage(nullptr) {
+				m_fileImage(nullptr), m_mapFD(-1), m_snapshotBytes(0),
+				m_bufferBytes(0), m_isRecycled(false) {
 
 #ifndef NDEBUG
 	setlocale(LC_ALL, "");
@@ -560,9 +1515,11 @@ UMesh::UMesh(const CubicMesh& CMIn, const int nDivs) :
 											+ CMIn.numPrisms() + CMIn.numHexes();
 	fprintf(
 			stderr,
-			"Initial mesh has:\n %'15u verts,\n %'15u bdry tris,\n %'15u bdry quads,\n %'15u tets,\n %'15u pyramids,\n %'15u prisms,\n %'15u hexes,\n%'15lu cells total\n",
-			CMIn.numVertsToCopy(), CMIn.numBdryTris(), CMIn.numBdryQuads(),
-			CMIn.numTets(), CMIn.numPyramids(), CMIn.numPrisms(), CMIn.numHexes(),
+			"Initial mesh has:\n %'15lu verts,\n %'15lu bdry tris,\n %'15lu bdry quads,\n %'15lu tets,\n %'15lu pyramids,\n %'15lu prisms,\n %'15lu hexes,\n%'15lu cells total\n",
+			size_t(CMIn.numVertsToCopy()), size_t(CMIn.numBdryTris()),
+			size_t(CMIn.numBdryQuads()), size_t(CMIn.numTets()),
+			size_t(CMIn.numPyramids()), size_t(CMIn.numPrisms()),
+			size_t(CMIn.numHexes()),
 			totalInputCells);
 #endif
 
@@ -579,169 +1536,424 @@ UMesh::UMesh(const CubicMesh& CMIn, const int nDivs) :
 	if (!sizesOK) exit(2);
 
 	init(MSOut.nVerts, MSOut.nBdryVerts, MSOut.nBdryTris, MSOut.nBdryQuads,
-				MSOut.nTets, MSOut.nPyrs, MSOut.nPrisms, MSOut.nHexes);
-	// Copy length scale data from the other mesh.
-	for (emInt vv = 0; vv < CMIn.numVertsToCopy(); vv++) {
-		m_lenScale[vv] = CMIn.getLengthScale(vv);
-	}
+				MSOut.nTets, MSOut.nPyrs, MSOut.nPrisms, MSOut.nHexes, mapFileName,
+				true);
 
-	subdividePartMesh(&CMIn, this, nDivs);
+	subdividePartMesh(&CMIn, this, nDivs, lattices, &m_tableSizes);
+	clearUnwrittenImage();
 
 #ifndef NDEBUG
 	setlocale(LC_ALL, "");
 	fprintf(
 			stderr,
-			"Final mesh has:\n %'15u verts,\n %'15u bdry tris,\n %'15u bdry quads,\n %'15u tets,\n %'15u pyramids,\n %'15u prisms,\n %'15u hexes,\n%'15lu cells total\n",
-			m_nVerts, m_nTris, m_nQuads, m_nTets, m_nPyrs, m_nPrisms, m_nHexes,
-			numCells());
+			"Final mesh has:\n %'15lu verts,\n %'15lu bdry tris,\n %'15lu bdry quads,\n %'15lu tets,\n %'15lu pyramids,\n %'15lu prisms,\n %'15lu hexes,\n%'15lu cells total\n",
+			size_t(m_nVerts), size_t(m_nTris), size_t(m_nQuads), size_t(m_nTets),
+			size_t(m_nPyrs), size_t(m_nPrisms), size_t(m_nHexes), size_t(numCells()));
 #endif
 }
 
+// The mesh's cells, bdry faces first, in the form the VTK writers want.
+static int vtkCellBlocks(const UMesh& UM, VTKCellBlock blocks[6]) {
+	const VTKCellBlock allBlocks[] = {
+			{ UM.numBdryTris() ? UM.getBdryTriConn(0) : nullptr, UM.numBdryTris(),
+				3, VTK_TRI },
+			{ UM.numBdryQuads() ? UM.getBdryQuadConn(0) : nullptr,
+				UM.numBdryQuads(), 4, VTK_QUAD },
+			{ UM.numTets() ? UM.getTetConn(0) : nullptr, UM.numTets(), 4, VTK_TET },
+			{ UM.numPyramids() ? UM.getPyrConn(0) : nullptr, UM.numPyramids(), 5,
+				VTK_PYR },
+			{ UM.numPrisms() ? UM.getPrismConn(0) : nullptr, UM.numPrisms(), 6,
+				VTK_PRISM },
+			{ UM.numHexes() ? UM.getHexConn(0) : nullptr, UM.numHexes(), 8, VTK_HEX } };
+	std::copy(allBlocks, allBlocks + 6, blocks);
+	return 6;
+}
+
+static void reportWriteTime(const char what[], const double elapsed,
+		const size_t totalCells) {
+	fprintf(stderr, "CPU time for %s file write = %5.2F seconds\n", what,
+					elapsed);
+	fprintf(stderr, "                          %5.2F million cells / minute\n",
+					(totalCells / 1000000.) / (elapsed / 60));
+}
+
 bool UMesh::writeVTKFile(const char fileName[]) {
 	double timeBefore = exaTime();
+	VTKCellBlock blocks[6];
+	const int nBlocks = vtkCellBlocks(*this, blocks);
+	if (!writeVTKLegacyFile(fileName, m_coords, m_nVerts, blocks, nBlocks)) {
+		return false;
+	}
+	reportWriteTime("VTK", exaTime() - timeBefore,
+									size_t(m_nTets) + m_nPyrs + m_nPrisms + m_nHexes);
+	return true;
+}
 
-	FILE* outFile = fopen(fileName, "w");
-	if (!outFile) {
-		fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n", fileName);
+bool UMesh::writeVTUFile(const char fileName[], const bool compress) {
+	double timeBefore = exaTime();
+	VTKCellBlock blocks[6];
+	const int nBlocks = vtkCellBlocks(*this, blocks);
+	if (!::writeVTUFile(fileName, m_coords, m_nVerts, blocks, nBlocks,
+											compress)) {
 		return false;
 	}
+	reportWriteTime("VTU", exaTime() - timeBefore,
+									size_t(m_nTets) + m_nPyrs + m_nPrisms + m_nHexes);
+	return true;
+}
 
-	fprintf(outFile, "# vtk DataFile Version 1.0\n");
-	fprintf(outFile, "GRUMMP Tetra example\n");
-	fprintf(outFile, "ASCII\n");
-	fprintf(outFile, "DATASET UNSTRUCTURED_GRID\n");
-	fprintf(outFile, "POINTS %d float\n", m_header[eVert]);
+void UMesh::incrementVertIndices(emInt* conn, size_t size, int inc) {
+#pragma omp parallel for schedule(static)
+	for (size_t ii = 0; ii < size; ii++) {
+		conn[ii] += inc;
+	}
+}
+
+void UMesh::convertToUGridIndexing(const int inc) {
+	// Need to increment all vert indices, because UGRID files are 1-based.
+	size_t size = size_t(m_nTris) * 3 + size_t(m_nQuads) * 4;
+	incrementVertIndices(reinterpret_cast<emInt*>(m_TriConn), size, inc);
+	size = size_t(m_nTets) * 4 + size_t(m_nPyrs) * 5 + size_t(m_nPrisms) * 6
+			+ size_t(m_nHexes) * 8;
+	incrementVertIndices(reinterpret_cast<emInt*>(m_TetConn), size, inc);
 
-	//-------------------------------------
-	// write 3d vertex data
-	//-------------------------------------
-	for (emInt i = 0; i < m_header[eVert]; ++i) {
-		fprintf(outFile, "%16.8f %16.8f %16.8f\n", getX(i), getY(i), getZ(i));
+	// Also need to swap verts 2 and 4 for pyramids, because UGRID treats
+	// pyramids as prisms with the edge from 2 to 5 collapsed.  Compared
+	// with the ordering the rest of the world uses, this has the effect
+	// of switching verts 2 and 4.  The swap is its own inverse.
+#pragma omp parallel for schedule(static)
+	for (emInt ii = 0; ii < m_nPyrs; ii++) {
+		std::swap(m_PyrConn[ii][2], m_PyrConn[ii][4]);
 	}
+}
 
-	const size_t nTris = numBdryTris();
-	const size_t nQuads = numBdryQuads();
-	const size_t nTets = numTets();
-	const size_t nPyrs = numPyramids();
-	const size_t nPrisms = numPrisms();
-	const size_t nHexes = numHexes();
+// Switches the byte order of the whole file image, on all cores.
+void UMesh::swapImageBytes() {
+	// Everything but the coordinates is an emInt.
+	auto swapInts = (sizeof(emInt) == 8) ? swapBytes8 : swapBytes4;
+	swapInts(m_header, 7);
+	const char* const triConn = reinterpret_cast<const char*>(m_TriConn);
+	const size_t nReals = 3 * size_t(m_nVerts);
+	const size_t nInts = (m_fileImage + m_fileImageSize - triConn)
+			/ sizeof(emInt);
+	const size_t chunk = 1 << 16;
+#pragma omp parallel for schedule(static)
+	for (size_t start = 0; start < nReals; start += chunk) {
+		swapBytes8(m_coords[0] + start, std::min(chunk, nReals - start));
+	}
+#pragma omp parallel for schedule(static)
+	for (size_t start = 0; start < nInts; start += chunk) {
+		swapInts(reinterpret_cast<emInt*>(m_TriConn) + start,
+							std::min(chunk, nInts - start));
+	}
+}
 
-	const size_t numEnts = nTris + nQuads + nTets + nPyrs + nPrisms + nHexes;
-	const size_t dataSize = 4 * nTris + 5 * (nQuads + nTets) + 6 * nPyrs
-													+ 7 * nPrisms + 9 * nHexes;
+namespace {
+	// A contiguous piece of the file image, and what has to happen to it on
+	// the way to disk.
+	struct ImageSegment {
+		enum Conversion {
+			eReals, eInts, eOneBased, eOneBasedPyr
+		};
+		const char* start;
+		size_t count;
+		Conversion conv;
+	};
+}
 
-	fprintf(outFile, "CELLS %lu %lu\n", numEnts, dataSize);
+// Where each piece of the file image goes in a UGRID file of some format.
+struct UGridLayout {
+	enum {
+		nSegs = 7
+	};
+	ImageSegment segments[nSegs];
+	off_t fileOffsets[nSegs];
+	size_t fileSize;
+	// Fortran record markers, in the file's byte order, and where they go.
+	int nMarkers;
+	uint32_t markers[4];
+	off_t markerOffsets[4];
+};
 
-	// Write all the bdry tris
-	for (emInt i = 0; i < nTris; i++) {
-		const emInt *verts = getBdryTriConn(i);
-		fprintf(outFile, "3 %d %d %d\n", verts[0], verts[1], verts[2]);
+bool UMesh::getUGridLayout(const UGridFormat& format, UGridLayout& layout,
+		const char fileName[]) const {
+	const size_t counts[] = { m_nVerts, m_nTris, m_nQuads, m_nTets, m_nPyrs,
+														m_nPrisms, m_nHexes };
+	if (!format.canHold(*std::max_element(counts, counts + 7))) {
+		fprintf(stderr, "Mesh too big for 32-bit ints in %s; "
+						"use a variant ending in l, as in b8l.\n", fileName);
+		return false;
 	}
-
-	// Write all the bdry quads
-	for (emInt i = 0; i < nQuads; i++) {
-		const emInt *verts = getBdryQuadConn(i);
-		fprintf(outFile, "4 %d %d %d %d\n", verts[0], verts[1], verts[2], verts[3]);
+	// UGRID files are 1-based, and UGRID treats pyramids as prisms with the
+	// edge from 2 to 5 collapsed, which switches verts 2 and 4 compared
+	// with the ordering the rest of the world uses.
+	const ImageSegment segments[] = {
+			{ m_fileImage, 7, ImageSegment::eInts },
+			{ reinterpret_cast<const char*>(m_coords), 3 * size_t(m_nVerts),
+				ImageSegment::eReals },
+			{ reinterpret_cast<const char*>(m_TriConn), 3 * size_t(m_nTris)
+					+ 4 * size_t(m_nQuads),
+				ImageSegment::eOneBased },
+			{ reinterpret_cast<const char*>(m_TriBC), size_t(m_nTris) + m_nQuads,
+				ImageSegment::eInts },
+			{ reinterpret_cast<const char*>(m_TetConn), 4 * size_t(m_nTets),
+				ImageSegment::eOneBased },
+			{ reinterpret_cast<const char*>(m_PyrConn), 5 * size_t(m_nPyrs),
+				ImageSegment::eOneBasedPyr },
+			{ reinterpret_cast<const char*>(m_PrismConn), 6 * size_t(m_nPrisms)
+					+ 8 * size_t(m_nHexes),
+				ImageSegment::eOneBased } };
+	static_assert(sizeof(segments) / sizeof(segments[0]) == UGridLayout::nSegs,
+			"UGRID files have seven segments");
+	std::copy(segments, segments + UGridLayout::nSegs, layout.segments);
+
+	// Fortran unformatted files have the header in one record and everything
+	// else in a second, each wrapped in 4-byte length markers.
+	const size_t markerBytes = format.isFortran ? 4 : 0;
+	off_t offset = markerBytes;
+	for (int iSeg = 0; iSeg < UGridLayout::nSegs; iSeg++) {
+		if (iSeg == 1) offset += 2 * markerBytes;
+		layout.fileOffsets[iSeg] = offset;
+		offset += segments[iSeg].count
+				* (segments[iSeg].conv == ImageSegment::eReals ?
+						format.realBytes() : format.intBytes());
 	}
-
-	// Write all the tets
-	for (emInt i = 0; i < nTets; i++) {
-		const emInt *verts = getTetConn(i);
-		fprintf(outFile, "4 %d %d %d %d\n", verts[0], verts[1], verts[2], verts[3]);
+	layout.fileSize = offset + markerBytes;
+
+	layout.nMarkers = 0;
+	if (format.isFortran) {
+		const size_t headerBytes = layout.fileOffsets[1] - 2 * markerBytes
+				- layout.fileOffsets[0];
+		const size_t dataBytes = layout.fileSize - markerBytes
+				- layout.fileOffsets[1];
+		if (dataBytes > INT32_MAX) {
+			fprintf(stderr, "Mesh too big for a single Fortran record in %s.\n",
+							fileName);
+			return false;
+		}
+		layout.nMarkers = 4;
+		const uint32_t markers[] = { uint32_t(headerBytes), uint32_t(headerBytes),
+																	uint32_t(dataBytes), uint32_t(dataBytes) };
+		const off_t markerOffsets[] = { 0, off_t(layout.fileOffsets[0]
+				+ headerBytes),
+																		layout.fileOffsets[1] - 4, off_t(
+																				layout.fileSize - 4) };
+		std::copy(markers, markers + 4, layout.markers);
+		std::copy(markerOffsets, markerOffsets + 4, layout.markerOffsets);
+		if (format.needsByteSwap()) swapBytes4(layout.markers, 4);
 	}
+	return true;
+}
 
-	// Write all the pyramids
-	for (emInt i = 0; i < nPyrs; i++) {
-		const emInt *verts = getPyrConn(i);
-		fprintf(outFile, "5 %d %d %d %d %d\n", verts[0], verts[1], verts[2],
-						verts[3], verts[4]);
+// Produce bytes [offset, offset + bytes) of the UGRID file that layout
+// describes, converting only the part of the mesh that's needed.
+static void encodeUGridRange(const UGridLayout& layout,
+		const UGridFormat& format, const size_t offset, const size_t bytes,
+		char* out) {
+	const size_t end = offset + bytes;
+	for (int iM = 0; iM < layout.nMarkers; iM++) {
+		const size_t markerStart = layout.markerOffsets[iM];
+		const size_t copyStart = std::max(offset, markerStart);
+		const size_t copyEnd = std::min(end, markerStart + 4);
+		if (copyStart < copyEnd) {
+			memcpy(out + (copyStart - offset),
+							reinterpret_cast<const char*>(&layout.markers[iM])
+									+ (copyStart - markerStart),
+							copyEnd - copyStart);
+		}
 	}
-
-	// Write all the prisms
-	for (emInt i = 0; i < nPrisms; i++) {
-		const emInt *verts = getPrismConn(i);
-		fprintf(outFile, "6 %d %d %d %d %d %d\n", verts[0], verts[1], verts[2],
-						verts[3], verts[4], verts[5]);
+	std::vector<uint64_t> staging;
+	for (int iSeg = 0; iSeg < UGridLayout::nSegs; iSeg++) {
+		const ImageSegment& seg = layout.segments[iSeg];
+		const size_t elemBytes =
+				(seg.conv == ImageSegment::eReals) ?
+						format.realBytes() : format.intBytes();
+		const size_t segStart = layout.fileOffsets[iSeg];
+		const size_t segEnd = segStart + seg.count * elemBytes;
+		if (segEnd <= offset || segStart >= end) continue;
+		// Pyramids are converted whole, so their verts can be switched.
+		const size_t align = (seg.conv == ImageSegment::eOneBasedPyr) ? 5 : 1;
+		const size_t first = (std::max(offset, segStart) - segStart) / elemBytes
+				/ align * align;
+		const size_t last = std::min(
+				seg.count,
+				((std::min(end, segEnd) - segStart + elemBytes - 1) / elemBytes
+						+ align - 1) / align * align);
+		staging.resize(last - first);
+		char* const encoded = reinterpret_cast<char*>(staging.data());
+		if (seg.conv == ImageSegment::eReals) {
+			encodeUGridReals(seg.start + 8 * first, last - first, format, encoded);
+		}
+		else {
+			const int inc = (seg.conv == ImageSegment::eInts) ? 0 : 1;
+			encodeUGridInts(reinterpret_cast<const emInt*>(seg.start) + first,
+											last - first, inc,
+											seg.conv == ImageSegment::eOneBasedPyr, format,
+											encoded);
+		}
+		const size_t encodedStart = segStart + first * elemBytes;
+		const size_t copyStart = std::max(offset, encodedStart);
+		const size_t copyEnd = std::min(end, segStart + last * elemBytes);
+		memcpy(out + (copyStart - offset), encoded + (copyStart - encodedStart),
+						copyEnd - copyStart);
 	}
+}
 
-	// Write all the hexes
-	for (emInt i = 0; i < nHexes; i++) {
-		const emInt *verts = getHexConn(i);
-		fprintf(outFile, "8 %d %d %d %d %d %d %d %d\n", verts[0], verts[1],
-						verts[2], verts[3], verts[4], verts[5], verts[6], verts[7]);
+bool UMesh::writeCompressedUGridFile(const char fileName[],
+		const UGridFormat& format, const UGridLayout& layout) const {
+	double timeBefore = exaTime();
+	if (!writeBlockCompressedFile(
+			fileName, layout.fileSize,
+			[&](size_t offset, size_t bytes, char* out) {
+				encodeUGridRange(layout, format, offset, bytes, out);
+			})) {
+		return false;
 	}
-
-	//-------------------------------------
-	// write cell type (VTK_TRIANGLE = 5, VTK_QUAD = 9,
-	// VTK_TETRA = 10, VTK_HEXAHEDRON = 12, VTK_WEDGE = 13,
-	// VTK_PYRAMID = 14)
-	//-------------------------------------
-	fprintf(outFile, "CELL_TYPES %lu\n", numEnts);
-	for (emInt ct = 0; ct < nTris; ++ct)
-		fprintf(outFile, "5\n");
-	for (emInt ct = 0; ct < nQuads; ++ct)
-		fprintf(outFile, "9\n");
-	for (emInt ct = 0; ct < nTets; ++ct)
-		fprintf(outFile, "10\n");
-	for (emInt ct = 0; ct < nPyrs; ++ct)
-		fprintf(outFile, "14\n");
-	for (emInt ct = 0; ct < nPrisms; ++ct)
-		fprintf(outFile, "13\n");
-	for (emInt ct = 0; ct < nHexes; ++ct)
-		fprintf(outFile, "12\n");
-
-	fclose(outFile);
-	double timeAfter = exaTime();
-	double elapsed = timeAfter - timeBefore;
+	double elapsed = exaTime() - timeBefore;
 	size_t totalCells = size_t(m_nTets) + m_nPyrs + m_nPrisms + m_nHexes;
-	fprintf(stderr, "CPU time for VTK file write = %5.2F seconds\n", elapsed);
+	fprintf(stderr, "CPU time for compressed UGRID file write = %5.2F seconds\n",
+					elapsed);
 	fprintf(stderr, "                          %5.2F million cells / minute\n",
 					(totalCells / 1000000.) / (elapsed / 60));
-
 	return true;
 }
 
-void UMesh::incrementVertIndices(emInt* conn, emInt size, int inc) {
-	for (emInt ii = 0; ii < size; ii++) {
-		conn[ii] += inc;
-	}
-}
-
 bool UMesh::writeUGridFile(const char fileName[]) {
-	double timeBefore = exaTime();
+	return writeUGridImage(fileName, true);
+}
 
-	// Need to increment all vert indices, because UGRID files are 1-based.
-	emInt size = m_nTris * 3 + m_nQuads * 4;
-	incrementVertIndices(reinterpret_cast<emInt*>(m_TriConn), size, 1);
-	size = m_nTets * 4 + m_nPyrs * 5 + m_nPrisms * 6 + m_nHexes * 8;
-	incrementVertIndices(reinterpret_cast<emInt*>(m_TetConn), size, 1);
+bool UMesh::writeUGridFileAndRelease(const char fileName[]) {
+	const bool written = writeUGridImage(fileName, false);
+	releaseImage();
+	return written;
+}
 
-	// Also need to swap verts 2 and 4 for pyramids, because UGRID treats
-	// pyramids as prisms with the edge from 2 to 5 collapsed.  Compared
-	// with the ordering the rest of the world uses, this has the effect
-	// of switching verts 2 and 4.
-	for (emInt ii = 0; ii < m_nPyrs; ii++) {
-		std::swap(m_PyrConn[ii][2], m_PyrConn[ii][4]);
+bool UMesh::writeUGridImage(const char fileName[], const bool keepMesh) {
+	double timeBefore = exaTime();
+	const UGridFormat format = formatForUGridFile(fileName);
+
+	if (isMapped() && m_mapFileName == fileName && !keepMesh) {
+		// The file image already is the file; converting it and flushing it is
+		// all, since the mesh is about to be released.
+		convertToUGridIndexing(1);
+		if (format.needsByteSwap()) swapImageBytes();
+		if (msync(m_buffer, m_fileImageSize, MS_SYNC) != 0) {
+			fprintf(stderr, "Couldn't flush mapped file %s.  Bummer!\n",
+							fileName);
+			return false;
+		}
 	}
-
-	FILE* outFile = fopen(fileName, "w");
-	if (!outFile) {
-		fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n", fileName);
-		return false;
+	else if (isMapped() && m_mapFileName == fileName) {
+		convertToUGridIndexing(1);
+		if (format.needsByteSwap()) swapImageBytes();
+		// The file image already is the file; just flush it.  Then the image
+		// is mapped again copy-on-write, so that converting it back leaves the
+		// file alone, and the mesh stays usable.
+		bool flushed = (msync(m_buffer, m_fileImageSize, MS_SYNC) == 0);
+		void* image = mmap(m_buffer, m_fileImageSize, PROT_READ | PROT_WRITE,
+												MAP_PRIVATE | MAP_FIXED, m_mapFD, 0);
+		close(m_mapFD);
+		m_mapFD = -1;
+		m_mapFileName.clear();
+		if (image == MAP_FAILED) {
+			// The shared mapping is still in place, holding the file as written.
+			fprintf(stderr, "Couldn't remap file %s.  Bummer!\n", fileName);
+			exit(1);
+		}
+		assert(image == m_buffer);
+		m_snapshotBytes = m_fileImageSize;
+		if (format.needsByteSwap()) swapImageBytes();
+		convertToUGridIndexing(-1);
+		if (!flushed) {
+			fprintf(stderr, "Couldn't flush mapped file %s.  Bummer!\n",
+							fileName);
+			return false;
+		}
 	}
+	else {
+		UGridLayout layout;
+		if (!getUGridLayout(format, layout, fileName)) return false;
+		if (isBlockCompressedFileName(fileName)) {
+			return writeCompressedUGridFile(fileName, format, layout);
+		}
+		const ImageSegment* const segments = layout.segments;
+		const off_t* const fileOffsets = layout.fileOffsets;
+		const int nSegs = UGridLayout::nSegs;
+
+		int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (fd < 0) {
+			fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n",
+							fileName);
+			return false;
+		}
 
-	fwrite(m_fileImage, m_fileImageSize, 1, outFile);
-	fclose(outFile);
+		// Rather than changing the mesh, convert chunks into per-thread
+		// staging buffers, along with any change of byte order or size, and
+		// write each at its own offset.
+		bool allWritten = true;
+		for (int iM = 0; iM < layout.nMarkers; iM++) {
+			allWritten = pwriteAll(fd,
+															reinterpret_cast<const char*>(&layout.markers[iM]),
+															4, layout.markerOffsets[iM]) && allWritten;
+		}
 
-	// Need to undo the increment for future use
-	size = m_nTris * 3 + m_nQuads * 4;
-	incrementVertIndices(reinterpret_cast<emInt*>(m_TriConn), size, -1);
-	size = m_nTets * 4 + m_nPyrs * 5 + m_nPrisms * 6 + m_nHexes * 8;
-	incrementVertIndices(reinterpret_cast<emInt*>(m_TetConn), size, -1);
+		// A whole number of cells of every type, so pyramids never straddle
+		// chunks.
+		const size_t chunkCount = 120 * 8192;
+		std::vector<std::pair<int, size_t> > chunks;
+		for (int iSeg = 0; iSeg < nSegs; iSeg++) {
+			for (size_t first = 0; first < segments[iSeg].count; first +=
+					chunkCount) {
+				chunks.push_back(std::make_pair(iSeg, first));
+			}
+		}
 
-	// Need to swap verts 2 and 4 back for future use.
-	for (emInt ii = 0; ii < m_nPyrs; ii++) {
-		std::swap(m_PyrConn[ii][2], m_PyrConn[ii][4]);
+#pragma omp parallel reduction(&&: allWritten)
+		{
+			std::vector<uint64_t> staging(chunkCount);
+			char* const out = reinterpret_cast<char*>(staging.data());
+#pragma omp for schedule(dynamic)
+			for (size_t ii = 0; ii < chunks.size(); ii++) {
+				const ImageSegment& seg = segments[chunks[ii].first];
+				const size_t first = chunks[ii].second;
+				const size_t count = std::min(chunkCount, seg.count - first);
+				size_t bytes = 0;
+				off_t offset = fileOffsets[chunks[ii].first];
+				if (seg.conv == ImageSegment::eReals) {
+					const char* const src = seg.start + 8 * first;
+					offset += first * format.realBytes();
+					if (!format.isSinglePrec && !format.needsByteSwap()) {
+						allWritten = pwriteAll(fd, src, 8 * count, offset) && allWritten;
+						continue;
+					}
+					bytes = encodeUGridReals(src, count, format, out);
+				}
+				else {
+					const emInt* const src = reinterpret_cast<const emInt*>(seg.start)
+							+ first;
+					offset += first * format.intBytes();
+					if (seg.conv == ImageSegment::eInts
+							&& format.intBytes() == sizeof(emInt)
+							&& !format.needsByteSwap()) {
+						allWritten = pwriteAll(fd, reinterpret_cast<const char*>(src),
+																		count * sizeof(emInt), offset)
+								&& allWritten;
+						continue;
+					}
+					const int inc = (seg.conv == ImageSegment::eInts) ? 0 : 1;
+					bytes = encodeUGridInts(src, count, inc,
+																	seg.conv == ImageSegment::eOneBasedPyr,
+																	format, out);
+				}
+				allWritten = pwriteAll(fd, out, bytes, offset) && allWritten;
+			}
+		}
+		close(fd);
+		if (!allWritten) {
+			fprintf(stderr, "Couldn't write all of file %s.  Bummer!\n",
+							fileName);
+			return false;
+		}
 	}
 
 	double timeAfter = exaTime();
@@ -754,6 +1966,81 @@ bool UMesh::writeUGridFile(const char fileName[]) {
 	return true;
 }
 
+bool UMesh::writePackedMeshFile(const char fileName[]) const {
+	double timeBefore = exaTime();
+	PackedMeshHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, packedMeshMagic, 8);
+	header.version = 1;
+	header.byteOrder = 0x01020304;
+	header.intBytes = sizeof(emInt);
+	for (int ii = 0; ii < 7; ii++) {
+		header.counts[ii] = m_header[ii];
+	}
+	header.counts[eHex + 1] = m_nBdryVerts;
+
+	const std::vector<char> packed[] = {
+			packConnectivity(m_TriConn[0], m_header[eTri], 3),
+			packConnectivity(m_QuadConn[0], m_header[eQuad], 4),
+			packConnectivity(m_TetConn[0], m_header[eTet], 4),
+			packConnectivity(m_PyrConn[0], m_header[ePyr], 5),
+			packConnectivity(m_PrismConn[0], m_header[ePrism], 6),
+			packConnectivity(m_HexConn[0], m_header[eHex], 8) };
+	const int packedSecs[] = { PackedMeshHeader::eTris,
+															PackedMeshHeader::eQuads, PackedMeshHeader::eTets,
+															PackedMeshHeader::ePyrs, PackedMeshHeader::ePrisms,
+															PackedMeshHeader::eHexes };
+	const char* data[PackedMeshHeader::nSections];
+	data[PackedMeshHeader::eCoords] = reinterpret_cast<const char*>(m_coords);
+	header.sectionBytes[PackedMeshHeader::eCoords] = 3 * sizeof(double)
+			* size_t(m_header[eVert]);
+	// The tri and quad BCs are next to each other in the file image.
+	data[PackedMeshHeader::eBCs] = reinterpret_cast<const char*>(m_TriBC);
+	header.sectionBytes[PackedMeshHeader::eBCs] = sizeof(emInt)
+			* (size_t(m_header[eTri]) + m_header[eQuad]);
+	for (int ii = 0; ii < 6; ii++) {
+		if (packed[ii].empty()) {
+			fprintf(stderr, "Connectivity too spread out to pack for file %s.\n",
+							fileName);
+			return false;
+		}
+		data[packedSecs[ii]] = packed[ii].data();
+		header.sectionBytes[packedSecs[ii]] = packed[ii].size();
+	}
+
+	int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n",
+						fileName);
+		return false;
+	}
+	bool allWritten = pwriteAll(fd, reinterpret_cast<const char*>(&header),
+															sizeof(header), 0);
+	for (int ii = 0; ii < PackedMeshHeader::nSections; ii++) {
+		allWritten = pwriteAll(fd, data[ii], header.sectionBytes[ii],
+														packedSectionStart(header, ii)) && allWritten;
+	}
+	// Pad out the last section.
+	const off_t fileSize = packedSectionStart(header,
+																						PackedMeshHeader::nSections);
+	allWritten = ftruncate(fd, fileSize) == 0 && allWritten;
+	close(fd);
+	if (!allWritten) {
+		fprintf(stderr, "Couldn't write all of file %s.  Bummer!\n", fileName);
+		return false;
+	}
+
+	double elapsed = exaTime() - timeBefore;
+	size_t totalCells = size_t(m_nTets) + m_nPyrs + m_nPrisms + m_nHexes;
+	fprintf(stderr, "CPU time for packed mesh file write = %5.2F seconds\n",
+					elapsed);
+	fprintf(stderr, "                          %5.2F million cells / minute\n",
+					(totalCells / 1000000.) / (elapsed / 60));
+	fprintf(stderr, "                          %5.2F bytes / cell\n",
+					double(fileSize) / std::max(totalCells, size_t(1)));
+	return true;
+}
+
 static void remapIndices(const emInt nPts, const std::vector<emInt>& newIndices,
 		const emInt* conn, emInt* newConn) {
 	for (emInt jj = 0; jj < nPts; jj++) {
@@ -762,7 +2049,9 @@ static void remapIndices(const emInt nPts, const std::vector<emInt>& newIndices,
 }
 
 std::unique_ptr<UMesh> UMesh::extractCoarseMesh(Part& P,
-		std::vector<CellPartData>& vecCPD) const {
+		std::vector<CellPartData>& vecCPD, PartInterface* pPI) const {
+	if (m_orderPartsForLocality) P.orderForLocality(vecCPD);
+
 	// Count the number of tris, quads, tets, pyrs, prisms and hexes.
 	const emInt first = P.getFirst();
 	const emInt last = P.getLast();
@@ -941,18 +2230,67 @@ std::unique_ptr<UMesh> UMesh::extractCoarseMesh(Part& P,
 																			nQuads + nPartBdryQuads, nTets, nPyrs,
 																			nPrisms, nHexes);
 
+	// The verts go in the order of their global indices or, for locality, in
+	// the order the (sorted) cells first use them.
+	std::vector<emInt> usedVerts;
+	usedVerts.reserve(nVerts);
+	if (m_orderPartsForLocality) {
+		for (emInt ii = first; ii < last; ii++) {
+			const emInt ind = vecCPD[ii].getIndex();
+			emInt nPts = 0;
+			switch (vecCPD[ii].getCellType()) {
+				case TETRA_4:
+					conn = getTetConn(ind);
+					nPts = 4;
+					break;
+				case PYRA_5:
+					conn = getPyrConn(ind);
+					nPts = 5;
+					break;
+				case PENTA_6:
+					conn = getPrismConn(ind);
+					nPts = 6;
+					break;
+				case HEXA_8:
+					conn = getHexConn(ind);
+					nPts = 8;
+					break;
+				default:
+					assert(0);
+					break;
+			}
+			for (emInt jj = 0; jj < nPts; jj++) {
+				// Not needed any more, so unmarking shows it's been listed.
+				if (isVertUsed[conn[jj]]) {
+					isVertUsed[conn[jj]] = false;
+					usedVerts.push_back(conn[jj]);
+				}
+			}
+		}
+	}
+	else {
+		for (emInt ii = 0; ii < numVerts(); ii++) {
+			if (isVertUsed[ii]) usedVerts.push_back(ii);
+		}
+	}
+	assert(usedVerts.size() == nVerts);
+
 	// Store the vertices, while keeping a mapping from the full list of verts
 	// to the restricted list so the connectivity can be copied properly.
 	std::vector<emInt> newIndices(numVerts(), EMINT_MAX);
-	for (emInt ii = 0; ii < numVerts(); ii++) {
-		if (isVertUsed[ii]) {
-			double coords[3];
-			getCoords(ii, coords);
-			newIndices[ii] = UUM->addVert(coords);
-			// Copy length scale for vertices from the parent; otherwise, there will be
-			// mismatches in the refined meshes.
-			UUM->setLengthScale(newIndices[ii], getLengthScale(ii));
-		}
+	if (pPI) {
+		pPI->coarseToGlobal.clear();
+		pPI->lattices.firstTri = nTris;
+		pPI->lattices.firstQuad = nQuads;
+	}
+	for (const emInt ii : usedVerts) {
+		double coords[3];
+		getCoords(ii, coords);
+		newIndices[ii] = UUM->addVert(coords);
+		if (pPI) pPI->coarseToGlobal.push_back(ii);
+		// Copy length scale for vertices from the parent; otherwise, there will be
+		// mismatches in the refined meshes.
+		UUM->setLengthScale(newIndices[ii], getLengthScale(ii));
 	}
 
 	// Now copy connectivity.
@@ -1003,9 +2341,8 @@ std::unique_ptr<UMesh> UMesh::extractCoarseMesh(Part& P,
 		UUM->addBdryQuad(newConn);
 	}
 
-	// Now, finally, the part bdry connectivity.
-	// TODO: Currently, there's nothing in the data structure that marks which
-	// are part bdry faces.
+	// Now, finally, the part bdry connectivity.  These come after all the
+	// real bdry faces, which is what marks them as part bdry faces.
 	for (auto tri : partBdryTris) {
 		emInt conn[] = { newIndices[tri.corners[0]], newIndices[tri.corners[1]],
 											newIndices[tri.corners[2]] };
@@ -1022,14 +2359,16 @@ std::unique_ptr<UMesh> UMesh::extractCoarseMesh(Part& P,
 }
 
 std::unique_ptr<UMesh> UMesh::createFineUMesh(const emInt numDivs, Part& P,
-		std::vector<CellPartData>& vecCPD, struct RefineStats& RS) const {
+		std::vector<CellPartData>& vecCPD, struct RefineStats& RS,
+		const char mapFileName[], PartInterface* pPI) const {
 	// Create a coarse
 	double start = exaTime();
-	auto coarse = extractCoarseMesh(P, vecCPD);
+	auto coarse = extractCoarseMesh(P, vecCPD, pPI);
 	double middle = exaTime();
 	RS.extractTime = middle - start;
 
-	auto UUM = std::make_unique<UMesh>(*coarse, numDivs);
+	auto UUM = std::make_unique<UMesh>(*coarse, numDivs, mapFileName,
+																			pPI ? &pPI->lattices : nullptr);
 	RS.cells = UUM->numCells();
 	RS.refineTime = exaTime() - middle;
 	return UUM;
@@ -1063,29 +2402,4 @@ void UMesh::setupCellDataForPartitioning(std::vector<CellPartData>& vecCPD,
 }
 
 
-//bool UMesh::writeCompressedUGridFile(const char fileName[]) {
-//	double timeBefore = clock() / double(CLOCKS_PER_SEC);
-//
-//	gzFile outFile = gzopen(fileName, "wb");
-//	if (!outFile) {
-//		fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n", fileName);
-//		return false;
-//	}
-//
-//	int bytesWritten = gzwrite(outFile, reinterpret_cast<void*>(m_fileImage),
-//															m_fileImageSize);
-//	gzclose(outFile);
-//	fprintf(stderr, "Wrote %d bytes into a compressed file as %d bytes\n",
-//					m_fileImageSize, bytesWritten);
-//
-//	double timeAfter = clock() / double(CLOCKS_PER_SEC);
-//	double elapsed = timeAfter - timeBefore;
-//	size_t totalCells = size_t(m_nTets) + m_nPyrs + m_nPrisms + m_nHexes;
-//	fprintf(stderr, "CPU time for compressed UGRID file write = %5.2F seconds\n",
-//					elapsed);
-//	fprintf(stderr, "                          %5.2F million cells / minute\n",
-//					(totalCells / 1000000.) / (elapsed / 60));
-//
-//	return true;
-//}
 
@@ -28,10 +28,34 @@
 
 #include <assert.h>
 
+#include <string>
+
 #include "CubicMesh.h"
 #include "ExaMesh.h"
+#include "RefineSink.h"
+
+// In a UGRID file image, the coordinates follow a 28-byte header, so when
+// the image is a mapped file they're only guaranteed 4-byte alignment.
+typedef double imageDouble __attribute__((aligned(4)));
+
+class Snapshot;
+struct UGridFormat;
+struct UGridLayout;
+
+// Bytes held by each part of a UMesh.  other is the header and padding.
+// refineTables is (roughly) the most that the tables of shared edges and
+// faces held while the mesh was being refined; they're gone by the time
+// this is reported, so it isn't part of the total.
+struct UMeshMemory {
+	size_t coords, triConn, quadConn, triBCs, quadBCs, tetConn, pyrConn,
+			prismConn, hexConn, other, lengthScales, refineTables;
+	size_t total() const {
+		return coords + triConn + quadConn + triBCs + quadBCs + tetConn + pyrConn
+				+ prismConn + hexConn + other + lengthScales;
+	}
+};
 
-class UMesh: public ExaMesh {
+class UMesh: public ExaMesh, public RefineSink {
 	emInt m_nVerts, m_nBdryVerts, m_nTris, m_nQuads, m_nTets, m_nPyrs, m_nPrisms,
 			m_nHexes;
 	enum {
@@ -39,7 +63,7 @@ class UMesh: public ExaMesh {
 	};
 	size_t m_fileImageSize;
 	emInt *m_header;
-	double (*m_coords)[3];
+	imageDouble (*m_coords)[3];
 	emInt (*m_TriConn)[3];
 	emInt (*m_QuadConn)[4];
 	emInt *m_TriBC;
@@ -49,6 +73,22 @@ class UMesh: public ExaMesh {
 	emInt (*m_PrismConn)[6];
 	emInt (*m_HexConn)[8];
 	char *m_buffer, *m_fileImage;
+	// When the file image is a mapped output file, the descriptor and name of
+	// that file; otherwise -1 and empty.
+	int m_mapFD;
+	std::string m_mapFileName;
+	// When the file image is a private, copy-on-write mapping (of a snapshot,
+	// or of an output file once it's written), the size of that mapping;
+	// otherwise 0.
+	size_t m_snapshotBytes;
+	// When the file image is in memory from allocateReusable, the size of
+	// that block; otherwise 0.
+	size_t m_bufferBytes;
+	// True if the file image is a reused block that wasn't zeroed, so
+	// refinement has to clear whatever it doesn't write.
+	bool m_isRecycled;
+	// How big the refinement tables got, for a refined mesh.
+	RefineTableSizes m_tableSizes;
 	UMesh(const UMesh&);
 	UMesh& operator=(const UMesh&);
 
@@ -57,8 +97,25 @@ public:
 			const emInt nBdryQuads, const emInt nTets, const emInt nPyramids,
 			const emInt nPrisms, const emInt nHexes);
 	UMesh(const char baseFileName[], const char type[], const char ugridInfix[]);
-	UMesh(const UMesh& UM_in, const int nDivs);
-	UMesh(const CubicMesh& CM, const int nDivs);
+	// Read any binary UGRID variant exactly as it is; the variant is taken
+	// from the file name, as in mesh.lb8.ugrid.  The constructor above reads
+	// binary UGRID the same way, but also fills in missing bdry faces.  Names
+	// ending in .pmesh are read as packed mesh files instead.
+	explicit UMesh(const char ugridFileName[]);
+	// The file image is mapped straight from the snapshot, copy-on-write.
+	explicit UMesh(const Snapshot& snap);
+	// If mapFileName is given, the refined mesh is built directly in a
+	// memory-mapped UGRID file of that name; see writeUGridFile.  If
+	// lattices is given, the fine verts on the bdry faces it asks for are
+	// recorded there.  Refined meshes are slim:  they have no length scales
+	// (the mappings only use those of the coarse mesh), so refining one
+	// again means writing it and reading it back first.
+	UMesh(const UMesh& UM_in, const int nDivs,
+			const char mapFileName[] = nullptr,
+			BdryFaceLattices* lattices = nullptr);
+	UMesh(const CubicMesh& CM, const int nDivs,
+			const char mapFileName[] = nullptr,
+			BdryFaceLattices* lattices = nullptr);
 	~UMesh();
 	emInt maxNVerts() const {
 		return m_nVerts;
@@ -117,9 +174,17 @@ public:
 	emInt addPrism(const emInt verts[]);
 	emInt addHex(const emInt verts[]);
 
+	// Bulk versions of the above; each returns the index of the first new entity.
+	emInt addBdryTris(const emInt verts[][3], const emInt nNew);
+	emInt addBdryQuads(const emInt verts[][4], const emInt nNew);
+	emInt addTets(const emInt verts[][4], const emInt nNew);
+	emInt addPyramids(const emInt verts[][5], const emInt nNew);
+	emInt addPrisms(const emInt verts[][6], const emInt nNew);
+	emInt addHexes(const emInt verts[][8], const emInt nNew);
+
 	virtual void getCoords(const emInt vert, double coords[3]) const {
 		assert(vert < m_nVerts && vert < m_header[eVert]);
-		const double* const tmp = m_coords[vert];
+		const imageDouble* const tmp = m_coords[vert];
 		coords[0] = tmp[0];
 		coords[1] = tmp[1];
 		coords[2] = tmp[2];
@@ -175,32 +240,92 @@ public:
 	}
 
 	virtual std::unique_ptr<UMesh> createFineUMesh(const emInt numDivs, Part& P,
-			std::vector<CellPartData>& vecCPD, struct RefineStats& RS) const;
+			std::vector<CellPartData>& vecCPD, struct RefineStats& RS,
+			const char mapFileName[] = nullptr,
+			PartInterface* pPI = nullptr) const;
 
+	// The part bdry faces are the last bdry faces of the coarse part mesh.
+	// If pPI is given, where they start and the global index of each vert
+	// are recorded there.
 	std::unique_ptr<UMesh> extractCoarseMesh(Part& P,
-			std::vector<CellPartData>& vecCPD) const;
+			std::vector<CellPartData>& vecCPD, PartInterface* pPI = nullptr) const;
+	std::unique_ptr<ExaMesh> extractCoarsePart(Part& P,
+			std::vector<CellPartData>& vecCPD, PartInterface* pPI = nullptr) const {
+		return extractCoarseMesh(P, vecCPD, pPI);
+	}
 
 	void setupCellDataForPartitioning(std::vector<CellPartData>& vecCPD,
 			double &xmin, double& ymin, double& zmin, double& xmax, double& ymax,
 			double& zmax) const;
 
+	// Binary legacy VTK.
 	bool writeVTKFile(const char fileName[]);
+	// XML VTK (.vtu), optionally zlib-compressed.
+	bool writeVTUFile(const char fileName[], const bool compress = false);
+	// The UGRID variant is taken from the file name, as in mesh.b8.ugrid; if
+	// the name doesn't give one, the file is written in native byte order.
+	// For a mesh built in a mapped file, writing to that same file only
+	// converts the image to UGRID conventions in place and flushes it.  After
+	// that, the file is closed and the mesh is converted back in a private
+	// copy-on-write mapping of it, so it can still be used.
+	// Names ending in .z, as in mesh.b8.ugrid.z, are block-compressed on all
+	// cores; see UGridIO.h.
 	bool writeUGridFile(const char fileName[]);
+	// The same, for a mesh that isn't needed afterwards:  a mesh built in a
+	// mapped file of that name is only converted and flushed, then unmapped,
+	// with no private copy made.  Either way the mesh is left empty.
+	bool writeUGridFileAndRelease(const char fileName[]);
+	// Connectivity packed with packConnectivity (see PackedConn.h), which
+	// usually takes well under half the space it does in UGRID; coordinates
+	// and BCs are stored as they are.  Native byte order only.
+	bool writePackedMeshFile(const char fileName[]) const;
+
+	bool isMapped() const {
+		return m_mapFD >= 0;
+	}
 
 	size_t getFileImageSize() const {
 		return m_fileImageSize;
 	}
 
-	void incrementVertIndices(emInt* conn, emInt size, int inc);
+	UMeshMemory memoryUsage() const;
+
+	void incrementVertIndices(emInt* conn, size_t size, int inc);
 
-	// Writing with compression reduces file size by a little over a factor of two,
-	// at the expense of making file write slower by two orders of magnitude.
-	// So don't do it.
-	// bool writeCompressedUGridFile(const char fileName[]);
 private:
 	void init(const emInt nVerts, const emInt nBdryVerts, const emInt nBdryTris,
 			const emInt nBdryQuads, const emInt nTets, const emInt nPyramids,
-			const emInt nPrisms, const emInt nHexes);
+			const emInt nPrisms, const emInt nHexes,
+			const char mapFileName[] = nullptr, const bool isSlim = false);
+	// For slim meshes in reused memory:  zero the parts that refinement
+	// doesn't write.
+	void clearUnwrittenImage();
+	bool mapFileImage(const char mapFileName[]);
+	bool writeUGridImage(const char fileName[], const bool keepMesh);
+	// Free or unmap the file image, leaving an empty mesh.
+	void releaseImage();
+	void setImagePointers();
+	bool getUGridLayout(const UGridFormat& format, UGridLayout& layout,
+			const char fileName[]) const;
+	bool writeCompressedUGridFile(const char fileName[],
+			const UGridFormat& format, const UGridLayout& layout) const;
+	int getSnapshotBlocks(SnapshotHeader& header, SnapshotBlock blocks[]) const;
+	// Read a binary UGRID file (any variant, block-compressed or not) by
+	// mapping it and decoding it straight into a new file image, in parallel.
+	void readUGridFile(const char ugridFileName[]);
+	// Read an ASCII legacy VTK unstructured grid the same way, parsing the
+	// points and cells in parallel.  Returns false, having read nothing, if
+	// the file isn't ASCII.
+	bool readVTKFile(const char vtkFileName[]);
+	void readPackedMeshFile(const char fileName[]);
+	void readWithFileWrapper(const char baseFileName[], const char type[],
+			const char ugridInfix[]);
+	// Any cell face that matches neither another cell face nor a bdry face
+	// is added as a bdry face, moving the mesh to a bigger file image.
+	void addMissingBdryFaces();
+	void countBdryVerts();
+	void convertToUGridIndexing(const int inc);
+	void swapImageBytes();
 };
 
 
@@ -0,0 +1,545 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * VTKIO.cxx
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <string>
+#include <vector>
+
+#include "UGridIO.h"
+#include "VTKIO.h"
+
+#if (HAVE_LIBZ == 1)
+#include <zlib.h>
+#endif
+
+namespace {
+	// One array in the output file: count elements of elemBytes each,
+	// generated a range at a time.
+	struct VTKArray {
+		enum Kind {
+			ePoints, eLegacyPoints, eLegacyCells, eLegacyTypes, eConn, eOffsets,
+			eTypes
+		};
+		Kind kind;
+		size_t count;
+		size_t elemBytes;
+		// Where the array's data starts in the file.
+		off_t offset;
+	};
+
+	// Arrays are generated (and for .vtu files, compressed) in pieces of
+	// this many bytes, which is a multiple of every element size.
+	const size_t chunkBytes = 1 << 20;
+}
+
+// Generate elements [first, first + n) of an array that has perCell
+// elements for each cell.
+static void fillCellArray(const VTKArray& array, const VTKCellBlock blocks[],
+		const int nBlocks, size_t first, const size_t n, char* out) {
+	size_t done = 0;
+	uint64_t connBefore = 0;
+	for (int iB = 0; iB < nBlocks && done < n; iB++) {
+		const VTKCellBlock& block = blocks[iB];
+		size_t perCell = 1;
+		if (array.kind == VTKArray::eConn) perCell = block.nPts;
+		else if (array.kind == VTKArray::eLegacyCells) perCell = block.nPts + 1;
+		const size_t blockLen = block.count * perCell;
+		if (first >= blockLen) {
+			first -= blockLen;
+			connBefore += block.count * block.nPts;
+			continue;
+		}
+		const size_t num = std::min(blockLen - first, n - done);
+		switch (array.kind) {
+			case VTKArray::eConn:
+				memcpy(out + done * sizeof(emInt), block.conn + first,
+								num * sizeof(emInt));
+				break;
+			case VTKArray::eOffsets: {
+				// Offsets are to the end of each cell's connectivity.
+				int64_t* const offsets = reinterpret_cast<int64_t*>(out) + done;
+#pragma omp simd
+				for (size_t ii = 0; ii < num; ii++) {
+					offsets[ii] = connBefore + (first + ii + 1) * block.nPts;
+				}
+				break;
+			}
+			case VTKArray::eTypes:
+				memset(out + done, block.type, num);
+				break;
+			case VTKArray::eLegacyTypes: {
+				uint32_t* const types = reinterpret_cast<uint32_t*>(out) + done;
+				std::fill(types, types + num, uint32_t(block.type));
+				break;
+			}
+			case VTKArray::eLegacyCells: {
+				// Each cell is its vert count followed by its verts.
+				uint32_t* const entries = reinterpret_cast<uint32_t*>(out) + done;
+				size_t cell = first / perCell;
+				size_t pos = first % perCell;
+				for (size_t ii = 0; ii < num; ii++) {
+					entries[ii] =
+							(pos == 0) ? block.nPts : block.conn[cell * block.nPts + pos - 1];
+					if (++pos == perCell) {
+						pos = 0;
+						cell++;
+					}
+				}
+				break;
+			}
+			default:
+				assert(0);
+		}
+		done += num;
+		first = 0;
+		connBefore += block.count * block.nPts;
+	}
+	assert(done == n);
+}
+
+static void fillArray(const VTKArray& array, const void* coords,
+		const VTKCellBlock blocks[], const int nBlocks, const size_t first,
+		const size_t n, char* out) {
+	if (array.kind == VTKArray::ePoints
+			|| array.kind == VTKArray::eLegacyPoints) {
+		memcpy(out, reinterpret_cast<const char*>(coords) + 8 * first, 8 * n);
+		if (array.kind == VTKArray::eLegacyPoints
+				&& __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) {
+			swapBytes8(out, n);
+		}
+	}
+	else {
+		fillCellArray(array, blocks, nBlocks, first, n, out);
+		if ((array.kind == VTKArray::eLegacyCells
+				|| array.kind == VTKArray::eLegacyTypes)
+				&& __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) {
+			swapBytes4(out, n);
+		}
+	}
+}
+
+// Generate all the arrays in chunks, in parallel, writing each chunk at its
+// place in the file.
+static bool writeArrays(const int fd, const std::vector<VTKArray>& arrays,
+		const void* coords, const VTKCellBlock blocks[], const int nBlocks) {
+	std::vector<std::pair<int, size_t> > chunks;
+	for (size_t iA = 0; iA < arrays.size(); iA++) {
+		const size_t perChunk = chunkBytes / arrays[iA].elemBytes;
+		for (size_t first = 0; first < arrays[iA].count; first += perChunk) {
+			chunks.push_back(std::make_pair(int(iA), first));
+		}
+	}
+
+	bool allWritten = true;
+#pragma omp parallel reduction(&&: allWritten)
+	{
+		std::vector<uint64_t> staging(chunkBytes / 8);
+		char* const out = reinterpret_cast<char*>(staging.data());
+#pragma omp for schedule(dynamic)
+		for (size_t ii = 0; ii < chunks.size(); ii++) {
+			const VTKArray& array = arrays[chunks[ii].first];
+			const size_t first = chunks[ii].second;
+			const size_t count = std::min(chunkBytes / array.elemBytes,
+																		array.count - first);
+			fillArray(array, coords, blocks, nBlocks, first, count, out);
+			allWritten = pwriteAll(fd, out, count * array.elemBytes,
+															array.offset + first * array.elemBytes)
+					&& allWritten;
+		}
+	}
+	return allWritten;
+}
+
+static int openForWriting(const char fileName[]) {
+	int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd < 0) {
+		fprintf(stderr, "Couldn't open file %s for writing.  Bummer!\n", fileName);
+	}
+	return fd;
+}
+
+static bool finishWriting(const int fd, const bool allWritten,
+		const char fileName[]) {
+	close(fd);
+	if (!allWritten) {
+		fprintf(stderr, "Couldn't write all of file %s.  Bummer!\n", fileName);
+	}
+	return allWritten;
+}
+
+bool writeVTKLegacyFile(const char fileName[], const void* coords,
+		const size_t nVerts, const VTKCellBlock blocks[], const int nBlocks) {
+	// Legacy files store everything as 32-bit signed ints.
+	if (nVerts > INT32_MAX) {
+		fprintf(stderr, "Too many verts for a legacy VTK file %s.\n", fileName);
+		return false;
+	}
+	size_t nCells = 0, nEntries = 0;
+	for (int iB = 0; iB < nBlocks; iB++) {
+		nCells += blocks[iB].count;
+		nEntries += blocks[iB].count * (blocks[iB].nPts + 1);
+	}
+
+	char headers[3][200];
+	snprintf(headers[0], sizeof(headers[0]),
+						"# vtk DataFile Version 3.0\nExaMesh output\nBINARY\n"
+						"DATASET UNSTRUCTURED_GRID\nPOINTS %zu double\n",
+						nVerts);
+	snprintf(headers[1], sizeof(headers[1]), "\nCELLS %zu %zu\n", nCells,
+						nEntries);
+	snprintf(headers[2], sizeof(headers[2]), "\nCELL_TYPES %zu\n", nCells);
+	const char trailer[] = "\n";
+
+	std::vector<VTKArray> arrays = { { VTKArray::eLegacyPoints, 3 * nVerts, 8,
+																		0 },
+																		{ VTKArray::eLegacyCells, nEntries, 4, 0 },
+																		{ VTKArray::eLegacyTypes, nCells, 4, 0 } };
+	off_t headerOffsets[3];
+	off_t offset = 0;
+	for (int ii = 0; ii < 3; ii++) {
+		headerOffsets[ii] = offset;
+		offset += strlen(headers[ii]);
+		arrays[ii].offset = offset;
+		offset += arrays[ii].count * arrays[ii].elemBytes;
+	}
+
+	int fd = openForWriting(fileName);
+	if (fd < 0) return false;
+	bool allWritten = true;
+	for (int ii = 0; ii < 3; ii++) {
+		allWritten = pwriteAll(fd, headers[ii], strlen(headers[ii]),
+														headerOffsets[ii]) && allWritten;
+	}
+	allWritten = pwriteAll(fd, trailer, strlen(trailer), offset) && allWritten;
+	allWritten = writeArrays(fd, arrays, coords, blocks, nBlocks)
+			&& allWritten;
+	return finishWriting(fd, allWritten, fileName);
+}
+
+// The XML header for a .vtu file with the four arrays appended at the
+// given offsets (which are relative to the start of the appended data).
+static std::string vtuHeader(const size_t nVerts, const size_t nCells,
+		const off_t offsets[4], const bool compressed) {
+	char header[2048];
+	snprintf(header, sizeof(header),
+						"<?xml version=\"1.0\"?>\n"
+						"<VTKFile type=\"UnstructuredGrid\" version=\"1.0\" "
+						"byte_order=\"%s\" header_type=\"UInt64\"%s>\n"
+						"  <UnstructuredGrid>\n"
+						"    <Piece NumberOfPoints=\"%zu\" NumberOfCells=\"%zu\">\n"
+						"      <Points>\n"
+						"        <DataArray type=\"Float64\" NumberOfComponents=\"3\" "
+						"format=\"appended\" offset=\"%ld\"/>\n"
+						"      </Points>\n"
+						"      <Cells>\n"
+						"        <DataArray type=\"%s\" Name=\"connectivity\" "
+						"format=\"appended\" offset=\"%ld\"/>\n"
+						"        <DataArray type=\"Int64\" Name=\"offsets\" "
+						"format=\"appended\" offset=\"%ld\"/>\n"
+						"        <DataArray type=\"UInt8\" Name=\"types\" "
+						"format=\"appended\" offset=\"%ld\"/>\n"
+						"      </Cells>\n"
+						"    </Piece>\n"
+						"  </UnstructuredGrid>\n"
+						"  <AppendedData encoding=\"raw\">\n"
+						"_",
+						__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__ ?
+								"BigEndian" : "LittleEndian",
+						compressed ? " compressor=\"vtkZLibDataCompressor\"" : "",
+						nVerts, nCells, long(offsets[0]),
+						sizeof(emInt) == 8 ? "UInt64" : "UInt32", long(offsets[1]),
+						long(offsets[2]), long(offsets[3]));
+	return std::string(header);
+}
+
+static const char vtuTrailer[] = "\n  </AppendedData>\n</VTKFile>\n";
+
+#if (HAVE_LIBZ == 1)
+// Compressed arrays are a header (number of blocks, block size, size of
+// the last block if it's partial, and the compressed size of each block)
+// followed by the blocks.  The compressed sizes aren't known until the
+// blocks are compressed, so all of them are compressed (in parallel) before
+// anything is written.
+static bool writeCompressedVTU(const int fd,
+		const std::vector<VTKArray>& arrays,
+		const void* coords, const size_t nVerts, const size_t nCells,
+		const VTKCellBlock blocks[], const int nBlocks) {
+	std::vector<std::pair<int, size_t> > chunks;
+	std::vector<size_t> firstChunk(arrays.size() + 1);
+	for (size_t iA = 0; iA < arrays.size(); iA++) {
+		firstChunk[iA] = chunks.size();
+		const size_t perChunk = chunkBytes / arrays[iA].elemBytes;
+		for (size_t first = 0; first < arrays[iA].count; first += perChunk) {
+			chunks.push_back(std::make_pair(int(iA), first));
+		}
+	}
+	firstChunk[arrays.size()] = chunks.size();
+
+	std::vector<std::vector<Bytef> > compressed(chunks.size());
+	bool allCompressed = true;
+#pragma omp parallel reduction(&&: allCompressed)
+	{
+		std::vector<uint64_t> staging(chunkBytes / 8);
+		char* const out = reinterpret_cast<char*>(staging.data());
+#pragma omp for schedule(dynamic)
+		for (size_t ii = 0; ii < chunks.size(); ii++) {
+			const VTKArray& array = arrays[chunks[ii].first];
+			const size_t first = chunks[ii].second;
+			const size_t count = std::min(chunkBytes / array.elemBytes,
+																		array.count - first);
+			fillArray(array, coords, blocks, nBlocks, first, count, out);
+			const uLong bytes = count * array.elemBytes;
+			uLongf compBytes = compressBound(bytes);
+			compressed[ii].resize(compBytes);
+			// Visualization output is written far more often than it's read,
+			// so favor speed over size.
+			allCompressed = (compress2(compressed[ii].data(), &compBytes,
+																	reinterpret_cast<const Bytef*>(out), bytes,
+																	Z_BEST_SPEED) == Z_OK) && allCompressed;
+			compressed[ii].resize(compBytes);
+		}
+	}
+	if (!allCompressed) return false;
+
+	// Now lay out the file.
+	std::vector<std::vector<uint64_t> > compHeaders(arrays.size());
+	std::vector<off_t> chunkOffsets(chunks.size());
+	off_t relOffsets[4];
+	off_t offset = 0;
+	for (size_t iA = 0; iA < arrays.size(); iA++) {
+		const size_t nChunks = firstChunk[iA + 1] - firstChunk[iA];
+		std::vector<uint64_t>& compHeader = compHeaders[iA];
+		compHeader.push_back(nChunks);
+		compHeader.push_back(chunkBytes);
+		compHeader.push_back((arrays[iA].count * arrays[iA].elemBytes) % chunkBytes);
+		for (size_t ii = firstChunk[iA]; ii < firstChunk[iA + 1]; ii++) {
+			compHeader.push_back(compressed[ii].size());
+		}
+		relOffsets[iA] = offset;
+		offset += compHeader.size() * sizeof(uint64_t);
+		for (size_t ii = firstChunk[iA]; ii < firstChunk[iA + 1]; ii++) {
+			chunkOffsets[ii] = offset;
+			offset += compressed[ii].size();
+		}
+	}
+	const std::string header = vtuHeader(nVerts, nCells, relOffsets, true);
+	const off_t dataStart = header.size();
+
+	bool allWritten = pwriteAll(fd, header.data(), header.size(), 0)
+			&& pwriteAll(fd, vtuTrailer, strlen(vtuTrailer), dataStart + offset);
+	for (size_t iA = 0; iA < arrays.size(); iA++) {
+		allWritten = pwriteAll(fd,
+														reinterpret_cast<const char*>(compHeaders[iA].data()),
+														compHeaders[iA].size() * sizeof(uint64_t),
+														dataStart + relOffsets[iA]) && allWritten;
+	}
+#pragma omp parallel for schedule(dynamic) reduction(&&: allWritten)
+	for (size_t ii = 0; ii < chunks.size(); ii++) {
+		allWritten = pwriteAll(fd,
+														reinterpret_cast<const char*>(compressed[ii].data()),
+														compressed[ii].size(), dataStart + chunkOffsets[ii])
+				&& allWritten;
+	}
+	return allWritten;
+}
+#endif
+
+bool writeVTUFile(const char fileName[], const void* coords,
+		const size_t nVerts, const VTKCellBlock blocks[], const int nBlocks,
+		const bool compress) {
+	size_t nCells = 0, nConn = 0;
+	for (int iB = 0; iB < nBlocks; iB++) {
+		nCells += blocks[iB].count;
+		nConn += blocks[iB].count * blocks[iB].nPts;
+	}
+	std::vector<VTKArray> arrays = { { VTKArray::ePoints, 3 * nVerts, 8, 0 }, {
+			VTKArray::eConn, nConn, sizeof(emInt), 0 },
+																		{ VTKArray::eOffsets, nCells, 8, 0 }, {
+																				VTKArray::eTypes, nCells, 1, 0 } };
+
+	int fd = openForWriting(fileName);
+	if (fd < 0) return false;
+
+	if (compress) {
+#if (HAVE_LIBZ == 1)
+		bool allWritten = writeCompressedVTU(fd, arrays, coords, nVerts, nCells,
+																					blocks, nBlocks);
+		return finishWriting(fd, allWritten, fileName);
+#else
+		fprintf(stderr, "Not compiled with zlib; writing %s uncompressed.\n",
+						fileName);
+#endif
+	}
+
+	// Uncompressed arrays are preceded by their size in bytes.
+	uint64_t sizes[4];
+	off_t relOffsets[4];
+	off_t offset = 0;
+	for (int iA = 0; iA < 4; iA++) {
+		sizes[iA] = arrays[iA].count * arrays[iA].elemBytes;
+		relOffsets[iA] = offset;
+		offset += sizeof(uint64_t) + sizes[iA];
+	}
+	const std::string header = vtuHeader(nVerts, nCells, relOffsets, false);
+	const off_t dataStart = header.size();
+	for (int iA = 0; iA < 4; iA++) {
+		arrays[iA].offset = dataStart + relOffsets[iA] + sizeof(uint64_t);
+	}
+
+	bool allWritten = pwriteAll(fd, header.data(), header.size(), 0)
+			&& pwriteAll(fd, vtuTrailer, strlen(vtuTrailer), dataStart + offset);
+	for (int iA = 0; iA < 4; iA++) {
+		allWritten = pwriteAll(fd, reinterpret_cast<const char*>(sizes + iA),
+														sizeof(uint64_t), dataStart + relOffsets[iA])
+				&& allWritten;
+	}
+	allWritten = writeArrays(fd, arrays, coords, blocks, nBlocks)
+			&& allWritten;
+	return finishWriting(fd, allWritten, fileName);
+}
+
+static inline bool isBlank(const char c) {
+	return c == ' ' || c == '\n' || c == '\t' || c == '\r';
+}
+
+static int numParseThreads() {
+#ifdef _OPENMP
+	return omp_get_max_threads();
+#else
+	return 1;
+#endif
+}
+
+std::vector<size_t> findVTKKeywordLines(const char* text, const size_t size) {
+	const int nPieces = numParseThreads();
+	std::vector<std::vector<size_t> > found(nPieces);
+#pragma omp parallel for schedule(static)
+	for (int iP = 0; iP < nPieces; iP++) {
+		const size_t begin = size * iP / nPieces;
+		const size_t end = size * (iP + 1) / nPieces;
+		const char* cp = text + begin;
+		const char* const pieceEnd = text + end;
+		if (begin == 0 && size > 0 && isupper((unsigned char) text[0])) {
+			found[iP].push_back(0);
+		}
+		while ((cp = reinterpret_cast<const char*>(memchr(cp, '\n',
+																											pieceEnd - cp)))) {
+			cp++;
+			if (cp < text + size && isupper((unsigned char) *cp)) {
+				found[iP].push_back(cp - text);
+			}
+		}
+	}
+	std::vector<size_t> lines;
+	for (const std::vector<size_t>& piece : found) {
+		lines.insert(lines.end(), piece.begin(), piece.end());
+	}
+	return lines;
+}
+
+template<typename T>
+static bool parseNumber(const char*& cp, const char* const end, T& value) {
+	if (*cp == '+') cp++;
+	std::from_chars_result result = std::from_chars(cp, end, value);
+	if (result.ec != std::errc() || (result.ptr < end && !isBlank(*result.ptr))) {
+		return false;
+	}
+	cp = result.ptr;
+	return true;
+}
+
+// Split the text at whitespace into pieces, count the numbers in each
+// piece, and then parse each piece straight into its place in out.
+template<typename T>
+static bool parseNumbers(const char* const begin, const char* const end,
+		const size_t count, char* out, const size_t pieceBytes) {
+	assert(pieceBytes > 0);
+	const size_t length = end - begin;
+	const int nPieces = std::max(
+			1, int(std::min(size_t(8 * numParseThreads()), length / pieceBytes)));
+	std::vector<const char*> starts(nPieces + 1);
+	starts[0] = begin;
+	starts[nPieces] = end;
+	for (int iP = 1; iP < nPieces; iP++) {
+		const char* cp = std::max(begin + length * iP / nPieces, starts[iP - 1]);
+		while (cp < end && !isBlank(*cp)) {
+			cp++;
+		}
+		starts[iP] = cp;
+	}
+
+	std::vector<size_t> firsts(nPieces + 1, 0);
+#pragma omp parallel for schedule(dynamic)
+	for (int iP = 0; iP < nPieces; iP++) {
+		size_t num = 0;
+		bool inBlank = true;
+		for (const char* cp = starts[iP]; cp < starts[iP + 1]; cp++) {
+			const bool blank = isBlank(*cp);
+			num += (inBlank && !blank);
+			inBlank = blank;
+		}
+		firsts[iP + 1] = num;
+	}
+	for (int iP = 0; iP < nPieces; iP++) {
+		firsts[iP + 1] += firsts[iP];
+	}
+	if (firsts[nPieces] != count) return false;
+
+	bool ok = true;
+#pragma omp parallel for schedule(dynamic) reduction(&&: ok)
+	for (int iP = 0; iP < nPieces; iP++) {
+		const char* cp = starts[iP];
+		const char* const pieceEnd = starts[iP + 1];
+		char* dst = out + firsts[iP] * sizeof(T);
+		for (size_t ii = firsts[iP]; ok && ii < firsts[iP + 1]; ii++) {
+			while (isBlank(*cp)) {
+				cp++;
+			}
+			T value = 0;
+			ok = parseNumber(cp, pieceEnd, value);
+			if (ok) memcpy(dst, &value, sizeof(T));
+			dst += sizeof(T);
+		}
+	}
+	return ok;
+}
+
+bool parseVTKReals(const char* begin, const char* end, const size_t count,
+		void* out, const size_t pieceBytes) {
+	return parseNumbers<double>(begin, end, count, reinterpret_cast<char*>(out),
+															pieceBytes);
+}
+
+bool parseVTKInts(const char* begin, const char* end, const size_t count,
+		emInt* out, const size_t pieceBytes) {
+	return parseNumbers<emInt>(begin, end, count, reinterpret_cast<char*>(out),
+															pieceBytes);
+}
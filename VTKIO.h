@@ -0,0 +1,79 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+/*
+ * VTKIO.h
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#ifndef SRC_VTKIO_H_
+#define SRC_VTKIO_H_
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "exa-defs.h"
+
+// VTK cell types.
+enum {
+	VTK_TRI = 5, VTK_QUAD = 9, VTK_TET = 10, VTK_HEX = 12, VTK_PRISM = 13,
+	VTK_PYR = 14
+};
+
+// A run of cells of one type, as VTK sees them.  VTK's vertex ordering is
+// the same as ours, so conn is just the mesh's connectivity array.
+struct VTKCellBlock {
+	const emInt* conn;
+	size_t count;
+	int nPts;
+	unsigned char type;
+};
+
+// Both writers generate everything (including cell types and offsets) in
+// chunks, in parallel, and write each chunk at its own offset.  coords
+// holds 3 * nVerts doubles, and need only be 4-byte aligned.
+
+// Legacy VTK, binary (and so big-endian).
+bool writeVTKLegacyFile(const char fileName[], const void* coords,
+		const size_t nVerts, const VTKCellBlock blocks[], const int nBlocks);
+
+// XML unstructured grid (.vtu) with raw appended data.  If compress is
+// true, each array is written as independently zlib-compressed blocks;
+// without zlib, the data is written uncompressed.
+bool writeVTUFile(const char fileName[], const void* coords,
+		const size_t nVerts, const VTKCellBlock blocks[], const int nBlocks,
+		const bool compress);
+
+// Parallel parsing of ASCII legacy VTK files, which the caller has mapped.
+
+// Offsets of the lines in the text that start with an uppercase letter; in
+// a legacy VTK file, these are the keyword lines.
+std::vector<size_t> findVTKKeywordLines(const char* text, const size_t size);
+
+// Parse exactly count whitespace-separated numbers from [begin, end), in
+// parallel; return false if that isn't what's there.  Reals are stored as
+// doubles, which need only be 4-byte aligned.  The text is split into
+// pieces of at least pieceBytes (but no more than eight per thread).
+bool parseVTKReals(const char* begin, const char* end, const size_t count,
+		void* out, const size_t pieceBytes = 65536);
+bool parseVTKInts(const char* begin, const char* end, const size_t count,
+		emInt* out, const size_t pieceBytes = 65536);
+
+#endif /* SRC_VTKIO_H_ */
@@ -0,0 +1,738 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*
+ * VirtualFineMesh.cxx
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <utility>
+
+#include "BdryQuadDivider.h"
+#include "BdryTriDivider.h"
+#include "CellTraits.h"
+#include "HexDivider.h"
+#include "PrismDivider.h"
+#include "PyrDivider.h"
+#include "RefineSink.h"
+#include "TetDivider.h"
+#include "VirtualFineMesh.h"
+
+struct VirtualFineMesh::Cache {
+	// The fine verts and cells made from one coarse cell or bdry face, with
+	// cells of each type stored under their UGRID header entry.
+	struct RefinedCell {
+		int type;
+		emInt cell, firstVert, nVerts;
+		std::vector<double> coords;
+		std::vector<emInt> conn[7];
+		RefinedCell() :
+				type(-1), cell(EMINT_MAX), firstVert(0), nVerts(0) {
+		}
+	};
+
+	// Where the dividers put what they make:  the slot being filled.  The
+	// coords of all other verts come from the virtual mesh itself.
+	class Filler: public RefineSink {
+		template<int nPts>
+		emInt append(const int type, const emInt verts[][nPts], const emInt nNew) {
+			std::vector<emInt>& conn = slot->conn[type];
+			const emInt first = conn.size() / nPts;
+			conn.insert(conn.end(), verts[0], verts[0] + nPts * nNew);
+			return first;
+		}
+	public:
+		const VirtualFineMesh* mesh;
+		RefinedCell* slot;
+		Filler(const VirtualFineMesh* VFM) :
+				mesh(VFM), slot(nullptr) {
+		}
+		emInt addVert(const double newCoords[3]) {
+			slot->coords.insert(slot->coords.end(), newCoords, newCoords + 3);
+			return slot->firstVert + slot->nVerts++;
+		}
+		void getCoords(const emInt vert, double coords[3]) const {
+			if (vert >= slot->firstVert && vert - slot->firstVert < slot->nVerts) {
+				const double* xyz = slot->coords.data() + 3 * (vert - slot->firstVert);
+				coords[0] = xyz[0];
+				coords[1] = xyz[1];
+				coords[2] = xyz[2];
+			}
+			else {
+				mesh->getCoords(vert, coords);
+			}
+		}
+		emInt addBdryTris(const emInt verts[][3], const emInt nNew) {
+			return append<3>(1, verts, nNew);
+		}
+		emInt addBdryQuads(const emInt verts[][4], const emInt nNew) {
+			return append<4>(2, verts, nNew);
+		}
+		emInt addTets(const emInt verts[][4], const emInt nNew) {
+			return append<4>(3, verts, nNew);
+		}
+		emInt addPyramids(const emInt verts[][5], const emInt nNew) {
+			return append<5>(4, verts, nNew);
+		}
+		emInt addPrisms(const emInt verts[][6], const emInt nNew) {
+			return append<6>(5, verts, nNew);
+		}
+		emInt addHexes(const emInt verts[][8], const emInt nNew) {
+			return append<8>(6, verts, nNew);
+		}
+		emInt numCells() const {
+			return slot->conn[3].size() / 4 + slot->conn[4].size() / 5
+					+ slot->conn[5].size() / 6 + slot->conn[6].size() / 8;
+		}
+	};
+
+	enum {
+		nSlots = 4
+	};
+	RefinedCell slots[nSlots];
+	int nextSlot;
+	Filler filler;
+	exa_map<Edge, EdgeVerts> vertsOnEdges;
+	exa_set<TriFaceVerts> vertsOnTris;
+	exa_set<QuadFaceVerts> vertsOnQuads;
+	FaceVertArena triArena, quadArena;
+	TetDivider<0> TD;
+	PyrDivider<0> PD;
+	PrismDivider<0> PrismD;
+	HexDivider<0> HD;
+	BdryTriDivider<0> BTD;
+	BdryQuadDivider<0> BQD;
+	// Edge and face verts are placed by dividers of their own, set up for
+	// the owning cell, since that can happen in the middle of refining some
+	// other cell.
+	TetDivider<0> coordTD;
+	PyrDivider<0> coordPD;
+	PrismDivider<0> coordPrismD;
+	HexDivider<0> coordHD;
+	emInt coordCell[4];
+
+	Cache(const VirtualFineMesh* VFM, const ExaMesh* coarse, const int nDivs) :
+			nextSlot(0), filler(VFM), TD(&filler, coarse, nDivs),
+					PD(&filler, coarse, nDivs), PrismD(&filler, coarse, nDivs),
+					HD(&filler, coarse, nDivs), BTD(&filler, coarse, nDivs),
+					BQD(&filler, coarse, nDivs), coordTD(nullptr, coarse, nDivs),
+					coordPD(nullptr, coarse, nDivs),
+					coordPrismD(nullptr, coarse, nDivs),
+					coordHD(nullptr, coarse, nDivs) {
+		std::fill(coordCell, coordCell + 4, EMINT_MAX);
+		triArena.setBlockSize(TriFaceVerts::numIntVerts(nDivs));
+		quadArena.setBlockSize(QuadFaceVerts::numIntVerts(nDivs));
+		TD.setFaceArenas(triArena, quadArena);
+		PD.setFaceArenas(triArena, quadArena);
+		PrismD.setFaceArenas(triArena, quadArena);
+		HD.setFaceArenas(triArena, quadArena);
+		BTD.setFaceArenas(triArena, quadArena);
+		BQD.setFaceArenas(triArena, quadArena);
+	}
+
+	const RefinedCell& get(const VirtualFineMesh& VFM, const int type,
+			const emInt cell);
+
+	template<typename Divider>
+	Divider& setupOwner(Divider& D, const VirtualFineMesh& VFM, const int type,
+			const emInt cell) {
+		if (coordCell[type] != cell) {
+			D.setupCoordMapping(VFM.coarseConn(type, cell));
+			coordCell[type] = cell;
+		}
+		return D;
+	}
+
+	// Call func with a divider set up for the owner of CE.
+	template<typename Func>
+	void withOwner(const VirtualFineMesh& VFM, const CoarseEntity& CE,
+			Func func) {
+		switch (CE.ownerType) {
+			case eTet:
+				func(setupOwner(coordTD, VFM, eTet, CE.ownerCell));
+				break;
+			case ePyr:
+				func(setupOwner(coordPD, VFM, ePyr, CE.ownerCell));
+				break;
+			case ePrism:
+				func(setupOwner(coordPrismD, VFM, ePrism, CE.ownerCell));
+				break;
+			case eHex:
+				func(setupOwner(coordHD, VFM, eHex, CE.ownerCell));
+				break;
+			default:
+				assert(0);
+		}
+	}
+};
+
+const VirtualFineMesh::Cache::RefinedCell& VirtualFineMesh::Cache::get(
+		const VirtualFineMesh& VFM, const int type, const emInt cell) {
+	for (const RefinedCell& RC : slots) {
+		if (RC.type == type && RC.cell == cell) return RC;
+	}
+	RefinedCell& RC = slots[nextSlot];
+	nextSlot = (nextSlot + 1) % nSlots;
+	RC.type = type;
+	RC.cell = cell;
+	RC.firstVert =
+			type <= eHex ?
+					VFM.m_firstCellVert[type] + cell * VFM.m_vertsPerCell[type] : 0;
+	RC.nVerts = 0;
+	RC.coords.clear();
+	for (std::vector<emInt>& conn : RC.conn) {
+		conn.clear();
+	}
+	filler.slot = &RC;
+
+	const emInt* const verts = VFM.coarseConn(type, cell);
+	switch (type) {
+		case eTet:
+			VFM.prepareCell<TetTraits>(verts, *this);
+			TD.refineCell(verts, vertsOnEdges, vertsOnTris, vertsOnQuads);
+			break;
+		case ePyr:
+			VFM.prepareCell<PyrTraits>(verts, *this);
+			PD.refineCell(verts, vertsOnEdges, vertsOnTris, vertsOnQuads);
+			break;
+		case ePrism:
+			VFM.prepareCell<PrismTraits>(verts, *this);
+			PrismD.refineCell(verts, vertsOnEdges, vertsOnTris, vertsOnQuads);
+			break;
+		case eHex:
+			VFM.prepareCell<HexTraits>(verts, *this);
+			HD.refineCell(verts, vertsOnEdges, vertsOnTris, vertsOnQuads);
+			break;
+		case eBdryTri:
+			VFM.prepareCell<BdryTriTraits>(verts, *this);
+			BTD.refineCell(verts, vertsOnEdges, vertsOnTris, vertsOnQuads);
+			break;
+		case eBdryQuad:
+			VFM.prepareCell<BdryQuadTraits>(verts, *this);
+			BQD.refineCell(verts, vertsOnEdges, vertsOnTris, vertsOnQuads);
+			break;
+		default:
+			assert(0);
+	}
+	assert(type > eHex || RC.nVerts == VFM.m_vertsPerCell[type]);
+
+	// Every face was found, so the dividers have already freed and removed
+	// them all.
+	assert(vertsOnTris.empty() && vertsOnQuads.empty());
+	vertsOnEdges.clear();
+	return RC;
+}
+
+bool VirtualFineMesh::CoarseEntity::operator<(const CoarseEntity& CE) const {
+	for (int ii = 0; ii < 4; ii++) {
+		if (verts[ii] != CE.verts[ii]) return verts[ii] < CE.verts[ii];
+	}
+	if (ownerType != CE.ownerType) return ownerType < CE.ownerType;
+	return ownerCell < CE.ownerCell;
+}
+
+static bool sameVerts(const emInt a[4], const emInt b[4]) {
+	return std::equal(a, a + 4, b);
+}
+
+VirtualFineMesh::VirtualFineMesh(const ExaMesh& coarse, const int nDivs) :
+		m_coarse(coarse), m_nDivs(nDivs) {
+	assert(nDivs >= 1);
+	collectEntities<TetTraits>(eTet, coarse.numTets());
+	collectEntities<PyrTraits>(ePyr, coarse.numPyramids());
+	collectEntities<PrismTraits>(ePrism, coarse.numPrisms());
+	collectEntities<HexTraits>(eHex, coarse.numHexes());
+	// Each edge and face is owned by the first cell in the sorted list that
+	// has it.
+	for (std::vector<CoarseEntity>* entities : { &m_edges, &m_triFaces,
+																								&m_quadFaces }) {
+		std::sort(entities->begin(), entities->end());
+		entities->erase(
+				std::unique(entities->begin(), entities->end(),
+										[](const CoarseEntity& a, const CoarseEntity& b) {
+											return sameVerts(a.verts, b.verts);
+										}),
+				entities->end());
+		entities->shrink_to_fit();
+	}
+
+	const size_t n = nDivs;
+	m_vertsPerEdge = n - 1;
+	m_vertsPerTri = (n - 1) * (n - 2) / 2;
+	m_vertsPerQuad = (n - 1) * (n - 1);
+	// Signed, for nDivs = 1.
+	const long nn = nDivs;
+	m_vertsPerCell[eTet] = (nn - 1) * (nn - 2) * (nn - 3) / 6;
+	m_vertsPerCell[ePyr] = (2 * nn - 3) * (nn - 2) * (nn - 1) / 6;
+	m_vertsPerCell[ePrism] = (nn - 1) * (nn - 1) * (nn - 2) / 2;
+	m_vertsPerCell[eHex] = (nn - 1) * (nn - 1) * (nn - 1);
+	m_tetsPerTet = n * n * n;
+	m_tetsPerPyr = (n * n * n - n) * 2 / 3;
+	m_pyrsPerPyr = (2 * n * n * n + n) / 3;
+	m_cellsPerCell = n * n * n;
+	m_facesPerFace = n * n;
+
+	size_t first = coarse.numVertsToCopy();
+	const size_t firstEdgeVert = first;
+	first += m_edges.size() * m_vertsPerEdge;
+	const size_t firstTriVert = first;
+	first += m_triFaces.size() * m_vertsPerTri;
+	const size_t firstQuadVert = first;
+	first += m_quadFaces.size() * m_vertsPerQuad;
+	size_t firstCellVert[5];
+	const emInt nCells[] = { coarse.numTets(), coarse.numPyramids(),
+														coarse.numPrisms(), coarse.numHexes() };
+	for (int type = eTet; type <= eHex; type++) {
+		firstCellVert[type] = first;
+		first += size_t(nCells[type]) * m_vertsPerCell[type];
+	}
+	firstCellVert[4] = first;
+
+	const size_t counts[] = { first, coarse.numBdryTris() * size_t(
+			m_facesPerFace), coarse.numBdryQuads() * size_t(m_facesPerFace),
+														nCells[eTet] * size_t(m_tetsPerTet)
+																+ nCells[ePyr] * size_t(m_tetsPerPyr),
+														nCells[ePyr] * size_t(m_pyrsPerPyr),
+														nCells[ePrism] * size_t(m_cellsPerCell),
+														nCells[eHex] * size_t(m_cellsPerCell) };
+	for (const size_t count : counts) {
+		if (count > EMINT_MAX) {
+			fprintf(stderr, "Refined mesh is too big to index with emInt.\n");
+			exit(1);
+		}
+	}
+	m_firstEdgeVert = firstEdgeVert;
+	m_firstTriVert = firstTriVert;
+	m_firstQuadVert = firstQuadVert;
+	for (int ii = 0; ii < 5; ii++) {
+		m_firstCellVert[ii] = firstCellVert[ii];
+	}
+	m_size.nVerts = counts[0];
+	m_size.nBdryTris = counts[1];
+	m_size.nBdryQuads = counts[2];
+	m_size.nTets = counts[3];
+	m_size.nPyrs = counts[4];
+	m_size.nPrisms = counts[5];
+	m_size.nHexes = counts[6];
+	countBdryVerts();
+
+#ifdef _OPENMP
+	m_caches.resize(std::max(omp_get_max_threads(), omp_get_num_procs()));
+#else
+	m_caches.resize(1);
+#endif
+}
+
+VirtualFineMesh::Cache& VirtualFineMesh::cache() const {
+	// In an inactive nested region, every thread is thread 0 of its own team,
+	// so threads are told apart by their number in the one active region.
+	size_t thread = 0;
+#ifdef _OPENMP
+	int nActive = 0;
+	for (int level = 1; level <= omp_get_level(); level++) {
+		if (omp_get_team_size(level) > 1) {
+			thread = omp_get_ancestor_thread_num(level);
+			nActive++;
+		}
+	}
+	if (nActive > 1 || thread >= m_caches.size()) {
+		fprintf(stderr, "Too many threads reading a virtual fine mesh.\n");
+		exit(1);
+	}
+#endif
+	std::unique_ptr<Cache>& C = m_caches[thread];
+	if (!C) C.reset(new Cache(this, &m_coarse, m_nDivs));
+	return *C;
+}
+
+VirtualFineMesh::~VirtualFineMesh() {
+}
+
+const emInt* VirtualFineMesh::coarseConn(const int type,
+		const emInt cell) const {
+	switch (type) {
+		case eTet:
+			return m_coarse.getTetConn(cell);
+		case ePyr:
+			return m_coarse.getPyrConn(cell);
+		case ePrism:
+			return m_coarse.getPrismConn(cell);
+		case eHex:
+			return m_coarse.getHexConn(cell);
+		case eBdryTri:
+			return m_coarse.getBdryTriConn(cell);
+		case eBdryQuad:
+			return m_coarse.getBdryQuadConn(cell);
+		default:
+			assert(0);
+			return nullptr;
+	}
+}
+
+template<typename Traits>
+void VirtualFineMesh::collectEntities(const int type, const emInt nCells) {
+	for (emInt cell = 0; cell < nCells; cell++) {
+		const emInt* const verts = coarseConn(type, cell);
+		CoarseEntity CE;
+		CE.ownerCell = cell;
+		CE.ownerType = type;
+		for (int iE = 0; iE < Traits::numEdges; iE++) {
+			const Edge E(verts[Traits::edgeVerts[iE][0]],
+										verts[Traits::edgeVerts[iE][1]]);
+			CE.verts[0] = E.getV0();
+			CE.verts[1] = E.getV1();
+			CE.verts[2] = CE.verts[3] = EMINT_MAX;
+			CE.ownerLocal = iE;
+			m_edges.push_back(CE);
+		}
+		for (int iF = 0; iF < Traits::numQuadFaces; iF++) {
+			const int* const FV = Traits::faceVerts[iF];
+			const emInt corners[] = { verts[FV[0]], verts[FV[1]], verts[FV[2]],
+																verts[FV[3]] };
+			sortVerts4(corners, CE.verts);
+			CE.ownerLocal = iF;
+			m_quadFaces.push_back(CE);
+		}
+		for (int iF = Traits::numQuadFaces;
+				iF < Traits::numQuadFaces + Traits::numTriFaces; iF++) {
+			const int* const FV = Traits::faceVerts[iF];
+			const emInt corners[] = { verts[FV[0]], verts[FV[1]], verts[FV[2]] };
+			sortVerts3(corners, CE.verts);
+			CE.verts[3] = EMINT_MAX;
+			CE.ownerLocal = iF;
+			m_triFaces.push_back(CE);
+		}
+	}
+}
+
+size_t VirtualFineMesh::findEntity(const std::vector<CoarseEntity>& entities,
+		const emInt sorted[4]) const {
+	auto iter = std::lower_bound(
+			entities.begin(), entities.end(), sorted,
+			[](const CoarseEntity& CE, const emInt* key) {
+				return std::lexicographical_compare(CE.verts, CE.verts + 4, key,
+																						key + 4);
+			});
+	if (iter == entities.end() || !sameVerts(iter->verts, sorted)) {
+		fprintf(stderr, "Bdry face of the coarse mesh isn't a face of any cell.\n");
+		exit(1);
+	}
+	return iter - entities.begin();
+}
+
+// The corners of a face of one cell, in that cell's order.
+template<typename Traits>
+static void faceCorners(const emInt cellVerts[], const int face,
+		emInt corners[4]) {
+	for (int ii = 0; ii < 4; ii++) {
+		corners[ii] = cellVerts[Traits::faceVerts[face][ii]];
+	}
+}
+
+template<typename Traits>
+void VirtualFineMesh::prepareCell(const emInt verts[], Cache& C) const {
+	const int nDivs = m_nDivs;
+	for (int iE = 0; iE < Traits::numEdges; iE++) {
+		const Edge E(verts[Traits::edgeVerts[iE][0]],
+									verts[Traits::edgeVerts[iE][1]]);
+		const emInt sorted[] = { E.getV0(), E.getV1(), EMINT_MAX, EMINT_MAX };
+		const size_t index = findEntity(m_edges, sorted);
+		EdgeVerts EV;
+		EV.verts.resize(nDivs + 1);
+		EV.verts[0] = E.getV0();
+		EV.verts[nDivs] = E.getV1();
+		for (int ii = 1; ii < nDivs; ii++) {
+			EV.verts[ii] = m_firstEdgeVert + index * m_vertsPerEdge + ii - 1;
+		}
+		EV.m_totalDihed = 0;
+		C.vertsOnEdges.insert(std::make_pair(E, EV));
+	}
+
+	// Faces are stored the way their owners would have stored them.
+	for (int iF = 0; iF < Traits::numQuadFaces + Traits::numTriFaces; iF++) {
+		const bool isQuad = iF < Traits::numQuadFaces;
+		const int* const FV = Traits::faceVerts[iF];
+		emInt corners[] = { verts[FV[0]], verts[FV[1]], verts[FV[2]],
+												isQuad ? verts[FV[3]] : EMINT_MAX };
+		emInt sorted[4];
+		if (isQuad) {
+			sortVerts4(corners, sorted);
+		}
+		else {
+			sortVerts3(corners, sorted);
+			sorted[3] = EMINT_MAX;
+		}
+		const size_t index = findEntity(isQuad ? m_quadFaces : m_triFaces, sorted);
+		const CoarseEntity& CE = (isQuad ? m_quadFaces : m_triFaces)[index];
+		const emInt* const ownerVerts = coarseConn(CE.ownerType, CE.ownerCell);
+		switch (CE.ownerType) {
+			case eTet:
+				faceCorners<TetTraits>(ownerVerts, CE.ownerLocal, corners);
+				break;
+			case ePyr:
+				faceCorners<PyrTraits>(ownerVerts, CE.ownerLocal, corners);
+				break;
+			case ePrism:
+				faceCorners<PrismTraits>(ownerVerts, CE.ownerLocal, corners);
+				break;
+			case eHex:
+				faceCorners<HexTraits>(ownerVerts, CE.ownerLocal, corners);
+				break;
+			default:
+				assert(0);
+		}
+		if (isQuad) {
+			QuadFaceVerts QFV(corners[0], corners[1], corners[2], corners[3]);
+			QFV.allocVertMemory(nDivs, C.quadArena);
+			for (int ii = 0; ii < QFV.numIntVerts(); ii++) {
+				QFV.intVerts[ii] = m_firstQuadVert + index * m_vertsPerQuad + ii;
+			}
+			C.vertsOnQuads.insert(QFV);
+		}
+		else {
+			TriFaceVerts TFV(corners[0], corners[1], corners[2]);
+			TFV.allocVertMemory(nDivs, C.triArena);
+			for (int ii = 0; ii < TFV.numIntVerts(); ii++) {
+				TFV.intVerts[ii] = m_firstTriVert + index * m_vertsPerTri + ii;
+			}
+			C.vertsOnTris.insert(TFV);
+		}
+	}
+}
+
+void VirtualFineMesh::countBdryVerts() {
+	// Coarse verts and edges on the bdry, plus the faces themselves.
+	std::vector<emInt> verts;
+	std::vector<std::pair<emInt, emInt>> edges;
+	for (emInt iT = 0; iT < m_coarse.numBdryTris(); iT++) {
+		const emInt* const conn = m_coarse.getBdryTriConn(iT);
+		for (int ii = 0; ii < 3; ii++) {
+			const Edge E(conn[ii], conn[(ii + 1) % 3]);
+			verts.push_back(conn[ii]);
+			edges.push_back(std::make_pair(E.getV0(), E.getV1()));
+		}
+	}
+	for (emInt iQ = 0; iQ < m_coarse.numBdryQuads(); iQ++) {
+		const emInt* const conn = m_coarse.getBdryQuadConn(iQ);
+		for (int ii = 0; ii < 4; ii++) {
+			const Edge E(conn[ii], conn[(ii + 1) % 4]);
+			verts.push_back(conn[ii]);
+			edges.push_back(std::make_pair(E.getV0(), E.getV1()));
+		}
+	}
+	std::sort(verts.begin(), verts.end());
+	std::sort(edges.begin(), edges.end());
+	const size_t nVerts = std::unique(verts.begin(), verts.end()) - verts.begin();
+	const size_t nEdges = std::unique(edges.begin(), edges.end()) - edges.begin();
+	m_size.nBdryVerts = nVerts + nEdges * m_vertsPerEdge
+			+ size_t(m_coarse.numBdryTris()) * m_vertsPerTri
+			+ size_t(m_coarse.numBdryQuads()) * m_vertsPerQuad;
+}
+
+void VirtualFineMesh::getCoords(const emInt vert, double coords[3]) const {
+	assert(vert < m_size.nVerts);
+	if (vert < m_firstEdgeVert) {
+		m_coarse.getCoords(vert, coords);
+		return;
+	}
+	Cache& C = cache();
+	if (vert < m_firstTriVert) {
+		const emInt offset = vert - m_firstEdgeVert;
+		const CoarseEntity& CE = m_edges[offset / m_vertsPerEdge];
+		const int step = offset % m_vertsPerEdge + 1;
+		C.withOwner(*this, CE, [&](const auto& D) {
+			D.getEdgePointCoords(CE.ownerLocal, step, coords);
+		});
+	}
+	else if (vert < m_firstQuadVert) {
+		// Interior verts of a tri face are packed row by row, as in
+		// TriFaceVerts.
+		const emInt offset = vert - m_firstTriVert;
+		const CoarseEntity& CE = m_triFaces[offset / m_vertsPerTri];
+		int ii = offset % m_vertsPerTri, jj = 0;
+		while (ii >= m_nDivs - 2 - jj) {
+			ii -= m_nDivs - 2 - jj;
+			jj++;
+		}
+		C.withOwner(*this, CE, [&](const auto& D) {
+			D.getTriFacePointCoords(CE.ownerLocal, ii + 1, jj + 1, coords);
+		});
+	}
+	else if (vert < m_firstCellVert[eTet]) {
+		const emInt offset = vert - m_firstQuadVert;
+		const CoarseEntity& CE = m_quadFaces[offset / m_vertsPerQuad];
+		const int ii = offset % m_vertsPerQuad % (m_nDivs - 1);
+		const int jj = offset % m_vertsPerQuad / (m_nDivs - 1);
+		C.withOwner(*this, CE, [&](const auto& D) {
+			D.getQuadFacePointCoords(CE.ownerLocal, ii + 1, jj + 1, coords);
+		});
+	}
+	else {
+		int type = eTet;
+		while (vert >= m_firstCellVert[type + 1]) {
+			type++;
+		}
+		const emInt offset = vert - m_firstCellVert[type];
+		const Cache::RefinedCell& RC = C.get(*this, type,
+																					offset / m_vertsPerCell[type]);
+		const double* const xyz = RC.coords.data()
+				+ 3 * (offset % m_vertsPerCell[type]);
+		coords[0] = xyz[0];
+		coords[1] = xyz[1];
+		coords[2] = xyz[2];
+	}
+}
+
+const emInt* VirtualFineMesh::fineConn(const int coarseType,
+		const emInt coarseCell, const int fineType, const emInt index,
+		const int nPts) const {
+	const Cache::RefinedCell& RC = cache().get(*this, coarseType, coarseCell);
+	assert((index + 1) * nPts <= RC.conn[fineType].size());
+	return RC.conn[fineType].data() + index * nPts;
+}
+
+const emInt* VirtualFineMesh::getBdryTriConn(const emInt bdryTri) const {
+	assert(bdryTri < m_size.nBdryTris);
+	return fineConn(eBdryTri, bdryTri / m_facesPerFace, 1,
+									bdryTri % m_facesPerFace, 3);
+}
+
+const emInt* VirtualFineMesh::getBdryQuadConn(const emInt bdryQuad) const {
+	assert(bdryQuad < m_size.nBdryQuads);
+	return fineConn(eBdryQuad, bdryQuad / m_facesPerFace, 2,
+									bdryQuad % m_facesPerFace, 4);
+}
+
+const emInt* VirtualFineMesh::getTetConn(const emInt tet) const {
+	assert(tet < m_size.nTets);
+	// Tets from coarse tets come first, then those from pyramids.
+	const emInt fromTets = m_coarse.numTets() * m_tetsPerTet;
+	if (tet < fromTets) {
+		return fineConn(eTet, tet / m_tetsPerTet, 3, tet % m_tetsPerTet, 4);
+	}
+	else {
+		const emInt index = tet - fromTets;
+		return fineConn(ePyr, index / m_tetsPerPyr, 3, index % m_tetsPerPyr, 4);
+	}
+}
+
+const emInt* VirtualFineMesh::getPyrConn(const emInt pyr) const {
+	assert(pyr < m_size.nPyrs);
+	return fineConn(ePyr, pyr / m_pyrsPerPyr, 4, pyr % m_pyrsPerPyr, 5);
+}
+
+const emInt* VirtualFineMesh::getPrismConn(const emInt prism) const {
+	assert(prism < m_size.nPrisms);
+	return fineConn(ePrism, prism / m_cellsPerCell, 5, prism % m_cellsPerCell,
+									6);
+}
+
+const emInt* VirtualFineMesh::getHexConn(const emInt hex) const {
+	assert(hex < m_size.nHexes);
+	return fineConn(eHex, hex / m_cellsPerCell, 6, hex % m_cellsPerCell, 8);
+}
+
+static void readOnly() {
+	fprintf(stderr, "Can't add to a virtual fine mesh.\n");
+	exit(1);
+}
+
+emInt VirtualFineMesh::addVert(const double[3]) {
+	readOnly();
+	return EMINT_MAX;
+}
+
+emInt VirtualFineMesh::addBdryTri(const emInt[]) {
+	readOnly();
+	return EMINT_MAX;
+}
+
+emInt VirtualFineMesh::addBdryQuad(const emInt[]) {
+	readOnly();
+	return EMINT_MAX;
+}
+
+emInt VirtualFineMesh::addTet(const emInt[]) {
+	readOnly();
+	return EMINT_MAX;
+}
+
+emInt VirtualFineMesh::addPyramid(const emInt[]) {
+	readOnly();
+	return EMINT_MAX;
+}
+
+emInt VirtualFineMesh::addPrism(const emInt[]) {
+	readOnly();
+	return EMINT_MAX;
+}
+
+emInt VirtualFineMesh::addHex(const emInt[]) {
+	readOnly();
+	return EMINT_MAX;
+}
+
+std::unique_ptr<UMesh> VirtualFineMesh::createFineUMesh(const emInt, Part&,
+		std::vector<CellPartData>&, struct RefineStats&, const char[],
+		PartInterface*) const {
+	fprintf(stderr, "Can't refine a virtual fine mesh further.\n");
+	exit(1);
+}
+
+std::unique_ptr<ExaMesh> VirtualFineMesh::extractCoarsePart(Part&,
+		std::vector<CellPartData>&, PartInterface*) const {
+	fprintf(stderr, "Can't refine a virtual fine mesh further.\n");
+	exit(1);
+}
+
+void VirtualFineMesh::setupCellDataForPartitioning(
+		std::vector<CellPartData>& vecCPD, double &xmin, double& ymin,
+		double& zmin, double& xmax, double& ymax, double& zmax) const {
+	for (emInt ii = 0; ii < numTets(); ii++) {
+		const emInt* verts = getTetConn(ii);
+		addCellToPartitionData(verts, 4, ii, TETRA_4, vecCPD, xmin, ymin, zmin,
+														xmax, ymax, zmax);
+	}
+	for (emInt ii = 0; ii < numPyramids(); ii++) {
+		const emInt* verts = getPyrConn(ii);
+		addCellToPartitionData(verts, 5, ii, PYRA_5, vecCPD, xmin, ymin, zmin, xmax,
+														ymax, zmax);
+	}
+	for (emInt ii = 0; ii < numPrisms(); ii++) {
+		const emInt* verts = getPrismConn(ii);
+		addCellToPartitionData(verts, 6, ii, PENTA_6, vecCPD, xmin, ymin, zmin,
+														xmax, ymax, zmax);
+	}
+	for (emInt ii = 0; ii < numHexes(); ii++) {
+		const emInt* verts = getHexConn(ii);
+		addCellToPartitionData(verts, 8, ii, HEXA_8, vecCPD, xmin, ymin, zmin, xmax,
+														ymax, zmax);
+	}
+}
+
+int VirtualFineMesh::getSnapshotBlocks(SnapshotHeader&, SnapshotBlock[]) const {
+	fprintf(stderr, "Can't snapshot a virtual fine mesh; snapshot the coarse "
+					"mesh instead.\n");
+	exit(1);
+}
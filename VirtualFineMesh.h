@@ -0,0 +1,185 @@
+//  Copyright 2019 by Carl Ollivier-Gooch.  The University of British
+//  Columbia disclaims all copyright interest in the software ExaMesh.//
+//
+//  This file is part of ExaMesh.
+//
+//  ExaMesh is free software: you can redistribute it and/or modify
+//  it under the terms of the GNU Lesser General Public License as
+//  published by the Free Software Foundation, either version 3 of
+//  the License, or (at your option) any later version.
+//
+//  ExaMesh is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU Lesser General Public License for more details.
+//
+//  You should have received a copy of the GNU Lesser General Public
+//  License along with ExaMesh.  If not, see <https://www.gnu.org/licenses/>.
+
+
+/*
+ * VirtualFineMesh.h
+ *
+ *  Created on: Oct. 18, 2026
+ */
+
+#ifndef SRC_VIRTUALFINEMESH_H_
+#define SRC_VIRTUALFINEMESH_H_
+
+#include <memory>
+#include <vector>
+
+#include "ExaMesh.h"
+
+// The mesh that refining a coarse mesh nDivs times would give, without
+// ever building it.  Only the coarse mesh (which must outlive this) and
+// tables of its edges and faces are kept; each fine cell is made on demand
+// by refining its coarse cell, and a few recently refined coarse cells are
+// cached.  Cells and coords are exactly those of serial refinement, and
+// fine cells are numbered the same way.  Fine verts are numbered
+// arithmetically instead, by what coarse entity they're on:  coarse verts,
+// then edge verts (from the lower-numbered end of each edge), then verts
+// on tri faces and quad faces, then those inside tets, pyramids, prisms
+// and hexes.
+//
+// Each thread that reads the mesh has a cache of its own, so it can be read
+// from a parallel region, as any other mesh can, as long as only one level
+// of it is active and it has no more threads than there are CPUs (or than
+// OpenMP would use when the mesh was made, if more).  Returned connectivity
+// stays valid until the thread that asked for it has refined a few more
+// coarse cells.
+class VirtualFineMesh: public ExaMesh {
+	enum {
+		eTet = 0, ePyr, ePrism, eHex, eBdryTri, eBdryQuad
+	};
+	// A coarse edge or face, identified by its sorted verts (unused ones are
+	// EMINT_MAX), and the cell whose mapping places its fine verts:  the
+	// first one that has it, in the order serial refinement goes through
+	// them.  ownerLocal is the index of the edge or face in that cell (see
+	// CellTraits.h).
+	struct CoarseEntity {
+		emInt verts[4];
+		emInt ownerCell;
+		unsigned char ownerType, ownerLocal;
+		bool operator<(const CoarseEntity& CE) const;
+	};
+	// The mutable part:  cached cells and the dividers that fill them.  Each
+	// thread has one, made the first time it's needed.
+	struct Cache;
+
+	const ExaMesh& m_coarse;
+	int m_nDivs;
+	std::vector<CoarseEntity> m_edges, m_triFaces, m_quadFaces;
+	MeshSize m_size;
+	// Where each group of fine verts starts; m_firstCellVert[4] is the
+	// total.
+	emInt m_firstEdgeVert, m_firstTriVert, m_firstQuadVert, m_firstCellVert[5];
+	emInt m_vertsPerEdge, m_vertsPerTri, m_vertsPerQuad, m_vertsPerCell[4];
+	emInt m_tetsPerTet, m_tetsPerPyr, m_pyrsPerPyr, m_cellsPerCell;
+	emInt m_facesPerFace;
+	mutable std::vector<std::unique_ptr<Cache> > m_caches;
+	VirtualFineMesh(const VirtualFineMesh&);
+	VirtualFineMesh& operator=(const VirtualFineMesh&);
+
+public:
+	VirtualFineMesh(const ExaMesh& coarse, const int nDivs);
+	~VirtualFineMesh();
+
+	void getCoords(const emInt vert, double coords[3]) const;
+	double getX(const emInt vert) const {
+		double coords[3];
+		getCoords(vert, coords);
+		return coords[0];
+	}
+	double getY(const emInt vert) const {
+		double coords[3];
+		getCoords(vert, coords);
+		return coords[1];
+	}
+	double getZ(const emInt vert) const {
+		double coords[3];
+		getCoords(vert, coords);
+		return coords[2];
+	}
+
+	emInt numVerts() const {
+		return m_size.nVerts;
+	}
+	emInt numBdryVerts() const {
+		return m_size.nBdryVerts;
+	}
+	emInt numBdryTris() const {
+		return m_size.nBdryTris;
+	}
+	emInt numBdryQuads() const {
+		return m_size.nBdryQuads;
+	}
+	emInt numTets() const {
+		return m_size.nTets;
+	}
+	emInt numPyramids() const {
+		return m_size.nPyrs;
+	}
+	emInt numPrisms() const {
+		return m_size.nPrisms;
+	}
+	emInt numHexes() const {
+		return m_size.nHexes;
+	}
+
+	// The mesh is read-only.
+	emInt addVert(const double newCoords[3]);
+	emInt addBdryTri(const emInt verts[]);
+	emInt addBdryQuad(const emInt verts[]);
+	emInt addTet(const emInt verts[]);
+	emInt addPyramid(const emInt verts[]);
+	emInt addPrism(const emInt verts[]);
+	emInt addHex(const emInt verts[]);
+
+	const emInt* getBdryTriConn(const emInt bdryTri) const;
+	const emInt* getBdryQuadConn(const emInt bdryQuad) const;
+	const emInt* getTetConn(const emInt tet) const;
+	const emInt* getPyrConn(const emInt pyr) const;
+	const emInt* getPrismConn(const emInt prism) const;
+	const emInt* getHexConn(const emInt hex) const;
+
+	Mapping::MappingType getDefaultMappingType() const {
+		return m_coarse.getDefaultMappingType();
+	}
+
+	// Refining a virtual mesh further isn't supported; refine the coarse
+	// mesh by the product of the nDivs instead.
+	std::unique_ptr<UMesh> createFineUMesh(const emInt numDivs, Part& P,
+			std::vector<CellPartData>& vecCPD, struct RefineStats& RS,
+			const char mapFileName[] = nullptr,
+			PartInterface* pPI = nullptr) const;
+	std::unique_ptr<ExaMesh> extractCoarsePart(Part& P,
+			std::vector<CellPartData>& vecCPD, PartInterface* pPI = nullptr) const;
+
+	void setupCellDataForPartitioning(std::vector<CellPartData>& vecCPD,
+			double &xmin, double& ymin, double& zmin, double& xmax, double& ymax,
+			double& zmax) const;
+
+protected:
+	int getSnapshotBlocks(SnapshotHeader& header, SnapshotBlock blocks[]) const;
+
+private:
+	const emInt* coarseConn(const int type, const emInt cell) const;
+	template<typename Traits>
+	void collectEntities(const int type, const emInt nCells);
+	size_t findEntity(const std::vector<CoarseEntity>& entities,
+			const emInt sorted[4]) const;
+	// Set up the shared edges and faces of a coarse cell, with their fine
+	// verts already numbered, just as if their owners had been refined.
+	template<typename Traits>
+	void prepareCell(const emInt verts[], Cache& C) const;
+	// The calling thread's cache.
+	Cache& cache() const;
+	void countBdryVerts();
+	// The connectivity of fine cell index, among those of fineType (a UGRID
+	// header entry) that coarseCell was divided into.
+	const emInt* fineConn(const int coarseType, const emInt coarseCell,
+			const int fineType, const emInt index, const int nPts) const;
+};
+
+#endif /* SRC_VIRTUALFINEMESH_H_ */
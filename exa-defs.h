@@ -26,9 +26,14 @@
 #ifndef SRC_EXA_DEFS_H_
 #define SRC_EXA_DEFS_H_
 
+#include <assert.h>
 #include <cmath>
+#include <inttypes.h>
 #include <stdint.h>
 #include <limits.h>
+#include <algorithm>
+#include <memory>
+#include <vector>
 
 #include "exa_config.h"
 
@@ -62,11 +67,31 @@
 #define CALLGRIND_TOGGLE_COLLECT
 #endif
 
-#define MAX_DIVS 50
 #define FILE_NAME_LEN 1024
 
+// Indices are 32-bit unless configured with --enable-64bit-indices, which
+// defines EXA_64BIT_INDICES.  64-bit indices take twice the memory and
+// bandwidth for connectivity, but let a single mesh or part have more than
+// about four billion verts or cells.  NATIVE_UGRID_INFIX names the UGRID
+// variant with ints the size of emInt and the host's byte order, which can
+// be mapped in place and written without swapping bytes.  EMINT_FMT is
+// the printf conversion for an emInt, as in "%5" EMINT_FMT.
+#if (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define NATIVE_UGRID_ENDIAN ""
+#else
+#define NATIVE_UGRID_ENDIAN "l"
+#endif
+#if (EXA_64BIT_INDICES == 1)
+typedef uint64_t emInt;
+#define EMINT_MAX UINT64_MAX
+#define EMINT_FMT PRIu64
+#define NATIVE_UGRID_INFIX NATIVE_UGRID_ENDIAN "b8l"
+#else
 typedef uint32_t emInt;
 #define EMINT_MAX UINT_MAX
+#define EMINT_FMT PRIu32
+#define NATIVE_UGRID_INFIX NATIVE_UGRID_ENDIAN "b8"
+#endif
 
 #if (HAVE_CGNS == 0)
 #define TRI_3 5
@@ -136,42 +161,136 @@ public:
 };
 
 struct EdgeVerts {
-	emInt verts[MAX_DIVS + 1];
+	std::vector<emInt> verts;
 	double m_totalDihed;
 };
 
+// Storage for the interior verts of shared faces.  Every face of a kind
+// needs the same number of them, so blocks of that size are cut from big
+// slabs, and blocks given back are handed out again.  clear() releases
+// everything at once, keeping the slabs for next time; they're only freed
+// when the block size changes or the arena goes.
+class FaceVertArena {
+	std::vector<std::unique_ptr<emInt[]>> m_slabs;
+	std::vector<emInt*> m_freeBlocks;
+	size_t m_blockSize, m_blocksPerSlab;
+	// Slabs handed out from so far, and blocks used from the last of them.
+	size_t m_slabsUsed, m_blocksUsed;
+public:
+	FaceVertArena() :
+			m_blockSize(0), m_blocksPerSlab(0), m_slabsUsed(0), m_blocksUsed(0) {
+	}
+	size_t blockSize() const {
+		return m_blockSize;
+	}
+	size_t numSlabs() const {
+		return m_slabs.size();
+	}
+	// Also releases everything.
+	void setBlockSize(const size_t blockSize) {
+		if (blockSize != m_blockSize) {
+			m_slabs.clear();
+			m_blockSize = blockSize;
+			// About 256 KB per slab.
+			m_blocksPerSlab = blockSize ?
+					std::max(size_t(1), (size_t(1) << 16) / blockSize) : 0;
+		}
+		clear();
+	}
+	void clear() {
+		m_freeBlocks.clear();
+		m_slabsUsed = 0;
+		m_blocksUsed = m_blocksPerSlab;
+	}
+	// nullptr if blocks are empty.
+	emInt* allocate() {
+		if (m_blockSize == 0) return nullptr;
+		if (!m_freeBlocks.empty()) {
+			emInt* const block = m_freeBlocks.back();
+			m_freeBlocks.pop_back();
+			return block;
+		}
+		if (m_blocksUsed == m_blocksPerSlab) {
+			if (m_slabsUsed == m_slabs.size()) {
+				m_slabs.emplace_back(new emInt[m_blocksPerSlab * m_blockSize]);
+			}
+			m_slabsUsed++;
+			m_blocksUsed = 0;
+		}
+		return m_slabs[m_slabsUsed - 1].get() + m_blocksUsed++ * m_blockSize;
+	}
+	void release(emInt* const block) {
+		if (block) m_freeBlocks.push_back(block);
+	}
+};
+
 struct TriFaceVerts {
 	emInt corners[3], sorted[3];
-	volatile emInt (*intVerts)[MAX_DIVS - 2];
-//	emInt intVerts[MAX_DIVS - 2][MAX_DIVS - 2];
+	// Interior verts, packed row by row (constant j); sized for nDivs.
+	emInt *intVerts;
 	emInt volElement, volElementType;
+	int nDivs;
 	TriFaceVerts() :
-			intVerts(nullptr), volElement(EMINT_MAX), volElementType(0) {
+			intVerts(nullptr), volElement(EMINT_MAX), volElementType(0), nDivs(0) {
 	}
 	TriFaceVerts(const emInt v0, const emInt v1, const emInt v2,
 			const emInt type = 0, const emInt elemInd = EMINT_MAX);
 	~TriFaceVerts() {
 	}
-	void allocVertMemory() {
-		intVerts = new emInt[MAX_DIVS - 2][MAX_DIVS - 2];
+	// The arena's blocks must hold numIntVerts(numDivs) verts.
+	void allocVertMemory(const int numDivs, FaceVertArena& arena) {
+		nDivs = numDivs;
+		assert(arena.blockSize() == size_t(numIntVerts()));
+		intVerts = arena.allocate();
+	}
+	void freeVertMemory(FaceVertArena& arena) const {
+		arena.release(intVerts);
+	}
+	static int numIntVerts(const int numDivs) {
+		return numDivs > 2 ? (numDivs - 2) * (numDivs - 1) / 2 : 0;
 	}
-	void freeVertMemory() const {
-		// TODO  It's really stinky to do this to avoid a double free....
-		if (intVerts) delete[] intVerts;
-//		intVerts = nullptr;
+	int numIntVerts() const {
+		return numIntVerts(nDivs);
+	}
+	// Interior vert (ii,jj), with ii + jj <= nDivs - 3.
+	emInt& intVert(const int ii, const int jj) const {
+		assert(ii >= 0 && jj >= 0 && ii + jj <= nDivs - 3);
+		return intVerts[jj * (nDivs - 2) - jj * (jj - 1) / 2 + ii];
 	}
 	void setupSorted();
 };
 
 struct QuadFaceVerts {
 	emInt corners[4], sorted[4];
-	emInt intVerts[MAX_DIVS - 1][MAX_DIVS - 1];
+	// Interior verts, row by row (constant j); sized for nDivs.
+	emInt *intVerts;
 	emInt volElement, volElementType;
+	int nDivs;
 	QuadFaceVerts() :
-			volElement(EMINT_MAX), volElementType(0) {
+			intVerts(nullptr), volElement(EMINT_MAX), volElementType(0), nDivs(0) {
 	}
 	QuadFaceVerts(const emInt v0, const emInt v1, const emInt v2, const emInt v3,
 			const emInt type = 0, const emInt elemInd = EMINT_MAX);
+	// The arena's blocks must hold numIntVerts(numDivs) verts.
+	void allocVertMemory(const int numDivs, FaceVertArena& arena) {
+		nDivs = numDivs;
+		assert(arena.blockSize() == size_t(numIntVerts()));
+		intVerts = arena.allocate();
+	}
+	void freeVertMemory(FaceVertArena& arena) const {
+		arena.release(intVerts);
+	}
+	static int numIntVerts(const int numDivs) {
+		return numDivs > 1 ? (numDivs - 1) * (numDivs - 1) : 0;
+	}
+	int numIntVerts() const {
+		return numIntVerts(nDivs);
+	}
+	// Interior vert (ii,jj), with 0 <= ii, jj <= nDivs - 2.
+	emInt& intVert(const int ii, const int jj) const {
+		assert(ii >= 0 && jj >= 0 && ii <= nDivs - 2 && jj <= nDivs - 2);
+		return intVerts[jj * (nDivs - 1) + ii];
+	}
 	void setupSorted();
 };
 
@@ -25,11 +25,88 @@
 
 #include <unistd.h>
 #include <cstdio>
+#include <cstdlib>
+#include <cstring>
 
 #include "ExaMesh.h"
 #include "CubicMesh.h"
+#include "NumaMemory.h"
+#include "Snapshot.h"
 #include "UMesh.h"
 
+static bool hasSuffix(const char fileName[], const char suffix[]) {
+	const size_t len = strlen(fileName), suffixLen = strlen(suffix);
+	return len >= suffixLen && strcmp(fileName + len - suffixLen, suffix) == 0;
+}
+
+// The output format is taken from the file name: .vtk for legacy VTK, .vtu
+// for XML VTK (compressed if .vtu.z), .pmesh for a packed mesh file, and
+// UGRID otherwise (block-compressed if the name ends in .z).
+static bool isVTKFileName(const char fileName[]) {
+	return hasSuffix(fileName, ".vtk") || hasSuffix(fileName, ".vtu")
+			|| hasSuffix(fileName, ".vtu.z");
+}
+
+// The mesh isn't used after it's written, so a mesh built in a mapped
+// UGRID file is released rather than kept in a private copy.
+static bool writeRefinedMesh(UMesh& UM, const char fileName[]) {
+	if (hasSuffix(fileName, ".vtk")) return UM.writeVTKFile(fileName);
+	else if (hasSuffix(fileName, ".vtu")) return UM.writeVTUFile(fileName);
+	else if (hasSuffix(fileName, ".vtu.z")) {
+		return UM.writeVTUFile(fileName, true);
+	}
+	else if (hasSuffix(fileName, ".pmesh")) return UM.writePackedMeshFile(fileName);
+	else return UM.writeUGridFileAndRelease(fileName);
+}
+
+static void reportMemory(const UMesh& UM) {
+	const UMeshMemory UMM = UM.memoryUsage();
+	const double MB = 1024 * 1024;
+	const size_t conn = UMM.triConn + UMM.quadConn + UMM.tetConn + UMM.pyrConn
+			+ UMM.prismConn + UMM.hexConn;
+	fprintf(stderr, "Memory for refined mesh  = %8.1F MB\n", UMM.total() / MB);
+	fprintf(stderr, "  coords                   %8.1F MB\n", UMM.coords / MB);
+	fprintf(stderr, "  connectivity             %8.1F MB\n", conn / MB);
+	fprintf(stderr, "  BCs                      %8.1F MB\n",
+					(UMM.triBCs + UMM.quadBCs) / MB);
+	fprintf(stderr, "  length scales            %8.1F MB\n",
+					UMM.lengthScales / MB);
+	fprintf(stderr, "Peak refinement tables  ~ %8.1F MB\n",
+					UMM.refineTables / MB);
+}
+
+// Partition for parallel refinement, reusing the snapshot's partition if
+// it has the right number of parts, and then refine.  If newSnapshotName
+// is given, the coarse mesh and partition are saved there first.  With
+// singleFileName, the parts go into one globally numbered UGRID file;
+// otherwise, each part is written separately, based on mapFileName.
+static void refineInParallel(const ExaMesh& EM, const emInt nDivs,
+		const emInt maxCellsPerPart, const char mapFileName[],
+		const Snapshot* snap, const char newSnapshotName[],
+		const char singleFileName[]) {
+	const emInt nParts = EM.numPartsForParallel(nDivs, maxCellsPerPart);
+	std::vector<Part> parts;
+	std::vector<CellPartData> vecCPD;
+	double start = exaTime();
+	if (!snap || snap->numParts() != nParts
+			|| !snap->getPartition(parts, vecCPD)) {
+		parts.clear();
+		vecCPD.clear();
+		partitionCells(&EM, nParts, parts, vecCPD);
+	}
+	double partitionTime = exaTime() - start;
+	if (newSnapshotName) EM.writeSnapshot(newSnapshotName, &parts, &vecCPD);
+	if (singleFileName) {
+		if (!EM.refineIntoSingleFile(nDivs, parts, vecCPD, singleFileName,
+																	partitionTime)) {
+			exit(1);
+		}
+	}
+	else {
+		EM.refineForParallel(nDivs, parts, vecCPD, mapFileName, partitionTime);
+	}
+}
+
 int main(int argc, char* const argv[]) {
 	char opt = EOF;
 	emInt nDivs = 1;
@@ -39,7 +116,10 @@ int main(int argc, char* const argv[]) {
 	char inFileBaseName[1024];
 	char cgnsFileName[1024];
 	char outFileName[1024];
-	bool isInputCGNS = false, isParallel = false;
+	char snapshotFileName[1024];
+	bool isInputCGNS = false, isParallel = false, isOutput = false;
+	bool useSnapshot = false, isSingleFile = false;
+	bool pinThreads = false, orderForLocality = false;
 
 	sprintf(type, "vtk");
 	sprintf(infix, "b8");
@@ -47,27 +127,48 @@ int main(int argc, char* const argv[]) {
 	sprintf(inFileBaseName, "/need/a/file/name");
 	sprintf(cgnsFileName, "/need/a/file/name");
 
-	while ((opt = getopt(argc, argv, "c:i:m:n:o:pt:u:")) != EOF) {
+	while ((opt = getopt(argc, argv, "Bc:gHi:lm:n:o:ps:t:u:")) != EOF) {
 		switch (opt) {
+			case 'B':
+				// Bind worker threads to cores (NUMA machines).
+				pinThreads = true;
+				break;
 			case 'c':
 				sscanf(optarg, "%1023s", cgnsFileName);
 				isInputCGNS = true;
 				break;
+			case 'g':
+				// With -p, write one file rather than one per part.
+				isSingleFile = true;
+				break;
+			case 'H':
+				// Transparent huge pages for big mesh arrays.
+				setUseHugePages(true);
+				break;
 			case 'i':
 				sscanf(optarg, "%1023s", inFileBaseName);
 				break;
+			case 'l':
+				// With -p, reorder each coarse part for locality.
+				orderForLocality = true;
+				break;
 			case 'n':
-				sscanf(optarg, "%d", &nDivs);
+				nDivs = strtoul(optarg, nullptr, 10);
 				break;
 			case 'm':
-				sscanf(optarg, "%d", &maxCellsPerPart);
+				maxCellsPerPart = strtoul(optarg, nullptr, 10);
 				break;
 			case 'o':
 				sscanf(optarg, "%1023s", outFileName);
+				isOutput = true;
 				break;
 			case 'p':
 				isParallel = true;
 				break;
+			case 's':
+				sscanf(optarg, "%1023s", snapshotFileName);
+				useSnapshot = true;
+				break;
 			case 't':
 				sscanf(optarg, "%9s", type);
 				break;
@@ -77,13 +178,49 @@ int main(int argc, char* const argv[]) {
 		}
 	}
 
+	if (pinThreads) pinWorkerThreads();
+
+	// Refined meshes headed for an uncompressed UGRID file are written as
+	// they're made:  serial refinement streams the fine mesh into it, and
+	// parallel refinement builds each part directly in its own mapped file.
+	// Parallel refinement only writes UGRID parts.
+	const char* mapFileName =
+			(isOutput && !isVTKFileName(outFileName)
+					&& !hasSuffix(outFileName, ".z") && !hasSuffix(outFileName, ".pmesh")) ?
+					outFileName : nullptr;
+	const char* singleFileName =
+			(isOutput && isSingleFile) ? outFileName : nullptr;
+
+	// With a snapshot file, the coarse mesh (and partition, if it fits) is
+	// taken from the snapshot if it exists; if not, the coarse mesh is read
+	// as usual and then saved in it.
+	std::unique_ptr<Snapshot> snap;
+	const char* newSnapshotName = nullptr;
+	if (useSnapshot) {
+		if (access(snapshotFileName, F_OK) == 0) {
+			snap.reset(new Snapshot(snapshotFileName));
+		}
+		else {
+			newSnapshotName = snapshotFileName;
+		}
+	}
+
 	if (isInputCGNS) {
 #if (HAVE_CGNS == 1)
-		CubicMesh CMorig(cgnsFileName);
+		std::unique_ptr<CubicMesh> pCM(
+				snap ? new CubicMesh(*snap) : new CubicMesh(cgnsFileName));
+		CubicMesh& CMorig = *pCM;
+		CMorig.setOrderPartsForLocality(orderForLocality);
 		if (isParallel) {
-			CMorig.refineForParallel(nDivs, maxCellsPerPart);
+			refineInParallel(CMorig, nDivs, maxCellsPerPart, mapFileName,
+												snap.get(), newSnapshotName, singleFileName);
+		}
+		else if (mapFileName) {
+			if (newSnapshotName) CMorig.writeSnapshot(newSnapshotName);
+			if (!CMorig.refineIntoUGridFile(nDivs, mapFileName)) exit(1);
 		}
 		else {
+			if (newSnapshotName) CMorig.writeSnapshot(newSnapshotName);
 			double start = exaTime();
 			UMesh UMrefined(CMorig, nDivs);
 			double time = exaTime() - start;
@@ -93,9 +230,9 @@ int main(int argc, char* const argv[]) {
 			fprintf(stderr,
 							"                          %5.2F million cells / minute\n",
 							(cells / 1000000.) / (time / 60));
+			reportMemory(UMrefined);
 
-//			UMrefined.writeUGridFile("/tmp/junk.b8.ugrid");
-//			UMrefined.writeVTKFile("/tmp/junk.vtk");
+			if (isOutput) writeRefinedMesh(UMrefined, outFileName);
 		}
 #else
 		fprintf(stderr, "Not compiled with CGNS; curved meshes not supported.\n");
@@ -103,11 +240,20 @@ int main(int argc, char* const argv[]) {
 #endif
 	}
 	else {
-		UMesh UMorig(inFileBaseName, type, infix);
+		std::unique_ptr<UMesh> pUM(
+				snap ? new UMesh(*snap) : new UMesh(inFileBaseName, type, infix));
+		UMesh& UMorig = *pUM;
+		UMorig.setOrderPartsForLocality(orderForLocality);
 		if (isParallel) {
-			UMorig.refineForParallel(nDivs, maxCellsPerPart);
+			refineInParallel(UMorig, nDivs, maxCellsPerPart, mapFileName,
+												snap.get(), newSnapshotName, singleFileName);
+		}
+		else if (mapFileName) {
+			if (newSnapshotName) UMorig.writeSnapshot(newSnapshotName);
+			if (!UMorig.refineIntoUGridFile(nDivs, mapFileName)) exit(1);
 		}
-		if (!isParallel) {
+		else {
+			if (newSnapshotName) UMorig.writeSnapshot(newSnapshotName);
 			double start = exaTime();
 			UMesh UMrefined(UMorig, nDivs);
 			double time = exaTime() - start;
@@ -117,8 +263,8 @@ int main(int argc, char* const argv[]) {
 			fprintf(stderr,
 							"                          %5.2F million cells / minute\n",
 							(cells / 1000000.) / (time / 60));
-//			UMrefined.writeUGridFile("/tmp/junk.b8.ugrid");
-//			UMrefined.writeVTKFile("/tmp/junk.vtk");
+			reportMemory(UMrefined);
+			if (isOutput) writeRefinedMesh(UMrefined, outFileName);
 		}
 	}
 
@@ -23,11 +23,14 @@
 //
 //////////////////////////////////////////////////////////////////////////
 
+#include <stdio.h>
 #include <string.h>
 #include <locale.h>
 #include <unistd.h>
 #include <time.h>
 
+#include <algorithm>
+
 #include "ExaMesh.h"
 #include "HexDivider.h"
 #include "PrismDivider.h"
@@ -35,10 +38,43 @@
 #include "TetDivider.h"
 #include "BdryTriDivider.h"
 #include "BdryQuadDivider.h"
+#include "NumaMemory.h"
+
+namespace {
+	// The tables of verts on shared edges and faces, and the arenas the
+	// face entries keep their interior verts in.  While a LocalPool is
+	// active, each thread keeps its tables from one part to the next, so
+	// their bucket arrays and arena slabs only grow when a part needs more
+	// than any part before it did.
+	struct RefineTables {
+		exa_map<Edge, EdgeVerts> vertsOnEdges;
+		exa_set<TriFaceVerts> vertsOnTris;
+		exa_set<QuadFaceVerts> vertsOnQuads;
+		FaceVertArena triArena, quadArena;
+	};
+}
+static thread_local RefineTables keptTables;
+
+// Keep track of the most entries each table has held.
+static void noteTableSizes(RefineTableSizes* tableSizes,
+		const exa_map<Edge, EdgeVerts>& vertsOnEdges,
+		const exa_set<TriFaceVerts>& vertsOnTris,
+		const exa_set<QuadFaceVerts>& vertsOnQuads) {
+	if (tableSizes) {
+		tableSizes->edges = std::max(tableSizes->edges, vertsOnEdges.size());
+		tableSizes->tris = std::max(tableSizes->tris, vertsOnTris.size());
+		tableSizes->quads = std::max(tableSizes->quads, vertsOnQuads.size());
+	}
+}
 
-emInt subdividePartMesh(const ExaMesh * const pVM_input,
-		UMesh * const pVM_output, const int nDivs) {
+// NDIVS is 0 for a generic nDivs; otherwise it must match nDivs, and the
+// dividers use tables and trip counts fixed at compile time.
+template<int NDIVS>
+static emInt subdividePartMesh(const ExaMesh * const pVM_input,
+		RefineSink * const pVM_output, const int nDivs,
+		BdryFaceLattices* lattices, RefineTableSizes* tableSizes) {
 	assert(nDivs >= 1);
+	assert(NDIVS == 0 || NDIVS == nDivs);
   // Assumption:  the mesh is already ordered in a way that seems sensible
   // to the caller, both cells and vertices.  As a result, we can create new
   // verts and cells on the fly, with the expectation that the new ones will
@@ -55,12 +91,21 @@ emInt subdividePartMesh(const ExaMesh * const pVM_input,
   // progressively more points / tris.  Nevertheless, the tets produces should
   // be geometrically right-handed.
 
-  // TODO: Potentially, identify in advance how many times each edge is used,
-  // so that when all of them have appeared, the edge can be removed from the
-  // map.
-	exa_map<Edge, EdgeVerts> vertsOnEdges;
-	exa_set<TriFaceVerts> vertsOnTris;
-	exa_set<QuadFaceVerts> vertsOnQuads;
+  // An edge leaves the map once the dihedral angles of the cells that have
+  // used it add up to a full turn; edges on the bdry stay until the end.
+	RefineTables localTables;
+	if (!LocalPool::active()) {
+		// Whatever an earlier pooled run kept isn't needed any more.
+		std::swap(keptTables, localTables);
+	}
+	RefineTables& tables = LocalPool::active() ? keptTables : localTables;
+	assert(tables.vertsOnEdges.empty() && tables.vertsOnTris.empty()
+			&& tables.vertsOnQuads.empty());
+	exa_map<Edge, EdgeVerts>& vertsOnEdges = tables.vertsOnEdges;
+	exa_set<TriFaceVerts>& vertsOnTris = tables.vertsOnTris;
+	exa_set<QuadFaceVerts>& vertsOnQuads = tables.vertsOnQuads;
+	tables.triArena.setBlockSize(TriFaceVerts::numIntVerts(nDivs));
+	tables.quadArena.setBlockSize(QuadFaceVerts::numIntVerts(nDivs));
 
 	// Copy vertex data into the new mesh.
 	for (emInt iV = 0; iV < pVM_input->numVertsToCopy(); iV++) {
@@ -68,152 +113,102 @@ emInt subdividePartMesh(const ExaMesh * const pVM_input,
 		pVM_input->getCoords(iV, coords);
 		pVM_output->addVert(coords);
 	}
-	assert(pVM_input->numVertsToCopy() == pVM_output->numVerts());
 
-	// Need to explicitly specify the type of mapping here.
-	TetDivider TD(pVM_output, pVM_input, nDivs);
+	// Each divider type picks its own default mapping.
+	TetDivider<NDIVS> TD(pVM_output, pVM_input, nDivs);
+	TD.setFaceArenas(tables.triArena, tables.quadArena);
 	for (emInt iT = 0; iT < pVM_input->numTets(); iT++) {
-    // Divide all the edges, including storing info about which new verts
-    // are on which edges
-		const emInt* const thisTet = pVM_input->getTetConn(iT);
-		TD.setupCoordMapping(thisTet);
-		TD.divideEdges(vertsOnEdges);
-
-    // Divide all the faces, including storing info about which new verts
-    // are on which faces
-		TD.divideFaces(vertsOnTris, vertsOnQuads);
-
-    // Divide the cell
-    if (nDivs > 3) {
-			TD.divideInterior();
-    } // Done with internal division
-
-		// And now the moment of truth:  create a flock of new tets.
-    TD.createNewCells();
+		// Divide edges, faces, and interior, then create a flock of new tets.
+		TD.refineCell(pVM_input->getTetConn(iT), vertsOnEdges, vertsOnTris,
+				vertsOnQuads);
+		noteTableSizes(tableSizes, vertsOnEdges, vertsOnTris, vertsOnQuads);
 		if ((iT + 1) % 100000 == 0) fprintf(
-				stderr, "Refined %'12d tets.  Tree sizes: %'12lu %'12lu %'12lu\r",
-				iT + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
+				stderr, "Refined %'12lu tets.  Tree sizes: %'12lu %'12lu %'12lu\r",
+				size_t(iT) + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
   } // Done looping over all tets
 #ifndef NDEBUG
 	fprintf(stderr, "\nDone with tets\n");
 #endif
 
-	PyrDivider PD(pVM_output, nDivs);
+	PyrDivider<NDIVS> PD(pVM_output, pVM_input, nDivs);
+	PD.setFaceArenas(tables.triArena, tables.quadArena);
 	for (emInt iP = 0; iP < pVM_input->numPyramids(); iP++) {
-    // Divide all the edges, including storing info about which new verts
-    // are on which edges
-		const emInt* const thisPyr = pVM_input->getPyrConn(iP);
-		PD.setupCoordMapping(thisPyr);
-
-		PD.divideEdges(vertsOnEdges);
-
-    // Divide all the faces, including storing info about which new verts
-    // are on which faces
-		PD.divideFaces(vertsOnTris, vertsOnQuads);
-
-    // Divide the cell
-    if (nDivs >= 3) {
-			PD.divideInterior();
-    } // Done with internal division
-
-		// And now the moment of truth:  create a flock of new pyramids.
-    PD.createNewCells();
+		// Divide edges, faces, and interior, then create new pyramids.
+		PD.refineCell(pVM_input->getPyrConn(iP), vertsOnEdges, vertsOnTris,
+				vertsOnQuads);
+		noteTableSizes(tableSizes, vertsOnEdges, vertsOnTris, vertsOnQuads);
 		if ((iP + 1) % 100000 == 0) fprintf(
-				stderr, "Refined %'12d pyrs.  Tree sizes: %'12lu %'12lu %'12lu\r",
-				iP + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
+				stderr, "Refined %'12lu pyrs.  Tree sizes: %'12lu %'12lu %'12lu\r",
+				size_t(iP) + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
   } // Done looping over all pyramids
 #ifndef NDEBUG
 	fprintf(stderr, "\nDone with pyramids\n");
 #endif
 
-	PrismDivider PrismD(pVM_output, nDivs);
+	PrismDivider<NDIVS> PrismD(pVM_output, pVM_input, nDivs);
+	PrismD.setFaceArenas(tables.triArena, tables.quadArena);
 	for (emInt iP = 0; iP < pVM_input->numPrisms(); iP++) {
-    // Divide all the edges, including storing info about which new verts
-    // are on which edges
-		const emInt* const thisPrism = pVM_input->getPrismConn(iP);
-		PrismD.setupCoordMapping(thisPrism);
-
-		PrismD.divideEdges(vertsOnEdges);
-
-    // Divide all the faces, including storing info about which new verts
-    // are on which faces
-		PrismD.divideFaces(vertsOnTris, vertsOnQuads);
-
-    // Divide the cell
-    if (nDivs >= 3) {
-			PrismD.divideInterior();
-    } // Done with internal division
-
-		// And now the moment of truth:  create a flock of new prisms.
-    PrismD.createNewCells();
+		// Divide edges, faces, and interior, then create new prisms.
+		PrismD.refineCell(pVM_input->getPrismConn(iP), vertsOnEdges, vertsOnTris,
+				vertsOnQuads);
+		noteTableSizes(tableSizes, vertsOnEdges, vertsOnTris, vertsOnQuads);
 		if ((iP + 1) % 100000 == 0) fprintf(
-				stderr, "Refined %'12d prisms.  Tree sizes: %'12lu %'12lu %'12lu\r",
-				iP + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
+				stderr, "Refined %'12lu prisms.  Tree sizes: %'12lu %'12lu %'12lu\r",
+				size_t(iP) + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
 	} // Done looping over all prisms
 #ifndef NDEBUG
 	fprintf(stderr, "\nDone with prisms\n");
 #endif
 
-	HexDivider HD(pVM_output, nDivs);
+	HexDivider<NDIVS> HD(pVM_output, pVM_input, nDivs);
+	HD.setFaceArenas(tables.triArena, tables.quadArena);
 	for (emInt iH = 0; iH < pVM_input->numHexes(); iH++) {
-    // Divide all the edges, including storing info about which new verts
-    // are on which edges
-		const emInt* const thisHex = pVM_input->getHexConn(iH);
-		HD.setupCoordMapping(thisHex);
-
-		HD.divideEdges(vertsOnEdges);
-
-    // Divide all the faces, including storing info about which new verts
-    // are on which faces
-		HD.divideFaces(vertsOnTris, vertsOnQuads);
-
-    // Divide the cell
-    if (nDivs >= 2) {
-			HD.divideInterior();
-    } // Done with internal division
-
-		// And now the moment of truth:  create a flock of new hexes.
-    HD.createNewCells();
+		// Divide edges, faces, and interior, then create new hexes.
+		HD.refineCell(pVM_input->getHexConn(iH), vertsOnEdges, vertsOnTris,
+				vertsOnQuads);
+		noteTableSizes(tableSizes, vertsOnEdges, vertsOnTris, vertsOnQuads);
 		if ((iH + 1) % 100000 == 0) fprintf(
-				stderr, "Refined %'12d hexes.  Tree sizes: %'12lu %'12lu %'12lu\r",
-				iH + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
+				stderr, "Refined %'12lu hexes.  Tree sizes: %'12lu %'12lu %'12lu\r",
+				size_t(iH) + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
 	} // Done looping over all hexes
 #ifndef NDEBUG
 	fprintf(stderr, "\nDone with hexes\n");
 #endif
 
-	BdryTriDivider BTD(pVM_output, nDivs);
+	BdryTriDivider<NDIVS> BTD(pVM_output, pVM_input, nDivs);
+	BTD.setFaceArenas(tables.triArena, tables.quadArena);
 	for (emInt iBT = 0; iBT < pVM_input->numBdryTris(); iBT++) {
-		const emInt* const thisBdryTri = pVM_input->getBdryTriConn(iBT);
-		BTD.setupCoordMapping(thisBdryTri);
-		// Shouldn't need to divide anything at all here, but these function
-		// copy the vertices into the CellDivider internal data structure.
-		BTD.divideEdges(vertsOnEdges);
-		BTD.divideFaces(vertsOnTris, vertsOnQuads);
-
-		BTD.createNewCells();
+		// Bdry faces re-use the verts already created on edges and faces.
+		BTD.refineCell(pVM_input->getBdryTriConn(iBT), vertsOnEdges, vertsOnTris,
+				vertsOnQuads);
+		noteTableSizes(tableSizes, vertsOnEdges, vertsOnTris, vertsOnQuads);
+		if (lattices && iBT >= lattices->firstTri) {
+			const std::vector<emInt>& LV = BTD.getLocalVerts();
+			lattices->triVerts.insert(lattices->triVerts.end(), LV.begin(), LV.end());
+		}
 		if ((iBT + 1) % 100000 == 0) fprintf(
-				stderr, "Refined %'12d bdry tris.  Tree sizes: %'12lu %'12lu %'12lu\r",
-				iBT + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
+				stderr, "Refined %'12lu bdry tris.  Tree sizes: %'12lu %'12lu %'12lu\r",
+				size_t(iBT) + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
 	}
 #ifndef NDEBUG
 	fprintf(stderr, "\nDone with bdry tris\n");
 #endif
 
-	BdryQuadDivider BQD(pVM_output, nDivs);
+	BdryQuadDivider<NDIVS> BQD(pVM_output, pVM_input, nDivs);
+	BQD.setFaceArenas(tables.triArena, tables.quadArena);
 	for (emInt iBQ = 0; iBQ < pVM_input->numBdryQuads(); iBQ++) {
-		const emInt* const thisBdryQuad = pVM_input->getBdryQuadConn(iBQ);
-		BQD.setupCoordMapping(thisBdryQuad);
-
-		// Shouldn't need to divide anything at all here, but this function
-		// copies the triangle vertices into the CellDivider internal data structure.
-		BQD.divideEdges(vertsOnEdges);
-		BQD.divideFaces(vertsOnTris, vertsOnQuads);
-
-		BQD.createNewCells();
+		// Bdry faces re-use the verts already created on edges and faces.
+		BQD.refineCell(pVM_input->getBdryQuadConn(iBQ), vertsOnEdges, vertsOnTris,
+				vertsOnQuads);
+		noteTableSizes(tableSizes, vertsOnEdges, vertsOnTris, vertsOnQuads);
+		if (lattices && iBQ >= lattices->firstQuad) {
+			const std::vector<emInt>& LV = BQD.getLocalVerts();
+			lattices->quadVerts.insert(lattices->quadVerts.end(), LV.begin(),
+																	LV.end());
+		}
 		if ((iBQ + 1) % 100000 == 0) fprintf(
-				stderr, "Refined %'12d bdry quads.  Tree sizes: %'12lu %'12lu %'12lu\r",
-				iBQ + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
+				stderr, "Refined %'12lu bdry quads.  Tree sizes: %'12lu %'12lu %'12lu\r",
+				size_t(iBQ) + 1, vertsOnEdges.size(), vertsOnTris.size(), vertsOnQuads.size());
 	}
 #ifndef NDEBUG
 	fprintf(stderr, "\nDone with bdry quads\n");
@@ -227,12 +222,58 @@ emInt subdividePartMesh(const ExaMesh * const pVM_input,
 	fprintf(stderr, "Final size of tri list: %'lu\n", vertsOnTris.size());
 	fprintf(stderr, "Final size of quad list: %'lu\n", vertsOnQuads.size());
 #endif
+	if (tableSizes) {
+		// Each entry is a node (a link and a cached hash, or tree links) plus
+		// the fine verts it holds.
+		const size_t nodeBytes = 3 * sizeof(void*);
+		const size_t triVerts = nDivs > 2 ? (nDivs - 2) * (nDivs - 1) / 2 : 0;
+		const size_t quadVerts = (nDivs - 1) * (nDivs - 1);
+		const size_t edgeBytes = sizeof(std::pair<const Edge, EdgeVerts>)
+				+ nodeBytes + (nDivs + 1) * sizeof(emInt);
+		const size_t triBytes = sizeof(TriFaceVerts) + nodeBytes
+				+ triVerts * sizeof(emInt);
+		const size_t quadBytes = sizeof(QuadFaceVerts) + nodeBytes
+				+ quadVerts * sizeof(emInt);
+		tableSizes->bytes = tableSizes->edges * edgeBytes
+				+ tableSizes->tris * triBytes + tableSizes->quads * quadBytes;
+	}
+
+	// Faces left over (part boundaries, for instance) go all at once, along
+	// with their interior verts.
+	vertsOnEdges.clear();
+	vertsOnTris.clear();
+	vertsOnQuads.clear();
+	tables.triArena.clear();
+	tables.quadArena.clear();
 
 	return pVM_output->numCells();
 }
 
+emInt subdividePartMesh(const ExaMesh * const pVM_input,
+		RefineSink * const pVM_output, const int nDivs,
+		BdryFaceLattices* lattices, RefineTableSizes* tableSizes) {
+	// Dispatch once per part to a specialized version for common cases.
+	switch (nDivs) {
+		case 2:
+			return subdividePartMesh<2>(pVM_input, pVM_output, nDivs, lattices,
+					tableSizes);
+		case 3:
+			return subdividePartMesh<3>(pVM_input, pVM_output, nDivs, lattices,
+					tableSizes);
+		case 4:
+			return subdividePartMesh<4>(pVM_input, pVM_output, nDivs, lattices,
+					tableSizes);
+		case 8:
+			return subdividePartMesh<8>(pVM_input, pVM_output, nDivs, lattices,
+					tableSizes);
+		default:
+			return subdividePartMesh<0>(pVM_input, pVM_output, nDivs, lattices,
+					tableSizes);
+	}
+}
+
 bool computeMeshSize(const struct MeshSize& MSIn, const emInt nDivs,
-		struct MeshSize& MSOut) {
+		struct MeshSize& MSOut, const ssize_t nEdgesIn) {
 	// It's relatively easy to compute some of these quantities:
 	const emInt surfFactor = nDivs * nDivs;
 	const emInt volFactor = surfFactor * nDivs;
@@ -268,15 +309,17 @@ bool computeMeshSize(const struct MeshSize& MSIn, const emInt nDivs,
 
 	ssize_t inputCellCount = MSIn.nTets + MSIn.nPyrs + MSIn.nPrisms + MSIn.nHexes;
 	ssize_t inputBdryEdgeCount = (MSIn.nBdryTris * 3 + MSIn.nBdryQuads * 4) / 2;
-	// Upcast the first arg explicitly, and the rest should follow.
+	// Upcast every arg explicitly; with 64-bit indices, an unsigned emInt
+	// would otherwise turn the whole sum unsigned.
 	int inputGenus = (ssize_t(MSIn.nBdryVerts) - inputBdryEdgeCount
-			+ MSIn.nBdryTris
-										+ MSIn.nBdryQuads
+			+ ssize_t(MSIn.nBdryTris)
+										+ ssize_t(MSIn.nBdryQuads)
 										- 2)
 										/ 2;
 
 	ssize_t inputEdges = (ssize_t(MSIn.nVerts) + inputFaceCount - inputCellCount
 												- 1 - inputGenus);
+	if (nEdgesIn >= 0) inputEdges = nEdgesIn;
 
 	ssize_t outputFaceVerts = inputTriCount * (nDivs - 2) * (nDivs - 1) / 2
 			+ inputQuadCount * (nDivs - 1) * (nDivs - 1);
@@ -295,6 +338,10 @@ bool computeMeshSize(const struct MeshSize& MSIn, const emInt nDivs,
 												+ MSIn.nVerts;
 //	ssize_t outputEdges = outputVerts + inputFaceCount * surfFactor
 //												- inputCellCount * volFactor - 1 - inputGenus;
+	if (size_t(outputVerts) > size_t(EMINT_MAX)) {
+		fprintf(stderr, "Output mesh will exceed max index size!\n");
+		return false;
+	}
 	MSOut.nVerts = outputVerts;
 
 	return true;
@@ -26,14 +26,36 @@
 #define BOOST_TEST_MODULE test-exa
 #include <boost/test/unit_test.hpp>
 
+#include <algorithm>
+#include <map>
+#include <set>
+#include <string>
+
+#include "CellTraits.h"
 #include "ExaMesh.h"
+#include "GeomUtils.h"
 #include "UMesh.h"
 #include "CubicMesh.h"
+#include "NumaMemory.h"
+#include "PackedConn.h"
+#include "PartInterface.h"
+#include "RefineSink.h"
+#include "Snapshot.h"
+#include "UGridIO.h"
+#include "VirtualFineMesh.h"
+#include "VTKIO.h"
 
 #include "TetDivider.h"
+#include "PyrDivider.h"
+#include "PrismDivider.h"
+#include "HexDivider.h"
 
 #include "Mapping.h"
 
+#if (HAVE_LIBZ == 1)
+#include <zlib.h>
+#endif
+
 static void checkExpectedSize(const UMesh& UM) {
 	BOOST_CHECK_EQUAL(UM.maxNVerts(), UM.numVerts());
 	BOOST_CHECK_EQUAL(UM.maxNBdryTris(), UM.numBdryTris());
@@ -662,6 +684,1876 @@ BOOST_AUTO_TEST_CASE(MixedN5) {
 	BOOST_CHECK(result);
 }
 
+// More divisions than the old fixed-size lattice allowed.
+BOOST_AUTO_TEST_CASE(MixedN64) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	double coords[][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 }, {
+			0, 0, 1 },
+													{ 0, 0, -1 }, { 1, 0, -1 }, { 1, 1, -1 },
+													{ 0, 1, -1 }, { 0, -1, 0 }, { 0, -1, -1 } };
+	emInt triVerts[][3] = { { 1, 2, 4 }, { 2, 3, 4 }, { 3, 0, 4 }, { 0, 9, 4 }, {
+			9, 1, 4 },
+													{ 10, 6, 5 } };
+	emInt quadVerts[][4] = { { 6, 7, 2, 1 }, { 7, 8, 3, 2 }, { 8, 5, 0, 3 },
+														{ 10, 6, 1, 9 }, { 5, 10, 9, 0 }, { 5, 6, 7, 8 } };
+	emInt tetVerts[4] = { 9, 1, 0, 4 };
+	emInt pyrVerts[5] = { 0, 1, 2, 3, 4 };
+	emInt prismVerts[6] = { 10, 6, 5, 9, 1, 0 };
+	emInt hexVerts[8] = { 5, 6, 7, 8, 0, 1, 2, 3 };
+
+	for (int ii = 0; ii < 11; ii++) {
+		UM.addVert(coords[ii]);
+	}
+	for (int ii = 0; ii < 6; ii++) {
+		UM.addBdryTri(triVerts[ii]);
+		UM.addBdryQuad(quadVerts[ii]);
+	}
+	UM.addTet(tetVerts);
+	UM.addPyramid(pyrVerts);
+	UM.addPrism(prismVerts);
+	UM.addHex(hexVerts);
+
+	MeshSize MSIn, MSOut;
+	MSIn.nBdryVerts = 11;
+	MSIn.nVerts = 11;
+	MSIn.nBdryTris = 6;
+	MSIn.nBdryQuads = 6;
+	MSIn.nTets = 1;
+	MSIn.nPyrs = 1;
+	MSIn.nPrisms = 1;
+	MSIn.nHexes = 1;
+	computeMeshSize(MSIn, 64, MSOut);
+
+	UMesh UMOut(MSOut.nVerts, MSOut.nBdryVerts, MSOut.nBdryTris, MSOut.nBdryQuads,
+							MSOut.nTets, MSOut.nPyrs, MSOut.nPrisms, MSOut.nHexes);
+	subdividePartMesh(&UM, &UMOut, 64);
+	checkExpectedSize(UMOut);
+}
+
+// The mixed mesh used by MixedN3 and friends, one cell of each type.
+static void addMixedMeshEntities(UMesh& UM) {
+	double coords[][3] = { { 0, 0, 0 }, { 1, 0, 0 }, { 1, 1, 0 }, { 0, 1, 0 }, {
+			0, 0, 1 },
+													{ 0, 0, -1 }, { 1, 0, -1 }, { 1, 1, -1 },
+													{ 0, 1, -1 }, { 0, -1, 0 }, { 0, -1, -1 } };
+	emInt triVerts[][3] = { { 1, 2, 4 }, { 2, 3, 4 }, { 3, 0, 4 }, { 0, 9, 4 }, {
+			9, 1, 4 },
+													{ 10, 6, 5 } };
+	emInt quadVerts[][4] = { { 6, 7, 2, 1 }, { 7, 8, 3, 2 }, { 8, 5, 0, 3 },
+														{ 10, 6, 1, 9 }, { 5, 10, 9, 0 }, { 5, 6, 7, 8 } };
+	emInt tetVerts[4] = { 9, 1, 0, 4 };
+	emInt pyrVerts[5] = { 0, 1, 2, 3, 4 };
+	emInt prismVerts[6] = { 10, 6, 5, 9, 1, 0 };
+	emInt hexVerts[8] = { 5, 6, 7, 8, 0, 1, 2, 3 };
+
+	for (int ii = 0; ii < 11; ii++) {
+		UM.addVert(coords[ii]);
+	}
+	for (int ii = 0; ii < 6; ii++) {
+		UM.addBdryTri(triVerts[ii]);
+		UM.addBdryQuad(quadVerts[ii]);
+	}
+	UM.addTet(tetVerts);
+	UM.addPyramid(pyrVerts);
+	UM.addPrism(prismVerts);
+	UM.addHex(hexVerts);
+}
+
+static std::vector<char> readFileBytes(const char fileName[]) {
+	std::vector<char> bytes;
+	FILE* file = fopen(fileName, "r");
+	if (!file) return bytes;
+	char buffer[1 << 16];
+	size_t nRead;
+	while ((nRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		bytes.insert(bytes.end(), buffer, buffer + nRead);
+	}
+	fclose(file);
+	return bytes;
+}
+
+// Refining straight into a mapped file must give the same UGRID file as
+// refining in memory and writing afterwards, in either byte order, and
+// leave the mesh as it was.
+BOOST_AUTO_TEST_CASE(MixedN3Mapped) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+
+	UMesh UMOut(UM, 3);
+	BOOST_CHECK(!UMOut.isMapped());
+	// The same variant in the other byte order.
+	const std::string nativeInfix(NATIVE_UGRID_INFIX);
+	const std::string otherInfix =
+			nativeInfix[0] == 'l' ? nativeInfix.substr(1) : "l" + nativeInfix;
+	for (const std::string& infix : { nativeInfix, otherInfix }) {
+		const std::string inMemName = "/tmp/test-exa." + infix + ".ugrid";
+		const std::string mappedName = "/tmp/test-exa-mapped." + infix + ".ugrid";
+		BOOST_CHECK(UMOut.writeUGridFile(inMemName.c_str()));
+
+		UMesh UMMapped(UM, 3, mappedName.c_str());
+		BOOST_CHECK(UMMapped.isMapped());
+		checkExpectedSize(UMMapped);
+		BOOST_CHECK(UMMapped.writeUGridFile(mappedName.c_str()));
+		BOOST_CHECK(!UMMapped.isMapped());
+
+		const std::vector<char> bytesInMem = readFileBytes(inMemName.c_str());
+		BOOST_CHECK_EQUAL(bytesInMem.size(), UMOut.getFileImageSize());
+		BOOST_CHECK(bytesInMem == readFileBytes(mappedName.c_str()));
+
+		// Still the same mesh, and writing it again doesn't touch the first
+		// file.
+		BOOST_CHECK_EQUAL(UMMapped.numVerts(), UMOut.numVerts());
+		BOOST_CHECK(std::equal(UMOut.getTetConn(0), UMOut.getTetConn(0)
+																+ 4 * size_t(UMOut.numTets()),
+														UMMapped.getTetConn(0)));
+		BOOST_CHECK(std::equal(UMOut.getPyrConn(0), UMOut.getPyrConn(0)
+																+ 5 * size_t(UMOut.numPyramids()),
+														UMMapped.getPyrConn(0)));
+		BOOST_CHECK(std::equal(UMOut.getBdryQuadConn(0),
+														UMOut.getBdryQuadConn(0)
+																+ 4 * size_t(UMOut.numBdryQuads()),
+														UMMapped.getBdryQuadConn(0)));
+		double coordsOut[3], coordsMapped[3];
+		UMOut.getCoords(UMOut.numVerts() - 1, coordsOut);
+		UMMapped.getCoords(UMOut.numVerts() - 1, coordsMapped);
+		BOOST_CHECK(std::equal(coordsOut, coordsOut + 3, coordsMapped));
+		const std::string againName = "/tmp/test-exa-again." + infix + ".ugrid";
+		BOOST_CHECK(UMMapped.writeUGridFile(againName.c_str()));
+		BOOST_CHECK(readFileBytes(againName.c_str()) == bytesInMem);
+		BOOST_CHECK(readFileBytes(mappedName.c_str()) == bytesInMem);
+
+		// A mesh that isn't needed afterwards is just flushed and released.
+		const std::string releasedName = "/tmp/test-exa-released." + infix
+				+ ".ugrid";
+		UMesh UMReleased(UM, 3, releasedName.c_str());
+		BOOST_CHECK(UMReleased.writeUGridFileAndRelease(releasedName.c_str()));
+		BOOST_CHECK(!UMReleased.isMapped());
+		BOOST_CHECK_EQUAL(UMReleased.numVerts(), 0);
+		BOOST_CHECK_EQUAL(UMReleased.numCells(), 0);
+		BOOST_CHECK_EQUAL(UMReleased.getFileImageSize(), 0);
+		BOOST_CHECK(readFileBytes(releasedName.c_str()) == bytesInMem);
+	}
+}
+
+static long fileSize(const char fileName[]) {
+	FILE* file = fopen(fileName, "r");
+	if (!file) return -1;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+// Every UGRID variant must read back as the mesh that was written.
+BOOST_AUTO_TEST_CASE(UGridVariants) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+
+	UMesh UMOut(UM, 3);
+	const char* infixes[] = { "b8", "lb8", "r8", "lr8", "b4", "lb4", "r4", "lr4",
+														"b8l", "lb8l", "r8l", "lr8l", "b4l" };
+	// The refined mesh doesn't count its bdry verts, but every file read
+	// should agree on the count.
+	emInt nBdryVerts = 0;
+	for (const char* infix : infixes) {
+		char fileName[100];
+		sprintf(fileName, "/tmp/test-exa-variant.%s.ugrid", infix);
+		BOOST_TEST_CONTEXT(fileName) {
+			BOOST_REQUIRE(UMOut.writeUGridFile(fileName));
+			UMesh UMIn(fileName);
+			BOOST_CHECK_EQUAL(UMIn.numVerts(), UMOut.numVerts());
+			if (nBdryVerts == 0) nBdryVerts = UMIn.numBdryVerts();
+			BOOST_CHECK_EQUAL(UMIn.numBdryVerts(), nBdryVerts);
+			BOOST_CHECK_EQUAL(UMIn.numBdryTris(), UMOut.numBdryTris());
+			BOOST_CHECK_EQUAL(UMIn.numBdryQuads(), UMOut.numBdryQuads());
+			BOOST_CHECK_EQUAL(UMIn.numTets(), UMOut.numTets());
+			BOOST_CHECK_EQUAL(UMIn.numPyramids(), UMOut.numPyramids());
+			BOOST_CHECK_EQUAL(UMIn.numPrisms(), UMOut.numPrisms());
+			BOOST_CHECK_EQUAL(UMIn.numHexes(), UMOut.numHexes());
+
+			const bool isSingle = (strchr(infix, '4') != nullptr);
+			for (emInt ii = 0; ii < UMOut.numVerts(); ii++) {
+				double in[3], out[3];
+				UMIn.getCoords(ii, in);
+				UMOut.getCoords(ii, out);
+				for (int jj = 0; jj < 3; jj++) {
+					if (isSingle) {
+						BOOST_CHECK_CLOSE_FRACTION(in[jj] + 1, out[jj] + 1, 1.e-6);
+					}
+					else {
+						BOOST_CHECK_EQUAL(in[jj], out[jj]);
+					}
+				}
+			}
+			for (emInt ii = 0; ii < UMOut.numBdryTris(); ii++) {
+				BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getBdryTriConn(ii),
+																			UMIn.getBdryTriConn(ii) + 3,
+																			UMOut.getBdryTriConn(ii),
+																			UMOut.getBdryTriConn(ii) + 3);
+			}
+			for (emInt ii = 0; ii < UMOut.numBdryQuads(); ii++) {
+				BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getBdryQuadConn(ii),
+																			UMIn.getBdryQuadConn(ii) + 4,
+																			UMOut.getBdryQuadConn(ii),
+																			UMOut.getBdryQuadConn(ii) + 4);
+			}
+			for (emInt ii = 0; ii < UMOut.numTets(); ii++) {
+				BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getTetConn(ii),
+																			UMIn.getTetConn(ii) + 4,
+																			UMOut.getTetConn(ii),
+																			UMOut.getTetConn(ii) + 4);
+			}
+			for (emInt ii = 0; ii < UMOut.numPyramids(); ii++) {
+				BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getPyrConn(ii),
+																			UMIn.getPyrConn(ii) + 5,
+																			UMOut.getPyrConn(ii),
+																			UMOut.getPyrConn(ii) + 5);
+			}
+			for (emInt ii = 0; ii < UMOut.numPrisms(); ii++) {
+				BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getPrismConn(ii),
+																			UMIn.getPrismConn(ii) + 6,
+																			UMOut.getPrismConn(ii),
+																			UMOut.getPrismConn(ii) + 6);
+			}
+			for (emInt ii = 0; ii < UMOut.numHexes(); ii++) {
+				BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getHexConn(ii),
+																			UMIn.getHexConn(ii) + 8,
+																			UMOut.getHexConn(ii),
+																			UMOut.getHexConn(ii) + 8);
+			}
+		}
+	}
+	// Plain binary with doubles and ints the size of emInt is exactly the
+	// file image.
+#if (EXA_64BIT_INDICES == 1)
+	const char* const sameInts[] = { "/tmp/test-exa-variant.b8l.ugrid",
+																		"/tmp/test-exa-variant.r8l.ugrid",
+																		"/tmp/test-exa-variant.b4l.ugrid" };
+#else
+	const char* const sameInts[] = { "/tmp/test-exa-variant.b8.ugrid",
+																		"/tmp/test-exa-variant.r8.ugrid",
+																		"/tmp/test-exa-variant.b4.ugrid" };
+#endif
+	BOOST_CHECK_EQUAL(fileSize(sameInts[0]), long(UMOut.getFileImageSize()));
+	BOOST_CHECK_EQUAL(fileSize(sameInts[1]),
+										long(UMOut.getFileImageSize()) + 16);
+	BOOST_CHECK_EQUAL(fileSize(sameInts[2]),
+										long(UMOut.getFileImageSize()) - 12 * long(UMOut.numVerts()));
+
+	// Byte order really does differ between b8 and lb8.
+	FILE* big = fopen("/tmp/test-exa-variant.b8.ugrid", "r");
+	FILE* little = fopen("/tmp/test-exa-variant.lb8.ugrid", "r");
+	BOOST_REQUIRE(big && little);
+	unsigned char bigHeader[4], littleHeader[4];
+	BOOST_REQUIRE(fread(bigHeader, 1, 4, big) == 4);
+	BOOST_REQUIRE(fread(littleHeader, 1, 4, little) == 4);
+	fclose(big);
+	fclose(little);
+	const emInt nVerts = UMOut.numVerts();
+	BOOST_CHECK_EQUAL(bigHeader[3], nVerts & 0xFF);
+	BOOST_CHECK_EQUAL(littleHeader[0], nVerts & 0xFF);
+}
+
+// Reading a coarse mesh through the mesh-file constructor must fill in any
+// bdry faces the file leaves out.
+BOOST_AUTO_TEST_CASE(UGridMissingBdryFaces) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMNoQuads(11, 11, 6, 0, 1, 1, 1, 1);
+	for (emInt vv = 0; vv < UM.numVerts(); vv++) {
+		double coords[3];
+		UM.getCoords(vv, coords);
+		UMNoQuads.addVert(coords);
+	}
+	for (emInt ii = 0; ii < UM.numBdryTris(); ii++) {
+		UMNoQuads.addBdryTri(UM.getBdryTriConn(ii));
+	}
+	UMNoQuads.addTet(UM.getTetConn(0));
+	UMNoQuads.addPyramid(UM.getPyrConn(0));
+	UMNoQuads.addPrism(UM.getPrismConn(0));
+	UMNoQuads.addHex(UM.getHexConn(0));
+	BOOST_REQUIRE(UMNoQuads.writeUGridFile("/tmp/test-exa-noquads.lb8.ugrid"));
+	BOOST_REQUIRE(UM.writeUGridFile("/tmp/test-exa-complete.r8.ugrid"));
+
+	UMesh UMIn("/tmp/test-exa-noquads", "ugrid", "lb8");
+	checkExpectedSize(UMIn);
+	BOOST_CHECK_EQUAL(UMIn.numVerts(), 11);
+	BOOST_CHECK_EQUAL(UMIn.numBdryVerts(), 11);
+	BOOST_CHECK_EQUAL(UMIn.numBdryTris(), 6);
+	BOOST_CHECK_EQUAL(UMIn.numBdryQuads(), 6);
+	BOOST_CHECK_EQUAL(UMIn.numHexes(), 1);
+	BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getHexConn(0), UMIn.getHexConn(0) + 8,
+																UM.getHexConn(0), UM.getHexConn(0) + 8);
+	std::set<std::vector<emInt> > added, expected;
+	for (emInt ii = 0; ii < 6; ii++) {
+		std::vector<emInt> quad(UMIn.getBdryQuadConn(ii),
+														UMIn.getBdryQuadConn(ii) + 4);
+		std::sort(quad.begin(), quad.end());
+		added.insert(quad);
+		quad.assign(UM.getBdryQuadConn(ii), UM.getBdryQuadConn(ii) + 4);
+		std::sort(quad.begin(), quad.end());
+		expected.insert(quad);
+	}
+	BOOST_CHECK(added == expected);
+
+	// A complete mesh is read as is.
+	UMesh UMComplete("/tmp/test-exa-complete", "ugrid", "r8");
+	checkExpectedSize(UMComplete);
+	BOOST_CHECK_EQUAL(UMComplete.numBdryTris(), 6);
+	BOOST_CHECK_EQUAL(UMComplete.numBdryQuads(), 6);
+	for (emInt ii = 0; ii < 6; ii++) {
+		BOOST_CHECK_EQUAL_COLLECTIONS(UMComplete.getBdryQuadConn(ii),
+																	UMComplete.getBdryQuadConn(ii) + 4,
+																	UM.getBdryQuadConn(ii),
+																	UM.getBdryQuadConn(ii) + 4);
+	}
+}
+
+// Missing bdry faces are found by hashing faces into partitions, one set
+// per thread; the faces added mustn't depend on how many threads did that.
+BOOST_AUTO_TEST_CASE(UGridMissingBdryFacesThreaded) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMRefined(UM, 4);
+	UMesh UMNoFaces(UMRefined.numVerts(), UMRefined.numBdryVerts(), 0, 0,
+									UMRefined.numTets(), UMRefined.numPyramids(),
+									UMRefined.numPrisms(), UMRefined.numHexes());
+	for (emInt vv = 0; vv < UMRefined.numVerts(); vv++) {
+		double coords[3];
+		UMRefined.getCoords(vv, coords);
+		UMNoFaces.addVert(coords);
+	}
+	for (emInt ii = 0; ii < UMRefined.numTets(); ii++) {
+		UMNoFaces.addTet(UMRefined.getTetConn(ii));
+	}
+	for (emInt ii = 0; ii < UMRefined.numPyramids(); ii++) {
+		UMNoFaces.addPyramid(UMRefined.getPyrConn(ii));
+	}
+	for (emInt ii = 0; ii < UMRefined.numPrisms(); ii++) {
+		UMNoFaces.addPrism(UMRefined.getPrismConn(ii));
+	}
+	for (emInt ii = 0; ii < UMRefined.numHexes(); ii++) {
+		UMNoFaces.addHex(UMRefined.getHexConn(ii));
+	}
+	BOOST_REQUIRE(UMNoFaces.writeUGridFile("/tmp/test-exa-nofaces.b8.ugrid"));
+
+#ifdef _OPENMP
+	const int oldThreads = omp_get_max_threads();
+	omp_set_num_threads(1);
+#endif
+	UMesh UMSerial("/tmp/test-exa-nofaces", "ugrid", "b8");
+#ifdef _OPENMP
+	omp_set_num_threads(4);
+#endif
+	UMesh UMThreaded("/tmp/test-exa-nofaces", "ugrid", "b8");
+	// Inside a parallel region, with nesting off, the read gets a team of one
+	// thread, though it still asks for four.
+	std::unique_ptr<UMesh> pNested;
+#ifdef _OPENMP
+	const int oldLevels = omp_get_max_active_levels();
+	omp_set_max_active_levels(1);
+#endif
+#pragma omp parallel num_threads(2)
+	{
+#pragma omp single
+		pNested.reset(new UMesh("/tmp/test-exa-nofaces", "ugrid", "b8"));
+	}
+#ifdef _OPENMP
+	omp_set_max_active_levels(oldLevels);
+	omp_set_num_threads(oldThreads);
+#endif
+
+	BOOST_REQUIRE_EQUAL(UMSerial.numBdryTris(), UMRefined.numBdryTris());
+	BOOST_REQUIRE_EQUAL(UMSerial.numBdryQuads(), UMRefined.numBdryQuads());
+	BOOST_REQUIRE_EQUAL(UMThreaded.numBdryTris(), UMRefined.numBdryTris());
+	BOOST_REQUIRE_EQUAL(UMThreaded.numBdryQuads(), UMRefined.numBdryQuads());
+	BOOST_REQUIRE_EQUAL(pNested->numBdryTris(), UMRefined.numBdryTris());
+	BOOST_REQUIRE_EQUAL(pNested->numBdryQuads(), UMRefined.numBdryQuads());
+	std::set<std::vector<emInt> > added, expected;
+	for (emInt ii = 0; ii < UMSerial.numBdryTris(); ii++) {
+		BOOST_CHECK_EQUAL_COLLECTIONS(UMThreaded.getBdryTriConn(ii),
+																	UMThreaded.getBdryTriConn(ii) + 3,
+																	UMSerial.getBdryTriConn(ii),
+																	UMSerial.getBdryTriConn(ii) + 3);
+		BOOST_CHECK_EQUAL_COLLECTIONS(pNested->getBdryTriConn(ii),
+																	pNested->getBdryTriConn(ii) + 3,
+																	UMSerial.getBdryTriConn(ii),
+																	UMSerial.getBdryTriConn(ii) + 3);
+		std::vector<emInt> tri(UMSerial.getBdryTriConn(ii),
+														UMSerial.getBdryTriConn(ii) + 3);
+		std::sort(tri.begin(), tri.end());
+		added.insert(tri);
+		tri.assign(UMRefined.getBdryTriConn(ii), UMRefined.getBdryTriConn(ii) + 3);
+		std::sort(tri.begin(), tri.end());
+		expected.insert(tri);
+	}
+	for (emInt ii = 0; ii < UMSerial.numBdryQuads(); ii++) {
+		BOOST_CHECK_EQUAL_COLLECTIONS(UMThreaded.getBdryQuadConn(ii),
+																	UMThreaded.getBdryQuadConn(ii) + 4,
+																	UMSerial.getBdryQuadConn(ii),
+																	UMSerial.getBdryQuadConn(ii) + 4);
+		BOOST_CHECK_EQUAL_COLLECTIONS(pNested->getBdryQuadConn(ii),
+																	pNested->getBdryQuadConn(ii) + 4,
+																	UMSerial.getBdryQuadConn(ii),
+																	UMSerial.getBdryQuadConn(ii) + 4);
+		std::vector<emInt> quad(UMSerial.getBdryQuadConn(ii),
+														UMSerial.getBdryQuadConn(ii) + 4);
+		std::sort(quad.begin(), quad.end());
+		added.insert(quad);
+		quad.assign(UMRefined.getBdryQuadConn(ii),
+								UMRefined.getBdryQuadConn(ii) + 4);
+		std::sort(quad.begin(), quad.end());
+		expected.insert(quad);
+	}
+	BOOST_CHECK(added == expected);
+}
+
+template<int N>
+static std::multiset<std::vector<emInt> > sortedFaces(const UMesh& UM,
+		const emInt nFaces, const emInt* (UMesh::*getConn)(const emInt) const) {
+	std::multiset<std::vector<emInt> > faces;
+	for (emInt ii = 0; ii < nFaces; ii++) {
+		std::vector<emInt> face((UM.*getConn)(ii), (UM.*getConn)(ii) + N);
+		std::sort(face.begin(), face.end());
+		faces.insert(face);
+	}
+	return faces;
+}
+
+// With no bdry faces in the file at all, every one has to be found.
+BOOST_AUTO_TEST_CASE(UGridAllBdryFacesMissing) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMOut(UM, 4);
+	UMesh UMCells(UMOut.numVerts(), 0, 0, 0, UMOut.numTets(),
+								UMOut.numPyramids(), UMOut.numPrisms(), UMOut.numHexes());
+	for (emInt vv = 0; vv < UMOut.numVerts(); vv++) {
+		double coords[3];
+		UMOut.getCoords(vv, coords);
+		UMCells.addVert(coords);
+	}
+	for (emInt ii = 0; ii < UMOut.numTets(); ii++) {
+		UMCells.addTet(UMOut.getTetConn(ii));
+	}
+	for (emInt ii = 0; ii < UMOut.numPyramids(); ii++) {
+		UMCells.addPyramid(UMOut.getPyrConn(ii));
+	}
+	for (emInt ii = 0; ii < UMOut.numPrisms(); ii++) {
+		UMCells.addPrism(UMOut.getPrismConn(ii));
+	}
+	for (emInt ii = 0; ii < UMOut.numHexes(); ii++) {
+		UMCells.addHex(UMOut.getHexConn(ii));
+	}
+	BOOST_REQUIRE(UMCells.writeUGridFile("/tmp/test-exa-cells.b8.ugrid"));
+
+	UMesh UMIn("/tmp/test-exa-cells", "ugrid", "b8");
+	checkExpectedSize(UMIn);
+	BOOST_CHECK_EQUAL(UMIn.numBdryTris(), UMOut.numBdryTris());
+	BOOST_CHECK_EQUAL(UMIn.numBdryQuads(), UMOut.numBdryQuads());
+	BOOST_CHECK(sortedFaces<3>(UMIn, UMIn.numBdryTris(), &UMesh::getBdryTriConn)
+							== sortedFaces<3>(UMOut, UMOut.numBdryTris(),
+																&UMesh::getBdryTriConn));
+	BOOST_CHECK(sortedFaces<4>(UMIn, UMIn.numBdryQuads(), &UMesh::getBdryQuadConn)
+							== sortedFaces<4>(UMOut, UMOut.numBdryQuads(),
+																&UMesh::getBdryQuadConn));
+}
+
+static std::string readWholeFile(const char fileName[]) {
+	std::string contents;
+	FILE* file = fopen(fileName, "r");
+	if (!file) return contents;
+	char buffer[65536];
+	size_t nRead;
+	while ((nRead = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+		contents.append(buffer, nRead);
+	}
+	fclose(file);
+	return contents;
+}
+
+// The bytes of one of the appended arrays in a .vtu file, uncompressed.
+static std::string vtuArray(const std::string& file, const int iArray,
+		const bool compressed) {
+	size_t pos = 0;
+	for (int ii = 0; ii <= iArray; ii++) {
+		pos = file.find("offset=\"", pos) + 8;
+	}
+	const size_t offset = strtoul(file.c_str() + pos, nullptr, 10);
+	const char appended[] = "<AppendedData encoding=\"raw\">\n_";
+	const char* data = file.data() + file.find(appended) + strlen(appended)
+			+ offset;
+	uint64_t header[3];
+	memcpy(header, data, sizeof(header));
+	if (!compressed) return std::string(data + 8, header[0]);
+	std::string result;
+#if (HAVE_LIBZ == 1)
+	std::vector<uint64_t> compSizes(header[0]);
+	memcpy(compSizes.data(), data + 24, 8 * header[0]);
+	const char* block = data + 24 + 8 * header[0];
+	for (uint64_t ii = 0; ii < header[0]; ii++) {
+		uLongf size = (ii == header[0] - 1 && header[2] != 0) ? header[2] : header[1];
+		std::string buffer(size, '\0');
+		BOOST_CHECK_EQUAL(uncompress(reinterpret_cast<Bytef*>(&buffer[0]), &size,
+																	reinterpret_cast<const Bytef*>(block),
+																	compSizes[ii]),
+											Z_OK);
+		result += buffer;
+		block += compSizes[ii];
+	}
+#endif
+	return result;
+}
+
+template<typename T>
+static T bigEndian(const char* data) {
+	unsigned char bytes[sizeof(T)];
+	for (size_t ii = 0; ii < sizeof(T); ii++) {
+		bytes[ii] = data[sizeof(T) - 1 - ii];
+	}
+	T value;
+	memcpy(&value, bytes, sizeof(T));
+	return value;
+}
+
+BOOST_AUTO_TEST_CASE(VTKWriters) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMOut(UM, 3);
+
+	// What VTK should see: cells in the order bdry tris, bdry quads, tets,
+	// pyramids, prisms, hexes.
+	std::vector<emInt> conn;
+	std::vector<int> nPts, types;
+	const struct {
+		emInt count;
+		int nPts, type;
+		const emInt* (UMesh::*getConn)(const emInt) const;
+	} cellTypes[] = { { UMOut.numBdryTris(), 3, 5, &UMesh::getBdryTriConn }, {
+			UMOut.numBdryQuads(), 4, 9, &UMesh::getBdryQuadConn },
+										{ UMOut.numTets(), 4, 10, &UMesh::getTetConn }, {
+												UMOut.numPyramids(), 5, 14, &UMesh::getPyrConn },
+										{ UMOut.numPrisms(), 6, 13, &UMesh::getPrismConn }, {
+												UMOut.numHexes(), 8, 12, &UMesh::getHexConn } };
+	for (const auto& cellType : cellTypes) {
+		for (emInt ii = 0; ii < cellType.count; ii++) {
+			const emInt* verts = (UMOut.*cellType.getConn)(ii);
+			conn.insert(conn.end(), verts, verts + cellType.nPts);
+			nPts.push_back(cellType.nPts);
+			types.push_back(cellType.type);
+		}
+	}
+	const size_t nCells = types.size();
+
+	// Legacy binary, which is big-endian.
+	BOOST_REQUIRE(UMOut.writeVTKFile("/tmp/test-exa.vtk"));
+	const std::string legacy = readWholeFile("/tmp/test-exa.vtk");
+	char expected[100];
+	sprintf(expected, "POINTS %" EMINT_FMT " double\n", UMOut.numVerts());
+	size_t pos = legacy.find(expected);
+	BOOST_REQUIRE(pos != std::string::npos);
+	const char* data = legacy.data() + pos + strlen(expected);
+	for (emInt vv = 0; vv < UMOut.numVerts(); vv++) {
+		double coords[3];
+		UMOut.getCoords(vv, coords);
+		for (int jj = 0; jj < 3; jj++) {
+			BOOST_CHECK_EQUAL(bigEndian<double>(data + 8 * (3 * vv + jj)),
+												coords[jj]);
+		}
+	}
+	sprintf(expected, "\nCELLS %zu %zu\n", nCells, conn.size() + nCells);
+	pos = legacy.find(expected);
+	BOOST_REQUIRE(pos != std::string::npos);
+	data = legacy.data() + pos + strlen(expected);
+	size_t entry = 0, connIndex = 0;
+	for (size_t cc = 0; cc < nCells; cc++) {
+		BOOST_CHECK_EQUAL(bigEndian<int32_t>(data + 4 * entry++), nPts[cc]);
+		for (int ii = 0; ii < nPts[cc]; ii++) {
+			BOOST_CHECK_EQUAL(bigEndian<int32_t>(data + 4 * entry++),
+												conn[connIndex++]);
+		}
+	}
+	sprintf(expected, "\nCELL_TYPES %zu\n", nCells);
+	pos = legacy.find(expected);
+	BOOST_REQUIRE(pos != std::string::npos);
+	data = legacy.data() + pos + strlen(expected);
+	for (size_t cc = 0; cc < nCells; cc++) {
+		BOOST_CHECK_EQUAL(bigEndian<int32_t>(data + 4 * cc), types[cc]);
+	}
+	BOOST_CHECK_EQUAL(legacy.size(), pos + strlen(expected) + 4 * nCells + 1);
+
+	// XML, with raw appended data in native byte order.
+	BOOST_REQUIRE(UMOut.writeVTUFile("/tmp/test-exa.vtu"));
+	const std::string vtu = readWholeFile("/tmp/test-exa.vtu");
+	const std::string points = vtuArray(vtu, 0, false);
+	BOOST_REQUIRE_EQUAL(points.size(), 24 * size_t(UMOut.numVerts()));
+	for (emInt vv = 0; vv < UMOut.numVerts(); vv++) {
+		double coords[3], written[3];
+		UMOut.getCoords(vv, coords);
+		memcpy(written, points.data() + 24 * vv, 24);
+		BOOST_CHECK_EQUAL_COLLECTIONS(written, written + 3, coords, coords + 3);
+	}
+	const std::string vtuConn = vtuArray(vtu, 1, false);
+	BOOST_REQUIRE_EQUAL(vtuConn.size(), conn.size() * sizeof(emInt));
+	BOOST_CHECK(memcmp(vtuConn.data(), conn.data(), vtuConn.size()) == 0);
+	const std::string vtuOffsets = vtuArray(vtu, 2, false);
+	const std::string vtuTypes = vtuArray(vtu, 3, false);
+	BOOST_REQUIRE_EQUAL(vtuOffsets.size(), 8 * nCells);
+	BOOST_REQUIRE_EQUAL(vtuTypes.size(), nCells);
+	int64_t end = 0;
+	for (size_t cc = 0; cc < nCells; cc++) {
+		end += nPts[cc];
+		int64_t offset;
+		memcpy(&offset, vtuOffsets.data() + 8 * cc, 8);
+		BOOST_CHECK_EQUAL(offset, end);
+		BOOST_CHECK_EQUAL(int(uint8_t(vtuTypes[cc])), types[cc]);
+	}
+	BOOST_CHECK(vtu.find("</VTKFile>") != std::string::npos);
+
+#if (HAVE_LIBZ == 1)
+	BOOST_REQUIRE(UMOut.writeVTUFile("/tmp/test-exa.vtu.z", true));
+	const std::string compressed = readWholeFile("/tmp/test-exa.vtu.z");
+	BOOST_CHECK(compressed.find("vtkZLibDataCompressor") != std::string::npos);
+	BOOST_CHECK_LT(compressed.size(), vtu.size());
+	for (int iArray = 0; iArray < 4; iArray++) {
+		BOOST_CHECK(vtuArray(compressed, iArray, true)
+										== vtuArray(vtu, iArray, false));
+	}
+#endif
+}
+
+// Write UM as an ASCII legacy VTK file, with the cell types interleaved so
+// the reader has to sort them out.  Version 5 files have separate offsets
+// and connectivity.
+static void writeASCIIVTKFile(const UMesh& UM, const char fileName[],
+		const bool isVersion5) {
+	FILE* outFile = fopen(fileName, "w");
+	BOOST_REQUIRE(outFile != nullptr);
+	fprintf(outFile, "# vtk DataFile Version %s\n", isVersion5 ? "5.1" : "3.0");
+	fprintf(outFile, "Mixed mesh\nASCII\nDATASET UNSTRUCTURED_GRID\n");
+	fprintf(outFile, "POINTS %" EMINT_FMT " double\n", UM.numVerts());
+	for (emInt vv = 0; vv < UM.numVerts(); vv++) {
+		double coords[3];
+		UM.getCoords(vv, coords);
+		fprintf(outFile, "%.17g %.17g\n%.17g\n", coords[0], coords[1],
+						coords[2]);
+	}
+
+	const struct {
+		emInt count;
+		int nPts, type;
+		const emInt* (UMesh::*getConn)(const emInt) const;
+	} cellTypes[] = { { UM.numBdryTris(), 3, 5, &UMesh::getBdryTriConn }, {
+			UM.numBdryQuads(), 4, 9, &UMesh::getBdryQuadConn },
+										{ UM.numTets(), 4, 10, &UMesh::getTetConn }, {
+												UM.numPyramids(), 5, 14, &UMesh::getPyrConn },
+										{ UM.numPrisms(), 6, 13, &UMesh::getPrismConn }, {
+												UM.numHexes(), 8, 12, &UMesh::getHexConn } };
+	std::vector<const emInt*> cells;
+	std::vector<int> nPts, types;
+	emInt maxCount = 0;
+	for (const auto& cellType : cellTypes) {
+		maxCount = std::max(maxCount, cellType.count);
+	}
+	for (emInt ii = 0; ii < maxCount; ii++) {
+		for (const auto& cellType : cellTypes) {
+			if (ii >= cellType.count) continue;
+			cells.push_back((UM.*cellType.getConn)(ii));
+			nPts.push_back(cellType.nPts);
+			types.push_back(cellType.type);
+		}
+	}
+	size_t connSize = 0;
+	for (int n : nPts) {
+		connSize += n;
+	}
+
+	if (isVersion5) {
+		fprintf(outFile, "CELLS %zu %zu\nOFFSETS vtktypeint64\n",
+						cells.size() + 1, connSize);
+		size_t offset = 0;
+		fprintf(outFile, "0");
+		for (size_t cc = 0; cc < cells.size(); cc++) {
+			offset += nPts[cc];
+			fprintf(outFile, " %zu", offset);
+		}
+		fprintf(outFile, "\nCONNECTIVITY vtktypeint64\n");
+		for (size_t cc = 0; cc < cells.size(); cc++) {
+			for (int ii = 0; ii < nPts[cc]; ii++) {
+				fprintf(outFile, "%" EMINT_FMT " ", cells[cc][ii]);
+			}
+			fprintf(outFile, "\n");
+		}
+	}
+	else {
+		fprintf(outFile, "CELLS %zu %zu\n", cells.size(),
+						cells.size() + connSize);
+		for (size_t cc = 0; cc < cells.size(); cc++) {
+			fprintf(outFile, "%d", nPts[cc]);
+			for (int ii = 0; ii < nPts[cc]; ii++) {
+				fprintf(outFile, "\t%" EMINT_FMT, cells[cc][ii]);
+			}
+			fprintf(outFile, "\n");
+		}
+	}
+	fprintf(outFile, "CELL_TYPES %zu\n", cells.size());
+	for (size_t cc = 0; cc < cells.size(); cc++) {
+		fprintf(outFile, "%d\n", types[cc]);
+	}
+	fprintf(outFile, "CELL_DATA %zu\nSCALARS id int 1\nLOOKUP_TABLE default\n",
+					cells.size());
+	for (size_t cc = 0; cc < cells.size(); cc++) {
+		fprintf(outFile, "%zu\n", cc);
+	}
+	fclose(outFile);
+}
+
+BOOST_AUTO_TEST_CASE(ASCIIVTKReader) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	// Big enough (about 600 KB) that each section is parsed in pieces.
+	UMesh UMOut(UM, 12);
+
+	// The refined mesh doesn't count its bdry verts, so both reads are
+	// compared with each other instead.
+	emInt nBdryVerts = 0;
+	for (const bool isVersion5 : { false, true }) {
+		writeASCIIVTKFile(UMOut, "/tmp/test-exa-ascii.vtk", isVersion5);
+		UMesh UMIn("/tmp/test-exa-ascii", "vtk", "");
+		checkExpectedSize(UMIn);
+		BOOST_REQUIRE_EQUAL(UMIn.numVerts(), UMOut.numVerts());
+		if (!isVersion5) nBdryVerts = UMIn.numBdryVerts();
+		BOOST_CHECK_GT(nBdryVerts, 0);
+		BOOST_CHECK_EQUAL(UMIn.numBdryVerts(), nBdryVerts);
+		BOOST_REQUIRE_EQUAL(UMIn.numBdryTris(), UMOut.numBdryTris());
+		BOOST_REQUIRE_EQUAL(UMIn.numBdryQuads(), UMOut.numBdryQuads());
+		BOOST_REQUIRE_EQUAL(UMIn.numTets(), UMOut.numTets());
+		BOOST_REQUIRE_EQUAL(UMIn.numPyramids(), UMOut.numPyramids());
+		BOOST_REQUIRE_EQUAL(UMIn.numPrisms(), UMOut.numPrisms());
+		BOOST_REQUIRE_EQUAL(UMIn.numHexes(), UMOut.numHexes());
+		for (emInt vv = 0; vv < UMOut.numVerts(); vv++) {
+			double coordsIn[3], coordsOut[3];
+			UMIn.getCoords(vv, coordsIn);
+			UMOut.getCoords(vv, coordsOut);
+			BOOST_CHECK_EQUAL_COLLECTIONS(coordsIn, coordsIn + 3, coordsOut,
+																		coordsOut + 3);
+		}
+		for (emInt ii = 0; ii < UMOut.numBdryTris(); ii++) {
+			BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getBdryTriConn(ii),
+																		UMIn.getBdryTriConn(ii) + 3,
+																		UMOut.getBdryTriConn(ii),
+																		UMOut.getBdryTriConn(ii) + 3);
+		}
+		for (emInt ii = 0; ii < UMOut.numBdryQuads(); ii++) {
+			BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getBdryQuadConn(ii),
+																		UMIn.getBdryQuadConn(ii) + 4,
+																		UMOut.getBdryQuadConn(ii),
+																		UMOut.getBdryQuadConn(ii) + 4);
+		}
+		for (emInt ii = 0; ii < UMOut.numTets(); ii++) {
+			BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getTetConn(ii),
+																		UMIn.getTetConn(ii) + 4,
+																		UMOut.getTetConn(ii),
+																		UMOut.getTetConn(ii) + 4);
+		}
+		for (emInt ii = 0; ii < UMOut.numPyramids(); ii++) {
+			BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getPyrConn(ii),
+																		UMIn.getPyrConn(ii) + 5,
+																		UMOut.getPyrConn(ii),
+																		UMOut.getPyrConn(ii) + 5);
+		}
+		for (emInt ii = 0; ii < UMOut.numPrisms(); ii++) {
+			BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getPrismConn(ii),
+																		UMIn.getPrismConn(ii) + 6,
+																		UMOut.getPrismConn(ii),
+																		UMOut.getPrismConn(ii) + 6);
+		}
+		for (emInt ii = 0; ii < UMOut.numHexes(); ii++) {
+			BOOST_CHECK_EQUAL_COLLECTIONS(UMIn.getHexConn(ii),
+																		UMIn.getHexConn(ii) + 8,
+																		UMOut.getHexConn(ii),
+																		UMOut.getHexConn(ii) + 8);
+		}
+	}
+}
+
+// Numbers must come out the same however the text is cut into pieces,
+// including pieces that start or end in the middle of a number.
+BOOST_AUTO_TEST_CASE(ParseVTKNumbersInPieces) {
+#ifdef _OPENMP
+	const int oldThreads = omp_get_max_threads();
+	omp_set_num_threads(4);
+#endif
+	const char* const blanks[] = { " ", "\n", "  \t", " \r\n" };
+	const emInt nInts = 40000;
+	std::string intText = "\n";
+	for (emInt ii = 0; ii < nInts; ii++) {
+		intText += std::to_string(ii * 37) + blanks[ii % 4];
+	}
+	const emInt nReals = 1000;
+	std::string realText;
+	for (emInt ii = 0; ii < nReals; ii++) {
+		realText += std::to_string(ii * 0.25 - 7) + blanks[ii % 4];
+	}
+	BOOST_REQUIRE_GT(intText.size(), 65536 * 3);
+
+	for (const size_t pieceBytes : { size_t(65536), size_t(1), size_t(7),
+																		size_t(1000) }) {
+		BOOST_TEST_CONTEXT("pieces of " << pieceBytes << " bytes") {
+			const char* const begin = intText.data();
+			const char* const end = begin + intText.size();
+			std::vector<emInt> ints(nInts, EMINT_MAX);
+			BOOST_CHECK(parseVTKInts(begin, end, nInts, ints.data(), pieceBytes));
+			bool allRight = true;
+			for (emInt ii = 0; ii < nInts; ii++) {
+				allRight = allRight && ints[ii] == ii * 37;
+			}
+			BOOST_CHECK(allRight);
+			BOOST_CHECK(!parseVTKInts(begin, end, nInts - 1, ints.data(),
+																pieceBytes));
+			BOOST_CHECK(!parseVTKInts(begin, end, nInts + 1, ints.data(),
+																pieceBytes));
+
+			std::vector<double> reals(nReals, -1);
+			BOOST_CHECK(parseVTKReals(realText.data(),
+																realText.data() + realText.size(), nReals,
+																reals.data(), pieceBytes));
+			for (emInt ii = 0; ii < nReals; ii += 97) {
+				BOOST_CHECK_EQUAL(reals[ii], ii * 0.25 - 7);
+			}
+
+			// A bad number in the middle of some piece.
+			std::string badText = intText;
+			badText[badText.size() / 2 + 1] = 'x';
+			BOOST_CHECK(!parseVTKInts(badText.data(),
+																badText.data() + badText.size(), nInts,
+																ints.data(), pieceBytes));
+		}
+	}
+#ifdef _OPENMP
+	omp_set_num_threads(oldThreads);
+#endif
+}
+
+BOOST_AUTO_TEST_CASE(UMeshSnapshot) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	BOOST_REQUIRE(UM.writeUGridFile("/tmp/test-exa-snap.b8.ugrid"));
+	UMesh UMIn("/tmp/test-exa-snap", "ugrid", "b8");
+	std::vector<Part> parts;
+	std::vector<CellPartData> vecCPD;
+	partitionCells(&UMIn, 2, parts, vecCPD);
+	BOOST_REQUIRE(UMIn.writeSnapshot("/tmp/test-exa.snap", &parts, &vecCPD));
+
+	Snapshot snap("/tmp/test-exa.snap");
+	UMesh UMSnap(snap);
+	checkExpectedSize(UMSnap);
+	BOOST_CHECK_EQUAL(UMSnap.numVerts(), UMIn.numVerts());
+	BOOST_CHECK_EQUAL(UMSnap.numBdryVerts(), UMIn.numBdryVerts());
+	BOOST_CHECK_EQUAL(UMSnap.numBdryTris(), UMIn.numBdryTris());
+	BOOST_CHECK_EQUAL(UMSnap.numBdryQuads(), UMIn.numBdryQuads());
+	BOOST_CHECK_EQUAL(UMSnap.numCells(), UMIn.numCells());
+	for (emInt vv = 0; vv < UMIn.numVerts(); vv++) {
+		double coordsIn[3], coordsSnap[3];
+		UMIn.getCoords(vv, coordsIn);
+		UMSnap.getCoords(vv, coordsSnap);
+		BOOST_CHECK_EQUAL_COLLECTIONS(coordsSnap, coordsSnap + 3, coordsIn,
+																	coordsIn + 3);
+		BOOST_CHECK_GT(UMSnap.getLengthScale(vv), 0);
+		BOOST_CHECK_EQUAL(UMSnap.getLengthScale(vv), UMIn.getLengthScale(vv));
+	}
+	BOOST_CHECK_EQUAL_COLLECTIONS(UMSnap.getBdryQuadConn(0),
+																UMSnap.getBdryQuadConn(0) + 24,
+																UMIn.getBdryQuadConn(0),
+																UMIn.getBdryQuadConn(0) + 24);
+	BOOST_CHECK_EQUAL_COLLECTIONS(UMSnap.getHexConn(0),
+																UMSnap.getHexConn(0) + 8,
+																UMIn.getHexConn(0), UMIn.getHexConn(0) + 8);
+
+	BOOST_REQUIRE_EQUAL(snap.numParts(), 2);
+	std::vector<Part> partsSnap;
+	std::vector<CellPartData> vecCPDSnap;
+	BOOST_REQUIRE(snap.getPartition(partsSnap, vecCPDSnap));
+	BOOST_REQUIRE_EQUAL(vecCPDSnap.size(), vecCPD.size());
+	for (int ii = 0; ii < 2; ii++) {
+		BOOST_CHECK_EQUAL(partsSnap[ii].getFirst(), parts[ii].getFirst());
+		BOOST_CHECK_EQUAL(partsSnap[ii].getLast(), parts[ii].getLast());
+	}
+	for (size_t ii = 0; ii < vecCPD.size(); ii++) {
+		BOOST_CHECK_EQUAL(vecCPDSnap[ii].getIndex(), vecCPD[ii].getIndex());
+		BOOST_CHECK_EQUAL(vecCPDSnap[ii].getCellType(),
+											vecCPD[ii].getCellType());
+	}
+
+	UMesh UMFine(UMSnap, 3), UMFineIn(UMIn, 3);
+	BOOST_CHECK_EQUAL(UMFine.numVerts(), UMFineIn.numVerts());
+	BOOST_CHECK_EQUAL(UMFine.numCells(), UMFineIn.numCells());
+
+	// Without a partition.
+	BOOST_REQUIRE(UMIn.writeSnapshot("/tmp/test-exa-nopart.snap"));
+	Snapshot snapNoParts("/tmp/test-exa-nopart.snap");
+	BOOST_CHECK_EQUAL(snapNoParts.numParts(), 0);
+	BOOST_CHECK(!snapNoParts.getPartition(partsSnap, vecCPDSnap));
+}
+
+BOOST_AUTO_TEST_CASE(CubicMeshSnapshot) {
+	CubicMesh CM(20, 20, 4, 0, 1, 0, 0, 0);
+	emInt tri[10], tet[20];
+	for (emInt ii = 0; ii < 20; ii++) {
+		double coords[] = { 0.5 * ii, 1. / (ii + 1), -double(ii) };
+		CM.addVert(coords);
+		tet[ii] = (7 * ii) % 20;
+	}
+	CM.addTet(tet);
+	for (emInt ii = 0; ii < 4; ii++) {
+		for (emInt jj = 0; jj < 10; jj++) {
+			tri[jj] = (ii + 3 * jj) % 20;
+		}
+		CM.addBdryTri(tri);
+	}
+	CM.setNVertNodes(4);
+	BOOST_REQUIRE(CM.writeSnapshot("/tmp/test-exa-cubic.snap"));
+
+	Snapshot snap("/tmp/test-exa-cubic.snap");
+	CubicMesh CMSnap(snap);
+	BOOST_CHECK_EQUAL(CMSnap.numVerts(), 20);
+	BOOST_CHECK_EQUAL(CMSnap.numBdryVerts(), 20);
+	BOOST_CHECK_EQUAL(CMSnap.numBdryTris(), 4);
+	BOOST_CHECK_EQUAL(CMSnap.numTets(), 1);
+	BOOST_CHECK_EQUAL(CMSnap.numVertsToCopy(), 4);
+	for (emInt vv = 0; vv < 20; vv++) {
+		double coords[3], coordsSnap[3];
+		CM.getCoords(vv, coords);
+		CMSnap.getCoords(vv, coordsSnap);
+		BOOST_CHECK_EQUAL_COLLECTIONS(coordsSnap, coordsSnap + 3, coords,
+																	coords + 3);
+	}
+	BOOST_CHECK_EQUAL_COLLECTIONS(CMSnap.getTetConn(0), CMSnap.getTetConn(0) + 20,
+																tet, tet + 20);
+	for (emInt ii = 0; ii < 4; ii++) {
+		BOOST_CHECK_EQUAL_COLLECTIONS(CMSnap.getBdryTriConn(ii),
+																	CMSnap.getBdryTriConn(ii) + 10,
+																	CM.getBdryTriConn(ii),
+																	CM.getBdryTriConn(ii) + 10);
+	}
+}
+
+#if (HAVE_LIBZ == 1)
+// A block-compressed UGRID file must hold exactly the bytes of the plain
+// file, and read back as the same mesh.
+BOOST_AUTO_TEST_CASE(BlockCompressedUGrid) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+
+	// Big enough for several blocks.
+	UMesh UMOut(UM, 20);
+	const char* infixes[] = { "b8", "lr8", "b4l", "lr4" };
+	for (const char* infix : infixes) {
+		char fileName[100], zFileName[sizeof(fileName) + 2];
+		snprintf(fileName, sizeof(fileName), "/tmp/test-exa-blocks.%s.ugrid",
+							infix);
+		snprintf(zFileName, sizeof(zFileName), "%s.z", fileName);
+		BOOST_TEST_CONTEXT(zFileName) {
+			BOOST_REQUIRE(UMOut.writeUGridFile(fileName));
+			BOOST_REQUIRE(UMOut.writeUGridFile(zFileName));
+			const std::string plain = readWholeFile(fileName);
+			const std::string compressed = readWholeFile(zFileName);
+			BOOST_CHECK_LT(compressed.size(), plain.size());
+
+			size_t dataBytes = 0;
+			BOOST_REQUIRE(
+					blockCompressedDataSize(compressed.data(), compressed.size(),
+																	dataBytes));
+			BOOST_REQUIRE_EQUAL(dataBytes, plain.size());
+			std::string data(dataBytes, '\0');
+			BOOST_REQUIRE(
+					readBlockCompressedRange(compressed.data(), compressed.size(), 0,
+																		dataBytes, &data[0]));
+			BOOST_CHECK(data == plain);
+			// Ranges that start and end mid-block.
+			const size_t offset = dataBytes / 3 + 1, bytes = dataBytes / 2;
+			std::string range(bytes, '\0');
+			BOOST_REQUIRE(
+					readBlockCompressedRange(compressed.data(), compressed.size(),
+																		offset, bytes, &range[0]));
+			BOOST_CHECK(range == plain.substr(offset, bytes));
+
+			UMesh UMIn(zFileName), UMPlain(fileName);
+			BOOST_REQUIRE(UMIn.writeUGridFile("/tmp/test-exa-fromz.b8.ugrid"));
+			BOOST_REQUIRE(
+					UMPlain.writeUGridFile("/tmp/test-exa-fromplain.b8.ugrid"));
+			BOOST_CHECK(
+					readWholeFile("/tmp/test-exa-fromz.b8.ugrid")
+							== readWholeFile("/tmp/test-exa-fromplain.b8.ugrid"));
+		}
+	}
+
+	// The (base, type, infix) constructor finds the compressed file when
+	// there's no plain one.
+	remove("/tmp/test-exa-blocks.b8.ugrid");
+	UMesh UMBase("/tmp/test-exa-blocks", "ugrid", "b8");
+	BOOST_CHECK_EQUAL(UMBase.numCells(), UMOut.numCells());
+}
+#endif
+
+BOOST_AUTO_TEST_CASE(PackedConnectivity) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMOut(UM, 20);
+
+	// Prisms, packed in several blocks.
+	const emInt nPrisms = UMOut.numPrisms();
+	const emInt* const conn = UMOut.getPrismConn(0);
+	const std::vector<char> packed = packConnectivity(conn, nPrisms, 6);
+	BOOST_REQUIRE(!packed.empty());
+	BOOST_CHECK_LT(packed.size(), 6 * sizeof(emInt) * nPrisms / 2);
+	size_t nCells = 0;
+	int nPts = 0;
+	BOOST_REQUIRE(packedConnectivitySize(packed.data(), packed.size(), nCells,
+																				nPts));
+	BOOST_CHECK_EQUAL(nCells, nPrisms);
+	BOOST_CHECK_EQUAL(nPts, 6);
+
+	// With the SIMD decoder, where the CPU has one, and without.
+	const bool hasSIMD = setUseSIMDUnpacking(true);
+	std::vector<emInt> unpackedSIMD;
+	for (const bool useSIMD : { true, false }) {
+		BOOST_CHECK_EQUAL(setUseSIMDUnpacking(useSIMD), useSIMD && hasSIMD);
+		std::vector<emInt> unpacked(6 * size_t(nPrisms));
+		BOOST_REQUIRE(unpackConnectivity(packed.data(), 0, nPrisms,
+																			unpacked.data()));
+		BOOST_CHECK(std::equal(unpacked.begin(), unpacked.end(), conn));
+		if (useSIMD) unpackedSIMD = unpacked;
+		else BOOST_CHECK(unpacked == unpackedSIMD);
+		// A range that starts and ends mid-block.
+		const size_t first = nPrisms / 3 + 1, count = nPrisms / 2;
+		std::vector<emInt> range(6 * count);
+		BOOST_REQUIRE(unpackConnectivity(packed.data(), first, count,
+																			range.data()));
+		BOOST_CHECK(std::equal(range.begin(), range.end(), conn + 6 * first));
+	}
+	setUseSIMDUnpacking(true);
+#if defined(__x86_64__) && defined(__GNUC__)
+	BOOST_CHECK_EQUAL(hasSIMD, __builtin_cpu_supports("ssse3") != 0);
+#endif
+
+	// Large jumps in both directions (differences are limited to 2^31 even
+	// with 64-bit indices).
+	const emInt spread[] = { 0, UINT32_MAX / 4, 7, 3, 2, 1, 1000000, 0 };
+	const std::vector<char> packedSpread = packConnectivity(spread, 2, 4);
+	std::vector<emInt> unpackedSpread(8);
+	BOOST_REQUIRE(unpackConnectivity(packedSpread.data(), 0, 2,
+																		unpackedSpread.data()));
+	BOOST_CHECK(std::equal(unpackedSpread.begin(), unpackedSpread.end(), spread));
+
+	// And a whole mesh in a packed mesh file.
+	BOOST_REQUIRE(UMOut.writePackedMeshFile("/tmp/test-exa-packed.pmesh"));
+	BOOST_REQUIRE(UMOut.writeUGridFile("/tmp/test-exa-packed.b8.ugrid"));
+	BOOST_CHECK_LT(readWholeFile("/tmp/test-exa-packed.pmesh").size(),
+									readWholeFile("/tmp/test-exa-packed.b8.ugrid").size());
+	UMesh UMIn("/tmp/test-exa-packed.pmesh");
+	BOOST_CHECK_EQUAL(UMIn.numCells(), UMOut.numCells());
+	BOOST_REQUIRE(UMIn.writeUGridFile("/tmp/test-exa-unpacked.b8.ugrid"));
+	BOOST_CHECK(
+			readWholeFile("/tmp/test-exa-unpacked.b8.ugrid")
+					== readWholeFile("/tmp/test-exa-packed.b8.ugrid"));
+}
+
+// Refining part by part into one file must give the same mesh as serial
+// refinement, with every part bdry vert shared by the parts that meet there.
+BOOST_AUTO_TEST_CASE(SingleFileParallelRefine) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	// Read back from a file, so that the coarse mesh has length scales.
+	UMesh UMRefined(UM, 3);
+	BOOST_REQUIRE(UMRefined.writeUGridFile("/tmp/test-exa-coarse.b8.ugrid"));
+	UMesh UMCoarse("/tmp/test-exa-coarse", "ugrid", "b8");
+
+	// The exact edge count, which sizes the file.
+	std::set<std::pair<emInt, emInt> > edges;
+	auto addEdges = [&](const emInt* conn, const int (*edgeVerts)[2],
+			const int nEdges) {
+		for (int iE = 0; iE < nEdges; iE++) {
+			const emInt v0 = conn[edgeVerts[iE][0]], v1 = conn[edgeVerts[iE][1]];
+			edges.insert(std::make_pair(std::min(v0, v1), std::max(v0, v1)));
+		}
+	};
+	for (emInt ii = 0; ii < UMCoarse.numTets(); ii++) {
+		addEdges(UMCoarse.getTetConn(ii), TetTraits::edgeVerts,
+							TetTraits::numEdges);
+	}
+	for (emInt ii = 0; ii < UMCoarse.numPyramids(); ii++) {
+		addEdges(UMCoarse.getPyrConn(ii), PyrTraits::edgeVerts,
+							PyrTraits::numEdges);
+	}
+	for (emInt ii = 0; ii < UMCoarse.numPrisms(); ii++) {
+		addEdges(UMCoarse.getPrismConn(ii), PrismTraits::edgeVerts,
+							PrismTraits::numEdges);
+	}
+	for (emInt ii = 0; ii < UMCoarse.numHexes(); ii++) {
+		addEdges(UMCoarse.getHexConn(ii), HexTraits::edgeVerts,
+							HexTraits::numEdges);
+	}
+	BOOST_CHECK_EQUAL(countEdges(UMCoarse), edges.size());
+
+	const int nDivs = 3;
+	std::vector<Part> parts;
+	std::vector<CellPartData> vecCPD;
+	partitionCells(&UMCoarse, 4, parts, vecCPD);
+	BOOST_REQUIRE(UMCoarse.refineIntoSingleFile(nDivs, parts, vecCPD,
+																							"/tmp/test-exa-single.b8.ugrid"));
+	UMesh UMSerial(UMCoarse, nDivs);
+
+	UMesh UMIn("/tmp/test-exa-single.b8.ugrid");
+	BOOST_CHECK_EQUAL(UMIn.numVerts(), UMSerial.numVerts());
+	BOOST_CHECK_EQUAL(UMIn.numBdryTris(), UMSerial.numBdryTris());
+	BOOST_CHECK_EQUAL(UMIn.numBdryQuads(), UMSerial.numBdryQuads());
+	BOOST_CHECK_EQUAL(UMIn.numTets(), UMSerial.numTets());
+	BOOST_CHECK_EQUAL(UMIn.numPyramids(), UMSerial.numPyramids());
+	BOOST_CHECK_EQUAL(UMIn.numPrisms(), UMSerial.numPrisms());
+	BOOST_CHECK_EQUAL(UMIn.numHexes(), UMSerial.numHexes());
+	double sumIn[3] = { 0, 0, 0 }, sumSerial[3] = { 0, 0, 0 };
+	for (emInt vv = 0; vv < UMIn.numVerts(); vv++) {
+		for (int ii = 0; ii < 3; ii++) {
+			double coords[3];
+			UMIn.getCoords(vv, coords);
+			sumIn[ii] += coords[ii];
+			UMSerial.getCoords(vv, coords);
+			sumSerial[ii] += coords[ii];
+		}
+	}
+	// The verts are numbered differently, and those on faces between cells
+	// move a little depending on which cell places them, so only the sums
+	// of the coordinates can be compared, and only approximately.
+	for (int ii = 0; ii < 3; ii++) {
+		BOOST_CHECK_CLOSE(sumIn[ii], sumSerial[ii], 0.1);
+	}
+
+	// Any cell face matched by no other cell or bdry face would be added as
+	// a bdry face here.
+	UMesh UMFilled("/tmp/test-exa-single", "ugrid", "b8");
+	BOOST_CHECK_EQUAL(UMFilled.numBdryTris(), UMSerial.numBdryTris());
+	BOOST_CHECK_EQUAL(UMFilled.numBdryQuads(), UMSerial.numBdryQuads());
+}
+
+// Each part's interface table must pair its verts with the neighbour's
+// verts at the same place, and agree with the neighbour's table.
+BOOST_AUTO_TEST_CASE(PartInterfaceTables) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMRefined(UM, 3);
+	BOOST_REQUIRE(UMRefined.writeUGridFile("/tmp/test-exa-coarse.b8.ugrid"));
+	UMesh UMCoarse("/tmp/test-exa-coarse", "ugrid", "b8");
+
+	const int nParts = 4;
+	std::vector<Part> parts;
+	std::vector<CellPartData> vecCPD;
+	partitionCells(&UMCoarse, nParts, parts, vecCPD);
+	UMCoarse.refineForParallel(3, parts, vecCPD, "/tmp/test-exa-part");
+
+	std::vector<std::unique_ptr<UMesh> > meshes;
+	std::vector<std::vector<PartNeighbour> > tables(nParts);
+	for (int ii = 0; ii < nParts; ii++) {
+		char fileName[100];
+		sprintf(fileName, "/tmp/test-exa-part%03d." NATIVE_UGRID_INFIX ".ugrid",
+						ii);
+		meshes.emplace_back(new UMesh(fileName));
+		sprintf(fileName, "/tmp/test-exa-part%03d.interface", ii);
+		emInt part = EMINT_MAX;
+		BOOST_REQUIRE(readInterfaceTable(fileName, part, tables[ii]));
+		BOOST_CHECK_EQUAL(part, ii);
+		BOOST_CHECK(!tables[ii].empty());
+	}
+
+	for (int ii = 0; ii < nParts; ii++) {
+		for (const PartNeighbour& PN : tables[ii]) {
+			BOOST_REQUIRE_LT(PN.part, nParts);
+			BOOST_CHECK_NE(PN.part, ii);
+			auto other = std::find_if(tables[PN.part].begin(),
+																tables[PN.part].end(),
+																[&](const PartNeighbour& PNOther) {
+																	return PNOther.part == emInt(ii);
+																});
+			BOOST_REQUIRE(other != tables[PN.part].end());
+			BOOST_CHECK(other->localVerts == PN.neighbourVerts);
+			BOOST_CHECK(other->neighbourVerts == PN.localVerts);
+
+			// Shared verts can move a little depending on which cell placed
+			// them, but each is much closer to its partner than to any other
+			// vert of the neighbour.
+			const UMesh& local = *meshes[ii];
+			const UMesh& neighbour = *meshes[PN.part];
+			for (size_t iV = 0; iV < PN.localVerts.size(); iV++) {
+				double coords[3];
+				local.getCoords(PN.localVerts[iV], coords);
+				emInt closest = EMINT_MAX;
+				double minDist = DBL_MAX;
+				for (emInt vv = 0; vv < neighbour.numVerts(); vv++) {
+					double coordsN[3];
+					neighbour.getCoords(vv, coordsN);
+					const double dist = (coords[0] - coordsN[0])
+							* (coords[0] - coordsN[0])
+							+ (coords[1] - coordsN[1]) * (coords[1] - coordsN[1])
+							+ (coords[2] - coordsN[2]) * (coords[2] - coordsN[2]);
+					if (dist < minDist) {
+						minDist = dist;
+						closest = vv;
+					}
+				}
+				BOOST_CHECK_EQUAL(closest, PN.neighbourVerts[iV]);
+			}
+		}
+	}
+}
+
+// Refining parts on several threads, each allocating its own, gives the
+// same part files and interface tables as refining them one at a time.
+BOOST_AUTO_TEST_CASE(ParallelPartsMatchSerial) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMRefined(UM, 3);
+	BOOST_REQUIRE(UMRefined.writeUGridFile("/tmp/test-exa-coarse.b8.ugrid"));
+	UMesh UMCoarse("/tmp/test-exa-coarse", "ugrid", "b8");
+
+	const int nParts = 7;
+	std::vector<Part> parts;
+	std::vector<CellPartData> vecCPD;
+	partitionCells(&UMCoarse, nParts, parts, vecCPD);
+#ifdef _OPENMP
+	const int oldThreads = omp_get_max_threads();
+	omp_set_num_threads(1);
+#endif
+	UMCoarse.refineForParallel(3, parts, vecCPD, "/tmp/test-exa-serial");
+#ifdef _OPENMP
+	omp_set_num_threads(4);
+#endif
+	pinInitialThread();
+	UMCoarse.refineForParallel(3, parts, vecCPD, "/tmp/test-exa-threaded");
+	unpinInitialThread();
+#ifdef _OPENMP
+	omp_set_num_threads(oldThreads);
+#endif
+
+	for (int ii = 0; ii < nParts; ii++) {
+		for (const char* suffix : { "." NATIVE_UGRID_INFIX ".ugrid", ".interface" }) {
+			char serialName[100], threadedName[100];
+			snprintf(serialName, sizeof(serialName), "/tmp/test-exa-serial%03d%s",
+								ii, suffix);
+			snprintf(threadedName, sizeof(threadedName),
+								"/tmp/test-exa-threaded%03d%s", ii, suffix);
+			const std::vector<char> serial = readFileBytes(serialName);
+			BOOST_CHECK(!serial.empty());
+			BOOST_CHECK(serial == readFileBytes(threadedName));
+		}
+	}
+}
+
+// The single file is laid out from keys found before refinement, which
+// must be the ones the refined parts have.  Parts are written by whichever
+// thread gets them, but the file mustn't depend on that.
+BOOST_AUTO_TEST_CASE(ThreadedSingleFileMatchesSerial) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMRefined(UM, 3);
+	BOOST_REQUIRE(UMRefined.writeUGridFile("/tmp/test-exa-coarse.b8.ugrid"));
+	UMesh UMCoarse("/tmp/test-exa-coarse", "ugrid", "b8");
+
+	const int nDivs = 3;
+	std::vector<Part> parts;
+	std::vector<CellPartData> vecCPD;
+	partitionCells(&UMCoarse, 7, parts, vecCPD);
+	for (Part& P : parts) {
+		PartInterface PI;
+		std::unique_ptr<UMesh> coarse = UMCoarse.extractCoarseMesh(P, vecCPD,
+																															&PI);
+		const std::vector<InterfaceVert> keys = findInterfaceKeys(*coarse, PI,
+																															nDivs);
+		UMesh UMPart(*coarse, nDivs, nullptr, &PI.lattices);
+		const std::vector<InterfaceVert> IVs = findInterfaceVerts(PI, nDivs);
+		BOOST_REQUIRE_EQUAL(keys.size(), IVs.size());
+		for (size_t ii = 0; ii < keys.size(); ii++) {
+			BOOST_CHECK(keys[ii].key == IVs[ii].key);
+			BOOST_CHECK_EQUAL(keys[ii].fineVert, ii);
+		}
+	}
+
+#ifdef _OPENMP
+	const int oldThreads = omp_get_max_threads();
+	omp_set_num_threads(1);
+#endif
+	BOOST_REQUIRE(UMCoarse.refineIntoSingleFile(nDivs, parts, vecCPD,
+																							"/tmp/test-exa-single1.b8.ugrid"));
+#ifdef _OPENMP
+	omp_set_num_threads(4);
+#endif
+	BOOST_REQUIRE(UMCoarse.refineIntoSingleFile(nDivs, parts, vecCPD,
+																							"/tmp/test-exa-single4.b8.ugrid"));
+#ifdef _OPENMP
+	omp_set_num_threads(oldThreads);
+#endif
+	const std::vector<char> serial = readFileBytes(
+			"/tmp/test-exa-single1.b8.ugrid");
+	BOOST_CHECK(!serial.empty());
+	BOOST_CHECK(serial == readFileBytes("/tmp/test-exa-single4.b8.ugrid"));
+
+	// Any cell face matched by no other cell or bdry face would be added as
+	// a bdry face here.
+	UMesh UMSerial(UMCoarse, nDivs);
+	UMesh UMFilled("/tmp/test-exa-single4", "ugrid", "b8");
+	BOOST_CHECK_EQUAL(UMFilled.numVerts(), UMSerial.numVerts());
+	BOOST_CHECK_EQUAL(UMFilled.numCells(), UMSerial.numCells());
+	BOOST_CHECK_EQUAL(UMFilled.numBdryTris(), UMSerial.numBdryTris());
+	BOOST_CHECK_EQUAL(UMFilled.numBdryQuads(), UMSerial.numBdryQuads());
+}
+
+// Checks each vert and each batch of faces or cells against the same mesh
+// refined into a UMesh, without keeping any of them.
+class CheckingSink: public StreamingSink {
+	const UMesh& m_UM;
+protected:
+	void newVert(const emInt index, const double coords[3]) {
+		double expected[3];
+		m_UM.getCoords(index, expected);
+		if (!std::equal(coords, coords + 3, expected)) nBadVerts++;
+	}
+	void cells(const int type, const emInt first, const emInt conn[],
+			const emInt count) {
+		static const int nPts[] = { 0, 3, 4, 4, 5, 6, 8 };
+		const emInt* expected = nullptr;
+		switch (type) {
+			case 1:
+				expected = m_UM.getBdryTriConn(first);
+				break;
+			case 2:
+				expected = m_UM.getBdryQuadConn(first);
+				break;
+			case 3:
+				expected = m_UM.getTetConn(first);
+				break;
+			case 4:
+				expected = m_UM.getPyrConn(first);
+				break;
+			case 5:
+				expected = m_UM.getPrismConn(first);
+				break;
+			case 6:
+				expected = m_UM.getHexConn(first);
+				break;
+		}
+		BOOST_REQUIRE(expected);
+		BOOST_CHECK(std::equal(conn, conn + nPts[type] * count, expected));
+		nBatches++;
+	}
+public:
+	int nBatches, nBadVerts;
+	CheckingSink(const UMesh& UM) :
+			m_UM(UM), nBatches(0), nBadVerts(0) {
+	}
+};
+
+BOOST_AUTO_TEST_CASE(StreamingRefinement) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMOut(UM, 4);
+
+	CheckingSink sink(UMOut);
+	BOOST_CHECK_EQUAL(subdividePartMesh(&UM, &sink, 4), UMOut.numCells());
+	BOOST_CHECK_GT(sink.nBatches, 6);
+	BOOST_CHECK_EQUAL(sink.numVerts(), UMOut.numVerts());
+	BOOST_CHECK_EQUAL(sink.numOfType(1), UMOut.numBdryTris());
+	BOOST_CHECK_EQUAL(sink.numOfType(2), UMOut.numBdryQuads());
+	BOOST_CHECK_EQUAL(sink.numOfType(3), UMOut.numTets());
+	BOOST_CHECK_EQUAL(sink.numOfType(4), UMOut.numPyramids());
+	BOOST_CHECK_EQUAL(sink.numOfType(5), UMOut.numPrisms());
+	BOOST_CHECK_EQUAL(sink.numOfType(6), UMOut.numHexes());
+	BOOST_CHECK_EQUAL(sink.nBadVerts, 0);
+	// Only the coarse verts and those on bdry edges are still kept.
+	std::set<Edge> bdryEdges;
+	for (emInt ii = 0; ii < UM.numBdryTris(); ii++) {
+		const emInt* const conn = UM.getBdryTriConn(ii);
+		for (int jj = 0; jj < 3; jj++) {
+			bdryEdges.insert(Edge(conn[jj], conn[(jj + 1) % 3]));
+		}
+	}
+	for (emInt ii = 0; ii < UM.numBdryQuads(); ii++) {
+		const emInt* const conn = UM.getBdryQuadConn(ii);
+		for (int jj = 0; jj < 4; jj++) {
+			bdryEdges.insert(Edge(conn[jj], conn[(jj + 1) % 4]));
+		}
+	}
+	BOOST_CHECK_EQUAL(sink.numLiveVerts(),
+										UM.numVerts() + 3 * bdryEdges.size());
+	BOOST_CHECK_LT(sink.maxLiveVerts(), size_t(UMOut.numVerts()));
+}
+
+// Streaming refinement writes the same UGRID file as refining in memory,
+// in any variant.
+BOOST_AUTO_TEST_CASE(StreamingUGridFile) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMRefined(UM, 2);
+	BOOST_REQUIRE(UMRefined.writeUGridFile("/tmp/test-exa-coarse.b8.ugrid"));
+	UMesh UMCoarse("/tmp/test-exa-coarse", "ugrid", "b8");
+	UMesh UMOut(UMCoarse, 5);
+
+	const char* infixes[] = { NATIVE_UGRID_INFIX, "b8", "r8", "lr4" };
+	for (const char* infix : infixes) {
+		char inMemName[100], streamedName[100];
+		snprintf(inMemName, sizeof(inMemName), "/tmp/test-exa.%s.ugrid", infix);
+		snprintf(streamedName, sizeof(streamedName),
+							"/tmp/test-exa-streamed.%s.ugrid", infix);
+		BOOST_REQUIRE(UMOut.writeUGridFile(inMemName));
+		BOOST_REQUIRE(UMCoarse.refineIntoUGridFile(5, streamedName));
+		BOOST_CHECK(readFileBytes(inMemName) == readFileBytes(streamedName));
+	}
+	BOOST_CHECK(!UMCoarse.refineIntoUGridFile(5, "/tmp/test-exa.b8.ugrid.z"));
+}
+
+BOOST_AUTO_TEST_CASE(VirtualFineMeshMatchesRefinement) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	// Read back from a file, so that the coarse mesh has length scales.
+	UMesh UMRefined(UM, 3);
+	BOOST_REQUIRE(UMRefined.writeUGridFile("/tmp/test-exa-coarse.b8.ugrid"));
+	UMesh UMCoarse("/tmp/test-exa-coarse", "ugrid", "b8");
+
+	UMesh UMOut(UMCoarse, 4);
+	VirtualFineMesh VFM(UMCoarse, 4);
+	BOOST_CHECK_EQUAL(VFM.numVerts(), UMOut.numVerts());
+	BOOST_CHECK_EQUAL(VFM.numBdryTris(), UMOut.numBdryTris());
+	BOOST_CHECK_EQUAL(VFM.numBdryQuads(), UMOut.numBdryQuads());
+	BOOST_CHECK_EQUAL(VFM.numTets(), UMOut.numTets());
+	BOOST_CHECK_EQUAL(VFM.numPyramids(), UMOut.numPyramids());
+	BOOST_CHECK_EQUAL(VFM.numPrisms(), UMOut.numPrisms());
+	BOOST_CHECK_EQUAL(VFM.numHexes(), UMOut.numHexes());
+
+	// Every fine cell is the same, vert by vert, up to vert numbering, and
+	// the two numberings match one to one.
+	std::vector<emInt> toSerial(VFM.numVerts(), EMINT_MAX);
+	std::vector<emInt> fromSerial(UMOut.numVerts(), EMINT_MAX);
+	bool allMatch = true;
+	auto compare = [&](const emInt* virtualConn, const emInt* serialConn,
+			const int nPts) {
+		for (int ii = 0; ii < nPts; ii++) {
+			const emInt vv = virtualConn[ii], vs = serialConn[ii];
+			double coords[3], coordsSerial[3];
+			VFM.getCoords(vv, coords);
+			UMOut.getCoords(vs, coordsSerial);
+			if (toSerial[vv] == EMINT_MAX && fromSerial[vs] == EMINT_MAX) {
+				toSerial[vv] = vs;
+				fromSerial[vs] = vv;
+			}
+			allMatch = allMatch && toSerial[vv] == vs
+					&& std::equal(coords, coords + 3, coordsSerial);
+		}
+	};
+	// Backwards, to go through the coarse cells in a different order.
+	for (emInt ii = UMOut.numTets(); ii-- > 0;) {
+		compare(VFM.getTetConn(ii), UMOut.getTetConn(ii), 4);
+	}
+	for (emInt ii = 0; ii < UMOut.numPyramids(); ii++) {
+		compare(VFM.getPyrConn(ii), UMOut.getPyrConn(ii), 5);
+	}
+	for (emInt ii = 0; ii < UMOut.numPrisms(); ii++) {
+		compare(VFM.getPrismConn(ii), UMOut.getPrismConn(ii), 6);
+	}
+	for (emInt ii = 0; ii < UMOut.numHexes(); ii++) {
+		compare(VFM.getHexConn(ii), UMOut.getHexConn(ii), 8);
+	}
+	for (emInt ii = 0; ii < UMOut.numBdryTris(); ii++) {
+		compare(VFM.getBdryTriConn(ii), UMOut.getBdryTriConn(ii), 3);
+	}
+	for (emInt ii = 0; ii < UMOut.numBdryQuads(); ii++) {
+		compare(VFM.getBdryQuadConn(ii), UMOut.getBdryQuadConn(ii), 4);
+	}
+	BOOST_CHECK(allMatch);
+	BOOST_CHECK(
+			std::find(toSerial.begin(), toSerial.end(), EMINT_MAX) == toSerial.end());
+
+	BOOST_REQUIRE(UMOut.writeUGridFile("/tmp/test-exa-virtual.b8.ugrid"));
+	UMesh UMFine("/tmp/test-exa-virtual", "ugrid", "b8");
+	BOOST_CHECK_EQUAL(VFM.numBdryVerts(), UMFine.numBdryVerts());
+}
+
+// Each thread reading a virtual mesh has its own cache, so reads from four
+// threads must give what reads from one do.
+BOOST_AUTO_TEST_CASE(VirtualFineMeshThreadedReads) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMRefined(UM, 3);
+	BOOST_REQUIRE(UMRefined.writeUGridFile("/tmp/test-exa-coarse.b8.ugrid"));
+	UMesh UMCoarse("/tmp/test-exa-coarse", "ugrid", "b8");
+
+#ifdef _OPENMP
+	const int oldThreads = omp_get_max_threads();
+	omp_set_num_threads(4);
+#endif
+	VirtualFineMesh VFM(UMCoarse, 4);
+	// Conn of every cell, then coords of every vert; each thread takes
+	// scattered cells, so the threads keep evicting each other's cells if
+	// the caches are shared.
+	auto sweep = [&](std::vector<emInt>& conn, std::vector<double>& coords) {
+		const emInt nTets = VFM.numTets(), nPyrs = VFM.numPyramids();
+		const emInt nPrisms = VFM.numPrisms(), nHexes = VFM.numHexes();
+		conn.assign(4 * size_t(nTets) + 5 * size_t(nPyrs) + 6 * size_t(nPrisms)
+				+ 8 * size_t(nHexes), EMINT_MAX);
+		coords.assign(3 * size_t(VFM.numVerts()), 0);
+		emInt* const pyrs = conn.data() + 4 * size_t(nTets);
+		emInt* const prisms = pyrs + 5 * size_t(nPyrs);
+		emInt* const hexes = prisms + 6 * size_t(nPrisms);
+#pragma omp parallel for schedule(dynamic, 7)
+		for (emInt ii = 0; ii < nTets; ii++) {
+			std::copy(VFM.getTetConn(ii), VFM.getTetConn(ii) + 4,
+								conn.data() + 4 * size_t(ii));
+		}
+#pragma omp parallel for schedule(dynamic, 7)
+		for (emInt ii = 0; ii < nPyrs; ii++) {
+			std::copy(VFM.getPyrConn(ii), VFM.getPyrConn(ii) + 5,
+								pyrs + 5 * size_t(ii));
+		}
+#pragma omp parallel for schedule(dynamic, 7)
+		for (emInt ii = 0; ii < nPrisms; ii++) {
+			std::copy(VFM.getPrismConn(ii), VFM.getPrismConn(ii) + 6,
+								prisms + 6 * size_t(ii));
+		}
+#pragma omp parallel for schedule(dynamic, 7)
+		for (emInt ii = 0; ii < nHexes; ii++) {
+			std::copy(VFM.getHexConn(ii), VFM.getHexConn(ii) + 8,
+								hexes + 8 * size_t(ii));
+		}
+#pragma omp parallel for schedule(dynamic, 7)
+		for (emInt vv = 0; vv < VFM.numVerts(); vv++) {
+			VFM.getCoords(vv, coords.data() + 3 * size_t(vv));
+		}
+	};
+	std::vector<emInt> connThreaded, connSerial;
+	std::vector<double> coordsThreaded, coordsSerial;
+	sweep(connThreaded, coordsThreaded);
+	const size_t edgesThreaded = countEdges(VFM);
+#ifdef _OPENMP
+	omp_set_num_threads(1);
+#endif
+	sweep(connSerial, coordsSerial);
+	const size_t edgesSerial = countEdges(VFM);
+#ifdef _OPENMP
+	omp_set_num_threads(oldThreads);
+#endif
+
+	BOOST_CHECK(connThreaded == connSerial);
+	BOOST_CHECK(coordsThreaded == coordsSerial);
+	BOOST_CHECK_EQUAL(edgesThreaded, edgesSerial);
+	UMesh UMOut(UMCoarse, 4);
+	BOOST_CHECK_EQUAL(edgesSerial, countEdges(UMOut));
+}
+
+BOOST_AUTO_TEST_CASE(SlimRefinedMesh) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMOut(UM, 4);
+
+	// No length scales, and the image is all accounted for.
+	const UMeshMemory UMM = UMOut.memoryUsage();
+	BOOST_CHECK_EQUAL(UMM.lengthScales, 0);
+	BOOST_CHECK_EQUAL(UMM.coords, 24 * size_t(UMOut.numVerts()));
+	BOOST_CHECK_EQUAL(UMM.tetConn, 4 * sizeof(emInt) * UMOut.numTets());
+	BOOST_CHECK_EQUAL(UMM.hexConn, 8 * sizeof(emInt) * UMOut.numHexes());
+	BOOST_CHECK_EQUAL(UMM.triBCs, sizeof(emInt) * UMOut.numBdryTris());
+	BOOST_CHECK_EQUAL(UMM.other, 7 * sizeof(emInt));
+	BOOST_CHECK_EQUAL(UMM.total(), UMOut.getFileImageSize());
+	BOOST_CHECK_GT(UMM.refineTables, 0);
+	BOOST_CHECK_EQUAL(UMOut.getLengthScale(0), 1);
+
+	// The unzeroed buffer doesn't leak into files; in particular, the BCs are
+	// all zero.
+	BOOST_REQUIRE(UMOut.writeUGridFile("/tmp/test-exa-slim.b8.ugrid"));
+	const size_t nFaces = size_t(UMOut.numBdryTris()) + UMOut.numBdryQuads();
+	std::vector<uint32_t> BCs(nFaces, 1);
+	FILE* file = fopen("/tmp/test-exa-slim.b8.ugrid", "rb");
+	BOOST_REQUIRE(file);
+	fseek(file,
+				28 + 24 * long(UMOut.numVerts())
+				+ 4 * (3 * long(UMOut.numBdryTris()) + 4 * long(UMOut.numBdryQuads())),
+				SEEK_SET);
+	BOOST_CHECK_EQUAL(fread(BCs.data(), 4, nFaces, file), nFaces);
+	fclose(file);
+	BOOST_CHECK(std::count(BCs.begin(), BCs.end(), 0) == long(nFaces));
+	UMesh UMRead("/tmp/test-exa-slim.b8.ugrid");
+	const UMeshMemory UMMRead = UMRead.memoryUsage();
+	BOOST_CHECK_EQUAL(UMMRead.lengthScales, 8 * size_t(UMRead.numVerts()));
+	BOOST_CHECK_EQUAL(UMMRead.refineTables, 0);
+}
+
+// Local allocations read as zero, with or without huge pages, and meshes
+// built in them refine the same either way.
+BOOST_AUTO_TEST_CASE(LocalAllocation) {
+	const size_t bytes = size_t(5) << 20;
+	for (const bool huge : { false, true }) {
+		setUseHugePages(huge);
+		const char* const mem = reinterpret_cast<char*>(allocateLocal(bytes));
+		BOOST_REQUIRE(mem);
+		BOOST_CHECK(std::count(mem, mem + bytes, 0) == long(bytes));
+		freeLocal(const_cast<char*>(mem), bytes);
+	}
+
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMHuge(UM, 30);
+	setUseHugePages(false);
+	UMesh UMSmall(UM, 30);
+	BOOST_REQUIRE_EQUAL(UMHuge.getFileImageSize(), UMSmall.getFileImageSize());
+	BOOST_CHECK(UMHuge.getFileImageSize() > (size_t(2) << 20));
+	BOOST_CHECK(std::equal(UMHuge.getTetConn(0),
+													UMHuge.getTetConn(0) + 4 * size_t(UMHuge.numTets()),
+													UMSmall.getTetConn(0)));
+}
+
+// Blocks freed while a pool is active are handed out again, and a refined
+// mesh built in one that's been used before writes the same file.
+BOOST_AUTO_TEST_CASE(LocalPoolReuse) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMFresh(UM, 20);
+	BOOST_REQUIRE(UMFresh.writeUGridFile("/tmp/test-exa-fresh.lb8.ugrid"));
+	{
+		LocalPool pool;
+		size_t capacity = 0;
+		bool isZero = false;
+		char* const mem = reinterpret_cast<char*>(allocateReusable(1 << 20, false,
+				capacity, isZero));
+		BOOST_REQUIRE(mem);
+		BOOST_CHECK(isZero);
+		BOOST_CHECK_GE(capacity, size_t(1 << 20));
+		mem[100] = 1;
+		freeReusable(mem, capacity);
+		size_t capacity2 = 0;
+		char* const mem2 = reinterpret_cast<char*>(allocateReusable(1 << 19, true,
+				capacity2, isZero));
+		BOOST_CHECK(mem2 == mem);
+		BOOST_CHECK_EQUAL(capacity2, capacity);
+		BOOST_CHECK(isZero);
+		BOOST_CHECK_EQUAL(mem2[100], 0);
+		freeReusable(mem2, capacity2);
+
+		// Leave a bigger, dirty image in the pool.
+		{
+			UMesh UMBig(UM, 30);
+		}
+		UMesh UMReused(UM, 20);
+		BOOST_REQUIRE(UMReused.writeUGridFile("/tmp/test-exa-reused.lb8.ugrid"));
+	}
+	BOOST_CHECK(
+			readWholeFile("/tmp/test-exa-reused.lb8.ugrid")
+					== readWholeFile("/tmp/test-exa-fresh.lb8.ugrid"));
+}
+
+BOOST_AUTO_TEST_CASE(FaceVertArenaReuse) {
+	FaceVertArena arena;
+	arena.setBlockSize(TriFaceVerts::numIntVerts(10));
+	BOOST_CHECK_EQUAL(arena.blockSize(), size_t(36));
+	TriFaceVerts TFV(0, 1, 2);
+	TFV.allocVertMemory(10, arena);
+	BOOST_REQUIRE(TFV.intVerts);
+	TFV.intVert(7, 0) = 7;
+	emInt* const other = arena.allocate();
+	BOOST_CHECK(other + 36 == TFV.intVerts || TFV.intVerts + 36 == other);
+	TFV.freeVertMemory(arena);
+	BOOST_CHECK(arena.allocate() == TFV.intVerts);
+
+	// Bulk release hands the same slabs out again.
+	std::set<emInt*> blocks;
+	for (int ii = 0; ii < 5000; ii++) {
+		blocks.insert(arena.allocate());
+	}
+	BOOST_CHECK_EQUAL(blocks.size(), size_t(5000));
+	const size_t nSlabs = arena.numSlabs();
+	BOOST_CHECK_GT(nSlabs, size_t(1));
+	arena.clear();
+	// As many blocks as were out before.
+	for (int ii = 0; ii < 5002; ii++) {
+		arena.allocate();
+	}
+	BOOST_CHECK_EQUAL(arena.numSlabs(), nSlabs);
+
+	// Too few divisions for interior verts.
+	arena.setBlockSize(TriFaceVerts::numIntVerts(2));
+	BOOST_CHECK_EQUAL(arena.numSlabs(), size_t(0));
+	BOOST_CHECK(arena.allocate() == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(DihedralAngles) {
+	const double A[] = { 0, 0, 0 }, B[] = { 0, 0, 2 }, C[] = { 1, 0, 5 },
+			D[] = { 0, 3, -1 }, E[] = { -1, -1, 1 };
+	BOOST_CHECK_CLOSE(dihedralAngle(A, B, C, D), M_PI / 2, 1.e-10);
+	BOOST_CHECK_CLOSE(dihedralAngle(B, A, D, C), M_PI / 2, 1.e-10);
+	BOOST_CHECK_CLOSE(dihedralAngle(A, B, C, E), 3 * M_PI / 4, 1.e-10);
+	BOOST_CHECK_SMALL(dihedralAngle(A, B, C, C), 1.e-12);
+}
+
+// Once every cell around an interior edge has been refined, the edge is out
+// of the table; only the bdry edges are left for the bdry faces.
+BOOST_AUTO_TEST_CASE(RetireInteriorEdges) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMRefined(UM, 2);
+	BOOST_REQUIRE(UMRefined.writeUGridFile("/tmp/test-exa-retire.b8.ugrid"));
+	UMesh UMCoarse("/tmp/test-exa-retire", "ugrid", "b8");
+
+	std::set<Edge> bdryEdges;
+	for (emInt ii = 0; ii < UMCoarse.numBdryTris(); ii++) {
+		const emInt* const conn = UMCoarse.getBdryTriConn(ii);
+		for (int jj = 0; jj < 3; jj++) {
+			bdryEdges.insert(Edge(conn[jj], conn[(jj + 1) % 3]));
+		}
+	}
+	for (emInt ii = 0; ii < UMCoarse.numBdryQuads(); ii++) {
+		const emInt* const conn = UMCoarse.getBdryQuadConn(ii);
+		for (int jj = 0; jj < 4; jj++) {
+			bdryEdges.insert(Edge(conn[jj], conn[(jj + 1) % 4]));
+		}
+	}
+
+	const int nDivs = 3;
+	UMesh UMFine(64 * UMCoarse.numVerts(), 0, 0, 0,
+								27 * (UMCoarse.numTets() + 4 * UMCoarse.numPyramids()),
+								27 * UMCoarse.numPyramids(), 27 * UMCoarse.numPrisms(),
+								27 * UMCoarse.numHexes());
+	for (emInt iV = 0; iV < UMCoarse.numVerts(); iV++) {
+		double coords[3];
+		UMCoarse.getCoords(iV, coords);
+		UMFine.addVert(coords);
+	}
+	exa_map<Edge, EdgeVerts> vertsOnEdges;
+	exa_set<TriFaceVerts> vertsOnTris;
+	exa_set<QuadFaceVerts> vertsOnQuads;
+	FaceVertArena triArena, quadArena;
+	triArena.setBlockSize(TriFaceVerts::numIntVerts(nDivs));
+	quadArena.setBlockSize(QuadFaceVerts::numIntVerts(nDivs));
+
+	TetDivider<0> TD(&UMFine, &UMCoarse, nDivs);
+	PyrDivider<0> PD(&UMFine, &UMCoarse, nDivs);
+	PrismDivider<0> PrismD(&UMFine, &UMCoarse, nDivs);
+	HexDivider<0> HD(&UMFine, &UMCoarse, nDivs);
+	TD.setFaceArenas(triArena, quadArena);
+	PD.setFaceArenas(triArena, quadArena);
+	PrismD.setFaceArenas(triArena, quadArena);
+	HD.setFaceArenas(triArena, quadArena);
+	for (emInt ii = 0; ii < UMCoarse.numTets(); ii++) {
+		TD.refineCell(UMCoarse.getTetConn(ii), vertsOnEdges, vertsOnTris,
+									vertsOnQuads);
+	}
+	for (emInt ii = 0; ii < UMCoarse.numPyramids(); ii++) {
+		PD.refineCell(UMCoarse.getPyrConn(ii), vertsOnEdges, vertsOnTris,
+									vertsOnQuads);
+	}
+	for (emInt ii = 0; ii < UMCoarse.numPrisms(); ii++) {
+		PrismD.refineCell(UMCoarse.getPrismConn(ii), vertsOnEdges, vertsOnTris,
+											vertsOnQuads);
+	}
+	for (emInt ii = 0; ii < UMCoarse.numHexes(); ii++) {
+		HD.refineCell(UMCoarse.getHexConn(ii), vertsOnEdges, vertsOnTris,
+									vertsOnQuads);
+	}
+
+	BOOST_CHECK_EQUAL(vertsOnEdges.size(), bdryEdges.size());
+	for (const Edge& E : bdryEdges) {
+		BOOST_CHECK(vertsOnEdges.count(E) == 1);
+	}
+	// Every fine vert was made once.
+	BOOST_CHECK_EQUAL(UMFine.numVerts(), UMesh(UMCoarse, nDivs).numVerts());
+}
+
+// Reordering a coarse part for locality renumbers it, but refining it
+// gives the same fine mesh.
+BOOST_AUTO_TEST_CASE(LocalityOrdering) {
+	UMesh UM(11, 11, 6, 6, 1, 1, 1, 1);
+	addMixedMeshEntities(UM);
+	UMesh UMRefined(UM, 3);
+	BOOST_REQUIRE(UMRefined.writeUGridFile("/tmp/test-exa-coarse.b8.ugrid"));
+	UMesh UMCoarse("/tmp/test-exa-coarse", "ugrid", "b8");
+
+	std::vector<Part> parts;
+	std::vector<CellPartData> vecCPD;
+	partitionCells(&UMCoarse, 2, parts, vecCPD);
+	const emInt first = parts[0].getFirst(), last = parts[0].getLast();
+	std::vector<CellPartData> sortedCPD(vecCPD);
+	PartInterface PI;
+	UMCoarse.setOrderPartsForLocality(true);
+	std::unique_ptr<UMesh> pSorted = UMCoarse.extractCoarseMesh(parts[0],
+																															sortedCPD, &PI);
+	UMCoarse.setOrderPartsForLocality(false);
+	std::unique_ptr<UMesh> pPlain = UMCoarse.extractCoarseMesh(parts[0], vecCPD);
+
+	// The same cells, in a new order.
+	std::multiset<std::pair<emInt, emInt> > cells, sortedCells;
+	for (emInt ii = first; ii < last; ii++) {
+		cells.insert(std::make_pair(vecCPD[ii].getCellType(),
+																vecCPD[ii].getIndex()));
+		sortedCells.insert(std::make_pair(sortedCPD[ii].getCellType(),
+																			sortedCPD[ii].getIndex()));
+	}
+	BOOST_CHECK(cells == sortedCells);
+
+	// The verts are numbered in the order the sorted cells first use them.
+	std::map<emInt, emInt> globalToCoarse;
+	for (emInt vv = 0; vv < PI.coarseToGlobal.size(); vv++) {
+		globalToCoarse[PI.coarseToGlobal[vv]] = vv;
+	}
+	emInt nextVert = 0;
+	bool isFirstUse = true;
+	for (emInt ii = first; ii < last; ii++) {
+		const emInt ind = sortedCPD[ii].getIndex();
+		const emInt* conn = nullptr;
+		int nPts = 0;
+		switch (sortedCPD[ii].getCellType()) {
+			case TETRA_4:
+				conn = UMCoarse.getTetConn(ind);
+				nPts = 4;
+				break;
+			case PYRA_5:
+				conn = UMCoarse.getPyrConn(ind);
+				nPts = 5;
+				break;
+			case PENTA_6:
+				conn = UMCoarse.getPrismConn(ind);
+				nPts = 6;
+				break;
+			case HEXA_8:
+				conn = UMCoarse.getHexConn(ind);
+				nPts = 8;
+				break;
+		}
+		for (int jj = 0; jj < nPts; jj++) {
+			const emInt vv = globalToCoarse[conn[jj]];
+			if (vv == nextVert) nextVert++;
+			else if (vv > nextVert) isFirstUse = false;
+		}
+	}
+	BOOST_CHECK(isFirstUse);
+	BOOST_CHECK_EQUAL(nextVert, pPlain->numVerts());
+
+	BOOST_CHECK_EQUAL(pSorted->numVerts(), pPlain->numVerts());
+	BOOST_CHECK_EQUAL(pSorted->numBdryTris(), pPlain->numBdryTris());
+	BOOST_CHECK_EQUAL(pSorted->numBdryQuads(), pPlain->numBdryQuads());
+	UMesh UMFineSorted(*pSorted, 4), UMFinePlain(*pPlain, 4);
+	BOOST_CHECK_EQUAL(UMFineSorted.numVerts(), UMFinePlain.numVerts());
+	BOOST_CHECK_EQUAL(UMFineSorted.numCells(), UMFinePlain.numCells());
+	BOOST_CHECK_EQUAL(UMFineSorted.numBdryTris(), UMFinePlain.numBdryTris());
+	BOOST_CHECK_EQUAL(UMFineSorted.numBdryQuads(), UMFinePlain.numBdryQuads());
+	printf("Peak refinement tables: %lu bytes sorted, %lu as partitioned\n",
+					UMFineSorted.memoryUsage().refineTables,
+					UMFinePlain.memoryUsage().refineTables);
+
+	// Parts still fit together when each is sorted.
+	UMCoarse.setOrderPartsForLocality(true);
+	BOOST_REQUIRE(UMCoarse.refineIntoSingleFile(3, parts, vecCPD,
+																							"/tmp/test-exa-local.b8.ugrid"));
+	UMesh UMSerial(UMCoarse, 3);
+	UMesh UMFilled("/tmp/test-exa-local", "ugrid", "b8");
+	BOOST_CHECK_EQUAL(UMFilled.numVerts(), UMSerial.numVerts());
+	BOOST_CHECK_EQUAL(UMFilled.numCells(), UMSerial.numCells());
+	BOOST_CHECK_EQUAL(UMFilled.numBdryTris(), UMSerial.numBdryTris());
+	BOOST_CHECK_EQUAL(UMFilled.numBdryQuads(), UMSerial.numBdryQuads());
+}
+
 BOOST_AUTO_TEST_SUITE(MappingTests)
 
 	BOOST_AUTO_TEST_CASE(TetMapping) {